@@ -0,0 +1,181 @@
+#include "Adversarial.h"
+#include "Harness.h"
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/impl/Tokenizer.h>
+#include <smallcalc/impl/Parser.h>
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+#include <math.h>
+
+using namespace sc;
+
+namespace bench {
+
+const char * adversarialKindName (AdversarialKind kind) {
+	switch (kind) {
+	case AK_NESTED_PARENTHESIS: return "nested_parenthesis";
+	case AK_NESTED_FUNCTIONS:   return "nested_functions";
+	case AK_NESTED_NEGATIONS:   return "nested_negations";
+	case AK_LONG_NUMBER:        return "long_number";
+	case AK_LONG_SUM:           return "long_sum";
+	case AK_FRACTION_SUM:       return "fraction_sum";
+	case AK_HUGE_EXPONENT:      return "huge_exponent";
+	default:                    return "unknown";
+	}
+}
+
+std::string adversarialInput (AdversarialKind kind, size_t n) {
+	std::string result;
+	switch (kind) {
+	case AK_NESTED_PARENTHESIS:
+		result.append (n, '(');
+		result += "1";
+		result.append (n, ')');
+		break;
+	case AK_NESTED_FUNCTIONS:
+		for (size_t i = 0; i < n; i++) result += "sin(";
+		result += "x";
+		result.append (n, ')');
+		break;
+	case AK_NESTED_NEGATIONS:
+		for (size_t i = 0; i < n; i++) result += "-(";
+		result += "1";
+		result.append (n, ')');
+		break;
+	case AK_LONG_NUMBER:
+		for (size_t i = 0; i < n; i++) result += (char) ('1' + i % 9);
+		break;
+	case AK_LONG_SUM:
+		result = "1";
+		for (size_t i = 1; i < n; i++) result += i % 2 ? "-1" : "+1";
+		break;
+	case AK_FRACTION_SUM: {
+		std::ostringstream s;
+		s << "1/2";
+		for (size_t i = 1; i < n; i++) s << "+1/" << (i + 2);
+		result = s.str();
+		break;
+	}
+	case AK_HUGE_EXPONENT: {
+		std::ostringstream s;
+		s << "(-1)^" << n * 1000;
+		result = s.str();
+		break;
+	}
+	default:
+		break;
+	}
+	return result;
+}
+
+namespace {
+
+enum Phase { PH_TOKENIZE, PH_PARSE, PH_EVAL, PH_COUNT };
+
+/// Times of one size, in ns
+struct Measurement {
+	Measurement () : n (0), bytes (0) {
+		for (int i = 0; i < PH_COUNT; i++) worst[i] = median[i] = 0;
+	}
+	size_t n;
+	size_t bytes;
+	double worst[PH_COUNT];
+	double median[PH_COUNT];
+};
+
+SmallCalc & calculator () {
+	static SmallCalc calc;
+	static bool initialized = false;
+	if (!initialized) {
+		calc.addAllStandard();
+		initialized = true;
+	}
+	return calc;
+}
+
+Measurement measure (const std::string & input, int repetitions) {
+	Measurement m;
+	m.bytes = input.size();
+	std::vector<double> samples[PH_COUNT];
+	VariableId x = calculator().idOfVariable ("x");
+	for (int r = 0; r < std::max (1, repetitions); r++) {
+		double t0 = nowNs();
+		Tokenizer tokenizer;
+		tokenizer.tokenize (input);
+		double t1 = nowNs();
+		Parser parser (calculator()._parserContext());
+		ExpressionPtr expression = parser.parse (tokenizer.result());
+		double t2 = nowNs();
+		EvaluationContext context;
+		context.accurateLevel = true;
+		context.setVariable (x, PrimitiveValue (Fraction64 (1, 3)));
+		PrimitiveValue value = expression->eval (&context);
+		double t3 = nowNs();
+		doNotOptimize (value);
+		samples[PH_TOKENIZE].push_back (t1 - t0);
+		samples[PH_PARSE].push_back (t2 - t1);
+		samples[PH_EVAL].push_back (t3 - t2);
+	}
+	for (int p = 0; p < PH_COUNT; p++) {
+		std::sort (samples[p].begin(), samples[p].end());
+		m.worst[p]  = samples[p].back();
+		m.median[p] = samples[p][samples[p].size() / 2];
+	}
+	return m;
+}
+
+/// Growth exponent of time against input length, from medians (worst times are too noisy)
+double exponent (const Measurement & a, const Measurement & b, Phase phase) {
+	double ta = std::max (a.median[phase], 1.0);
+	double tb = std::max (b.median[phase], 1.0);
+	if (b.bytes <= a.bytes) {
+		// Same length, any relevant growth is unbounded
+		return tb > ta * 1.5 ? HUGE_VAL : 0;
+	}
+	return log (tb / ta) / log ((double) b.bytes / a.bytes);
+}
+
+}
+
+int runScaling (const ScalingOptions & options) {
+	static const char * phaseNames[PH_COUNT] = { "tokenize", "parse", "eval" };
+	int flaggedKinds = 0;
+	printf ("%-20s %8s %9s %12s %12s %12s  %s\n", "kind", "n", "bytes", "tokenize us", "parse us", "eval us", "exponents (tokenize parse eval)");
+	for (int k = 0; k < AK_COUNT; k++) {
+		AdversarialKind kind = (AdversarialKind) k;
+		const char * name = adversarialKindName (kind);
+		if (!options.filter.empty() && std::string (name).find (options.filter) == std::string::npos) continue;
+		std::vector<std::string> flags;
+		Measurement last;
+		for (size_t n = std::max ((size_t) 1, options.minSize); n <= options.maxSize; n *= 2) {
+			Measurement m = measure (adversarialInput (kind, n), options.repetitions);
+			m.n = n;
+			printf ("%-20s %8lu %9lu %12.1f %12.1f %12.1f ", name, (unsigned long) n, (unsigned long) m.bytes,
+					m.worst[PH_TOKENIZE] / 1000, m.worst[PH_PARSE] / 1000, m.worst[PH_EVAL] / 1000);
+			if (last.n) {
+				for (int p = 0; p < PH_COUNT; p++) {
+					double e = exponent (last, m, (Phase) p);
+					printf (" %5.2f", e);
+					if (e > options.maxExponent && m.median[p] / 1000 > options.noiseFloorUs) {
+						flags.push_back (phaseNames[p]);
+					}
+				}
+			}
+			printf ("\n");
+			fflush (stdout);
+			last = m;
+		}
+		if (!flags.empty()) {
+			std::sort (flags.begin(), flags.end());
+			flags.erase (std::unique (flags.begin(), flags.end()), flags.end());
+			std::string phases;
+			for (size_t i = 0; i < flags.size(); i++) phases += (i ? ", " : "") + flags[i];
+			printf ("%-20s SUPER-LINEAR: %s\n", name, phases.c_str());
+			flaggedKinds++;
+		}
+	}
+	return flaggedKinds;
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * @file
+ * Adversarial (but valid) inputs and a harness for worst case latency scaling.
+ *
+ * Each input kind is generated for growing sizes n; the harness measures the
+ * worst tokenize, parse and eval time (accurate level) of every size and
+ * estimates the scaling exponent against the input length in bytes.
+ * Kinds whose time grows faster than allowed are flagged as super-linear.
+ */
+
+namespace bench {
+
+/// Kinds of generated inputs
+enum AdversarialKind {
+	AK_NESTED_PARENTHESIS, ///< ((((1))))
+	AK_NESTED_FUNCTIONS,   ///< sin(sin(sin(x)))
+	AK_NESTED_NEGATIONS,   ///< -(-(-(1)))
+	AK_LONG_NUMBER,        ///< 12345678901234...
+	AK_LONG_SUM,           ///< 1-1+1-1..., linear reference
+	AK_FRACTION_SUM,       ///< 1/2+1/3+1/5+..., overflows into double
+	AK_HUGE_EXPONENT,      ///< (-1)^(1000 n), the exponent grows, not the length
+	AK_COUNT
+};
+
+/// Returns the name of a kind
+const char * adversarialKindName (AdversarialKind kind);
+
+/// Generates an input of kind with size n
+std::string adversarialInput (AdversarialKind kind, size_t n);
+
+struct ScalingOptions {
+	ScalingOptions () : minSize (64), maxSize (4096), repetitions (5), maxExponent (1.5), noiseFloorUs (50) {}
+	size_t minSize;       ///< First n, doubled until maxSize
+	size_t maxSize;
+	int repetitions;      ///< Measurements per size, the worst is reported
+	double maxExponent;   ///< Flag growth faster than bytes^maxExponent
+	double noiseFloorUs;  ///< Do not flag phases faster than this
+	std::string filter;   ///< Only kinds containing this
+};
+
+/// Runs all kinds, prints a table and returns the number of flagged kinds
+int runScaling (const ScalingOptions & options);
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Harness.h"
+
+/**
+ * @file
+ * Registration of the benchmark groups of smallcalc_bench.
+ */
+
+namespace bench {
+
+/// Tokenizer, parser, tree evaluation, fractions and printing
+void addCoreBenchmarks (Suite & suite);
+
+/// Reactive recalculation of chained variables (DependencyGraph)
+void addDependencyBenchmarks (Suite & suite);
+
+/// Memoized function calls, user defined functions called and inlined
+void addFunctionBenchmarks (Suite & suite);
+
+/// Range reductions against written out sums, threads, closed forms
+void addReductionBenchmarks (Suite & suite);
+
+}
@@ -0,0 +1,181 @@
+#include "Benchmarks.h"
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/impl/Tokenizer.h>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/print/print.h>
+#include <smallcalc/Profiler.h>
+#include <smallcalc/Trace.h>
+#include <smallcalc/MemoryUsage.h>
+#include <boost/bind.hpp>
+#include <sstream>
+
+using namespace sc;
+
+namespace bench {
+
+namespace {
+
+const char * ShortFormula = "sin(x)*3 + 1/4 - sqrt(2)^x";
+
+/// Sum with many terms, like a long user input
+std::string longFormula (int terms) {
+	std::ostringstream s;
+	for (int i = 0; i < terms; i++) {
+		if (i > 0) s << "+";
+		s << "x*" << (i + 1) << "/(" << (i + 2) << "-x)";
+	}
+	return s.str();
+}
+
+/// sin(sin(...(x))), nested deeper than evaluation recurses
+std::string nestedFormula (int depth) {
+	std::string result;
+	for (int i = 0; i < depth; i++) result += "sin(";
+	result += "x";
+	result += std::string (depth, ')');
+	return result;
+}
+
+/// Calculator shared by all benchmarks of this file
+SmallCalc & calculator () {
+	static SmallCalc calc;
+	static bool initialized = false;
+	if (!initialized) {
+		calc.addAllStandard();
+		initialized = true;
+	}
+	return calc;
+}
+
+void tokenize (const std::string & input, size_t iterations) {
+	AllocationScope scope (AP_TOKENIZE);
+	for (size_t i = 0; i < iterations; i++) {
+		Tokenizer tokenizer;
+		tokenizer.tokenize (input);
+		doNotOptimize (tokenizer.result().size());
+	}
+}
+
+void parse (const std::vector<Token> & tokens, size_t iterations) {
+	AllocationScope scope (AP_PARSE);
+	for (size_t i = 0; i < iterations; i++) {
+		Parser parser (calculator()._parserContext());
+		ExpressionPtr result = parser.parse (tokens);
+		doNotOptimize (result.get());
+	}
+}
+
+void parseTraced (const std::vector<Token> & tokens, size_t iterations) {
+	setTracingEnabled ();
+	parse (tokens, iterations);
+	setTracingEnabled (false);
+	clearTrace ();
+}
+
+void evalLoop (const ExpressionPtr & expression, EvaluationContext & context, bool accurate, size_t iterations) {
+	context.accurateLevel = accurate;
+	VariableId x = calculator().idOfVariable ("x");
+	for (size_t i = 0; i < iterations; i++) {
+		context.setVariable (x, accurate ? PrimitiveValue (Fraction64 (1 + (i & 7), 3)) : doubleValue (1 + (i & 7) / 3.0));
+		PrimitiveValue v = expression->eval (&context);
+		doNotOptimize (v);
+	}
+}
+
+void eval (const ExpressionPtr & expression, bool accurate, size_t iterations) {
+	AllocationScope scope (AP_EVAL);
+	EvaluationContext context;
+	evalLoop (expression, context, accurate, iterations);
+}
+
+void evalProfiled (const ExpressionPtr & expression, size_t iterations) {
+	EvaluationProfiler profiler;
+	EvaluationContext context;
+	context.profiler = &profiler;
+	evalLoop (expression, context, false, iterations);
+}
+
+void fractionAdd (size_t iterations) {
+	bool overflow = false;
+	Fraction64 sum (0);
+	for (size_t i = 0; i < iterations; i++) {
+		// Harmonic numbers of 1..16, restarting before overflows
+		sum = addWithOverflowCheck (sum, Fraction64 (1, 1 + (i & 15)), &overflow);
+		if ((i & 15) == 15) sum = Fraction64 (0);
+	}
+	doNotOptimize (sum);
+	doNotOptimize (overflow);
+}
+
+void fractionMultDiv (size_t iterations) {
+	bool overflow = false;
+	Fraction64 a (355, 113);
+	Fraction64 b (22, 7);
+	for (size_t i = 0; i < iterations; i++) {
+		Fraction64 p = multWithOverflowCheck (a, b, &overflow);
+		Fraction64 q = divWithOverflowCheck (p, b, &overflow);
+		doNotOptimize (q);
+	}
+	doNotOptimize (overflow);
+}
+
+void fractionToDecimal (size_t iterations) {
+	Fraction64 f (1, 7);
+	for (size_t i = 0; i < iterations; i++) {
+		std::string s = f.toDecimal();
+		doNotOptimize (s.size());
+	}
+}
+
+void printExpression (const ExpressionPtr & expression, size_t iterations) {
+	for (size_t i = 0; i < iterations; i++) {
+		std::string s = print (expression);
+		doNotOptimize (s.size());
+	}
+}
+
+void addMemoryMetrics (Suite & suite, const std::string & name, const ExpressionPtr & expression) {
+	MemoryUsage usage = memoryUsage (expression);
+	suite.addMetric ("memory/" + name, (double) usage.bytes, "bytes");
+	suite.addMetric ("memory/" + name + "/per_node", usage.bytesPerNode(), "bytes/node");
+}
+
+std::vector<Token> tokens (const std::string & input) {
+	Tokenizer tokenizer;
+	tokenizer.tokenize (input);
+	return tokenizer.result();
+}
+
+}
+
+void addCoreBenchmarks (Suite & suite) {
+	// Inputs are prepared here, so that benchmarks only measure their operation
+	const std::string shortFormula = ShortFormula;
+	const std::string longFormula  = bench::longFormula (200);
+	ExpressionPtr shortExpression = calculator().parse (shortFormula);
+	ExpressionPtr longExpression  = calculator().parse (longFormula);
+	ExpressionPtr nestedExpression = calculator().parse (nestedFormula (10000));
+	suite.add ("tokenize/short", boost::bind (&tokenize, shortFormula, _1));
+	suite.add ("tokenize/long200", boost::bind (&tokenize, longFormula, _1));
+	suite.add ("parse/short", boost::bind (&parse, tokens (shortFormula), _1));
+	suite.add ("parse/long200", boost::bind (&parse, tokens (longFormula), _1));
+	suite.add ("parse/short/traced", boost::bind (&parseTraced, tokens (shortFormula), _1));
+	suite.add ("eval/double/short", boost::bind (&eval, shortExpression, false, _1));
+	suite.add ("eval/double/long200", boost::bind (&eval, longExpression, false, _1));
+	suite.add ("eval/double/nested10000", boost::bind (&eval, nestedExpression, false, _1));
+	suite.add ("eval/double/short/profiled", boost::bind (&evalProfiled, shortExpression, _1));
+	suite.add ("eval/accurate/fractions", boost::bind (&eval, calculator().parse ("x/3 + 1/4 - x*x/7"), true, _1));
+	suite.add ("eval/accurate/long200", boost::bind (&eval, longExpression, true, _1));
+	suite.add ("fraction/add", &fractionAdd);
+	suite.add ("fraction/multdiv", &fractionMultDiv);
+	suite.add ("fraction/toDecimal", &fractionToDecimal);
+	suite.add ("print/short", boost::bind (&printExpression, shortExpression, _1));
+	suite.add ("print/long200", boost::bind (&printExpression, longExpression, _1));
+	suite.add ("print/nested10000", boost::bind (&printExpression, nestedExpression, _1));
+
+	addMemoryMetrics (suite, "short", shortExpression);
+	addMemoryMetrics (suite, "long200", longExpression);
+	suite.addMetric ("memory/parser_context", (double) memoryUsage (*calculator()._parserContext()).bytes, "bytes");
+}
+
+}
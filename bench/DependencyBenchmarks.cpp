@@ -0,0 +1,83 @@
+#include "Benchmarks.h"
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/DependencyGraph.h>
+#include <sstream>
+
+using namespace sc;
+
+namespace bench {
+
+namespace {
+
+const int ChainLength = 100000;
+
+/// Reactive calculator with c0 = x, c1 = c0 + 1, ... and the last cell also reading y
+struct Chain {
+	Chain () {
+		calc.setReactive();
+		calc.eval ("x = 0");
+		calc.eval ("y = 0");
+		for (int i = 0; i < ChainLength; i++) {
+			std::ostringstream s;
+			s << "c" << i << " = ";
+			if (i == 0) s << "x";
+			else s << "c" << (i - 1) << " + 1";
+			if (i == ChainLength - 1) s << " + y";
+			calc.eval (s.str());
+			assignments.push_back (calc.lastExpression());
+		}
+		x = calc.idOfVariable ("x");
+		y = calc.idOfVariable ("y");
+	}
+
+	SmallCalc calc;
+	std::vector<ExpressionPtr> assignments;
+	VariableId x, y;
+};
+
+/// Built on first use, so that filtered runs don't pay for it
+Chain & chain () {
+	static Chain chain;
+	return chain;
+}
+
+/// Changes x, all cells are recalculated
+void changeHead (size_t iterations) {
+	Chain & c = chain();
+	for (size_t i = 0; i < iterations; i++) {
+		c.calc.setVariable (c.x, PrimitiveValue ((int64_t) (i & 7)));
+	}
+	doNotOptimize (c.calc.dependencies().lastRecalculated());
+}
+
+/// Changes y, only the last cell is recalculated
+void changeTail (size_t iterations) {
+	Chain & c = chain();
+	for (size_t i = 0; i < iterations; i++) {
+		c.calc.setVariable (c.y, PrimitiveValue ((int64_t) (i & 7)));
+	}
+	doNotOptimize (c.calc.dependencies().lastRecalculated());
+}
+
+/// What a host without dependency tracking does: evaluating all assignments again after a change
+void evalAll (size_t iterations) {
+	Chain & c = chain();
+	EvaluationContext context (c.calc.evaluationContext());
+	context.dependencies = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		context.setVariable (c.y, PrimitiveValue ((int64_t) (i & 7)));
+		for (size_t j = 0; j < c.assignments.size(); j++) {
+			doNotOptimize (c.assignments[j]->eval (&context));
+		}
+	}
+}
+
+}
+
+void addDependencyBenchmarks (Suite & suite) {
+	suite.add ("reactive/chain100000/change_head", &changeHead);
+	suite.add ("reactive/chain100000/change_tail", &changeTail);
+	suite.add ("reactive/chain100000/eval_all", &evalAll);
+}
+
+}
@@ -0,0 +1,100 @@
+#include "Benchmarks.h"
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/MemoTable.h>
+#include <smallcalc/ColumnEvaluator.h>
+#include <vector>
+#include <algorithm>
+#include <boost/bind.hpp>
+
+using namespace sc;
+
+namespace bench {
+
+namespace {
+
+/// Calculator with memoized sin and cos
+SmallCalc & memoCalculator () {
+	static SmallCalc calc;
+	static bool initialized = false;
+	if (!initialized) {
+		calc.addAllStandard();
+		calc.setMemoization ("sin", 1024);
+		calc.setMemoization ("cos", 1024);
+		initialized = true;
+	}
+	return calc;
+}
+
+/// Evaluates expression, x cycles through distinct values (all different for distinct = 0)
+void evalMemo (const ExpressionPtr & expression, size_t distinct, size_t iterations) {
+	AllocationScope scope (AP_EVAL);
+	EvaluationContext context;
+	VariableId x = memoCalculator().idOfVariable ("x");
+	for (size_t i = 0; i < iterations; i++) {
+		context.setVariable (x, doubleValue ((double) (distinct ? i % distinct : i)));
+		doNotOptimize (expression->eval (&context));
+	}
+}
+
+/// Calculator with the user defined functions of the userfn benchmarks
+SmallCalc & userCalculator () {
+	static SmallCalc calc;
+	static bool initialized = false;
+	if (!initialized) {
+		calc.addAllStandard();
+		calc.eval ("f(x, y) = x^2 + 3 * x * y - y / 2");
+		initialized = true;
+	}
+	return calc;
+}
+
+/// Tree evaluation, one row per iteration
+void evalUser (const ExpressionPtr & expression, size_t iterations) {
+	AllocationScope scope (AP_EVAL);
+	EvaluationContext context;
+	VariableId a = userCalculator().idOfVariable ("a");
+	for (size_t i = 0; i < iterations; i++) {
+		context.setVariable (a, doubleValue ((double) (i % 1000)));
+		doNotOptimize (expression->eval (&context));
+	}
+}
+
+/// Column evaluation, one row per iteration
+void evalUserColumn (const ExpressionPtr & expression, size_t inlineLimit, size_t iterations) {
+	const size_t rows = 1024;
+	std::vector<double> input (rows), output (rows);
+	for (size_t i = 0; i < rows; i++) input[i] = (double) i;
+	ColumnEvaluator evaluator;
+	evaluator.setInlineLimit (inlineLimit);
+	evaluator.compile (expression);
+	evaluator.bind (userCalculator().idOfVariable ("a"), &input[0]);
+	AllocationScope scope (AP_EVAL);
+	for (size_t done = 0; done < iterations; done += rows) {
+		evaluator.evaluate (std::min (rows, iterations - done), &output[0]);
+		doNotOptimize (output[0]);
+	}
+}
+
+}
+
+void addFunctionBenchmarks (Suite & suite) {
+	const char * formula = "sin(x) * cos(x)";
+	SmallCalc plain;
+	plain.addAllStandard();
+	ExpressionPtr plainExpression = plain.parse (formula);
+	ExpressionPtr memoExpression = memoCalculator().parse (formula);
+	suite.add ("memo/sincos/off", boost::bind (&evalMemo, plainExpression, 0, _1));
+	suite.add ("memo/sincos/hits", boost::bind (&evalMemo, memoExpression, 64, _1));
+	suite.add ("memo/sincos/misses", boost::bind (&evalMemo, memoExpression, 0, _1));
+
+	// user defined function against the same formula written out
+	ExpressionPtr userExpression = userCalculator().parse ("f(a, a + 1) + 1");
+	ExpressionPtr expandedExpression = userCalculator().parse ("a^2 + 3 * a * (a + 1) - (a + 1) / 2 + 1");
+	suite.add ("userfn/tree/call", boost::bind (&evalUser, userExpression, _1));
+	suite.add ("userfn/tree/expanded", boost::bind (&evalUser, expandedExpression, _1));
+	suite.add ("userfn/column/inlined", boost::bind (&evalUserColumn, userExpression, (size_t) ColumnEvaluator::DefaultInlineLimit, _1));
+	suite.add ("userfn/column/call", boost::bind (&evalUserColumn, userExpression, (size_t) 0, _1));
+	suite.add ("userfn/column/expanded", boost::bind (&evalUserColumn, expandedExpression, (size_t) 0, _1));
+}
+
+}
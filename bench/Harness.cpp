@@ -0,0 +1,197 @@
+#include "Harness.h"
+#include <smallcalc/AllocationStats.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#ifndef WIN32
+#include <time.h>
+#endif
+
+#ifndef SMALLCALC_BUILD_TYPE
+#define SMALLCALC_BUILD_TYPE "unknown"
+#endif
+
+namespace bench {
+
+double nowNs () {
+#ifndef WIN32
+	struct timespec t;
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+#else
+	static const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1000.0;
+#endif
+}
+
+void Suite::add (const std::string & name, const BenchmarkFunction & function) {
+	mBenchmarks.push_back (Entry (name, function));
+}
+
+void Suite::addMetric (const std::string & name, double value, const std::string & unit) {
+	mMetrics.push_back (Metric (name, value, unit));
+}
+
+std::vector<Metric> Suite::metrics (const Options & options) const {
+	std::vector<Metric> result;
+	for (size_t i = 0; i < mMetrics.size(); i++) {
+		if (!options.filter.empty() && mMetrics[i].name.find (options.filter) == std::string::npos) continue;
+		result.push_back (mMetrics[i]);
+	}
+	return result;
+}
+
+std::vector<Result> Suite::run (const Options & options) const {
+	std::vector<Result> results;
+	printf ("%-40s %12s %12s %12s %12s %10s %10s %10s\n", "benchmark", "median ns", "min ns", "mean ns", "stddev ns", "iterations", "allocs/op", "bytes/op");
+	for (size_t i = 0; i < mBenchmarks.size(); i++) {
+		const Entry & entry = mBenchmarks[i];
+		if (!options.filter.empty() && entry.first.find (options.filter) == std::string::npos) continue;
+		Result r = measure (entry.first, entry.second, options);
+		printf ("%-40s %12.1f %12.1f %12.1f %12.1f %10lu", r.name.c_str(), r.median, r.min, r.mean, r.stddev, (unsigned long) r.iterations);
+		if (r.countsAllocations) {
+			printf (" %10.1f %10.1f\n", r.allocationsPerOp, r.bytesPerOp);
+		} else {
+			printf (" %10s %10s\n", "-", "-");
+		}
+		fflush (stdout);
+		results.push_back (r);
+	}
+	return results;
+}
+
+Result Suite::measure (const std::string & name, const BenchmarkFunction & function, const Options & options) const {
+	Result result;
+	result.name = name;
+
+	// Calibrate, so that one repetition takes at least minTimeMs
+	const double minTime = options.minTimeMs * 1e6;
+	size_t iterations = 1;
+	while (true) {
+		double start = nowNs();
+		function (iterations);
+		double elapsed = nowNs() - start;
+		if (elapsed >= minTime || iterations >= ((size_t) 1 << 40)) break;
+		double factor = elapsed > 0 ? minTime / elapsed * 1.2 : 10;
+		iterations = (size_t) (iterations * std::min (10.0, std::max (1.5, factor)));
+	}
+	result.iterations = iterations;
+
+	for (int i = 0; i < options.warmup; i++) {
+		function (iterations);
+	}
+	for (int i = 0; i < std::max (1, options.repetitions); i++) {
+		double start = nowNs();
+		function (iterations);
+		result.samples.push_back ((nowNs() - start) / iterations);
+	}
+
+	if (sc::allocationStatsEnabled()) {
+		// Extra run, so that counting doesn't disturb the time measurement
+		sc::AllocationStats before = sc::threadAllocationStats();
+		function (iterations);
+		sc::AllocationStats counted = sc::threadAllocationStats() - before;
+		result.countsAllocations = true;
+		result.allocationsPerOp  = (double) counted.totalAllocations() / iterations;
+		result.bytesPerOp        = (double) counted.totalBytes() / iterations;
+	}
+
+	std::vector<double> sorted (result.samples);
+	std::sort (sorted.begin(), sorted.end());
+	size_t n = sorted.size();
+	result.min    = sorted.front();
+	result.max    = sorted.back();
+	result.median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+	double sum = 0;
+	for (size_t i = 0; i < n; i++) sum += sorted[i];
+	result.mean = sum / n;
+	double squares = 0;
+	for (size_t i = 0; i < n; i++) squares += (sorted[i] - result.mean) * (sorted[i] - result.mean);
+	result.stddev = n > 1 ? sqrt (squares / (n - 1)) : 0;
+	return result;
+}
+
+void printMetrics (const std::vector<Metric> & metrics) {
+	if (metrics.empty()) return;
+	printf ("\n%-40s %12s %s\n", "metric", "value", "unit");
+	for (size_t i = 0; i < metrics.size(); i++) {
+		printf ("%-40s %12.1f %s\n", metrics[i].name.c_str(), metrics[i].value, metrics[i].unit.c_str());
+	}
+}
+
+bool writeJson (const std::vector<Result> & results, const std::vector<Metric> & metrics, const std::string & file) {
+	std::ofstream out (file.c_str());
+	if (!out) return false;
+	out.precision (10);
+	out << "{\n";
+	out << "  \"context\": { \"build_type\": \"" << SMALLCALC_BUILD_TYPE << "\", \"date\": \""
+		<< boost::posix_time::to_iso_extended_string (boost::posix_time::second_clock::universal_time()) << "\" },\n";
+	out << "  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result & r = results[i];
+		out << "    { \"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+			<< ", \"repetitions\": " << r.samples.size()
+			<< ", \"median\": " << r.median << ", \"min\": " << r.min << ", \"mean\": " << r.mean
+			<< ", \"stddev\": " << r.stddev << ", \"max\": " << r.max << ", \"unit\": \"ns/op\"";
+		if (r.countsAllocations) {
+			out << ", \"allocs_per_op\": " << r.allocationsPerOp << ", \"bytes_per_op\": " << r.bytesPerOp;
+		}
+		out << " }"
+			<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ],\n";
+	out << "  \"metrics\": [\n";
+	for (size_t i = 0; i < metrics.size(); i++) {
+		const Metric & m = metrics[i];
+		out << "    { \"metric\": \"" << m.name << "\", \"value\": " << m.value << ", \"unit\": \"" << m.unit << "\" }"
+			<< (i + 1 < metrics.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+	return (bool) out;
+}
+
+bool readBaseline (const std::string & file, std::map<std::string, double> * medians) {
+	std::ifstream in (file.c_str());
+	if (!in) return false;
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	const std::string content = buffer.str();
+	// Only reads the format written by writeJson
+	const std::string nameKey = "\"name\": \"";
+	const std::string medianKey = "\"median\": ";
+	size_t pos = 0;
+	while ((pos = content.find (nameKey, pos)) != std::string::npos) {
+		pos += nameKey.size();
+		size_t nameEnd = content.find ('"', pos);
+		size_t median = content.find (medianKey, pos);
+		if (nameEnd == std::string::npos || median == std::string::npos) return false;
+		(*medians)[content.substr (pos, nameEnd - pos)] = atof (content.c_str() + median + medianKey.size());
+		pos = median;
+	}
+	return true;
+}
+
+int compareWithBaseline (const std::vector<Result> & results, const std::map<std::string, double> & medians, double threshold) {
+	int regressions = 0;
+	printf ("\n%-40s %12s %12s %9s\n", "benchmark", "baseline ns", "current ns", "change");
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result & r = results[i];
+		std::map<std::string, double>::const_iterator j = medians.find (r.name);
+		if (j == medians.end() || j->second <= 0) {
+			printf ("%-40s %12s %12.1f %9s\n", r.name.c_str(), "-", r.median, "new");
+			continue;
+		}
+		double change = (r.median - j->second) / j->second * 100;
+		bool regression = change > threshold;
+		if (regression) regressions++;
+		printf ("%-40s %12.1f %12.1f %+8.1f%%%s\n", r.name.c_str(), j->second, r.median, change, regression ? " REGRESSION" : "");
+	}
+	return regressions;
+}
+
+}
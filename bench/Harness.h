@@ -0,0 +1,97 @@
+#pragma once
+#include <boost/function.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <stddef.h>
+
+/**
+ * @file
+ * Small microbenchmark harness: calibrates iterations, does warmup runs,
+ * repeats measurements, calculates statistics, writes JSON and compares
+ * against a saved baseline.
+ */
+
+namespace bench {
+
+/// Keeps the compiler from optimizing a result away
+template <class T> inline void doNotOptimize (const T & value) {
+#ifdef __GNUC__
+	asm volatile ("" : : "g" (&value) : "memory");
+#else
+	static volatile const void * sink;
+	sink = &value;
+#endif
+}
+
+/// A benchmark runs its operation iterations times
+typedef boost::function<void (size_t iterations)> BenchmarkFunction;
+
+/// Measurement of one benchmark, times in nanoseconds per operation
+struct Result {
+	Result () : iterations (0), min (0), median (0), mean (0), stddev (0), max (0), countsAllocations (false), allocationsPerOp (0), bytesPerOp (0) {}
+	std::string name;
+	size_t iterations;            ///< Operations per repetition
+	std::vector<double> samples;  ///< ns/op of each repetition
+	double min, median, mean, stddev, max;
+	bool countsAllocations;       ///< Library compiled with SMALLCALC_ALLOCATION_STATS
+	double allocationsPerOp;
+	double bytesPerOp;
+};
+
+/// A value which is tracked with the results, but not timed (e.g. memory footprint)
+struct Metric {
+	Metric (const std::string & name, double value, const std::string & unit) : name (name), value (value), unit (unit) {}
+	std::string name;
+	double value;
+	std::string unit;
+};
+
+struct Options {
+	Options () : warmup (2), repetitions (10), minTimeMs (50), threshold (10) {}
+	int warmup;             ///< Unmeasured repetitions
+	int repetitions;        ///< Measured repetitions
+	double minTimeMs;       ///< Minimum duration of one repetition
+	std::string filter;     ///< Only run benchmarks containing this
+	std::string jsonFile;   ///< Write results to this file
+	std::string baseline;   ///< Compare with this result file
+	double threshold;       ///< Slower medians by more than this percentage are regressions
+};
+
+/// Set of named benchmarks
+class Suite {
+public:
+	void add (const std::string & name, const BenchmarkFunction & function);
+
+	/// Adds a metric, it is printed after the benchmarks and written to JSON
+	void addMetric (const std::string & name, double value, const std::string & unit);
+
+	/// Metrics matching the filter
+	std::vector<Metric> metrics (const Options & options) const;
+
+	/// Runs all benchmarks matching the filter and prints a line for each
+	std::vector<Result> run (const Options & options) const;
+private:
+	Result measure (const std::string & name, const BenchmarkFunction & function, const Options & options) const;
+
+	typedef std::pair<std::string, BenchmarkFunction> Entry;
+	std::vector<Entry> mBenchmarks;
+	std::vector<Metric> mMetrics;
+};
+
+/// Monotonic time in nanoseconds
+double nowNs ();
+
+/// Prints metrics as table
+void printMetrics (const std::vector<Metric> & metrics);
+
+/// Writes results and metrics as JSON, returns false on error
+bool writeJson (const std::vector<Result> & results, const std::vector<Metric> & metrics, const std::string & file);
+
+/// Reads the medians of a result file written by writeJson, returns false on error
+bool readBaseline (const std::string & file, std::map<std::string, double> * medians);
+
+/// Prints the comparison with a baseline, returns the number of regressions
+int compareWithBaseline (const std::vector<Result> & results, const std::map<std::string, double> & medians, double threshold);
+
+}
@@ -0,0 +1,64 @@
+#include "Benchmarks.h"
+#include <smallcalc/smallcalc.h>
+#include <boost/bind.hpp>
+#include <sstream>
+
+using namespace sc;
+
+namespace bench {
+
+namespace {
+
+const int Terms = 2000;
+
+/// sin(1) + sin(2) + ... written out, what users did before sum()
+std::string writtenOut () {
+	std::ostringstream s;
+	for (int k = 1; k <= Terms; k++) {
+		if (k > 1) s << " + ";
+		s << "sin(" << k << ")";
+	}
+	return s.str();
+}
+
+/// Parses and evaluates input, one formula per iteration
+void parseEval (const std::string & input, size_t iterations) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	for (size_t i = 0; i < iterations; i++) {
+		doNotOptimize (calc.eval (input));
+	}
+}
+
+/// Evaluates input (parsed once) with threads threads
+void evalThreads (const std::string & input, int threads, bool accurate, size_t iterations) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	calc.setThreads (threads);
+	calc.setAccurateLevel (accurate);
+	ExpressionPtr expression = calc.parse (input);
+	AllocationScope scope (AP_EVAL);
+	EvaluationContext context (calc.evaluationContext());
+	for (size_t i = 0; i < iterations; i++) {
+		doNotOptimize (expression->eval (&context));
+	}
+}
+
+}
+
+void addReductionBenchmarks (Suite & suite) {
+	std::ostringstream sum;
+	sum << "sum(k, 1, " << Terms << ", sin(k))";
+	suite.add ("reduce/sin2000/written_out", boost::bind (&parseEval, writtenOut(), _1));
+	suite.add ("reduce/sin2000/sum", boost::bind (&parseEval, sum.str(), _1));
+
+	// chunks on one thread against one thread per core, same result
+	suite.add ("reduce/sin100000/threads1", boost::bind (&evalThreads, "sum(k, 1, 100000, sin(k))", 1, false, _1));
+	suite.add ("reduce/sin100000/threads_all", boost::bind (&evalThreads, "sum(k, 1, 100000, sin(k))", 0, false, _1));
+
+	// polynomial summand: closed form against the loop over the same values (abs hides the polynomial)
+	suite.add ("reduce/poly100000/closed_form", boost::bind (&evalThreads, "sum(k, 1, 100000, k^2 + 3*k)", 1, true, _1));
+	suite.add ("reduce/poly100000/loop", boost::bind (&evalThreads, "sum(k, 1, 100000, abs(k)^2 + 3*abs(k))", 1, false, _1));
+}
+
+}
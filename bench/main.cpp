@@ -0,0 +1,88 @@
+#include "Benchmarks.h"
+#include "Adversarial.h"
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+#ifndef SMALLCALC_BUILD_TYPE
+#define SMALLCALC_BUILD_TYPE "unknown"
+#endif
+
+static int usage (const char * name) {
+	std::cerr << "Usage: " << name << " [--filter text] [--repetitions n] [--warmup n] [--min-time ms]" << std::endl;
+	std::cerr << "       [--json file] [--baseline file] [--threshold percent]" << std::endl;
+	std::cerr << "       " << name << " --scaling [--filter kind] [--repetitions n] [--max-size n] [--max-exponent x]" << std::endl;
+	std::cerr << "Runs the microbenchmarks; with --baseline, exits with 3 if a median got slower than threshold" << std::endl;
+	std::cerr << "With --scaling, measures worst case latency of adversarial inputs, exits with 4 on super-linear growth" << std::endl;
+	return 1;
+}
+
+int main (int argc, char * argv[]) {
+	bench::Options options;
+	bench::ScalingOptions scalingOptions;
+	bool scaling = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--scaling") {
+			scaling = true;
+			continue;
+		}
+		if (i + 1 >= argc) return usage (argv[0]);
+		if (arg == "--filter") {
+			options.filter = scalingOptions.filter = argv[++i];
+		} else if (arg == "--repetitions") {
+			options.repetitions = scalingOptions.repetitions = atoi (argv[++i]);
+		} else if (arg == "--max-size") {
+			scalingOptions.maxSize = atoi (argv[++i]);
+		} else if (arg == "--max-exponent") {
+			scalingOptions.maxExponent = atof (argv[++i]);
+		} else if (arg == "--warmup") {
+			options.warmup = atoi (argv[++i]);
+		} else if (arg == "--min-time") {
+			options.minTimeMs = atof (argv[++i]);
+		} else if (arg == "--json") {
+			options.jsonFile = argv[++i];
+		} else if (arg == "--baseline") {
+			options.baseline = argv[++i];
+		} else if (arg == "--threshold") {
+			options.threshold = atof (argv[++i]);
+		} else {
+			return usage (argv[0]);
+		}
+	}
+	std::string buildType = SMALLCALC_BUILD_TYPE;
+	if (buildType != "RELEASE" && buildType != "Release") {
+		std::cerr << "Warning: build type is " << buildType << ", configure with -DCMAKE_BUILD_TYPE=RELEASE for meaningful numbers" << std::endl;
+	}
+
+	if (scaling) {
+		return bench::runScaling (scalingOptions) > 0 ? 4 : 0;
+	}
+
+	bench::Suite suite;
+	bench::addCoreBenchmarks (suite);
+	bench::addDependencyBenchmarks (suite);
+	bench::addFunctionBenchmarks (suite);
+	bench::addReductionBenchmarks (suite);
+	std::vector<bench::Result> results = suite.run (options);
+	std::vector<bench::Metric> metrics = suite.metrics (options);
+	bench::printMetrics (metrics);
+
+	if (!options.jsonFile.empty() && !bench::writeJson (results, metrics, options.jsonFile)) {
+		std::cerr << "Could not write " << options.jsonFile << std::endl;
+		return 1;
+	}
+	if (!options.baseline.empty()) {
+		std::map<std::string, double> medians;
+		if (!bench::readBaseline (options.baseline, &medians)) {
+			std::cerr << "Could not read " << options.baseline << std::endl;
+			return 1;
+		}
+		int regressions = bench::compareWithBaseline (results, medians, options.threshold);
+		if (regressions > 0) {
+			std::cerr << regressions << " regressions" << std::endl;
+			return 3;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include "AllocationStats.h"
+
+namespace sc {
+
+const char * allocationPhaseName (AllocationPhase phase) {
+	switch (phase) {
+	case AP_OTHER:    return "other";
+	case AP_TOKENIZE: return "tokenize";
+	case AP_PARSE:    return "parse";
+	case AP_EVAL:     return "eval";
+	case AP_PRINT:    return "print";
+	default:          return "unknown";
+	}
+}
+
+void AllocationStats::clear () {
+	for (int i = 0; i < AP_COUNT; i++) {
+		allocations[i] = 0;
+		bytes[i] = 0;
+	}
+}
+
+uint64_t AllocationStats::totalAllocations () const {
+	uint64_t sum = 0;
+	for (int i = 0; i < AP_COUNT; i++) sum += allocations[i];
+	return sum;
+}
+
+uint64_t AllocationStats::totalBytes () const {
+	uint64_t sum = 0;
+	for (int i = 0; i < AP_COUNT; i++) sum += bytes[i];
+	return sum;
+}
+
+AllocationStats & AllocationStats::operator+= (const AllocationStats & other) {
+	for (int i = 0; i < AP_COUNT; i++) {
+		allocations[i] += other.allocations[i];
+		bytes[i] += other.bytes[i];
+	}
+	return *this;
+}
+
+AllocationStats AllocationStats::operator- (const AllocationStats & other) const {
+	AllocationStats result;
+	for (int i = 0; i < AP_COUNT; i++) {
+		result.allocations[i] = allocations[i] - other.allocations[i];
+		result.bytes[i] = bytes[i] - other.bytes[i];
+	}
+	return result;
+}
+
+#ifdef SMALLCALC_ALLOCATION_STATS
+
+namespace {
+
+/// Per thread state, plain old data so that it can live in __thread storage
+struct ThreadState {
+	AllocationPhase phase;
+	AllocationStats * sink;
+	uint64_t allocations[AP_COUNT];
+	uint64_t bytes[AP_COUNT];
+};
+
+#ifdef _MSC_VER
+__declspec(thread) ThreadState threadState;
+#else
+__thread ThreadState threadState;
+#endif
+
+AllocationHook hook = &countAllocation;
+
+}
+
+void recordAllocation (size_t bytes) {
+	hook (threadState.phase, bytes);
+}
+
+void countAllocation (AllocationPhase phase, size_t bytes) {
+	threadState.allocations[phase]++;
+	threadState.bytes[phase] += bytes;
+	if (threadState.sink) {
+		threadState.sink->allocations[phase]++;
+		threadState.sink->bytes[phase] += bytes;
+	}
+}
+
+void setAllocationHook (AllocationHook newHook) {
+	hook = newHook ? newHook : &countAllocation;
+}
+
+AllocationStats threadAllocationStats () {
+	AllocationStats result;
+	for (int i = 0; i < AP_COUNT; i++) {
+		result.allocations[i] = threadState.allocations[i];
+		result.bytes[i] = threadState.bytes[i];
+	}
+	return result;
+}
+
+AllocationScope::AllocationScope (AllocationPhase phase, AllocationStats * sink) {
+	mPreviousPhase = threadState.phase;
+	mPreviousSink  = threadState.sink;
+	threadState.phase = phase;
+	if (sink) threadState.sink = sink;
+}
+
+AllocationScope::~AllocationScope () {
+	threadState.phase = mPreviousPhase;
+	threadState.sink  = mPreviousSink;
+}
+
+#endif
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file
+ * Optional allocation accounting.
+ *
+ * If compiled with SMALLCALC_ALLOCATION_STATS (cmake -DSMALLCALC_ALLOCATION_STATS=ON),
+ * the allocation points of the library (expression nodes, refined primitive values,
+ * argument vectors during evaluation, token vectors and box arena blocks) report to an
+ * allocation hook. The default hook counts allocations and bytes per phase, per thread
+ * and into the statistics of the SmallCalc running the operation.
+ *
+ * Without the flag all functions here are empty inlines and scopes are empty objects.
+ */
+
+namespace sc {
+
+/// Phase an allocation is attributed to
+enum AllocationPhase {
+	AP_OTHER,
+	AP_TOKENIZE,
+	AP_PARSE,
+	AP_EVAL,
+	AP_PRINT,
+	AP_COUNT
+};
+
+/// Returns a printable name of a phase
+const char * allocationPhaseName (AllocationPhase phase);
+
+/// Counted allocations per phase
+struct AllocationStats {
+	AllocationStats () { clear (); }
+	void clear ();
+
+	uint64_t totalAllocations () const;
+	uint64_t totalBytes () const;
+
+	AllocationStats & operator+= (const AllocationStats & other);
+	AllocationStats operator- (const AllocationStats & other) const;
+
+	uint64_t allocations[AP_COUNT];
+	uint64_t bytes[AP_COUNT];
+};
+
+/// Receives all allocations of the library
+typedef void (*AllocationHook) (AllocationPhase phase, size_t bytes);
+
+#ifdef SMALLCALC_ALLOCATION_STATS
+
+inline bool allocationStatsEnabled () { return true; }
+
+/// Called at allocation points, forwards to the hook with the current phase
+void recordAllocation (size_t bytes);
+
+/// Default hook, counts into thread statistics and the current sink
+void countAllocation (AllocationPhase phase, size_t bytes);
+
+/// Replaces the hook (for all threads), 0 restores countAllocation
+void setAllocationHook (AllocationHook hook);
+
+/// Counted allocations of the current thread
+AllocationStats threadAllocationStats ();
+
+/// Sets the phase (and optionally the sink which additionally counts) of the current thread while alive
+class AllocationScope {
+public:
+	AllocationScope (AllocationPhase phase, AllocationStats * sink = 0);
+	~AllocationScope ();
+private:
+	AllocationPhase mPreviousPhase;
+	AllocationStats * mPreviousSink;
+	// forbidden
+	AllocationScope (const AllocationScope&);
+	void operator= (const AllocationScope&);
+};
+
+#else
+
+inline bool allocationStatsEnabled () { return false; }
+inline void recordAllocation (size_t bytes) {}
+inline void countAllocation (AllocationPhase phase, size_t bytes) {}
+inline void setAllocationHook (AllocationHook hook) {}
+inline AllocationStats threadAllocationStats () { return AllocationStats (); }
+
+class AllocationScope {
+public:
+	AllocationScope (AllocationPhase phase, AllocationStats * sink = 0) {}
+};
+
+#endif
+
+}
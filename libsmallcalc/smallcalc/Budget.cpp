@@ -0,0 +1,90 @@
+#include "Budget.h"
+#include "Trace.h"
+#include <algorithm>
+#include <limits>
+
+namespace sc {
+
+EvaluationBudget::EvaluationBudget () : mSteps (0), mShared (0), mSharers (1), mSharedAdded (0), mSharedSteps (0), mMaxSteps (0), mDeadlineNs (0), mCancel (0), mReason (0) {
+	scheduleCheck ();
+}
+
+void EvaluationBudget::setMaxSteps (uint64_t maxSteps) {
+	mMaxSteps = maxSteps;
+	scheduleCheck ();
+}
+
+void EvaluationBudget::setDeadline (uint64_t deadlineNs) {
+	mDeadlineNs = deadlineNs;
+	scheduleCheck ();
+}
+
+void EvaluationBudget::setTimeout (uint64_t timeoutNs) {
+	setDeadline (monotonicNs() + timeoutNs);
+}
+
+void EvaluationBudget::setCancelFlag (const boost::atomic<bool> * cancel) {
+	mCancel = cancel;
+	scheduleCheck ();
+}
+
+void EvaluationBudget::share (boost::atomic<uint64_t> * steps, unsigned sharers) {
+	mShared      = steps;
+	mSharers     = std::max (sharers, 1u);
+	mSharedAdded = mSteps;
+	mSharedSteps = steps ? steps->load() : 0;
+	scheduleCheck ();
+}
+
+void EvaluationBudget::reset () {
+	mSteps = 0;
+	mSharedAdded = 0;
+	mReason = 0;
+	scheduleCheck ();
+}
+
+PrimitiveValue EvaluationBudget::error () const {
+	return PrimitiveValue (error::Eval_BudgetExhausted, mReason ? mReason : "budget exhausted");
+}
+
+bool EvaluationBudget::check () {
+	if (mReason) return false;
+	uint64_t steps = mSteps;
+	if (mShared) {
+		mSharedSteps = (*mShared += mSteps - mSharedAdded);
+		mSharedAdded = mSteps;
+		steps = mSharedSteps;
+	}
+	if (mMaxSteps && steps > mMaxSteps) {
+		mReason = "step limit exceeded";
+	} else if (mCancel && mCancel->load (boost::memory_order_relaxed)) {
+		mReason = "cancelled";
+	} else if (mDeadlineNs && monotonicNs() >= mDeadlineNs) {
+		mReason = "deadline exceeded";
+	}
+	if (mReason) {
+		mNextCheck = 0; // every further step fails
+		return false;
+	}
+	scheduleCheck ();
+	return true;
+}
+
+void EvaluationBudget::scheduleCheck () {
+	if (mReason) {
+		mNextCheck = 0;
+		return;
+	}
+	uint64_t next = std::numeric_limits<uint64_t>::max();
+	if (mDeadlineNs || mCancel) next = mSteps + CheckInterval;
+	if (mMaxSteps && mShared) {
+		// the others consume as well, each gets its part of the remaining steps until the next check
+		uint64_t remaining = mSharedSteps > mMaxSteps ? 0 : mMaxSteps - mSharedSteps;
+		next = std::min (next, mSteps + std::max ((uint64_t) 1, std::min ((uint64_t) CheckInterval, remaining / mSharers)));
+	} else if (mMaxSteps) {
+		next = std::min (next, mMaxSteps + 1);
+	}
+	mNextCheck = next;
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "types.h"
+#include "PrimitiveValue.h"
+#include <boost/atomic.hpp>
+
+namespace sc {
+
+/**
+ * Limits of an evaluation, for running untrusted formulas at a fixed latency.
+ *
+ * Set it as EvaluationContext::budget; evaluation then consumes one step per
+ * evaluated function node and per iteration of long running loops (e.g. exact
+ * powers) and stops with error::Eval_BudgetExhausted when
+ * - more than the maximum number of steps were consumed,
+ * - the deadline (monotonicNs(), see Trace.h) passed or
+ * - the cancel flag got set (e.g. by another thread).
+ *
+ * The clock and the cancel flag are only looked at every CheckInterval steps,
+ * a step usually costs an addition and a comparison.
+ * Once exhausted, a budget stays exhausted until reset().
+ *
+ * Note: this is NOT threadsafe (apart from the cancel flag), use one budget per evaluating thread.
+ * Budgets of threads working on the same evaluation can share their step limit, see share().
+ */
+class EvaluationBudget {
+public:
+	/// Steps between looking at the clock and the cancel flag
+	enum { CheckInterval = 1024 };
+
+	EvaluationBudget ();
+
+	/// Maximum number of steps, 0 for no limit
+	void setMaxSteps (uint64_t maxSteps);
+	uint64_t maxSteps () const { return mMaxSteps; }
+
+	/// Absolute deadline in monotonicNs(), 0 for none
+	void setDeadline (uint64_t deadlineNs);
+	/// Sets the deadline timeoutNs from now
+	void setTimeout (uint64_t timeoutNs);
+	uint64_t deadline () const { return mDeadlineNs; }
+
+	/// Flag which cancels evaluation when set, 0 for none. Not owned.
+	void setCancelFlag (const boost::atomic<bool> * cancel);
+
+	/// Shares the step limit with sharers budgets (including this one, e.g. copies for the threads of a reduction):
+	/// consumed steps are added to steps at each check and the maximum applies to its value, which
+	/// must already include steps(). Checks get more frequent near the maximum, the sharers together
+	/// overshoot it by less than sharers * CheckInterval steps. 0 for none, not owned.
+	void share (boost::atomic<uint64_t> * steps, unsigned sharers);
+
+	/// Forgets consumed steps and exhaustion, limits stay
+	void reset ();
+
+	/// Consumes steps, returns false if the budget is exhausted
+	bool consume (uint64_t steps = 1) {
+		mSteps += steps;
+		return mSteps < mNextCheck || check();
+	}
+
+	/// Consumed steps
+	uint64_t steps () const { return mSteps; }
+
+	bool exhausted () const { return mReason != 0; }
+
+	/// Why the budget is exhausted, 0 if it is not
+	const char * reason () const { return mReason; }
+
+	/// The error evaluation returns once the budget is exhausted
+	PrimitiveValue error () const;
+
+private:
+	/// Looks at all limits, returns false if exhausted
+	bool check ();
+	/// Sets mNextCheck for the current limits
+	void scheduleCheck ();
+
+	uint64_t mSteps;
+	uint64_t mNextCheck;   ///< check() is called when mSteps reaches it
+	boost::atomic<uint64_t> * mShared;
+	unsigned mSharers;
+	uint64_t mSharedAdded;  ///< mSteps when last added to mShared
+	uint64_t mSharedSteps;  ///< value of mShared at the last check
+	uint64_t mMaxSteps;
+	uint64_t mDeadlineNs;
+	const boost::atomic<bool> * mCancel;
+	const char * mReason;
+};
+
+}
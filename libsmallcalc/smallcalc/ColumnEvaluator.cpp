@@ -0,0 +1,325 @@
+#include "ColumnEvaluator.h"
+#include "impl/NamedFunction.h"
+#include "impl/Value.h"
+#include "impl/Variable.h"
+#include "impl/Constant.h"
+#include "impl/UserFunction.h"
+#include "impl/Reduction.h"
+#include "Trace.h"
+#include "Budget.h"
+#include <math.h>
+#include <string.h>
+#include <limits>
+#include <algorithm>
+#include <set>
+
+namespace sc {
+
+ColumnEvaluator::ColumnEvaluator () : mResult (-1), mHasCalls (false), mBudget (0), mInlineLimit (DefaultInlineLimit) {
+}
+
+Error ColumnEvaluator::compile (const ExpressionPtr & expression) {
+	TraceSpan span ("compile");
+	mOperations.clear();
+	mConstants.clear();
+	mVariables.clear();
+	mBindings.clear();
+	mParameterSlots.clear();
+	mHasCalls = false;
+	Error error = NoError;
+	mResult = compileExpression (expression.get(), &error);
+	if (mResult < 0) {
+		mOperations.clear();
+		return error;
+	}
+	mBuffers.assign (mOperations.size() * BlockSize, 0.0);
+	mSlots.assign (mOperations.size(), 0);
+	for (size_t i = 0; i < mOperations.size(); i++) {
+		if (mOperations[i].op == OP_CONSTANT) {
+			std::fill (mBuffers.begin() + i * BlockSize, mBuffers.begin() + (i + 1) * BlockSize, mConstants[i]);
+		}
+	}
+	return NoError;
+}
+
+void ColumnEvaluator::bind (VariableId id, const double * values) {
+	std::vector<VariableId>::const_iterator i = std::find (mVariables.begin(), mVariables.end(), id);
+	if (i == mVariables.end()) return; // not needed
+	mBindings[i - mVariables.begin()] = values;
+}
+
+void ColumnEvaluator::unbindAll () {
+	std::fill (mBindings.begin(), mBindings.end(), (const double*) 0);
+}
+
+Error ColumnEvaluator::evaluate (size_t count, double * output, uint8_t * errorMask, size_t * errorCount) {
+	if (mOperations.empty()) return error::Eval_InvalidOperation;
+	for (size_t i = 0; i < mBindings.size(); i++) {
+		if (!mBindings[i]) return error::Eval_UnboundVariable;
+	}
+	size_t errors = 0;
+	uint8_t blockErrors[BlockSize];
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	for (size_t offset = 0; offset < count; offset += BlockSize) {
+		size_t n = std::min ((size_t) BlockSize, count - offset);
+		if (mBudget && !mBudget->consume (n * mOperations.size())) {
+			if (errorCount) *errorCount = errors;
+			return error::Eval_BudgetExhausted;
+		}
+		if (mHasCalls) memset (blockErrors, 0, n);
+		evaluateBlock (offset, n, blockErrors);
+		// like the tree path reports division by zero, rows with non finite results are errors
+		const double * result = mSlots[mResult];
+		for (size_t i = 0; i < n; i++) {
+			bool error = !isfinite (result[i]) || (mHasCalls && blockErrors[i]);
+			output[offset + i] = error ? nan : result[i];
+			if (errorMask) errorMask[offset + i] = error ? 1 : 0;
+			if (error) errors++;
+		}
+	}
+	if (errorCount) *errorCount = errors;
+	return NoError;
+}
+
+void ColumnEvaluator::evaluateBlock (size_t offset, size_t count, uint8_t * errors) {
+	for (size_t s = 0; s < mOperations.size(); s++) {
+		const Operation & o = mOperations[s];
+		double * out = &mBuffers[s * BlockSize];
+		switch (o.op) {
+		case OP_CONSTANT:
+			mSlots[s] = out;
+			continue;
+		case OP_VARIABLE:
+			mSlots[s] = mBindings[o.variable] + offset;
+			continue;
+		default:
+			break;
+		}
+		const double * a = o.a >= 0 ? mSlots[o.a] : 0;
+		const double * b = o.b >= 0 ? mSlots[o.b] : 0;
+		switch (o.op) {
+		case OP_ADD:
+			for (size_t i = 0; i < count; i++) out[i] = a[i] + b[i];
+			break;
+		case OP_SUBTRACT:
+			for (size_t i = 0; i < count; i++) out[i] = a[i] - b[i];
+			break;
+		case OP_MULTIPLY:
+			for (size_t i = 0; i < count; i++) out[i] = a[i] * b[i];
+			break;
+		case OP_DIVIDE:
+			for (size_t i = 0; i < count; i++) out[i] = a[i] / b[i];
+			break;
+		case OP_POW:
+			for (size_t i = 0; i < count; i++) out[i] = ::pow (a[i], b[i]);
+			break;
+		case OP_NEGATE:
+			for (size_t i = 0; i < count; i++) out[i] = 0 - a[i];
+			break;
+		case OP_FUNCTION1:
+			for (size_t i = 0; i < count; i++) out[i] = o.function1 (a[i]);
+			break;
+		case OP_CALL: {
+			mCallArguments.resize (o.arguments.size());
+			for (size_t i = 0; i < count; i++) {
+				for (size_t j = 0; j < o.reads.size(); j++) {
+					mContext.setVariable (mVariables[o.reads[j]], doubleValue (mBindings[o.reads[j]][offset + i]));
+				}
+				for (size_t j = 0; j < o.arguments.size(); j++) {
+					mCallArguments[j] = doubleValue (mSlots[o.arguments[j]][i]);
+				}
+				PrimitiveValue v = o.function->call (mCallArguments, &mContext);
+				if (v.type() == PT_ERROR) {
+					errors[i] = 1;
+					out[i] = 0;
+				} else {
+					out[i] = v.toDouble();
+				}
+			}
+			break;
+		}
+		default:
+			assert (!"unexpected");
+		}
+		mSlots[s] = out;
+	}
+}
+
+int ColumnEvaluator::addOperation (const Operation & operation) {
+	mOperations.push_back (operation);
+	mConstants.push_back (0.0);
+	return (int) mOperations.size() - 1;
+}
+
+int ColumnEvaluator::addConstant (double value) {
+	Operation o = Operation ();
+	o.op = OP_CONSTANT;
+	o.b  = -1;
+	int slot = addOperation (o);
+	mConstants[slot] = value;
+	return slot;
+}
+
+size_t ColumnEvaluator::addVariable (VariableId id) {
+	std::vector<VariableId>::const_iterator i = std::find (mVariables.begin(), mVariables.end(), id);
+	if (i != mVariables.end()) return i - mVariables.begin();
+	mVariables.push_back (id);
+	mBindings.push_back (0);
+	return mVariables.size() - 1;
+}
+
+Error ColumnEvaluator::collectReads (const NamedFunction * function, std::vector<size_t> * reads) {
+	if (!function->body()) return NoError;
+	// Explicit stack, bodies can be deep
+	std::set<const Expression*> bodies; // each only once
+	std::vector<const Expression*> stack (1, function->body().get());
+	bodies.insert (function->body().get());
+	while (!stack.empty()) {
+		const Expression * node = stack.back();
+		stack.pop_back();
+		switch (node->kind()) {
+		case EK_VARIABLE: {
+			size_t variable = addVariable (static_cast<const Variable*> (node)->id());
+			if (std::find (reads->begin(), reads->end(), variable) == reads->end()) reads->push_back (variable);
+			break;
+		}
+		case EK_ASSIGNMENT:
+			return error::NotSupported;
+		case EK_FUNCTION: {
+			const NamedFunctionExpression * call = static_cast<const NamedFunctionExpression*> (node);
+			const ExpressionPtr & body (call->function()->body());
+			if (body && bodies.insert (body.get()).second) stack.push_back (body.get());
+			for (size_t i = 0; i < call->argumentCount(); i++) stack.push_back (call->argument (i).get());
+			break;
+		}
+		case EK_REDUCTION: {
+			const Reduction * reduction = static_cast<const Reduction*> (node);
+			stack.push_back (reduction->low().get());
+			stack.push_back (reduction->high().get());
+			stack.push_back (reduction->body().get());
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return NoError;
+}
+
+int ColumnEvaluator::compileExpression (const Expression * expression, Error * error) {
+	switch (expression->kind()) {
+	case EK_VALUE:
+	case EK_CONSTANT: {
+		PrimitiveValue v = expression->eval (&mContext);
+		if (v.type() == PT_ERROR) {
+			*error = v.error();
+			return -1;
+		}
+		return addConstant (v.toDouble());
+	}
+	case EK_VARIABLE: {
+		Operation o = Operation ();
+		o.op = OP_VARIABLE;
+		o.b  = -1;
+		o.variable = addVariable (static_cast<const Variable*> (expression)->id());
+		return addOperation (o);
+	}
+	case EK_PARAMETER: {
+		// only within an inlined body
+		size_t index = static_cast<const Parameter*> (expression)->index();
+		if (index >= mParameterSlots.size()) {
+			*error = error::NotSupported;
+			return -1;
+		}
+		return mParameterSlots[index];
+	}
+	case EK_FUNCTION:
+		break;
+	default:
+		*error = error::NotSupported;
+		return -1;
+	}
+	const NamedFunctionExpression * exp = static_cast<const NamedFunctionExpression*> (expression);
+	const NamedFunction * function = exp->function().get();
+	std::vector<int> arguments;
+	for (size_t i = 0; i < exp->argumentCount(); i++) {
+		int slot = compileExpression (exp->argument(i).get(), error);
+		if (slot < 0) return -1;
+		arguments.push_back (slot);
+	}
+	if (function->body() && function->bodySize() <= mInlineLimit && (int) arguments.size() == function->arity()) {
+		// Inline: parameters read the argument slots directly, no call frame per row
+		size_t operations = mOperations.size(), variables = mVariables.size();
+		std::vector<int> outer;
+		outer.swap (mParameterSlots);
+		mParameterSlots = arguments;
+		Error inlineError = NoError;
+		int slot = compileExpression (function->body().get(), &inlineError);
+		mParameterSlots.swap (outer);
+		if (slot >= 0) return slot;
+		// e.g. a reduction in the body, call it instead
+		mOperations.resize (operations);
+		mConstants.resize (operations);
+		mVariables.resize (variables);
+		mBindings.resize (variables);
+	}
+	Operation o = Operation ();
+	o.b = -1;
+	switch (function->builtin()) {
+	case BF_ADD:
+	case BF_MULTIPLY: {
+		if (arguments.empty()) return addConstant (function->builtin() == BF_ADD ? 0.0 : 1.0);
+		// Fold left, like the evaluation callbacks
+		int current = arguments[0];
+		for (size_t i = 1; i < arguments.size(); i++) {
+			o.op = function->builtin() == BF_ADD ? OP_ADD : OP_MULTIPLY;
+			o.a  = current;
+			o.b  = arguments[i];
+			current = addOperation (o);
+		}
+		return current;
+	}
+	case BF_SUBTRACT:
+	case BF_DIVIDE:
+	case BF_POW:
+		if (arguments.size() != 2) break;
+		o.op = function->builtin() == BF_SUBTRACT ? OP_SUBTRACT : (function->builtin() == BF_DIVIDE ? OP_DIVIDE : OP_POW);
+		o.a  = arguments[0];
+		o.b  = arguments[1];
+		return addOperation (o);
+	case BF_NEGATE:
+		if (arguments.size() != 1) break;
+		o.op = OP_NEGATE;
+		o.a  = arguments[0];
+		return addOperation (o);
+	case BF_ASSIGNMENT:
+		*error = error::NotSupported;
+		return -1;
+	default:
+		if (function->doubleFunction() && arguments.size() == 1) {
+			o.op        = OP_FUNCTION1;
+			o.a         = arguments[0];
+			o.function1 = function->doubleFunction();
+			return addOperation (o);
+		}
+		break;
+	}
+	if (!function->evaluationCallback()) {
+		*error = error::NotSupported;
+		return -1;
+	}
+	// the body runs with mContext, which gets the variables it reads row by row
+	Error readsError = collectReads (function, &o.reads);
+	if (readsError != NoError) {
+		*error = readsError;
+		return -1;
+	}
+	o.op        = OP_CALL;
+	o.a         = arguments.empty() ? -1 : arguments[0];
+	o.function  = function;
+	o.arguments = arguments;
+	mHasCalls   = true;
+	return addOperation (o);
+}
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "types.h"
+#include "Expression.h"
+#include <vector>
+
+namespace sc {
+
+class NamedFunction;
+class EvaluationBudget;
+
+/**
+ * Evaluates an expression over whole columns of doubles.
+ *
+ * The expression is compiled into a flat list of operations once; each
+ * operation then runs over a block of rows at a time, reading the input
+ * columns bound to variables. Calculation is done like in non accurate mode.
+ *
+ * Rows with errors (e.g. from functions returning an error) get NaN.
+ *
+ * Note: this is stateful and NOT threadsafe.
+ */
+class ColumnEvaluator {
+public:
+	ColumnEvaluator ();
+
+	/// Default for setInlineLimit
+	enum { DefaultInlineLimit = 64 };
+
+	/// Compiles an expression, replacing the current one. Assignments are not supported.
+	Error compile (const ExpressionPtr & expression);
+
+	/// Variables the compiled expression needs (also in bodies of called user defined functions), each only once
+	const std::vector<VariableId> & variables () const { return mVariables; }
+
+	/// Binds an input column to a variable. The values must stay valid while evaluating.
+	void bind (VariableId id, const double * values);
+
+	/// Removes all bindings
+	void unbindAll ();
+
+	/// Budget consumed with one step per operation and row, 0 for none. Not owned.
+	void setBudget (EvaluationBudget * budget) { mBudget = budget; }
+
+	/// Calls of user defined functions with bodies of up to nodes expression nodes are
+	/// compiled into the operations of the caller, others are called row by row. 0 disables inlining.
+	/// Default is DefaultInlineLimit, applies to the next compile().
+	void setInlineLimit (size_t nodes) { mInlineLimit = nodes; }
+
+	/**
+	 * Evaluates count rows into output.
+	 * Rows with errors of called functions or non finite results (e.g. division by zero
+	 * or sqrt(-1)) get NaN, like in tabulate().
+	 * errorMask (optional) gets 1 for rows with errors, 0 otherwise.
+	 * errorCount (optional) gets the number of rows with errors.
+	 * Returns an error if the evaluator is not compiled or a variable is not bound.
+	 * Returns error::Eval_BudgetExhausted if the budget ran out, rows from that block on are not written.
+	 */
+	Error evaluate (size_t count, double * output, uint8_t * errorMask = 0, size_t * errorCount = 0);
+
+private:
+	enum OpCode {
+		OP_CONSTANT,
+		OP_VARIABLE,
+		OP_ADD,
+		OP_SUBTRACT,
+		OP_MULTIPLY,
+		OP_DIVIDE,
+		OP_POW,
+		OP_NEGATE,
+		OP_FUNCTION1, ///< double function with one argument
+		OP_CALL       ///< generic evaluation callback, element by element
+	};
+
+	struct Operation {
+		OpCode op;
+		int a, b;                ///< Argument slots
+		size_t variable;         ///< Index into mVariables for OP_VARIABLE
+		double (*function1) (double);
+		const NamedFunction * function; ///< for OP_CALL
+		std::vector<int> arguments;     ///< for OP_CALL
+		std::vector<size_t> reads;      ///< for OP_CALL: indices into mVariables read by the called body, set in mContext per row
+	};
+
+	/// Adds operations for an expression, returns its slot or -1 on error
+	int compileExpression (const Expression * expression, Error * error);
+	int addOperation (const Operation & operation);
+	int addConstant (double value);
+	/// Index of id in mVariables, adds it if necessary
+	size_t addVariable (VariableId id);
+	/// Adds the variables read by the body of function (also through functions it calls) to reads
+	Error collectReads (const NamedFunction * function, std::vector<size_t> * reads);
+
+	/// Runs all operations on rows [offset, offset + count)
+	void evaluateBlock (size_t offset, size_t count, uint8_t * errors);
+
+	enum { BlockSize = 256 };
+
+	std::vector<Operation> mOperations; ///< Operation i writes slot i
+	std::vector<double> mConstants;     ///< Constant value per slot (for OP_CONSTANT)
+	std::vector<double> mBuffers;       ///< BlockSize values per slot
+	std::vector<const double*> mSlots;  ///< Current values of each slot
+	std::vector<VariableId> mVariables;
+	std::vector<const double*> mBindings; ///< per entry in mVariables
+	int mResult;                          ///< Slot of the result (may be any slot if the expression inlines a function)
+	std::vector<int> mParameterSlots;     ///< Argument slots of the function body being inlined
+	bool mHasCalls;
+	std::vector<PrimitiveValue> mCallArguments;
+	EvaluationContext mContext;
+	EvaluationBudget * mBudget;
+	size_t mInlineLimit;
+};
+
+}
@@ -0,0 +1,308 @@
+#include "DependencyGraph.h"
+#include "impl/Variable.h"
+#include "impl/NamedFunction.h"
+#include "impl/AssignmentExpression.h"
+#include "impl/Reduction.h"
+#include "Trace.h"
+#include <algorithm>
+#include <set>
+
+namespace sc {
+
+namespace {
+
+/// Children of node which rebindCalls has to look at
+void children (const Expression * node, std::vector<ExpressionPtr> & result) {
+	result.clear();
+	switch (node->kind()) {
+	case EK_FUNCTION: {
+		const NamedFunctionExpression * call = static_cast<const NamedFunctionExpression*> (node);
+		for (size_t i = 0; i < call->argumentCount(); i++) result.push_back (call->argument (i));
+		break;
+	}
+	case EK_REDUCTION:
+		result = static_cast<const Reduction*> (node)->arguments();
+		break;
+	case EK_ASSIGNMENT: {
+		const AssignmentExpression * assignment = static_cast<const AssignmentExpression*> (node);
+		result.push_back (assignment->variable());
+		result.push_back (assignment->argument());
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/// Copy of the tree expression with calls of function replaced by calls of replacement,
+/// unchanged subtrees are shared
+ExpressionPtr rebindCalls (const ExpressionPtr & expression, const NamedFunction * function, const NamedFunctionPtr & replacement) {
+	// Post order with an explicit stack, definitions can be deeper than the call stack
+	struct Frame {
+		ExpressionPtr node;
+		std::vector<ExpressionPtr> children;
+		size_t next;
+	};
+	std::vector<Frame> stack (1);
+	stack.back().node = expression;
+	children (expression.get(), stack.back().children);
+	stack.back().next = 0;
+	ExpressionPtr done;
+	while (true) {
+		Frame & top = stack.back();
+		if (done) {
+			top.children[top.next - 1] = done;
+			done.reset();
+		}
+		if (top.next < top.children.size()) {
+			ExpressionPtr child = top.children[top.next++];
+			stack.push_back (Frame());
+			stack.back().node = child;
+			children (child.get(), stack.back().children);
+			stack.back().next = 0;
+			continue;
+		}
+		// all children done, rebuild if one of them or the function changed
+		std::vector<ExpressionPtr> original;
+		children (top.node.get(), original);
+		ExpressionPtr result = top.node;
+		if (top.node->kind() == EK_FUNCTION || top.node->kind() == EK_REDUCTION || top.node->kind() == EK_ASSIGNMENT) {
+			NamedFunctionPtr f;
+			if (top.node->kind() == EK_FUNCTION) f = static_cast<const NamedFunctionExpression&> (*top.node).function();
+			if (top.node->kind() == EK_REDUCTION) f = static_cast<const Reduction&> (*top.node).function();
+			bool changed = f.get() == function || original != top.children;
+			if (changed && top.node->kind() == EK_ASSIGNMENT) {
+				result = ExpressionPtr (new AssignmentExpression (top.children[0], top.children[1]));
+			} else if (changed) {
+				if (f.get() == function) f = replacement;
+				result = f->createExpression (f, top.children);
+			}
+		}
+		stack.pop_back();
+		if (stack.empty()) return result;
+		done = result;
+	}
+}
+
+}
+
+DependencyGraph::DependencyGraph () : mGeneration (0), mUpdating (false), mLastRecalculated (0), mRecalculated (0) {
+}
+
+PrimitiveValue DependencyGraph::define (VariableId id, const ExpressionPtr & definition, EvaluationContext * context) {
+	if (mUpdating) {
+		// nested in a definition, plain assignment
+		PrimitiveValue value = definition->eval (context);
+		if (!value.error()) context->setVariable (id, value);
+		return value;
+	}
+	collectDependencies (definition.get());
+	markAffected (id);
+	for (size_t i = 0; i < mCollected.size(); i++) {
+		VariableId d = mCollected[i];
+		if ((size_t) d < mCells.size() && mCells[d].mark == mGeneration) {
+			return errorValue (error::Eval_CyclicDependency, "Cyclic dependency");
+		}
+	}
+	link (id, mCollected);
+	mCells[id].definition = definition;
+	mCells[id].functions = mCollectedFunctions;
+
+	TraceSpan span ("recalculate");
+	mUpdating = true;
+	PrimitiveValue value = definition->eval (context);
+	context->setVariable (id, value);
+	mLastRecalculated = 1;
+	update (context);
+	mUpdating = false;
+	mRecalculated += mLastRecalculated;
+	return value;
+}
+
+void DependencyGraph::set (VariableId id, const PrimitiveValue & value, EvaluationContext * context) {
+	context->setVariable (id, value);
+	if (mUpdating) return;
+	undefine (id);
+	markAffected (id);
+
+	TraceSpan span ("recalculate");
+	// definitions are top level expressions, also if this is called from a function body
+	const PrimitiveValue * parameters = context->parameters;
+	int parameterCount = context->parameterCount;
+	int frames = context->frames;
+	context->parameters = 0;
+	context->parameterCount = 0;
+	context->frames = 0;
+	mUpdating = true;
+	mLastRecalculated = 0;
+	update (context);
+	mUpdating = false;
+	context->parameters = parameters;
+	context->parameterCount = parameterCount;
+	context->frames = frames;
+	mRecalculated += mLastRecalculated;
+}
+
+void DependencyGraph::redefine (const NamedFunction * function, const NamedFunctionPtr & replacement, EvaluationContext * context) {
+	std::vector<VariableId> calling;
+	for (size_t i = 0; i < mCells.size(); i++) {
+		const std::vector<const NamedFunction*> & functions = mCells[i].functions;
+		if (std::find (functions.begin(), functions.end(), function) != functions.end()) calling.push_back ((VariableId) i);
+	}
+	for (size_t i = 0; i < calling.size(); i++) {
+		VariableId id = calling[i];
+		define (id, rebindCalls (mCells[id].definition, function, replacement), context);
+	}
+}
+
+void DependencyGraph::undefine (VariableId id) {
+	if (id < 0 || (size_t) id >= mCells.size()) return;
+	link (id, std::vector<VariableId>());
+	mCells[id].definition.reset();
+	mCells[id].functions.clear();
+}
+
+const ExpressionPtr & DependencyGraph::definition (VariableId id) const {
+	static const ExpressionPtr none;
+	if (id < 0 || (size_t) id >= mCells.size()) return none;
+	return mCells[id].definition;
+}
+
+const std::vector<VariableId> & DependencyGraph::dependencies (VariableId id) const {
+	static const std::vector<VariableId> none;
+	if (id < 0 || (size_t) id >= mCells.size()) return none;
+	return mCells[id].dependencies;
+}
+
+const std::vector<VariableId> & DependencyGraph::dependents (VariableId id) const {
+	static const std::vector<VariableId> none;
+	if (id < 0 || (size_t) id >= mCells.size()) return none;
+	return mCells[id].dependents;
+}
+
+void DependencyGraph::clear () {
+	mCells.clear();
+	mGeneration = 0;
+	mLastRecalculated = 0;
+	mRecalculated = 0;
+}
+
+DependencyGraph::Cell & DependencyGraph::cell (VariableId id) {
+	assert (id >= 0);
+	if ((size_t) id >= mCells.size()) mCells.resize (id + 1);
+	return mCells[id];
+}
+
+void DependencyGraph::collectDependencies (const Expression * definition) {
+	mCollected.clear();
+	mCollectedFunctions.clear();
+	std::set<const Expression*> bodies; // of user defined functions, each only once
+	// Explicit stack, definitions can be deeper than the call stack
+	mStack.push_back (definition);
+	while (!mStack.empty()) {
+		const Expression * node = mStack.back();
+		mStack.pop_back();
+		switch (node->kind()) {
+		case EK_VARIABLE:
+			mCollected.push_back (static_cast<const Variable*> (node)->id());
+			break;
+		case EK_FUNCTION: {
+			const NamedFunctionExpression * function = static_cast<const NamedFunctionExpression*> (node);
+			const ExpressionPtr & body (function->function()->body());
+			if (body) {
+				// calls in bodies count as well, redefine() recalculates every definition reaching the function
+				mCollectedFunctions.push_back (function->function().get());
+				if (bodies.insert (body.get()).second) mStack.push_back (body.get());
+			}
+			for (size_t i = 0; i < function->argumentCount(); i++) {
+				mStack.push_back (function->argument (i).get());
+			}
+			break;
+		}
+		case EK_REDUCTION: {
+			const Reduction * reduction = static_cast<const Reduction*> (node);
+			mStack.push_back (reduction->low().get());
+			mStack.push_back (reduction->high().get());
+			mStack.push_back (reduction->body().get());
+			break;
+		}
+		case EK_ASSIGNMENT:
+			// the assigned variable is written, not read
+			mStack.push_back (static_cast<const AssignmentExpression*> (node)->argument().get());
+			break;
+		default:
+			break;
+		}
+	}
+	std::sort (mCollected.begin(), mCollected.end());
+	mCollected.erase (std::unique (mCollected.begin(), mCollected.end()), mCollected.end());
+	std::sort (mCollectedFunctions.begin(), mCollectedFunctions.end());
+	mCollectedFunctions.erase (std::unique (mCollectedFunctions.begin(), mCollectedFunctions.end()), mCollectedFunctions.end());
+}
+
+void DependencyGraph::markAffected (VariableId id) {
+	cell (id);
+	if (++mGeneration == 0) {
+		for (size_t i = 0; i < mCells.size(); i++) mCells[i].mark = 0;
+		mGeneration = 1;
+	}
+	mAffected.clear();
+	mAffected.push_back (id);
+	mCells[id].mark = mGeneration;
+	// breadth first, mAffected is the queue
+	for (size_t i = 0; i < mAffected.size(); i++) {
+		const std::vector<VariableId> & dependents = mCells[mAffected[i]].dependents;
+		for (size_t j = 0; j < dependents.size(); j++) {
+			Cell & c = mCells[dependents[j]];
+			if (c.mark == mGeneration) continue;
+			c.mark = mGeneration;
+			mAffected.push_back (dependents[j]);
+		}
+	}
+}
+
+void DependencyGraph::link (VariableId id, const std::vector<VariableId> & dependencies) {
+	// grow first, references stay valid then
+	cell (dependencies.empty() ? id : std::max (id, dependencies.back()));
+	std::vector<VariableId> & old = mCells[id].dependencies;
+	for (size_t i = 0; i < old.size(); i++) {
+		std::vector<VariableId> & dependents = mCells[old[i]].dependents;
+		std::vector<VariableId>::iterator j = std::find (dependents.begin(), dependents.end(), id);
+		if (j != dependents.end()) {
+			*j = dependents.back();
+			dependents.pop_back();
+		}
+	}
+	old = dependencies;
+	for (size_t i = 0; i < dependencies.size(); i++) {
+		mCells[dependencies[i]].dependents.push_back (id);
+	}
+}
+
+void DependencyGraph::update (EvaluationContext * context) {
+	// Kahn's algorithm on the affected part of the graph, mAffected[0] is already done
+	for (size_t i = 1; i < mAffected.size(); i++) {
+		Cell & c = mCells[mAffected[i]];
+		c.pending = 0;
+		for (size_t j = 0; j < c.dependencies.size(); j++) {
+			if (mCells[c.dependencies[j]].mark == mGeneration) c.pending++;
+		}
+	}
+	mReady.clear();
+	mReady.push_back (mAffected[0]);
+	while (!mReady.empty()) {
+		VariableId done = mReady.back();
+		mReady.pop_back();
+		const std::vector<VariableId> & dependents = mCells[done].dependents;
+		for (size_t i = 0; i < dependents.size(); i++) {
+			VariableId id = dependents[i];
+			Cell & c = mCells[id];
+			if (--c.pending > 0) continue;
+			context->setVariable (id, c.definition->eval (context));
+			mLastRecalculated++;
+			mReady.push_back (id);
+		}
+	}
+}
+
+}
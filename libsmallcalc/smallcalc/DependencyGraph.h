@@ -0,0 +1,105 @@
+#pragma once
+#include "types.h"
+#include "Expression.h"
+#include <vector>
+
+namespace sc {
+
+class NamedFunction;
+typedef shared_ptr<NamedFunction> NamedFunctionPtr;
+
+/**
+ * Spreadsheet like recalculation of variables.
+ *
+ * Set it as EvaluationContext::dependencies (or use SmallCalc::setReactive); assignments
+ * then keep their right side as definition of the variable and the graph records
+ * which variables each definition reads. Changing a variable (by an assignment or set())
+ * recalculates the definitions depending on it, directly or indirectly, each once and
+ * in topological order. All other variables keep their values.
+ *
+ * A definition which would make a variable depend on itself is rejected with
+ * error::Eval_CyclicDependency, the graph stays unchanged then.
+ * Definitions which fail to evaluate (e.g. because of an unbound variable) store
+ * the error as value, dependent definitions see it and get recalculated once it's fixed.
+ * Assignments nested in definitions are evaluated as plain assignments.
+ * Assignments in bodies of user defined functions or reductions define nothing, they set the variable (see set()).
+ * Variables read by user defined functions (see UserFunction.h) count as read by the definitions calling them;
+ * redefine() rebinds the definitions calling a redefined function (functions calling it keep the former one).
+ *
+ * Note: this is NOT threadsafe, evaluations changing variables must not run concurrently.
+ */
+class DependencyGraph {
+public:
+	DependencyGraph ();
+
+	/// Defines variable id by definition, evaluates it and recalculates variables depending on id.
+	/// Returns the new value of id.
+	PrimitiveValue define (VariableId id, const ExpressionPtr & definition, EvaluationContext * context);
+
+	/// Sets variable id to value, dropping its definition, and recalculates variables depending on id
+	void set (VariableId id, const PrimitiveValue & value, EvaluationContext * context);
+
+	/// Replaces the calls of function in all definitions by calls of replacement (a redefinition with the same arity)
+	/// and recalculates the definitions reaching function (also through other functions) and the variables depending on them
+	void redefine (const NamedFunction * function, const NamedFunctionPtr & replacement, EvaluationContext * context);
+
+	/// Drops the definition of id, its current value stays
+	void undefine (VariableId id);
+
+	/// Definition of id, null if it has none
+	const ExpressionPtr & definition (VariableId id) const;
+
+	/// Variables read by the definition of id (sorted, unique)
+	const std::vector<VariableId> & dependencies (VariableId id) const;
+
+	/// Variables whose definition reads id
+	const std::vector<VariableId> & dependents (VariableId id) const;
+
+	/// Upper bound of variable ids known to the graph
+	VariableId size () const { return (VariableId) mCells.size(); }
+
+	/// Definitions evaluated by the last define() or set() (including the defined one)
+	size_t lastRecalculated () const { return mLastRecalculated; }
+
+	/// Definitions evaluated since construction or clear()
+	uint64_t recalculated () const { return mRecalculated; }
+
+	/// Forgets all definitions
+	void clear ();
+
+private:
+	struct Cell {
+		Cell () : mark (0), pending (0) {}
+		ExpressionPtr definition;
+		std::vector<VariableId> dependencies;
+		std::vector<VariableId> dependents;
+		std::vector<const NamedFunction*> functions; ///< User defined functions called by definition, also in bodies (sorted, unique)
+		uint32_t mark;   ///< == mGeneration if visited by the current traversal
+		size_t pending;  ///< Dependencies not yet recalculated in the current update
+	};
+
+	Cell & cell (VariableId id);
+	/// Collects the variables read by definition, also in bodies of called functions, into mCollected (sorted, unique)
+	/// and the user defined functions it calls into mCollectedFunctions
+	void collectDependencies (const Expression * definition);
+	/// Marks id and everything depending on it, in mAffected (id first)
+	void markAffected (VariableId id);
+	/// Makes id depend on dependencies, replacing its former dependencies
+	void link (VariableId id, const std::vector<VariableId> & dependencies);
+	/// Recalculates mAffected (except the first one, which is done) in topological order
+	void update (EvaluationContext * context);
+
+	std::vector<Cell> mCells;
+	uint32_t mGeneration;
+	bool mUpdating;
+	size_t mLastRecalculated;
+	uint64_t mRecalculated;
+	// Scratch space, reused by each change
+	std::vector<VariableId> mCollected;
+	std::vector<const NamedFunction*> mCollectedFunctions;
+	std::vector<VariableId> mAffected;
+	std::vector<VariableId> mReady;
+	std::vector<const Expression*> mStack;
+};
+
+}
@@ -1,11 +1,102 @@
 #include "Expression.h"
 #include "PrimitiveValue.h"
 #include "impl/Value.h"
+#include "impl/Variable.h"
+#include "impl/Constant.h"
+#include "impl/NamedFunction.h"
+#include "impl/AssignmentExpression.h"
+#include "impl/UserFunction.h"
+#include "impl/Reduction.h"
 
 namespace sc {
 
+void Expression::accept (ExpressionVisitor * visitor) const {
+	switch (mKind) {
+	case EK_VALUE:
+		visitor->visit (static_cast<const Value&> (*this));
+		break;
+	case EK_VARIABLE:
+		visitor->visit (static_cast<const Variable&> (*this));
+		break;
+	case EK_CONSTANT:
+		visitor->visit (static_cast<const Constant&> (*this));
+		break;
+	case EK_FUNCTION:
+		visitor->visit (static_cast<const NamedFunctionExpression&> (*this));
+		break;
+	case EK_ASSIGNMENT:
+		visitor->visit (static_cast<const AssignmentExpression&> (*this));
+		break;
+	case EK_PARAMETER:
+		visitor->visit (static_cast<const Parameter&> (*this));
+		break;
+	case EK_DEFINITION:
+		visitor->visit (static_cast<const FunctionDefinition&> (*this));
+		break;
+	case EK_REDUCTION:
+		visitor->visit (static_cast<const Reduction&> (*this));
+		break;
+	default:
+		visitor->visit (*this);
+		break;
+	}
+}
+
+uint64_t Expression::structuralHash () const {
+	return hashCombine (mKind, hashString (printNice()));
+}
+
 ExpressionPtr createError (Error e, const String & message) {
 	return ExpressionPtr(new Value (errorValue (e, message)));
 }
 
+bool structurallyEqual (const Expression & a, const Expression & b) {
+	// Explicit stack of pairs, trees can be deeper than the call stack
+	std::vector<std::pair<const Expression*, const Expression*> > stack (1, std::make_pair (&a, &b));
+	while (!stack.empty()) {
+		const Expression * x = stack.back().first;
+		const Expression * y = stack.back().second;
+		stack.pop_back();
+		if (x == y) continue;
+		if (x->kind() != y->kind()) return false;
+		switch (x->kind()) {
+		case EK_VALUE:
+			if (!(static_cast<const Value*> (x)->value() == static_cast<const Value*> (y)->value())) return false;
+			break;
+		case EK_FUNCTION: {
+			const NamedFunctionExpression * f = static_cast<const NamedFunctionExpression*> (x);
+			const NamedFunctionExpression * g = static_cast<const NamedFunctionExpression*> (y);
+			if (f->function() != g->function() && f->function()->name() != g->function()->name()) return false;
+			if (f->argumentCount() != g->argumentCount()) return false;
+			for (size_t i = 0; i < f->argumentCount(); i++) {
+				stack.push_back (std::make_pair (f->argument (i).get(), g->argument (i).get()));
+			}
+			break;
+		}
+		case EK_ASSIGNMENT: {
+			const AssignmentExpression * f = static_cast<const AssignmentExpression*> (x);
+			const AssignmentExpression * g = static_cast<const AssignmentExpression*> (y);
+			stack.push_back (std::make_pair (f->variable().get(), g->variable().get()));
+			stack.push_back (std::make_pair (f->argument().get(), g->argument().get()));
+			break;
+		}
+		case EK_REDUCTION: {
+			const Reduction * f = static_cast<const Reduction*> (x);
+			const Reduction * g = static_cast<const Reduction*> (y);
+			if (f->function()->name() != g->function()->name()) return false;
+			std::vector<ExpressionPtr> fa (f->arguments()), ga (g->arguments());
+			for (size_t i = 0; i < fa.size(); i++) {
+				stack.push_back (std::make_pair (fa[i].get(), ga[i].get()));
+			}
+			break;
+		}
+		default:
+			// leaves (variables, constants, parameters) are cheap to print
+			if (x->printNice() != y->printNice()) return false;
+			break;
+		}
+	}
+	return true;
+}
+
 }
@@ -1,15 +1,25 @@
 #pragma once
 #include "types.h"
 #include "PrimitiveValue.h"
+#include "AllocationStats.h"
 #include <vector>
 
 namespace sc {
+
+class EvaluationProfiler;
+struct FallbackStats;
+class EvaluationBudget;
+class DependencyGraph;
+
+/// Nesting depth up to which expressions are evaluated recursively, deeper subtrees use an explicit stack
+const int MaxRecursionDepth = 256;
+
 /**
  * The evaluation context stores the context which is used during the evaluation process of an expression
  * An example are variable values.
  */
 struct EvaluationContext {
-	EvaluationContext () { variables.resize (64); accurateLevel = false; }
+	EvaluationContext () { variables.resize (64); accurateLevel = false; profiler = 0; fallbacks = 0; budget = 0; dependencies = 0; parameters = 0; parameterCount = 0; frames = 0; threads = 0; depth = 0; }
 	const PrimitiveValue& findVariable (const VariableId & id) {
 		static PrimitiveValue invalidValue;
 		if (id < 0 || (size_t) id >= variables.size()) return invalidValue;
@@ -27,6 +37,24 @@ struct EvaluationContext {
 	std::vector<PrimitiveValue> variables;
 	/// try to calculate with accurate values
 	bool accurateLevel;
+	/// Records evaluation statistics if set (see Profiler.h), not owned
+	EvaluationProfiler * profiler;
+	/// Counts accurate calculations falling back to double if set (see FallbackStats.h), not owned
+	FallbackStats * fallbacks;
+	/// Stops evaluation with error::Eval_BudgetExhausted once exhausted, if set (see Budget.h), not owned
+	EvaluationBudget * budget;
+	/// Assignments define variables reactively if set (see DependencyGraph.h), not owned
+	DependencyGraph * dependencies;
+	/// Arguments of the user defined function whose body is evaluated (see UserFunction.h), not owned
+	const PrimitiveValue * parameters;
+	/// Number of values in parameters
+	int parameterCount;
+	/// Number of bodies of user defined functions and reductions being evaluated, 0 at top level
+	int frames;
+	/// Threads for reductions over large ranges (see Reduction.h), 0 for one per core
+	int threads;
+	/// Current recursion depth of evaluation
+	int depth;
 };
 
 /// Context for printing.
@@ -38,14 +66,77 @@ struct PrintingContext {
 	int  currentPrecedence;
 };
 
+/// Kind of an expression node, allows dispatching without RTTI
+enum ExpressionKind {
+	EK_OTHER,		///< Unknown expression type
+	EK_VALUE,		///< Value
+	EK_VARIABLE,	///< Variable
+	EK_CONSTANT,	///< Constant
+	EK_FUNCTION,	///< NamedFunctionExpression
+	EK_ASSIGNMENT,	///< AssignmentExpression
+	EK_PARAMETER,	///< Parameter of a user defined function
+	EK_DEFINITION,	///< FunctionDefinition
+	EK_REDUCTION	///< Reduction over a range (e.g. sum)
+};
+
+class Expression;
+class Value;
+class Variable;
+class Constant;
+class NamedFunctionExpression;
+class AssignmentExpression;
+class Parameter;
+class FunctionDefinition;
+class Reduction;
+
+/// Visitor for expression nodes, see Expression::accept
+/// Default implementations do nothing; the visitor is responsible for descending into children
+class ExpressionVisitor {
+public:
+	virtual ~ExpressionVisitor () {}
+	virtual void visit (const Value & value) {}
+	virtual void visit (const Variable & variable) {}
+	virtual void visit (const Constant & constant) {}
+	virtual void visit (const NamedFunctionExpression & function) {}
+	virtual void visit (const AssignmentExpression & assignment) {}
+	virtual void visit (const Parameter & parameter) {}
+	virtual void visit (const FunctionDefinition & definition) {}
+	virtual void visit (const Reduction & reduction) {}
+	virtual void visit (const Expression & other) {}
+};
+
 /// Simple expression
 class Expression {
 public:
+	Expression (ExpressionKind kind = EK_OTHER) : mKind (kind) {}
 	virtual ~Expression () {}
+
+#ifdef SMALLCALC_ALLOCATION_STATS
+	/// Node creation is an allocation point
+	static void * operator new (size_t size) {
+		recordAllocation (size);
+		return ::operator new (size);
+	}
+	static void operator delete (void * p) { ::operator delete (p); }
+#endif
+
+	/// Returns the kind of the expression node
+	ExpressionKind kind () const { return mKind; }
+
+	/// Calls the visit method of visitor which matches the kind of this node
+	void accept (ExpressionVisitor * visitor) const;
 	/// Standard calculation method
 	virtual PrimitiveValue eval (EvaluationContext * evaluationContext) const = 0;
 	/// standard printing method, no further formatting
-	virtual std::string print (PrintingContext * printingContext) const = 0;
+	std::string print (PrintingContext * printingContext) const {
+		std::string result;
+		printTo (result, printingContext);
+		return result;
+	}
+
+	/// Appends the printed expression to output.
+	/// Sub expressions append into the same buffer, so a tree is printed in one traversal.
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const = 0;
 
 	virtual std::string printNice () const {
 		PrintingContext defaultContext;
@@ -60,11 +151,20 @@ public:
 
 	/// Fast check if its an error
 	virtual Error error () const { return NoError; }
+
+	/// Hash over the structure of the expression; equal hashes for equally printed trees.
+	/// Default implementation hashes the printed expression.
+	virtual uint64_t structuralHash () const;
+private:
+	ExpressionKind mKind;
 };
 typedef shared_ptr<Expression> ExpressionPtr;
 
 /// Shortcut for creating error expressions
 ExpressionPtr createError (Error e, const String & message = String());
 
+/// If a and b have the same structure and leaves, so that they print equally (e.g. to verify equal structural hashes)
+bool structurallyEqual (const Expression & a, const Expression & b);
+
 
 }
@@ -0,0 +1,130 @@
+#include "FallbackStats.h"
+#include "PrimitiveValue.h"
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+
+namespace sc {
+
+const char * accurateOperationName (AccurateOperation operation) {
+	switch (operation) {
+	case AO_ADD:      return "add";
+	case AO_SUBTRACT: return "subtract";
+	case AO_MULTIPLY: return "multiply";
+	case AO_DIVIDE:   return "divide";
+	case AO_POWER:    return "power";
+	default:          return "unknown";
+	}
+}
+
+static int bitLength (int64_t v) {
+	uint64_t x = v < 0 ? (uint64_t) 0 - (uint64_t) v : (uint64_t) v;
+	int bits = 0;
+	while (x) {
+		bits++;
+		x >>= 1;
+	}
+	return bits;
+}
+
+int magnitudeBits (const PrimitiveValue & value) {
+	switch (value.type()) {
+	case PT_INT64:
+		return bitLength (value.intValue());
+	case PT_FRACTION: {
+		Fraction64 f = value.toFraction();
+		return std::max (bitLength (f.numerator()), bitLength (f.denumerator()));
+	}
+	default:
+		return 0;
+	}
+}
+
+void FallbackStats::clear () {
+	for (int i = 0; i < AO_COUNT; i++) {
+		for (int j = 0; j < AO_COUNT; j++) fallbacks[i][j] = 0;
+		for (int j = 0; j <= MaxBits; j++) operandBits[i][j] = 0;
+	}
+}
+
+void FallbackStats::record (AccurateOperation function, AccurateOperation operation, const PrimitiveValue & a, const PrimitiveValue & b) {
+	fallbacks[function][operation]++;
+	operandBits[operation][std::max (magnitudeBits (a), magnitudeBits (b))]++;
+}
+
+uint64_t FallbackStats::total () const {
+	uint64_t sum = 0;
+	for (int i = 0; i < AO_COUNT; i++) {
+		for (int j = 0; j < AO_COUNT; j++) sum += fallbacks[i][j];
+	}
+	return sum;
+}
+
+FallbackStats & FallbackStats::operator+= (const FallbackStats & other) {
+	for (int i = 0; i < AO_COUNT; i++) {
+		for (int j = 0; j < AO_COUNT; j++) fallbacks[i][j] += other.fallbacks[i][j];
+		for (int j = 0; j <= MaxBits; j++) operandBits[i][j] += other.operandBits[i][j];
+	}
+	return *this;
+}
+
+std::string FallbackStats::report () const {
+	std::ostringstream out;
+	out << total() << " fallbacks\n";
+	for (int i = 0; i < AO_COUNT; i++) {
+		for (int j = 0; j < AO_COUNT; j++) {
+			if (!fallbacks[i][j]) continue;
+			out << "  " << accurateOperationName ((AccurateOperation) i) << ": " << fallbacks[i][j]
+				<< " (" << accurateOperationName ((AccurateOperation) j) << " overflowed)\n";
+		}
+	}
+	for (int i = 0; i < AO_COUNT; i++) {
+		bool first = true;
+		for (int j = 0; j <= MaxBits; j++) {
+			if (!operandBits[i][j]) continue;
+			if (first) out << "  " << accurateOperationName ((AccurateOperation) i) << " operand bits:";
+			first = false;
+			out << " " << j << "x" << operandBits[i][j];
+		}
+		if (!first) out << "\n";
+	}
+	return out.str();
+}
+
+std::string FallbackStats::toJson () const {
+	std::ostringstream out;
+	out << "{ \"total\": " << total() << ", \"fallbacks\": {";
+	bool firstFunction = true;
+	for (int i = 0; i < AO_COUNT; i++) {
+		bool first = true;
+		for (int j = 0; j < AO_COUNT; j++) {
+			if (!fallbacks[i][j]) continue;
+			if (first) {
+				out << (firstFunction ? " \"" : ", \"") << accurateOperationName ((AccurateOperation) i) << "\": {";
+				firstFunction = false;
+			}
+			out << (first ? " \"" : ", \"") << accurateOperationName ((AccurateOperation) j) << "\": " << fallbacks[i][j];
+			first = false;
+		}
+		if (!first) out << " }";
+	}
+	out << " }, \"operand_bits\": {";
+	bool firstOperation = true;
+	for (int i = 0; i < AO_COUNT; i++) {
+		bool first = true;
+		for (int j = 0; j <= MaxBits; j++) {
+			if (!operandBits[i][j]) continue;
+			if (first) {
+				out << (firstOperation ? " \"" : ", \"") << accurateOperationName ((AccurateOperation) i) << "\": {";
+				firstOperation = false;
+			}
+			out << (first ? " \"" : ", \"") << j << "\": " << operandBits[i][j];
+			first = false;
+		}
+		if (!first) out << " }";
+	}
+	out << " } }";
+	return out.str();
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+/**
+ * @file
+ * Statistics about accurate calculations falling back to double.
+ *
+ * In accurate level add, multiply, subtract, divide and exponentation calculate
+ * with Fraction64 and fall back to double once an operation overflows.
+ * If EvaluationContext::fallbacks is set, each of these fallbacks is recorded
+ * with the function, the overflowing operation and the magnitude (bit length
+ * of numerator / denumerator) of its operands.
+ */
+
+namespace sc {
+
+class PrimitiveValue;
+
+/// Accurate operation, used for the falling back function and the overflowing operation
+enum AccurateOperation {
+	AO_ADD,
+	AO_SUBTRACT,
+	AO_MULTIPLY,
+	AO_DIVIDE,
+	AO_POWER,    ///< Non integer exponent (as operation) or the exponentation function
+	AO_COUNT
+};
+
+/// Returns a printable name of an operation
+const char * accurateOperationName (AccurateOperation operation);
+
+/// Counted fallbacks, merge them with +=
+struct FallbackStats {
+	/// Operand magnitudes are bit lengths 0..MaxBits
+	enum { MaxBits = 64 };
+
+	FallbackStats () { clear (); }
+	void clear ();
+
+	/// Records a fallback of function, because operation overflowed with operands a and b
+	void record (AccurateOperation function, AccurateOperation operation, const PrimitiveValue & a, const PrimitiveValue & b);
+
+	/// Sum of all fallbacks
+	uint64_t total () const;
+
+	FallbackStats & operator+= (const FallbackStats & other);
+
+	/// Human readable table of non empty counters
+	std::string report () const;
+
+	/// Exports the counters as JSON object
+	std::string toJson () const;
+
+	/// Fallbacks per function and overflowing operation
+	uint64_t fallbacks[AO_COUNT][AO_COUNT];
+	/// Per overflowing operation the number of overflows by bit length of the larger operand
+	uint64_t operandBits[AO_COUNT][MaxBits + 1];
+};
+
+/// Bit length of the larger part (absolute numerator or denumerator) of an accurate value, 0 for others
+int magnitudeBits (const PrimitiveValue & value);
+
+}
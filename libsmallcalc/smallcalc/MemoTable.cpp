@@ -0,0 +1,106 @@
+#include "MemoTable.h"
+#include "Expression.h"
+
+namespace sc {
+
+namespace {
+
+/// Spreads all bits of h over the low bits, which select the set (hashes of small doubles only differ in high bits)
+uint64_t mix (uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+}
+
+MemoTable::MemoTable (size_t capacity) : mClock (0) {
+	size_t size = Ways;
+	while (size < capacity) size *= 2;
+	mEntries.resize (size);
+	mSetMask = size / Ways - 1;
+}
+
+PrimitiveValue MemoTable::call (const EvaluationCallback & callback, const PrimitiveArgumentVector & arguments, const EvaluationContext * context) {
+	bool suitable = arguments.size() <= MaxArguments;
+	bool accurate = context && context->accurateLevel;
+	uint64_t hash = accurate ? 1 : 0;
+	for (size_t i = 0; i < arguments.size() && suitable; i++) {
+		if (arguments[i].type() == PT_ERROR) suitable = false; // hashes the message
+		else hash = hashCombine (hash, arguments[i].hash());
+	}
+	hash = mix (hash);
+	Entry * set = &mEntries[(hash & mSetMask) * Ways];
+	{
+		// never locked while calling back, the callback may use the table again
+		boost::mutex::scoped_try_lock lock (mMutex);
+		if (!lock.owns_lock()) {
+			return callback (arguments, context);
+		}
+		if (!suitable) {
+			mStats.bypasses++;
+			lock.unlock();
+			return callback (arguments, context);
+		}
+		Entry * entry = find (set, hash, arguments, accurate);
+		if (entry) {
+			mStats.hits++;
+			entry->stamp = ++mClock;
+			return entry->result;
+		}
+		mStats.misses++;
+	}
+
+	PrimitiveValue result = callback (arguments, context);
+	if (result.type() == PT_ERROR) return result;
+
+	boost::mutex::scoped_try_lock lock (mMutex);
+	if (!lock.owns_lock()) return result;
+	if (find (set, hash, arguments, accurate)) return result; // inserted meanwhile
+	Entry * victim = set;
+	for (int i = 1; i < Ways; i++) {
+		if (set[i].stamp < victim->stamp) victim = &set[i];
+	}
+	if (victim->stamp) mStats.evictions++;
+	victim->hash     = hash;
+	victim->stamp    = ++mClock;
+	victim->count    = (uint8_t) arguments.size();
+	victim->accurate = accurate;
+	for (size_t i = 0; i < arguments.size(); i++) {
+		victim->arguments[i] = arguments[i];
+	}
+	victim->result = result;
+	return result;
+}
+
+MemoTable::Entry * MemoTable::find (Entry * set, uint64_t hash, const PrimitiveArgumentVector & arguments, bool accurate) {
+	for (int i = 0; i < Ways; i++) {
+		Entry & entry (set[i]);
+		if (!entry.stamp || entry.hash != hash || entry.count != arguments.size() || entry.accurate != accurate) continue;
+		bool equal = true;
+		for (size_t j = 0; j < arguments.size() && equal; j++) {
+			equal = entry.arguments[j] == arguments[j];
+		}
+		if (equal) return &entry;
+	}
+	return 0;
+}
+
+MemoStats MemoTable::stats () const {
+	boost::mutex::scoped_lock lock (mMutex);
+	return mStats;
+}
+
+void MemoTable::clear () {
+	boost::mutex::scoped_lock lock (mMutex);
+	for (size_t i = 0; i < mEntries.size(); i++) {
+		mEntries[i] = Entry();
+	}
+	mStats = MemoStats();
+	mClock = 0;
+}
+
+}
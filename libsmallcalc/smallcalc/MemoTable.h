@@ -0,0 +1,80 @@
+#pragma once
+#include "types.h"
+#include "PrimitiveValue.h"
+#include <boost/thread/mutex.hpp>
+#include <vector>
+
+namespace sc {
+
+struct EvaluationContext;
+
+/// Counters of a MemoTable
+struct MemoStats {
+	MemoStats () : hits (0), misses (0), evictions (0), bypasses (0) {}
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;  ///< Misses which replaced an older entry
+	uint64_t bypasses;   ///< Calls with unsuitable arguments, evaluated without the table
+
+	/// hits / (hits + misses), 0 without lookups
+	double hitRate () const { return hits + misses ? (double) hits / (hits + misses) : 0; }
+};
+
+/**
+ * Bounded cache of the results of a pure function (see NamedFunction::setMemoization).
+ *
+ * Keyed by the exact argument values (type and value, see PrimitiveValue::operator==)
+ * and the accurate level of the evaluation. The table is set associative with Ways entries
+ * per set, a miss replaces the least recently used entry of its set. All entries are
+ * allocated up front, a miss only copies values into an entry.
+ *
+ * Error results are not cached (they may come from the context, e.g. an exhausted budget),
+ * neither are calls with error arguments or more than MaxArguments arguments.
+ * Hits don't reach the function, so they record no fallbacks (see FallbackStats.h).
+ *
+ * Threadsafe: a thread finding the table in use by another thread evaluates without it
+ * (not counted).
+ */
+class MemoTable {
+public:
+	typedef std::vector<PrimitiveValue> PrimitiveArgumentVector;
+	typedef function<PrimitiveValue(const PrimitiveArgumentVector& arguments, const EvaluationContext* context)> EvaluationCallback;
+
+	enum { Ways = 4, MaxArguments = 4 };
+
+	/// capacity is rounded up to a power of two, at least Ways
+	explicit MemoTable (size_t capacity);
+
+	/// Number of entries
+	size_t capacity () const { return mEntries.size(); }
+
+	/// Returns the cached result of callback for arguments, calls it on a miss
+	PrimitiveValue call (const EvaluationCallback & callback, const PrimitiveArgumentVector & arguments, const EvaluationContext * context);
+
+	MemoStats stats () const;
+
+	/// Forgets all entries and counters
+	void clear ();
+
+private:
+	struct Entry {
+		Entry () : hash (0), stamp (0), count (0), accurate (false) {}
+		uint64_t hash;
+		uint64_t stamp;   ///< Last use, 0 for empty entries
+		uint8_t count;
+		bool accurate;
+		PrimitiveValue arguments[MaxArguments];
+		PrimitiveValue result;
+	};
+
+	/// Returns the matching entry of set, 0 if there is none
+	Entry * find (Entry * set, uint64_t hash, const PrimitiveArgumentVector & arguments, bool accurate);
+
+	std::vector<Entry> mEntries;
+	size_t mSetMask;
+	uint64_t mClock;
+	MemoStats mStats;
+	mutable boost::mutex mMutex;
+};
+
+}
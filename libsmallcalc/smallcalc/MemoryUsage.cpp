@@ -0,0 +1,203 @@
+#include "MemoryUsage.h"
+#include "impl/NamedFunction.h"
+#include "impl/AssignmentExpression.h"
+#include "impl/Reduction.h"
+#include "impl/UserFunction.h"
+#include "impl/Variable.h"
+#include "impl/Constant.h"
+#include "impl/Value.h"
+#include "impl/Parser.h"
+
+namespace sc {
+
+namespace {
+
+/// Control block of a shared_ptr created from a raw pointer
+const size_t SharedCountBytes = sizeof (boost::detail::sp_counted_impl_p<Expression>);
+
+/// Heap buffer of a string, 0 if the characters are stored inside the object (small strings)
+size_t stringBytes (const std::string & s) {
+	const char * data   = s.data();
+	const char * object = reinterpret_cast<const char*> (&s);
+	if (data >= object && data < object + sizeof (s)) return 0;
+	return s.capacity() + 1;
+}
+
+/// Buckets and nodes of an unordered map, without the heap buffers of the values
+template <class Map> size_t mapBytes (const Map & map) {
+	return map.bucket_count() * sizeof (void*) + map.size() * (sizeof (typename Map::value_type) + sizeof (void*) + sizeof (size_t));
+}
+
+}
+
+MemoryUsage & MemoryUsage::operator+= (const MemoryUsage & other) {
+	nodes       += other.nodes;
+	bytes       += other.bytes;
+	sharedBytes += other.sharedBytes;
+	return *this;
+}
+
+bool MemoryCounter::first (const void * p) {
+	return mSeen.insert (p).second;
+}
+
+void MemoryCounter::addValue (const PrimitiveValue & value) {
+	const RefinedPrimitiveValuePtr & refined (value.refinedValue());
+	if (!refined || !first (refined.get())) return;
+	// created with make_shared, object and counts in one block
+	mUsage.bytes += SharedCountBytes;
+	if (value.type() == PT_FRACTION) {
+		mUsage.bytes += sizeof (FractionValue);
+	} else {
+		mUsage.bytes += sizeof (ErrorMessage) + stringBytes (refined->toString());
+	}
+}
+
+void MemoryCounter::addFunction (const NamedFunction * function) {
+	if (!function || !first (function)) return;
+	size_t bytes = SharedCountBytes + sizeof (NamedFunction) + stringBytes (function->name()) + stringBytes (function->printingName());
+	mUsage.bytes       += bytes;
+	mUsage.sharedBytes += bytes;
+}
+
+void MemoryCounter::add (const ExpressionPtr & expression) {
+	if (!expression) return;
+	// Explicit stack, trees can be deeper than the call stack
+	mStack.push_back (expression.get());
+	while (!mStack.empty()) {
+		const Expression * node = mStack.back();
+		mStack.pop_back();
+		if (!first (node)) continue;
+		mUsage.nodes++;
+		mUsage.bytes += SharedCountBytes;
+		switch (node->kind()) {
+		case EK_VALUE: {
+			const Value * value = static_cast<const Value*> (node);
+			mUsage.bytes += sizeof (Value);
+			addValue (value->value());
+			break;
+		}
+		case EK_VARIABLE:
+			mUsage.bytes += sizeof (Variable) + stringBytes (static_cast<const Variable*> (node)->name());
+			break;
+		case EK_CONSTANT: {
+			const Constant * constant = static_cast<const Constant*> (node);
+			mUsage.bytes += sizeof (Constant) + stringBytes (constant->name());
+			addValue (constant->value());
+			break;
+		}
+		case EK_FUNCTION: {
+			const NamedFunctionExpression * function = static_cast<const NamedFunctionExpression*> (node);
+			mUsage.bytes += sizeof (NamedFunctionExpression) + function->argumentCount() * sizeof (ExpressionPtr);
+			addFunction (function->function().get());
+			for (size_t i = function->argumentCount(); i > 0; i--) {
+				mStack.push_back (function->argument (i - 1).get());
+			}
+			break;
+		}
+		case EK_ASSIGNMENT: {
+			const AssignmentExpression * assignment = static_cast<const AssignmentExpression*> (node);
+			mUsage.bytes += sizeof (AssignmentExpression);
+			mStack.push_back (assignment->argument().get());
+			mStack.push_back (assignment->variable().get());
+			break;
+		}
+		case EK_REDUCTION: {
+			const Reduction * reduction = static_cast<const Reduction*> (node);
+			mUsage.bytes += sizeof (Reduction);
+			mStack.push_back (reduction->body().get());
+			mStack.push_back (reduction->high().get());
+			mStack.push_back (reduction->low().get());
+			mStack.push_back (&reduction->index());
+			break;
+		}
+		case EK_PARAMETER:
+			mUsage.bytes += sizeof (Parameter) + stringBytes (static_cast<const Parameter*> (node)->name());
+			break;
+		case EK_DEFINITION: {
+			const FunctionDefinition * definition = static_cast<const FunctionDefinition*> (node);
+			const std::vector<String> & parameters (definition->parameters());
+			mUsage.bytes += sizeof (FunctionDefinition) + parameters.capacity() * sizeof (String);
+			for (size_t i = 0; i < parameters.size(); i++) {
+				mUsage.bytes += stringBytes (parameters[i]);
+			}
+			addFunction (definition->function().get());
+			mStack.push_back (definition->function()->body().get());
+			break;
+		}
+		default:
+			mUsage.bytes += sizeof (Expression);
+			break;
+		}
+	}
+}
+
+void MemoryCounter::add (const ParserContext & context) {
+	mUsage.bytes += sizeof (ParserContext);
+	mUsage.bytes += mapBytes (context.constants) + mapBytes (context.functions) + mapBytes (context.nonPrefixFunctions);
+	for (ParserContext::ConstantMap::const_iterator i = context.constants.begin(); i != context.constants.end(); i++) {
+		mUsage.bytes += stringBytes (i->first);
+		add (i->second);
+	}
+	for (ParserContext::NamedFunctionMap::const_iterator i = context.functions.begin(); i != context.functions.end(); i++) {
+		mUsage.bytes += stringBytes (i->first);
+		addFunction (i->second.get());
+		add (i->second->body()); // user defined functions
+	}
+	for (ParserContext::NamedFunctionMap::const_iterator i = context.nonPrefixFunctions.begin(); i != context.nonPrefixFunctions.end(); i++) {
+		mUsage.bytes += stringBytes (i->first);
+		addFunction (i->second.get());
+	}
+}
+
+void MemoryCounter::add (const VariableIdMapping & mapping) {
+	mUsage.bytes += sizeof (VariableIdMapping);
+	mUsage.bytes += mapBytes (mapping.variableIds) + mapBytes (mapping.variableNames);
+	for (VariableIdMapping::VariableNameMap::const_iterator i = mapping.variableIds.begin(); i != mapping.variableIds.end(); i++) {
+		mUsage.bytes += stringBytes (i->first);
+	}
+	for (VariableIdMapping::ReverseVariableNameMap::const_iterator i = mapping.variableNames.begin(); i != mapping.variableNames.end(); i++) {
+		mUsage.bytes += stringBytes (i->second);
+	}
+}
+
+void MemoryCounter::add (const EvaluationContext & context) {
+	mUsage.bytes += sizeof (EvaluationContext) + context.variables.capacity() * sizeof (PrimitiveValue);
+	for (size_t i = 0; i < context.variables.size(); i++) {
+		addValue (context.variables[i]);
+	}
+}
+
+MemoryUsage memoryUsage (const ExpressionPtr & expression) {
+	MemoryCounter counter;
+	counter.add (expression);
+	return counter.usage();
+}
+
+MemoryUsage memoryUsage (const std::vector<ExpressionPtr> & expressions) {
+	MemoryCounter counter;
+	for (size_t i = 0; i < expressions.size(); i++) {
+		counter.add (expressions[i]);
+	}
+	return counter.usage();
+}
+
+MemoryUsage memoryUsage (const ParserContext & context) {
+	MemoryCounter counter;
+	counter.add (context);
+	return counter.usage();
+}
+
+MemoryUsage memoryUsage (const VariableIdMapping & mapping) {
+	MemoryCounter counter;
+	counter.add (mapping);
+	return counter.usage();
+}
+
+MemoryUsage memoryUsage (const EvaluationContext & context) {
+	MemoryCounter counter;
+	counter.add (context);
+	return counter.usage();
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "types.h"
+#include "Expression.h"
+#include <boost/unordered_set.hpp>
+#include <vector>
+
+/**
+ * @file
+ * Estimation of the memory footprint of expressions and calculator state.
+ *
+ * Bytes are the sizes of the objects and their heap buffers (node objects, shared
+ * pointer control blocks, argument vectors, string buffers, refined values, hash
+ * map nodes and buckets). Allocator overhead is not included.
+ */
+
+namespace sc {
+
+struct ParserContext;
+class NamedFunction;
+
+/// Counted memory
+struct MemoryUsage {
+	MemoryUsage () : nodes (0), bytes (0), sharedBytes (0) {}
+	size_t nodes;       ///< Expression nodes
+	size_t bytes;       ///< Bytes of the counted objects, including nodes
+	size_t sharedBytes; ///< Part of bytes held by NamedFunctions, which are shared between expressions and contexts
+
+	/// Average bytes per expression node, 0 without nodes
+	double bytesPerNode () const { return nodes ? (double) bytes / nodes : 0; }
+
+	MemoryUsage & operator+= (const MemoryUsage & other);
+};
+
+/**
+ * Counts the memory of several objects.
+ *
+ * Objects reachable more than once (shared subtrees, constants, named functions,
+ * refined values) are counted only at their first occurrence, also across
+ * all add calls of the same counter.
+ */
+class MemoryCounter {
+public:
+	void add (const ExpressionPtr & expression);
+	void add (const ParserContext & context);
+	void add (const VariableIdMapping & mapping);
+	void add (const EvaluationContext & context);
+
+	const MemoryUsage & usage () const { return mUsage; }
+private:
+	void addValue (const PrimitiveValue & value);
+	void addFunction (const NamedFunction * function);
+	/// Returns true if p was not seen before
+	bool first (const void * p);
+
+	MemoryUsage mUsage;
+	boost::unordered_set<const void*> mSeen;
+	std::vector<const Expression*> mStack;
+};
+
+/// Memory of an expression tree, shared subtrees are counted once
+MemoryUsage memoryUsage (const ExpressionPtr & expression);
+/// Memory of many expressions, subtrees shared between them are counted once
+MemoryUsage memoryUsage (const std::vector<ExpressionPtr> & expressions);
+/// Memory of registered constants and functions
+MemoryUsage memoryUsage (const ParserContext & context);
+/// Memory of variable names and ids
+MemoryUsage memoryUsage (const VariableIdMapping & mapping);
+/// Memory of the variable values
+MemoryUsage memoryUsage (const EvaluationContext & context);
+
+}
@@ -1,8 +1,11 @@
 #include "PrimitiveValue.h"
+#include "AllocationStats.h"
 #include <boost/make_shared.hpp>
+#include <string.h>
 namespace sc {
 
 PrimitiveValue::PrimitiveValue (Error e, const String & msg) : mType (PT_ERROR), mErrorValue (e) {
+	recordAllocation (sizeof (ErrorMessage));
 	mRefinedValue = boost::make_shared<ErrorMessage> (msg);
 }
 
@@ -14,9 +17,11 @@ PrimitiveValue::PrimitiveValue (const Fraction64 & f) {
 	} else if (!x.valid()){
 		mType = PT_ERROR;
 		mErrorValue = error::Eval_DivisionByZero;
+		recordAllocation (sizeof (ErrorMessage));
 		mRefinedValue = boost::make_shared<ErrorMessage> ("Division by zero");
 	} else {
 		mType = PT_FRACTION;
+		recordAllocation (sizeof (FractionValue));
 		mRefinedValue = boost::make_shared<FractionValue> (x);
 	}
 }
@@ -56,6 +61,27 @@ const Fraction64 & PrimitiveValue::fraction () const {
 }
 
 
+uint64_t PrimitiveValue::hash () const {
+	uint64_t result = mType;
+	switch (mType) {
+	case PT_DOUBLE: {
+		uint64_t bits;
+		memcpy (&bits, &mDoubleValue, sizeof (bits));
+		return hashCombine (result, bits);
+	}
+	case PT_INT64:
+		return hashCombine (result, (uint64_t) mIntValue);
+	case PT_FRACTION:
+		result = hashCombine (result, (uint64_t) fraction().numerator());
+		return hashCombine (result, (uint64_t) fraction().denumerator());
+	case PT_ERROR:
+		result = hashCombine (result, (uint64_t) mErrorValue);
+		return hashCombine (result, hashString (mRefinedValue->toString()));
+	default:
+		return result;
+	}
+}
+
 bool PrimitiveValue::operator== (const PrimitiveValue & other) const {
 	if (mType == PT_ERROR) return mErrorValue == other.error();
 	if (mType == PT_INT64 && other.type() == PT_INT64) return mIntValue == other.mIntValue;
@@ -22,7 +22,7 @@ class FractionValue;
 /// Other subtypes shall use union's or similar
 class PrimitiveValue {
 public:
-	PrimitiveValue () : mType (PT_NULL) {}
+	PrimitiveValue () : mType (PT_NULL), mIntValue (0) {}
 	PrimitiveValue (double d) : mType (PT_DOUBLE), mDoubleValue (d) {}
 	PrimitiveValue (int64_t i) : mType (PT_INT64), mIntValue (i) {}
 	PrimitiveValue (Error e, const String & msg);
@@ -57,6 +57,9 @@ public:
 
 	/// Exact comparison operator
 	bool operator== (const PrimitiveValue & other) const;
+
+	/// Hash of type and value
+	uint64_t hash () const;
 private:
 	PrimitiveValueType mType;
 	union {
@@ -0,0 +1,126 @@
+#include "Profiler.h"
+#include "impl/NamedFunction.h"
+#include "impl/AssignmentExpression.h"
+#include "Trace.h"
+#include <algorithm>
+#include <stdio.h>
+
+namespace sc {
+
+EvaluationProfiler::EvaluationProfiler () : mTotalNs (0) {
+	mStack.reserve (32);
+}
+
+void EvaluationProfiler::clear () {
+	mNodes.clear();
+	mFunctions.clear();
+	mTotalNs = 0;
+}
+
+const EvaluationProfiler::Stats * EvaluationProfiler::nodeStats (const Expression * node) const {
+	NodeMap::const_iterator i = mNodes.find (node);
+	return i == mNodes.end() ? 0 : &i->second;
+}
+
+const EvaluationProfiler::Stats * EvaluationProfiler::functionStats (const NamedFunction * function) const {
+	FunctionMap::const_iterator i = mFunctions.find (function);
+	return i == mFunctions.end() ? 0 : &i->second;
+}
+
+void EvaluationProfiler::enter () {
+	Frame frame;
+	frame.children = 0;
+	frame.start = monotonicNs();
+	mStack.push_back (frame);
+}
+
+void EvaluationProfiler::leave (const NamedFunctionExpression * node, bool fallback) {
+	uint64_t end = monotonicNs();
+	assert (!mStack.empty());
+	Frame frame = mStack.back();
+	mStack.pop_back();
+	uint64_t inclusive = end - frame.start;
+	uint64_t exclusive = inclusive > frame.children ? inclusive - frame.children : 0;
+	if (mStack.empty()) {
+		mTotalNs += inclusive;
+	} else {
+		mStack.back().children += inclusive;
+	}
+	Stats * targets[2] = { &mNodes[node], &mFunctions[node->function().get()] };
+	for (int i = 0; i < 2; i++) {
+		targets[i]->calls++;
+		targets[i]->inclusiveNs += inclusive;
+		targets[i]->exclusiveNs += exclusive;
+		if (fallback) targets[i]->fallbacks++;
+	}
+}
+
+static void appendStats (const EvaluationProfiler::Stats & stats, std::string & output) {
+	char buffer[96];
+	snprintf (buffer, sizeof (buffer), "%10lu %12.3f %12.3f %10lu  ", (unsigned long) stats.calls,
+			stats.inclusiveNs / 1000.0, stats.exclusiveNs / 1000.0, (unsigned long) stats.fallbacks);
+	output += buffer;
+}
+
+std::string EvaluationProfiler::report (const ExpressionPtr & root) const {
+	std::string output;
+	char buffer[64];
+	snprintf (buffer, sizeof (buffer), "total %.3fus\n", mTotalNs / 1000.0);
+	output += buffer;
+	output += "     calls      incl us      excl us  fallbacks  node\n";
+	reportNodes (root.get(), output);
+
+	// Functions, most expensive first
+	std::vector<std::pair<uint64_t, const NamedFunction*> > order;
+	for (FunctionMap::const_iterator i = mFunctions.begin(); i != mFunctions.end(); i++) {
+		order.push_back (std::make_pair (i->second.exclusiveNs, i->first));
+	}
+	std::sort (order.rbegin(), order.rend());
+	output += "     calls      incl us      excl us  fallbacks  function\n";
+	for (size_t i = 0; i < order.size(); i++) {
+		appendStats (mFunctions.find (order[i].second)->second, output);
+		output += order[i].second->name();
+		output += "\n";
+	}
+	return output;
+}
+
+/// Deeper nodes are indented like this depth, followed by their depth, so that lines stay short
+static const size_t MaxReportIndent = 32;
+
+void EvaluationProfiler::reportNodes (const Expression * root, std::string & output) const {
+	// Explicit stack, so that the depth of the tree is not limited by the call stack
+	std::vector<std::pair<const Expression*, size_t> > stack;
+	stack.push_back (std::make_pair (root, (size_t) 0));
+	while (!stack.empty()) {
+		const Expression * node = stack.back().first;
+		size_t depth = stack.back().second;
+		stack.pop_back();
+		if (node->kind() == EK_ASSIGNMENT) {
+			stack.push_back (std::make_pair (static_cast<const AssignmentExpression*> (node)->argument().get(), depth));
+			continue;
+		}
+		if (node->kind() != EK_FUNCTION) continue; // leaves are not profiled
+		const NamedFunctionExpression * function = static_cast<const NamedFunctionExpression*> (node);
+		const Stats * stats = nodeStats (node);
+		if (stats) {
+			appendStats (*stats, output);
+		} else {
+			output += "         -            -            -          -  ";
+		}
+		// the indentation shows the tree, each line only names the function of its node
+		output.append (std::min (depth, MaxReportIndent) * 2, ' ');
+		if (depth > MaxReportIndent) {
+			char buffer[32];
+			snprintf (buffer, sizeof (buffer), "[%lu] ", (unsigned long) depth);
+			output += buffer;
+		}
+		output += function->function()->favouredName();
+		output += "\n";
+		for (size_t i = function->argumentCount(); i > 0; i--) {
+			stack.push_back (std::make_pair (function->argument(i - 1).get(), depth + 1));
+		}
+	}
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "types.h"
+#include "Expression.h"
+#include <vector>
+
+namespace sc {
+
+class NamedFunction;
+class NamedFunctionExpression;
+
+/**
+ * Profiler for the evaluation of expressions.
+ *
+ * Set it as EvaluationContext::profiler to enable it; each evaluated function node
+ * then records its call count, inclusive and exclusive time (steady clock) and
+ * the number of accurate to double fallbacks (evaluation in accurate level where
+ * all arguments were accurate, but the result is a double).
+ * Statistics are kept per expression node and per NamedFunction.
+ *
+ * Nodes are referenced by address, so the profiled expressions have to stay alive
+ * while reporting. Without a profiler evaluation just checks a null pointer.
+ *
+ * Note: this is NOT threadsafe, use one profiler per evaluating thread.
+ */
+class EvaluationProfiler {
+public:
+	struct Stats {
+		Stats () : calls (0), inclusiveNs (0), exclusiveNs (0), fallbacks (0) {}
+		uint64_t calls;
+		uint64_t inclusiveNs;
+		uint64_t exclusiveNs;
+		uint64_t fallbacks;
+	};
+	typedef unordered_map<const Expression*, Stats> NodeMap;
+	typedef unordered_map<const NamedFunction*, Stats> FunctionMap;
+
+	EvaluationProfiler ();
+
+	/// Removes all statistics
+	void clear ();
+
+	/// Statistics of a node, 0 if it was not evaluated
+	const Stats * nodeStats (const Expression * node) const;
+	/// Statistics of a function over all its nodes, 0 if it was not evaluated
+	const Stats * functionStats (const NamedFunction * function) const;
+
+	const NodeMap & nodes () const { return mNodes; }
+	const FunctionMap & functions () const { return mFunctions; }
+
+	/// Sum of inclusive time of all outermost evaluations
+	uint64_t totalNs () const { return mTotalNs; }
+
+	/// Renders the statistics as indented tree along the nodes of root (one line with the function per node,
+	/// linear in the size of root), followed by a per function summary
+	std::string report (const ExpressionPtr & root) const;
+
+	// Called by evaluation
+	void enter ();
+	void leave (const NamedFunctionExpression * node, bool fallback);
+
+private:
+	void reportNodes (const Expression * root, std::string & output) const;
+
+	struct Frame {
+		uint64_t start;
+		uint64_t children; ///< Inclusive time of child calls
+	};
+	std::vector<Frame> mStack;
+	NodeMap mNodes;
+	FunctionMap mFunctions;
+	uint64_t mTotalNs;
+};
+
+}
@@ -0,0 +1,128 @@
+#include "Tabulate.h"
+#include "Trace.h"
+#include "Budget.h"
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+namespace sc {
+
+namespace {
+
+/// One contiguous part of a tabulation, evaluated by one thread
+struct TabulationPart {
+	const Expression * expression;
+	const EvaluationContext * context;
+	VariableId variable;
+	double lo, hi;
+	size_t n;
+	size_t begin, end;
+	double * y;
+	uint8_t * errorMask;
+	boost::atomic<uint64_t> * sharedSteps; ///< Steps of all threads, their budgets share the limit
+	int threads;
+	size_t errors;
+	uint64_t steps;
+
+	void run () {
+		TraceSpan span ("tabulate");
+		EvaluationContext own;
+		if (context) own = *context;
+		own.accurateLevel = false;
+		// not threadsafe
+		own.profiler = 0;
+		own.fallbacks = 0;
+		own.dependencies = 0;
+		own.threads = 1; // already parallel
+		// each thread gets its own budget, sharing the step limit; deadline and cancel flag are shared anyway
+		EvaluationBudget budget;
+		if (own.budget) {
+			budget = *own.budget;
+			budget.share (sharedSteps, threads);
+			own.budget = &budget;
+		}
+		uint64_t start = budget.steps();
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		size_t count = 0; // local, parts of other threads are close in memory
+		for (size_t i = begin; i < end; i++) {
+			own.setVariable (variable, doubleValue (tabulationX (lo, hi, i, n)));
+			PrimitiveValue v = expression->eval (&own);
+			double d = v.type() == PT_ERROR ? nan : v.toDouble();
+			bool error = !isfinite (d);
+			y[i] = error ? nan : d;
+			if (errorMask) errorMask[i] = error ? 1 : 0;
+			if (error) count++;
+		}
+		errors = count;
+		steps = budget.steps() - start;
+	}
+};
+
+/// Minimum samples per thread, fewer are not worth starting a thread
+const size_t MinSamplesPerThread = 4096;
+
+}
+
+size_t tabulate (const ExpressionPtr & expression, VariableId variable, double lo, double hi, size_t n,
+		double * y, uint8_t * errorMask, int threads, const EvaluationContext * context) {
+	if (n == 0) return 0;
+	if (threads <= 0) threads = boost::thread::hardware_concurrency();
+	if (threads <= 0) threads = 1;
+	threads = (int) std::max ((size_t) 1, std::min ((size_t) threads, n / MinSamplesPerThread));
+
+	EvaluationBudget * budget = context ? context->budget : 0;
+	boost::atomic<uint64_t> sharedSteps (budget ? budget->steps() : 0);
+	std::vector<TabulationPart> parts (threads);
+	for (int t = 0; t < threads; t++) {
+		TabulationPart & part = parts[t];
+		part.expression = expression.get();
+		part.context    = context;
+		part.variable   = variable;
+		part.lo         = lo;
+		part.hi         = hi;
+		part.n          = n;
+		part.begin      = n * t / threads;
+		part.end        = n * (t + 1) / threads;
+		part.y          = y;
+		part.errorMask  = errorMask;
+		part.sharedSteps = &sharedSteps;
+		part.threads    = threads;
+		part.errors     = 0;
+		part.steps      = 0;
+	}
+	if (threads == 1) {
+		parts[0].run();
+	} else {
+		boost::thread_group workers;
+		for (int t = 1; t < threads; t++) {
+			workers.create_thread (boost::bind (&TabulationPart::run, &parts[t]));
+		}
+		parts[0].run();
+		workers.join_all();
+	}
+	size_t errors = 0;
+	for (int t = 0; t < threads; t++) {
+		errors += parts[t].errors;
+		if (budget) budget->consume (parts[t].steps);
+	}
+	return errors;
+}
+
+Tabulation tabulate (const ExpressionPtr & expression, VariableId variable, double lo, double hi, size_t n, int threads) {
+	Tabulation result;
+	result.x.resize (n);
+	result.y.resize (n);
+	result.errors.resize (n);
+	for (size_t i = 0; i < n; i++) {
+		result.x[i] = tabulationX (lo, hi, i, n);
+	}
+	if (n > 0) {
+		result.errorCount = tabulate (expression, variable, lo, hi, n, &result.y[0], &result.errors[0], threads);
+	}
+	return result;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "types.h"
+#include "Expression.h"
+#include <vector>
+
+namespace sc {
+
+/// Samples of an expression, see tabulate
+struct Tabulation {
+	Tabulation () : errorCount (0) {}
+	std::vector<double> x;
+	std::vector<double> y;        ///< NaN for samples with errors
+	std::vector<uint8_t> errors;  ///< 1 if the sample had an error, 0 otherwise
+	size_t errorCount;
+};
+
+/**
+ * Evaluates expression at n equidistant points lo..hi (both included) of variable
+ * and writes the results into y (and errorMask, optional), both preallocated with n entries.
+ *
+ * The range is split into contiguous parts, each evaluated by its own thread with its
+ * own copy of context (0 for an empty one); the threads write disjoint parts of the output.
+ * Calculation is done in non accurate mode. Samples with errors or non finite results
+ * (e.g. division by zero) get NaN.
+ * A budget of context limits the whole tabulation: the threads share its step limit
+ * (see EvaluationBudget::share) and their steps are charged to it afterwards, so a budget
+ * reused across calls runs out. Once exhausted, the remaining samples get NaN quickly.
+ *
+ * threads = 0 uses one thread per core. Returns the number of samples with errors.
+ */
+size_t tabulate (const ExpressionPtr & expression, VariableId variable, double lo, double hi, size_t n,
+		double * y, uint8_t * errorMask = 0, int threads = 0, const EvaluationContext * context = 0);
+
+/// Convenience variant of tabulate, also returning the x values
+Tabulation tabulate (const ExpressionPtr & expression, VariableId variable, double lo, double hi, size_t n, int threads = 0);
+
+/// x value of sample i of n in lo..hi, as used by tabulate
+inline double tabulationX (double lo, double hi, size_t i, size_t n) {
+	if (n < 2) return lo;
+	return lo + (hi - lo) * ((double) i / (double) (n - 1));
+}
+
+}
@@ -0,0 +1,192 @@
+#include "Trace.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#ifndef WIN32
+#include <time.h>
+#endif
+
+namespace sc {
+
+uint64_t monotonicNs () {
+#ifndef WIN32
+	struct timespec t;
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+#else
+	static const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1000ULL;
+#endif
+}
+
+boost::atomic<bool> gTracingEnabled (false);
+
+namespace {
+
+struct TraceEvent {
+	const char * name;
+	uint64_t start;
+	uint64_t duration;
+};
+
+/// Ring buffer of one thread at a time. Only that thread writes events, the lock
+/// (uncontended then) protects against clearing, resizing and exporting.
+struct TraceBuffer {
+	TraceBuffer (int tid, size_t capacity) : tid (tid), written (0), events (capacity) {}
+	boost::mutex mutex;
+	int tid;
+	uint64_t written;
+	std::vector<TraceEvent> events;
+};
+
+void releaseBuffer (TraceBuffer * buffer);
+
+/// All buffers, they stay alive after their thread has finished and are reused by new threads
+struct TraceRegistry {
+	TraceRegistry () : capacity (65536), owner (&releaseBuffer) {}
+	boost::mutex mutex; ///< Locked before the mutex of a buffer
+	std::vector<boost::shared_ptr<TraceBuffer> > buffers;
+	std::vector<TraceBuffer*> unused; ///< Buffers of finished threads
+	size_t capacity;
+	boost::thread_specific_ptr<TraceBuffer> owner; ///< Hands the buffer back when its thread finishes
+};
+
+TraceRegistry & registry () {
+	// Never destroyed, threads may finish (and release their buffer) during static destruction
+	static TraceRegistry * instance = new TraceRegistry ();
+	return *instance;
+}
+
+void releaseBuffer (TraceBuffer * buffer) {
+	TraceRegistry & r (registry());
+	boost::lock_guard<boost::mutex> lock (r.mutex);
+	r.unused.push_back (buffer);
+}
+
+#ifdef _MSC_VER
+__declspec(thread) TraceBuffer * threadBuffer = 0;
+#else
+__thread TraceBuffer * threadBuffer = 0;
+#endif
+
+TraceBuffer * currentBuffer () {
+	if (!threadBuffer) {
+		TraceRegistry & r (registry());
+		{
+			boost::lock_guard<boost::mutex> lock (r.mutex);
+			if (r.unused.empty()) {
+				boost::shared_ptr<TraceBuffer> buffer (new TraceBuffer ((int) r.buffers.size() + 1, r.capacity));
+				r.buffers.push_back (buffer);
+				threadBuffer = buffer.get();
+			} else {
+				threadBuffer = r.unused.back();
+				r.unused.pop_back();
+			}
+		}
+		r.owner.reset (threadBuffer);
+	}
+	return threadBuffer;
+}
+
+}
+
+void setTracingEnabled (bool enabled) {
+	// Make sure the registry exists before any span
+	registry ();
+	gTracingEnabled = enabled;
+}
+
+void setTraceBufferSize (size_t events) {
+	TraceRegistry & r (registry());
+	boost::lock_guard<boost::mutex> lock (r.mutex);
+	r.capacity = std::max ((size_t) 1, events);
+	for (size_t i = 0; i < r.buffers.size(); i++) {
+		TraceBuffer & b (*r.buffers[i]);
+		boost::lock_guard<boost::mutex> bufferLock (b.mutex);
+		b.events.assign (r.capacity, TraceEvent ());
+		b.written = 0;
+	}
+}
+
+void clearTrace () {
+	TraceRegistry & r (registry());
+	boost::lock_guard<boost::mutex> lock (r.mutex);
+	for (size_t i = 0; i < r.buffers.size(); i++) {
+		TraceBuffer & b (*r.buffers[i]);
+		boost::lock_guard<boost::mutex> bufferLock (b.mutex);
+		b.written = 0;
+	}
+}
+
+size_t traceEventCount () {
+	TraceRegistry & r (registry());
+	boost::lock_guard<boost::mutex> lock (r.mutex);
+	size_t count = 0;
+	for (size_t i = 0; i < r.buffers.size(); i++) {
+		TraceBuffer & b (*r.buffers[i]);
+		boost::lock_guard<boost::mutex> bufferLock (b.mutex);
+		count += (size_t) std::min (b.written, (uint64_t) b.events.size());
+	}
+	return count;
+}
+
+size_t traceBufferCount () {
+	TraceRegistry & r (registry());
+	boost::lock_guard<boost::mutex> lock (r.mutex);
+	return r.buffers.size();
+}
+
+std::string traceEventJson () {
+	TraceRegistry & r (registry());
+	boost::lock_guard<boost::mutex> lock (r.mutex);
+	std::string output = "{\"traceEvents\":[";
+	bool first = true;
+	char buffer[256];
+	for (size_t i = 0; i < r.buffers.size(); i++) {
+		TraceBuffer & b (*r.buffers[i]);
+		boost::lock_guard<boost::mutex> bufferLock (b.mutex);
+		size_t capacity = b.events.size();
+		uint64_t begin = b.written > capacity ? b.written - capacity : 0;
+		for (uint64_t j = begin; j < b.written; j++) {
+			const TraceEvent & e (b.events[j % capacity]);
+			// Chrome wants microseconds, fractions are allowed
+			snprintf (buffer, sizeof (buffer), "%s\n{\"name\":\"%s\",\"cat\":\"smallcalc\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+					first ? "" : ",", e.name, e.start / 1000.0, e.duration / 1000.0, b.tid);
+			output += buffer;
+			first = false;
+		}
+	}
+	output += "\n],\"displayTimeUnit\":\"ns\"}\n";
+	return output;
+}
+
+bool writeTraceEvents (const std::string & file) {
+	std::ofstream out (file.c_str());
+	if (!out) return false;
+	out << traceEventJson ();
+	return (bool) out;
+}
+
+void TraceSpan::begin (const char * name) {
+	mName  = name;
+	mStart = monotonicNs ();
+}
+
+void TraceSpan::end () {
+	uint64_t now = monotonicNs ();
+	TraceBuffer * b = currentBuffer ();
+	boost::lock_guard<boost::mutex> lock (b->mutex);
+	TraceEvent & e (b->events[b->written % b->events.size()]);
+	e.name     = mName;
+	e.start    = mStart;
+	e.duration = now - mStart;
+	b->written++;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <boost/atomic.hpp>
+
+/**
+ * @file
+ * Lightweight phase tracing.
+ *
+ * TraceSpan objects mark phases (tokenize, parse, compress, compile, eval, convert,
+ * layout, draw). If tracing is enabled, every finished span is written into a ring
+ * buffer of the current thread, which keeps the newest events. The buffers can be
+ * exported as Chrome trace_event JSON (chrome://tracing, Perfetto).
+ *
+ * A finished thread hands its buffer (with its events) back to a pool, the next new
+ * thread continues writing into it under the same tid. So there are only as many
+ * buffers as threads tracing at the same time.
+ *
+ * If tracing is disabled a span only tests a global flag.
+ */
+
+namespace sc {
+
+/// Monotonic time in nanoseconds
+uint64_t monotonicNs ();
+
+/// Global switch (use setTracingEnabled)
+extern boost::atomic<bool> gTracingEnabled;
+
+inline bool tracingEnabled () { return gTracingEnabled.load (boost::memory_order_relaxed); }
+
+/// Enables/Disables tracing for all threads
+void setTracingEnabled (bool enabled = true);
+
+/// Sets the capacity (in events) of the ring buffers, clears all recorded events
+void setTraceBufferSize (size_t events);
+
+/// Removes all recorded events
+void clearTrace ();
+
+/// Number of recorded events in all buffers
+size_t traceEventCount ();
+
+/// Number of ring buffers (at most the number of threads which traced at the same time)
+size_t traceBufferCount ();
+
+/// Returns all recorded events as Chrome trace_event JSON
+std::string traceEventJson ();
+
+/// Writes traceEventJson() into a file, returns false on error
+bool writeTraceEvents (const std::string & file);
+
+/// Records the duration of a scope, name must be a static string
+class TraceSpan {
+public:
+	TraceSpan (const char * name) : mName (0) {
+		if (tracingEnabled()) begin (name);
+	}
+	~TraceSpan () {
+		if (mName) end ();
+	}
+private:
+	void begin (const char * name);
+	void end ();
+	const char * mName;
+	uint64_t mStart;
+	// forbidden
+	TraceSpan (const TraceSpan&);
+	void operator= (const TraceSpan&);
+};
+
+}
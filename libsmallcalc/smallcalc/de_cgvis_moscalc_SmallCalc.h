@@ -15,6 +15,110 @@ extern "C" {
 JNIEXPORT jstring JNICALL Java_de_cgvis_moscalc_SmallCalc_calc
   (JNIEnv *, jclass, jstring);
 
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    calcAll
+ * Signature: ([Ljava/lang/String;)[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_de_cgvis_moscalc_SmallCalc_calcAll
+  (JNIEnv *, jclass, jobjectArray);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    parseFormula
+ * Signature: (Ljava/lang/String;Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_de_cgvis_moscalc_SmallCalc_parseFormula
+  (JNIEnv *, jclass, jstring, jstring);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    releaseFormula
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_releaseFormula
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    evalArray
+ * Signature: (J[D[D)I
+ */
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_evalArray
+  (JNIEnv *, jclass, jlong, jdoubleArray, jdoubleArray);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    evalBuffer
+ * Signature: (JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;I)I
+ */
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_evalBuffer
+  (JNIEnv *, jclass, jlong, jobject, jobject, jint);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    createEnv
+ * Signature: (Z)J
+ */
+JNIEXPORT jlong JNICALL Java_de_cgvis_moscalc_SmallCalc_createEnv
+  (JNIEnv *, jclass, jboolean);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    freeEnv
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_freeEnv
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    variableId
+ * Signature: (JLjava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_variableId
+  (JNIEnv *, jclass, jlong, jstring);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    setVariable
+ * Signature: (JID)V
+ */
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_setVariable
+  (JNIEnv *, jclass, jlong, jint, jdouble);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    compile
+ * Signature: (JLjava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_de_cgvis_moscalc_SmallCalc_compile
+  (JNIEnv *, jclass, jlong, jstring);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    freeExpression
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_freeExpression
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    evalDouble
+ * Signature: (JJ)D
+ */
+JNIEXPORT jdouble JNICALL Java_de_cgvis_moscalc_SmallCalc_evalDouble
+  (JNIEnv *, jclass, jlong, jlong);
+
+/*
+ * Class:     de_cgvis_moscalc_SmallCalc
+ * Method:    evalValue
+ * Signature: (JJ[J)I
+ */
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_evalValue
+  (JNIEnv *, jclass, jlong, jlong, jlongArray);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,21 +1,32 @@
 #include "AssignmentExpression.h"
 #include "Variable.h"
+#include "../DependencyGraph.h"
 
 namespace sc {
 
 PrimitiveValue AssignmentExpression::eval (EvaluationContext * evaluationContext) const {
-	shared_ptr<Variable> var = boost::dynamic_pointer_cast<Variable>(mVariable);
-	if (!var) return errorValue (error::Eval_BadType, "Variable expected on left side");
+	if (mVariable->kind() != EK_VARIABLE) return errorValue (error::Eval_BadType, "Variable expected on left side");
+	const Variable & var (static_cast<const Variable&> (*mVariable));
+	// Only top level assignments become definitions; inside a function body or a reduction
+	// the right side may read parameters, which are unbound when the definition gets recalculated
+	if (evaluationContext->dependencies && !evaluationContext->frames) return evaluationContext->dependencies->define (var.id(), mArgument, evaluationContext);
 	PrimitiveValue right = mArgument->eval(evaluationContext);
 
 	if (right.error()) return right;
-	evaluationContext->setVariable (var->id(), right);
+	if (evaluationContext->dependencies) evaluationContext->dependencies->set (var.id(), right, evaluationContext);
+	else evaluationContext->setVariable (var.id(), right);
 	return right;
 }
 
-std::string AssignmentExpression::print (PrintingContext * context) const {
+uint64_t AssignmentExpression::structuralHash () const {
+	return hashCombine (hashCombine (EK_ASSIGNMENT, mVariable->structuralHash()), mArgument->structuralHash());
+}
+
+void AssignmentExpression::printTo (std::string & output, PrintingContext * context) const {
 	PushPrecedence push (context, 0);
-	return mVariable->print(context) + " = " + mArgument->print(context);
+	mVariable->printTo (output, context);
+	output += " = ";
+	mArgument->printTo (output, context);
 }
 
 }
@@ -12,12 +12,18 @@ namespace sc {
  */
 class AssignmentExpression : public Expression {
 public:
-	AssignmentExpression (const ExpressionPtr & variable, const ExpressionPtr & argument) : mVariable (variable), mArgument (argument) {}
+	AssignmentExpression (const ExpressionPtr & variable, const ExpressionPtr & argument) : Expression (EK_ASSIGNMENT), mVariable (variable), mArgument (argument) {}
 	virtual ~AssignmentExpression (){}
 
 	// Implementation of Expression
 	virtual PrimitiveValue eval (EvaluationContext * evaluationContext) const;
-	virtual std::string print (PrintingContext * printingContext) const;
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const;
+	virtual uint64_t structuralHash () const;
+
+	/// Left side of the assignment
+	const ExpressionPtr & variable () const { return mVariable; }
+	/// Right side of the assignment
+	const ExpressionPtr & argument () const { return mArgument; }
 
 private:
 	ExpressionPtr mVariable;
@@ -6,10 +6,11 @@ namespace sc {
 /// A constant with a given name and value
 class Constant : public Expression {
 public:
-	Constant (const std::string & name, const PrimitiveValue & value) : mName (name), mValue (value) {};
+	Constant (const std::string & name, const PrimitiveValue & value) : Expression (EK_CONSTANT), mName (name), mValue (value) {};
 
 	virtual PrimitiveValue eval (EvaluationContext * calcContext) const { return mValue; }
-	virtual std::string print (PrintingContext * printingContext) const { return mName; }
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const { output += mName; }
+	virtual uint64_t structuralHash () const { return hashCombine (EK_CONSTANT, hashString (mName)); }
 
 	const std::string& name() const { return mName; }
 
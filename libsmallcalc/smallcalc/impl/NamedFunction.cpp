@@ -1,4 +1,6 @@
 #include "NamedFunction.h"
+#include "../Profiler.h"
+#include "../Budget.h"
 
 namespace sc {
 
@@ -7,6 +9,13 @@ bool NamedFunction::checkArity (int count) const {
 	else return (0-mArity) - 1 <= count;
 }
 
+bool NamedFunction::setMemoization (size_t capacity) {
+	if (!mPure || !mEvaluationCallback) return false;
+	if (capacity) mMemoTable.reset (new MemoTable (capacity));
+	else mMemoTable.reset ();
+	return true;
+}
+
 ExpressionPtr NamedFunction::createExpression (const NamedFunctionPtr & me, const std::vector<ExpressionPtr>& arguments) {
 	assert (checkArity ((int)arguments.size()));
 	if (mCreateExpressionCallback) {
@@ -32,65 +41,193 @@ ExpressionPtr NamedFunction::createExpression (const NamedFunctionPtr & me, cons
 void NamedFunctionExpression::addArgument (const ExpressionPtr & arg) {
 	assert (mFunction->arity() < 0); /// must be able to hold multiple arguments
 	mArguments.push_back (arg);
+	mHash = hashCombine (mHash, arg->structuralHash()); // same as calculateHash()
+}
+
+NamedFunctionExpression::~NamedFunctionExpression () {
+	// Take over the arguments of subtrees only referenced from here, so that
+	// their destructors do not recurse into the next level
+	if (mArguments.empty()) return;
+	ExpressionVector pending;
+	pending.swap (mArguments);
+	while (!pending.empty()) {
+		ExpressionPtr current;
+		current.swap (pending.back());
+		pending.pop_back();
+		if (current.unique() && current->kind() == EK_FUNCTION) {
+			NamedFunctionExpression * function = static_cast<NamedFunctionExpression*> (current.get());
+			pending.insert (pending.end(), function->mArguments.begin(), function->mArguments.end());
+			function->mArguments.clear();
+		}
+	}
+}
+
+void NamedFunctionExpression::calculateHash () {
+	// Arguments are constructed before, so this does not descend
+	mHash = hashCombine (EK_FUNCTION, hashString (mFunction->name()));
+	for (ExpressionVector::const_iterator i = mArguments.begin(); i != mArguments.end(); i++) {
+		mHash = hashCombine (mHash, (*i)->structuralHash());
+	}
 }
 
-std::string NamedFunctionExpression::print (PrintingContext * printingContext) const {
+namespace {
+
+/// State of a function node while printing it
+struct PrintFrame {
+	enum Mode { PM_INFIX, PM_PREFIX, PM_REGULAR };
+	const NamedFunctionExpression * node;
+	size_t next;         ///< Next argument to print
+	Mode mode;
+	bool parenthesis;    ///< Surrounded by parenthesis
+	int oldPrecedence;   ///< Restored when leaving the node
+};
+
+PrintFrame enterPrint (const NamedFunctionExpression * node, std::string & output, PrintingContext * printingContext) {
+	const NamedFunction & function (*node->function());
 	bool canSkipParenthesis = false;
-	if (printingContext && printingContext->precedenceOptimization) {
-		if (mFunction->precedence() > printingContext->currentPrecedence) {
+	if (printingContext->precedenceOptimization) {
+		if (function.precedence() > printingContext->currentPrecedence) {
 			canSkipParenthesis = true;
 		}
-		if (mFunction->isAssociative() && (mFunction->precedence() == printingContext->currentPrecedence)) {
+		if (function.isAssociative() && (function.precedence() == printingContext->currentPrecedence)) {
 			canSkipParenthesis = true;
 		}
 	}
-	PushPrecedence push (printingContext, mFunction->precedence());
-	std::ostringstream ss;
-	if (mFunction->notation() == FN_INFIX){
+	PrintFrame frame;
+	frame.node = node;
+	frame.next = 0;
+	frame.parenthesis = !canSkipParenthesis;
+	frame.oldPrecedence = printingContext->currentPrecedence;
+	printingContext->currentPrecedence = function.precedence();
+	if (function.notation() == FN_INFIX) {
 		// Infix like +-*/
-		if (!canSkipParenthesis) ss << "(";
-		bool first = true;
-		for (ExpressionVector::const_iterator i = mArguments.begin(); i != mArguments.end(); i++){
-			if (!first) { ss << " " << mFunction->favouredName() << " ";}
-			first = false;
-			ss << (*i)->print(printingContext);
-		}
-		if (!canSkipParenthesis) ss << ")";
-		return ss.str();
-	}
-	if (mFunction->notation() == FN_PREFIX && mArguments.size() == 1){
+		frame.mode = PrintFrame::PM_INFIX;
+		if (frame.parenthesis) output += '(';
+	} else if (function.notation() == FN_PREFIX && node->argumentCount() == 1) {
 		// Prefix like (-2)
-		if (!canSkipParenthesis) ss << "(";
-		ss << mFunction->favouredName() << mArguments[0]->print(printingContext);
-		if (!canSkipParenthesis) ss << ")";
-		return ss.str();
+		frame.mode = PrintFrame::PM_PREFIX;
+		if (frame.parenthesis) output += '(';
+		output += function.favouredName();
+	} else {
+		// Default / Fallback
+		frame.mode = PrintFrame::PM_REGULAR;
+		frame.parenthesis = true;
+		output += function.favouredName();
+		output += '(';
 	}
+	return frame;
+}
 
-	// Default / Fallback
-	ss << mFunction->favouredName() << "(";
-	bool first = true;
-	for (ExpressionVector::const_iterator i = mArguments.begin(); i != mArguments.end(); i++){
-		if (!first) { ss << ",";}
-		first = false;
-		ss << (*i)->print(printingContext);
+}
+
+void NamedFunctionExpression::printTo (std::string & output, PrintingContext * printingContext) const {
+	// Explicit stack, so that the depth of the tree is not limited by the call stack
+	std::vector<PrintFrame> frames;
+	frames.push_back (enterPrint (this, output, printingContext));
+	while (!frames.empty()) {
+		PrintFrame & frame (frames.back());
+		if (frame.next == frame.node->argumentCount()) {
+			if (frame.parenthesis) output += ')';
+			printingContext->currentPrecedence = frame.oldPrecedence;
+			frames.pop_back();
+			continue;
+		}
+		if (frame.next > 0) {
+			if (frame.mode == PrintFrame::PM_INFIX) {
+				output += ' ';
+				output += frame.node->function()->favouredName();
+				output += ' ';
+			} else {
+				output += ',';
+			}
+		}
+		const Expression * argument = frame.node->argument (frame.next++).get();
+		if (argument->kind() == EK_FUNCTION) {
+			frames.push_back (enterPrint (static_cast<const NamedFunctionExpression*> (argument), output, printingContext));
+		} else {
+			argument->printTo (output, printingContext);
+		}
 	}
-	ss << ")";
-	return ss.str();
 }
 
 PrimitiveValue NamedFunctionExpression::eval (EvaluationContext * calcContext) const {
+	if (calcContext->budget && !calcContext->budget->consume()) return calcContext->budget->error();
+	if (calcContext->depth >= MaxRecursionDepth) return evalIterative (calcContext);
+	if (calcContext->profiler) return evalProfiled (calcContext);
 	NamedFunction::PrimitiveArgumentVector parguments;
+	if (!mArguments.empty()) recordAllocation (mArguments.size() * sizeof (PrimitiveValue));
 	parguments.reserve (mArguments.size());
+	calcContext->depth++;
 	for (ExpressionVector::const_iterator i = mArguments.begin(); i != mArguments.end(); i++) {
 		PrimitiveValue val ((*i)->eval(calcContext));
 		parguments.push_back (val);
 	}
-//	std::cout << "Eval " << this->function()->name() << std::endl;
-//	BOOST_FOREACH(PrimitiveValue & val, parguments){
-//		std::cout << "   val " << val.toString() << std::endl;
-//	}
-	return mFunction->evaluationCallback() (parguments, calcContext);
+	calcContext->depth--;
+	return mFunction->call (parguments, calcContext);
 }
 
+PrimitiveValue NamedFunctionExpression::evalProfiled (EvaluationContext * calcContext) const {
+	EvaluationProfiler * profiler = calcContext->profiler;
+	profiler->enter();
+	NamedFunction::PrimitiveArgumentVector parguments;
+	if (!mArguments.empty()) recordAllocation (mArguments.size() * sizeof (PrimitiveValue));
+	parguments.reserve (mArguments.size());
+	bool accurateArguments = calcContext->accurateLevel;
+	calcContext->depth++;
+	for (ExpressionVector::const_iterator i = mArguments.begin(); i != mArguments.end(); i++) {
+		parguments.push_back ((*i)->eval(calcContext));
+		if (!parguments.back().isAccurateType()) accurateArguments = false;
+	}
+	calcContext->depth--;
+	PrimitiveValue result = mFunction->call (parguments, calcContext);
+	profiler->leave (this, accurateArguments && result.type() == PT_DOUBLE);
+	return result;
+}
+
+PrimitiveValue NamedFunctionExpression::evalIterative (EvaluationContext * calcContext) const {
+	struct Frame {
+		const NamedFunctionExpression * node;
+		size_t next; ///< Next argument to evaluate
+		size_t base; ///< Position of the first argument value
+	};
+	EvaluationProfiler * profiler = calcContext->profiler;
+	EvaluationBudget * budget = calcContext->budget;
+	std::vector<Frame> frames;
+	std::vector<PrimitiveValue> values;
+	Frame root = { this, 0, 0 };
+	frames.push_back (root);
+	if (profiler) profiler->enter();
+	while (!frames.empty()) {
+		Frame & frame (frames.back());
+		const NamedFunctionExpression * node = frame.node;
+		if (frame.next < node->mArguments.size()) {
+			const Expression * argument = node->mArguments[frame.next++].get();
+			if (argument->kind() == EK_FUNCTION && budget && !budget->consume()) {
+				values.push_back (budget->error());
+			} else if (argument->kind() == EK_FUNCTION) {
+				Frame child = { static_cast<const NamedFunctionExpression*> (argument), 0, values.size() };
+				frames.push_back (child);
+				if (profiler) profiler->enter();
+			} else {
+				values.push_back (argument->eval (calcContext));
+			}
+			continue;
+		}
+		if (!node->mArguments.empty()) recordAllocation (node->mArguments.size() * sizeof (PrimitiveValue));
+		NamedFunction::PrimitiveArgumentVector parguments (values.begin() + frame.base, values.end());
+		values.resize (frame.base);
+		PrimitiveValue result = node->mFunction->call (parguments, calcContext);
+		if (profiler) {
+			bool accurateArguments = calcContext->accurateLevel;
+			for (size_t i = 0; i < parguments.size(); i++) {
+				if (!parguments[i].isAccurateType()) accurateArguments = false;
+			}
+			profiler->leave (node, accurateArguments && result.type() == PT_DOUBLE);
+		}
+		values.push_back (result);
+		frames.pop_back();
+	}
+	return values.back();
+}
 
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "../Expression.h"
+#include "../MemoTable.h"
 #include <assert.h>
 #include <vector>
 
@@ -13,6 +14,20 @@ enum FuncNotation {
 	FN_POSTFIX
 };
 
+/** Ids of built in functions, which need special handling e.g. during printing. */
+enum BuiltinFunction {
+	BF_NONE,	///< Not a built in function
+	BF_ADD,
+	BF_MULTIPLY,
+	BF_SUBTRACT,
+	BF_DIVIDE,
+	BF_NEGATE,
+	BF_POW,
+	BF_ASSIGNMENT,
+	BF_SQRT,
+	BF_REDUCTION ///< sum, prod, min, max binding an index (see Reduction.h)
+};
+
 class NamedFunction;
 typedef shared_ptr<NamedFunction> NamedFunctionPtr;
 
@@ -29,6 +44,8 @@ public:
 	typedef std::vector<PrimitiveValue> PrimitiveArgumentVector;
 	typedef function<PrimitiveValue(const PrimitiveArgumentVector& arguments, const EvaluationContext* context)> EvaluationCallback;
 	typedef function<ExpressionPtr (const NamedFunctionPtr &, const std::vector<ExpressionPtr> &)> CreateExpressionCallback;
+	/// Plain double implementation of a function with one argument
+	typedef double (*DoubleFunction) (double);
 
 	NamedFunction (
 			const std::string& name,
@@ -44,9 +61,29 @@ public:
 		mAssociative (associative),
 		mPrintingName (printingName),
 		mFuncNotation (notation),
+		mBuiltin (BF_NONE),
+		mDoubleFunction (0),
+		mPure (false),
+		mBodySize (0),
 		mEvaluationCallback (evaluationCallback){
 	}
 
+	/// Marks the function as built in function
+	void setBuiltin (BuiltinFunction builtin) { mBuiltin = builtin; }
+
+	/// Sets a double implementation, equal to the evaluation callback in non accurate mode (used for compiled evaluation)
+	void setDoubleFunction (DoubleFunction f) { mDoubleFunction = f; }
+
+	/// Marks the function as pure: its result only depends on the arguments and the accurate level
+	void setPure (bool pure = true) { mPure = pure; }
+
+	/// Sets the body of a user defined function with nodes expression nodes (see UserFunction.h)
+	void setBody (const ExpressionPtr & body, size_t nodes) { mBody = body; mBodySize = nodes; }
+
+	/// Caches up to capacity results of a pure function (see MemoTable.h), 0 disables caching.
+	/// Returns false (and does nothing) if the function is not pure.
+	bool setMemoization (size_t capacity);
+
 	/// Overwrite default create expression callback
 	void setCreateExpressionCallback (const CreateExpressionCallback & createExpressionCallback){
 		mCreateExpressionCallback = createExpressionCallback;
@@ -70,6 +107,24 @@ public:
 	bool isAssociative () const { return mAssociative;}
 	/// Returns the notation of the function
 	FuncNotation notation () const { return mFuncNotation;}
+	/// Returns the built in function id, BF_NONE for regular functions
+	BuiltinFunction builtin () const { return mBuiltin; }
+	/// Returns the double implementation of an one argument function, 0 if not available
+	DoubleFunction doubleFunction () const { return mDoubleFunction; }
+	/// If the function is pure, see setPure
+	bool isPure () const { return mPure; }
+	/// Body of a user defined function, null for other functions
+	const ExpressionPtr & body () const { return mBody; }
+	/// Number of expression nodes of body
+	size_t bodySize () const { return mBodySize; }
+	/// Cache of results, 0 if memoization is disabled
+	MemoTable * memoTable () const { return mMemoTable.get(); }
+
+	/// Evaluates the function, using the memo table if enabled
+	PrimitiveValue call (const PrimitiveArgumentVector & arguments, const EvaluationContext * context) const {
+		if (!mMemoTable) return mEvaluationCallback (arguments, context);
+		return mMemoTable->call (mEvaluationCallback, arguments, context);
+	}
 
 	/// Crate an expression from this function
 	ExpressionPtr createExpression (const NamedFunctionPtr & me, const std::vector<ExpressionPtr>& arguments);
@@ -84,6 +139,12 @@ protected:
 	bool mAssociative;  ///< If the function is associative
 	String mPrintingName; ///< For not FN_REGULAR functions this is the symbol to be printeds (instead of name), not used if 0
 	FuncNotation mFuncNotation;
+	BuiltinFunction mBuiltin;
+	DoubleFunction mDoubleFunction;
+	bool mPure;
+	ExpressionPtr mBody;
+	size_t mBodySize;
+	shared_ptr<MemoTable> mMemoTable;
 	EvaluationCallback mEvaluationCallback;
 	CreateExpressionCallback mCreateExpressionCallback;
 };
@@ -93,6 +154,14 @@ inline NamedFunctionPtr createNamedFunction (const std::string& name, int arity,
 	return NamedFunctionPtr (new NamedFunction (name, arity, callback, FN_REGULAR, 0, false, printingName));
 }
 
+/// Creates a standard named function with one argument, which also has a plain double implementation (and is pure therefore)
+inline NamedFunctionPtr createNamedFunction (const std::string& name, const NamedFunction::EvaluationCallback& callback, NamedFunction::DoubleFunction doubleFunction, const std::string & printingName = "") {
+	NamedFunctionPtr result = createNamedFunction (name, 1, callback, printingName);
+	result->setDoubleFunction (doubleFunction);
+	result->setPure ();
+	return result;
+}
+
 /// Tool RAII struct for pushing precedence into a printing context and releasing it from return.
 struct PushPrecedence {
 	PushPrecedence (PrintingContext * context, int precedence) {
@@ -113,16 +182,21 @@ class NamedFunctionExpression : public Expression {
 public:
 	typedef std::vector<ExpressionPtr> ExpressionVector;
 	NamedFunctionExpression (const NamedFunctionPtr & function, const ExpressionVector& arguments = ExpressionVector())
-	: mFunction (function),
-	  mArguments (arguments) {
+	: Expression (EK_FUNCTION),
+	  mFunction (function),
+	  mArguments (arguments),
+	  mHash (0) {
 		assert (mFunction->arity() < 0 || (int) mArguments.size () == mFunction->arity());
+		calculateHash();
 	}
+	/// Releases deep trees without recursion
+	virtual ~NamedFunctionExpression ();
 
 	/// Adds an argument to the function; note this is only useful during parsing stage
 	void addArgument (const ExpressionPtr & arg);
 
 	/// Returns bound named function
-	const NamedFunctionPtr function() const {
+	const NamedFunctionPtr & function() const {
 		return mFunction;
 	}
 
@@ -130,17 +204,26 @@ public:
 	size_t argumentCount () const { return mArguments.size(); }
 
 	/// Returns argument
-	ExpressionPtr argument (size_t i) const { return mArguments[i]; }
+	const ExpressionPtr & argument (size_t i) const { return mArguments[i]; }
 
 
 	// Implementation of Expression
-	virtual std::string print (PrintingContext * printingContext) const;
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const;
 	virtual PrimitiveValue eval (EvaluationContext * calcContext) const;
+	virtual uint64_t structuralHash () const { return mHash; }
 
 
 private:
+	/// eval with recording into calcContext->profiler
+	PrimitiveValue evalProfiled (EvaluationContext * calcContext) const;
+	/// eval with an explicit stack, for subtrees deeper than MaxRecursionDepth
+	PrimitiveValue evalIterative (EvaluationContext * calcContext) const;
+	/// Calculates mHash from the (already calculated) hashes of the arguments
+	void calculateHash ();
+
 	NamedFunctionPtr mFunction;
 	ExpressionVector mArguments;
+	uint64_t mHash; ///< Structural hash, calculated on construction, so that shared trees stay read only
 };
 typedef shared_ptr<NamedFunctionExpression> NamedFunctionExpressionPtr;
 
@@ -4,7 +4,11 @@
 #include "../PrimitiveValue.h"
 #include "Value.h"
 #include "Tokenizer.h"
+#include "UserFunction.h"
+#include "Reduction.h"
+#include "../Trace.h"
 #include <assert.h>
+#include <algorithm>
 
 namespace sc {
 
@@ -36,7 +40,19 @@ Parser::Parser (const ParserContext * context) {
 }
 
 ExpressionPtr Parser::parse (const std::vector<Token> & tokens) {
+	TraceSpan span ("parse");
 	if (tokens.empty()) return createError (error::Parser_NoTokens, "No input", 0);
+	if (mContext->maxTokens && tokens.size() > mContext->maxTokens) {
+		return createError (error::Parser_LimitExceeded, "More than " + boost::lexical_cast<std::string> (mContext->maxTokens) + " tokens", 0);
+	}
+	mParameters.clear();
+	size_t equals = definitionEquals (tokens);
+	if (equals) return parseDefinition (tokens, equals);
+	return parseTokens (tokens);
+}
+
+ExpressionPtr Parser::parseTokens (const std::vector<Token> & tokens) {
+	int depth = 0;
 	bool awaitFunction = false;
 	Token tokenForAwaitFunction;
 	Token invalidToken;
@@ -44,12 +60,19 @@ ExpressionPtr Parser::parse (const std::vector<Token> & tokens) {
 		const Token & ct (*i);
 		const Token & nextToken (i + 1 != tokens.end() ? *(i+1) : invalidToken);
 		if (ct.type == Token::TT_LP) {
+			if (mContext->maxDepth && ++depth > mContext->maxDepth) {
+				return createError (error::Parser_LimitExceeded, "Nested deeper than " + boost::lexical_cast<std::string> (mContext->maxDepth), ct.position);
+			}
 			mStateStack.push (mCurrentState);
 			mCurrentState.clear();
 			mCurrentState.begin = ct.position;
 			if (awaitFunction) {
 				mCurrentState.isFunction = true;
 				mCurrentState.commandStack.push_back (tokenForAwaitFunction);
+				if (findRegular (tokenForAwaitFunction)->builtin() == BF_REDUCTION && i + 2 < tokens.end()
+						&& (i + 1)->type == Token::TT_UNKNOWN && (i + 2)->type == Token::TT_COMMA) {
+					mCurrentState.index = (i + 1)->text;
+				}
 				awaitFunction = false;
 				tokenForAwaitFunction = Token ();
 				mStateStack.push (mCurrentState);
@@ -69,12 +92,17 @@ ExpressionPtr Parser::parse (const std::vector<Token> & tokens) {
 			if (subResult->error()) return subResult;
 			mCurrentState.clear();
 			subState.tokens.push_back (Token (subResult));
+			if (!subState.index.empty() && subState.tokens.size() == 3) {
+				// the body (after the bounds) sees the index
+				mParameters.push_back (subState.index);
+			}
 			continue;
 		}
 		if (ct.type == Token::TT_RP) {
 			if (mStateStack.empty())
 				return createError (error::Parser_ParanthesisMismatch, "Too much closing parenthesis", ct.position);
 			finalizeCurrentState();
+			depth--;
 
 			bool ignoreNoArguments = false;
 			if (mStateStack.top().isFunction) {
@@ -133,7 +161,46 @@ ExpressionPtr Parser::parse (const std::vector<Token> & tokens) {
 	return compress ();
 }
 
+size_t Parser::definitionEquals (const std::vector<Token> & tokens) const {
+	// name ( [parameter {, parameter}] ) =
+	if (tokens.size() < 4 || tokens[0].type != Token::TT_UNKNOWN || tokens[1].type != Token::TT_LP) return 0;
+	size_t i = 2;
+	if (tokens[i].type != Token::TT_RP) {
+		while (i < tokens.size() && tokens[i].type == Token::TT_UNKNOWN) {
+			i++;
+			if (i < tokens.size() && tokens[i].type == Token::TT_COMMA) i++;
+			else break;
+		}
+		if (i >= tokens.size() || tokens[i].type != Token::TT_RP) return 0;
+	}
+	i++;
+	if (i >= tokens.size() || tokens[i].type != Token::TT_EQUALS) return 0;
+	return i;
+}
+
+ExpressionPtr Parser::parseDefinition (const std::vector<Token> & tokens, size_t equals) {
+	const Token & name (tokens[0]);
+	NamedFunctionPtr existing = findRegular (name);
+	if ((existing && !existing->body()) || (mContext && mContext->findConstant (name.text))) {
+		return createError (error::Parser_NoValidToken, "Cannot redefine " + name.text, name.position);
+	}
+	for (size_t i = 2; i + 1 < equals; i += 2) {
+		const Token & parameter (tokens[i]);
+		if (std::find (mParameters.begin(), mParameters.end(), parameter.text) != mParameters.end()) {
+			return createError (error::Parser_NoValidToken, "Duplicate parameter " + parameter.text, parameter.position);
+		}
+		mParameters.push_back (parameter.text);
+	}
+	if (equals + 1 == tokens.size()) {
+		return createError (error::Parser_NoValidToken, "Expected function body", tokens[equals].position);
+	}
+	ExpressionPtr body = parseTokens (std::vector<Token> (tokens.begin() + equals + 1, tokens.end()));
+	if (body->error()) return body;
+	return ExpressionPtr (new FunctionDefinition (createUserFunction (name.text, (int) mParameters.size(), body), mParameters));
+}
+
 ExpressionPtr Parser::compress () {
+	TraceSpan span ("compress");
 	assert (mCurrentState.commandStack.empty() && "command stack must be finalized before that");
 	if (mCurrentState.tokens.empty()){
 		return createError (error::Parser_NoValidToken, "Expected an argument", mCurrentState.begin);
@@ -152,7 +219,7 @@ ExpressionPtr Parser::compress () {
 			ExpressionPtr last2 = argumentStack.size() > 1 ? *(argumentStack.end() - 2) : ExpressionPtr ();
 			if (last2 && function->arity() < 0){
 				// lets check if we can add last1 to last2
-				NamedFunctionExpressionPtr exp = boost::dynamic_pointer_cast<NamedFunctionExpression>(last2);
+				NamedFunctionExpression * exp = last2->kind() == EK_FUNCTION ? static_cast<NamedFunctionExpression*> (last2.get()) : 0;
 				if (exp && exp->function() == function){
 					// hooray
 					argumentStack.pop_back();
@@ -199,6 +266,14 @@ ExpressionPtr Parser::compressFunction () {
 		std::string aritys = boost::lexical_cast<std::string> (func->arity());
 		return createError (error::Parser_WrongArgumentCount, func->name() + "/" + aritys + " called with " + args + " arguments", functionToken.position);
 	}
+	if (func->builtin() == BF_REDUCTION) {
+		if (mCurrentState.index.empty()) {
+			return createError (error::Parser_NoValidToken, func->name() + " expects an index name as first argument", functionToken.position);
+		}
+		arguments[0] = ExpressionPtr (new Parameter (mCurrentState.index, (int) mParameters.size() - 1));
+		mParameters.pop_back();
+		return func->createExpression (func, arguments);
+	}
 	return ExpressionPtr (new NamedFunctionExpression (func, arguments));
 }
 
@@ -239,6 +314,11 @@ ExpressionPtr Parser::convertArgumentToken (const Token & t) const {
 	if (t.type == Token::TT_INT) return ExpressionPtr (new Value (t.vInt)); // TODO: real int support
 	if (t.type == Token::TT_EXPRESSION) return t.expression;
 	if (t.type == Token::TT_UNKNOWN) {
+		// Parameters of a function definition and indices of reductions hide everything else, the innermost first
+		std::vector<String>::const_reverse_iterator parameter = std::find (mParameters.rbegin(), mParameters.rend(), t.text);
+		if (parameter != mParameters.rend()) {
+			return ExpressionPtr (new Parameter (t.text, (int) (mParameters.rend() - parameter) - 1));
+		}
 		// Check for a constant
 		ConstantPtr constant = mContext ? mContext->findConstant(t.text) : ConstantPtr ();
 		if (constant) {
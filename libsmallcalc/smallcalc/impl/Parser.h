@@ -12,7 +12,7 @@ namespace sc {
 
 /// Context for parsing
 struct ParserContext {
-	ParserContext () {}
+	ParserContext () : maxTokens (0), maxDepth (0) {}
 
 	/// Add a constant wit hup to 3 alternative names
 	/// The real name of the constant will always be inserted
@@ -31,6 +31,10 @@ struct ParserContext {
 	NamedFunctionMap nonPrefixFunctions; ///< Regirstered named functions who have a printing name and are not prefix
 
 	VariableIdMapping * variableMapping;
+
+	/// Limits for untrusted input, exceeding them is error::Parser_LimitExceeded (0 for no limit)
+	size_t maxTokens;  ///< Maximum number of tokens
+	int maxDepth;      ///< Maximum nesting of parenthesis and function calls
 };
 
 /// Parser for smallscalc
@@ -58,6 +62,15 @@ public:
 
 private:
 
+	/// Parses tokens of an expression
+	ExpressionPtr parseTokens (const std::vector<Token> & tokens);
+
+	/// Position of = if tokens are a function definition (like f(x, y) = x * y), 0 otherwise
+	size_t definitionEquals (const std::vector<Token> & tokens) const;
+
+	/// Parses a function definition into a FunctionDefinition
+	ExpressionPtr parseDefinition (const std::vector<Token> & tokens, size_t equals);
+
 	/// Compress current expression which is now in postfix notation
 	ExpressionPtr compress ();
 
@@ -90,9 +103,10 @@ private:
 
 	struct State {
 		State () : isFunction (false), begin(0) {}
-		void clear () { isFunction = false; tokens.clear(); commandStack.clear(); begin = 0; }
+		void clear () { isFunction = false; index.clear(); tokens.clear(); commandStack.clear(); begin = 0; }
 		bool empty() const { return tokens.empty() && commandStack.empty(); }
 		bool isFunction;				///< State is inside a funciton argument list
+		String index;					///< Index bound by the reduction whose arguments these are (see Reduction.h)
 		int begin;
 		std::vector<Token> tokens; /// tokens in postfix notation
 		std::vector<Token> commandStack; /// current stack
@@ -104,6 +118,7 @@ private:
 	Error mError;
 	int mErrorPosition;
 	const ParserContext * mContext;
+	std::vector<String> mParameters;	///< Parameters of the function definition being parsed and indices of reductions
 };
 
 }
@@ -0,0 +1,445 @@
+#include "Reduction.h"
+#include "StandardFunctions.h"
+#include "Value.h"
+#include "../MathFunctions.h"
+#include "../FallbackStats.h"
+#include "../Budget.h"
+#include "../Trace.h"
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <set>
+
+namespace sc {
+
+namespace {
+
+/// Chunks per thread and round, results of a round are combined before the next one starts
+const size_t ChunksPerThread = 16;
+
+/// Parameter frame of a reduction body: the enclosing parameters and the index.
+/// The context gets its frame back when this is destroyed.
+class IndexFrame {
+public:
+	IndexFrame (EvaluationContext * context, int slot) : mContext (context), mOuter (context->parameters), mOuterCount (context->parameterCount), mValues (slot + 1) {
+		if (slot > 0) std::copy (mOuter, mOuter + std::min (slot, mOuterCount), mValues.begin());
+		context->parameters = &mValues[0];
+		context->parameterCount = slot + 1;
+		context->frames++;
+		context->depth++;
+	}
+	~IndexFrame () {
+		mContext->depth--;
+		mContext->frames--;
+		mContext->parameters = mOuter;
+		mContext->parameterCount = mOuterCount;
+	}
+	void bind (int64_t index) { mValues.back() = PrimitiveValue (index); }
+private:
+	EvaluationContext * mContext;
+	const PrimitiveValue * mOuter;
+	int mOuterCount;
+	std::vector<PrimitiveValue> mValues;
+};
+
+typedef PrimitiveValue (*Operation) (const std::vector<PrimitiveValue> & arguments, const EvaluationContext * context);
+
+/// Applies operation to a and b, pair is reused for the arguments
+PrimitiveValue apply (Operation operation, const PrimitiveValue & a, const PrimitiveValue & b, std::vector<PrimitiveValue> & pair, const EvaluationContext * context) {
+	pair[0] = a;
+	pair[1] = b;
+	return operation (pair, context);
+}
+
+/// Converts a bound of a range to result, returns an error if it is no integer (null otherwise)
+PrimitiveValue toIndex (const PrimitiveValue & value, const String & function, int64_t * result) {
+	if (value.error()) return value;
+	if (value.type() == PT_INT64) {
+		*result = value.intValue();
+		return PrimitiveValue ();
+	}
+	if (value.type() == PT_FRACTION && value.toFraction().normalize().isInteger()) {
+		*result = value.toFraction().normalize().numerator();
+		return PrimitiveValue ();
+	}
+	if (value.type() == PT_DOUBLE) {
+		double d = value.toDouble();
+		if (::floor (d) == d && ::fabs (d) <= 9007199254740992.0) { // 2^53, all integers below are exact
+			*result = (int64_t) d;
+			return PrimitiveValue ();
+		}
+	}
+	return errorValue (error::Eval_BadType, "Bounds of " + function + " must be integers");
+}
+
+/// If value is a number without rounding: an integer or a fraction, a double only without accurate level
+/// and if it is an integer up to 2^53 (whose sums, differences and products below 2^53 are exact as well)
+bool exact (const PrimitiveValue & value, const EvaluationContext * context) {
+	if (value.fractionable()) return true;
+	if (context->accurateLevel || value.type() != PT_DOUBLE) return false;
+	double d = value.toDouble();
+	return ::floor (d) == d && ::fabs (d) <= 9007199254740992.0;
+}
+
+ExpressionPtr createReduction (ReductionKind kind, const NamedFunctionPtr & function, const std::vector<ExpressionPtr> & arguments) {
+	return ExpressionPtr (new Reduction (kind, function, arguments));
+}
+
+}
+
+/// Chunks of a reduction evaluated by one thread
+struct Reduction::Worker {
+	const Reduction * reduction;
+	const EvaluationContext * context;
+	int64_t lo, n;                    ///< Range of the round
+	size_t chunks;
+	boost::atomic<size_t> * next;     ///< Next chunk to take
+	boost::atomic<size_t> * failed;   ///< First chunk with an error, later ones are skipped
+	PrimitiveValue * results;         ///< Per chunk
+	boost::atomic<uint64_t> * sharedSteps; ///< Steps of all threads, their budgets share the limit
+	int threads;
+	FallbackStats fallbacks;
+	uint64_t steps;
+
+	void run () {
+		TraceSpan span ("reduce");
+		EvaluationContext own (*context);
+		// not threadsafe
+		own.profiler = 0;
+		own.dependencies = 0;
+		own.fallbacks = context->fallbacks ? &fallbacks : 0;
+		own.threads = 1;
+		// each thread gets its own budget, sharing the step limit; deadline and cancel flag are shared anyway
+		EvaluationBudget budget;
+		if (own.budget) {
+			budget = *own.budget;
+			budget.share (sharedSteps, threads);
+			own.budget = &budget;
+		}
+		uint64_t start = budget.steps();
+		for (size_t c = (*next)++; c < chunks; c = (*next)++) {
+			if (c > failed->load()) break;
+			int64_t begin = (int64_t) c * ChunkSize;
+			results[c] = reduction->reduceRange (&own, lo + begin, std::min ((int64_t) ChunkSize, n - begin));
+			if (results[c].error()) {
+				size_t current = failed->load();
+				while (c < current && !failed->compare_exchange_weak (current, c)) {}
+			}
+		}
+		steps = budget.steps() - start;
+	}
+};
+
+Reduction::Reduction (ReductionKind kind, const NamedFunctionPtr & function, const std::vector<ExpressionPtr> & arguments) :
+	Expression (EK_REDUCTION),
+	mReductionKind (kind),
+	mFunction (function),
+	mIndex (arguments[0]),
+	mLow (arguments[1]),
+	mHigh (arguments[2]),
+	mBody (arguments[3]),
+	mDegree (-1),
+	mParallel (true),
+	mHash (0) {
+	assert (arguments.size() == 4 && mIndex->kind() == EK_PARAMETER);
+	mHash = hashCombine (EK_REDUCTION, hashString (mFunction->name()));
+	mHash = hashCombine (mHash, mIndex->structuralHash());
+	mHash = hashCombine (mHash, mLow->structuralHash());
+	mHash = hashCombine (mHash, mHigh->structuralHash());
+	mHash = hashCombine (mHash, mBody->structuralHash());
+	mDegree = degreeOf (mBody.get(), 0);
+	// Look for side effects, with an explicit stack as bodies can be deep
+	std::vector<const Expression*> stack (1, mBody.get());
+	std::set<const Expression*> bodies; // of user defined functions, each only once
+	while (!stack.empty() && mParallel) {
+		const Expression * node = stack.back();
+		stack.pop_back();
+		switch (node->kind()) {
+		case EK_FUNCTION: {
+			const NamedFunctionExpression * call = static_cast<const NamedFunctionExpression*> (node);
+			const NamedFunction & f (*call->function());
+			if (f.body()) {
+				// user defined functions may read variables, that is fine
+				if (bodies.insert (f.body().get()).second) stack.push_back (f.body().get());
+			} else if (!f.isPure()) {
+				mParallel = false;
+			}
+			for (size_t i = 0; i < call->argumentCount(); i++) {
+				stack.push_back (call->argument (i).get());
+			}
+			break;
+		}
+		case EK_REDUCTION: {
+			const Reduction * reduction = static_cast<const Reduction*> (node);
+			stack.push_back (reduction->low().get());
+			stack.push_back (reduction->high().get());
+			stack.push_back (reduction->body().get());
+			break;
+		}
+		case EK_ASSIGNMENT:
+			mParallel = false;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+std::vector<ExpressionPtr> Reduction::arguments () const {
+	std::vector<ExpressionPtr> result;
+	result.push_back (mIndex);
+	result.push_back (mLow);
+	result.push_back (mHigh);
+	result.push_back (mBody);
+	return result;
+}
+
+PrimitiveValue Reduction::eval (EvaluationContext * context) const {
+	if (context->budget && !context->budget->consume()) return context->budget->error();
+	const String & name (mFunction->name());
+	if (index().index() > context->parameterCount) {
+		return errorValue (error::Eval_UnboundVariable, "Parameters of " + name + " outside of its function");
+	}
+	int64_t lo = 0, hi = 0;
+	PrimitiveValue e = toIndex (mLow->eval (context), name, &lo);
+	if (e) return e;
+	e = toIndex (mHigh->eval (context), name, &hi);
+	if (e) return e;
+	if (hi < lo) {
+		switch (mReductionKind) {
+		case RK_SUM:     return PrimitiveValue ((int64_t) 0);
+		case RK_PRODUCT: return PrimitiveValue ((int64_t) 1);
+		default:         return errorValue (error::Eval_InvalidOperation, "Empty range for " + name);
+		}
+	}
+	bool overflow = false;
+	int64_t n = subWithOverflowCheck (hi, lo, &overflow);
+	if (overflow || n == std::numeric_limits<int64_t>::max()) return errorValue (error::Eval_InvalidOperation, "Range of " + name + " too large");
+	n++;
+	if (mReductionKind == RK_SUM && mDegree >= 0 && n > mDegree + 1) {
+		PrimitiveValue closed = closedForm (context, lo, n);
+		if (closed) return closed;
+	}
+	int threads = 1;
+	if (mParallel && !context->profiler && n > ChunkSize) {
+		threads = context->threads > 0 ? context->threads : (int) boost::thread::hardware_concurrency();
+		int64_t chunks = (n - 1) / ChunkSize + 1;
+		threads = (int) std::max ((int64_t) 1, std::min ((int64_t) threads, chunks));
+	}
+	return reduceChunks (context, lo, n, threads);
+}
+
+PrimitiveValue Reduction::reduceRange (EvaluationContext * context, int64_t begin, int64_t count) const {
+	IndexFrame frame (context, index().index());
+	std::vector<PrimitiveValue> pair (2);
+	PrimitiveValue result;
+	for (int64_t i = 0; i < count; i++) {
+		if (context->budget && !context->budget->consume()) return context->budget->error();
+		frame.bind (begin + i);
+		combine (result, mBody->eval (context), pair, context);
+		if (result.error()) break;
+	}
+	return result;
+}
+
+PrimitiveValue Reduction::reduceChunks (EvaluationContext * context, int64_t lo, int64_t n, int threads) const {
+	std::vector<PrimitiveValue> pair (2);
+	PrimitiveValue result;
+	if (threads <= 1) {
+		for (int64_t done = 0; done < n; done += ChunkSize) {
+			combine (result, reduceRange (context, lo + done, std::min ((int64_t) ChunkSize, n - done)), pair, context);
+			if (result.error()) break;
+		}
+		return result;
+	}
+	const int64_t round = (int64_t) (threads * ChunksPerThread) * ChunkSize;
+	std::vector<PrimitiveValue> results;
+	std::vector<Worker> workers (threads);
+	for (int64_t done = 0; done < n; done += round) {
+		int64_t count = std::min (round, n - done);
+		size_t chunks = (size_t) ((count - 1) / ChunkSize + 1);
+		results.assign (chunks, PrimitiveValue ());
+		boost::atomic<size_t> next (0);
+		boost::atomic<size_t> failed (chunks);
+		boost::atomic<uint64_t> sharedSteps (context->budget ? context->budget->steps() : 0);
+		for (int t = 0; t < threads; t++) {
+			Worker & worker (workers[t]);
+			worker.reduction = this;
+			worker.context   = context;
+			worker.lo        = lo + done;
+			worker.n         = count;
+			worker.chunks    = chunks;
+			worker.next      = &next;
+			worker.failed    = &failed;
+			worker.results   = &results[0];
+			worker.sharedSteps = &sharedSteps;
+			worker.threads   = threads;
+			worker.fallbacks.clear();
+			worker.steps     = 0;
+		}
+		boost::thread_group group;
+		for (int t = 1; t < threads; t++) {
+			group.create_thread (boost::bind (&Worker::run, &workers[t]));
+		}
+		workers[0].run();
+		group.join_all();
+		for (int t = 0; t < threads; t++) {
+			if (context->fallbacks) *context->fallbacks += workers[t].fallbacks;
+			if (context->budget) context->budget->consume (workers[t].steps);
+		}
+		// in chunk order, independent of the thread which calculated a chunk
+		for (size_t c = 0; c < chunks; c++) {
+			combine (result, results[c], pair, context);
+			if (result.error()) return result;
+		}
+	}
+	return result;
+}
+
+PrimitiveValue Reduction::closedForm (EvaluationContext * context, int64_t lo, int64_t n) const {
+	// With the forward differences d[j] of the body at lo the sum is d[0] * C(n, 1) + ... + d[degree] * C(n, degree + 1)
+	// The binomials get large, so the differences must be exact, a rounded d[j] would be multiplied with them.
+	// Binomials, terms and the sum may overflow: the operations fall back to double then, like for any overflow.
+	std::vector<PrimitiveValue> d (mDegree + 1);
+	std::vector<PrimitiveValue> pair (2);
+	{
+		IndexFrame frame (context, index().index());
+		for (int j = 0; j <= mDegree; j++) {
+			frame.bind (lo + j);
+			d[j] = mBody->eval (context);
+			if (d[j].error()) return d[j];
+			if (!exact (d[j], context)) return PrimitiveValue ();
+		}
+	}
+	for (int level = 1; level <= mDegree; level++) {
+		for (int j = mDegree; j >= level; j--) {
+			d[j] = apply (&sc::subtract, d[j], d[j - 1], pair, context);
+			if (!exact (d[j], context)) return PrimitiveValue ();
+		}
+	}
+	PrimitiveValue binomial (n);
+	PrimitiveValue result = apply (&sc::multiply, d[0], binomial, pair, context);
+	for (int j = 1; j <= mDegree; j++) {
+		// C(n, j + 1) = C(n, j) * (n - j) / (j + 1)
+		binomial = apply (&sc::multiply, binomial, PrimitiveValue (n - j), pair, context);
+		binomial = apply (&sc::divide, binomial, PrimitiveValue ((int64_t) (j + 1)), pair, context);
+		PrimitiveValue term = apply (&sc::multiply, d[j], binomial, pair, context);
+		result = apply (&sc::add, result, term, pair, context);
+	}
+	return result;
+}
+
+void Reduction::combine (PrimitiveValue & result, const PrimitiveValue & value, std::vector<PrimitiveValue> & pair, const EvaluationContext * context) const {
+	if (!result || value.error()) {
+		result = value;
+		return;
+	}
+	switch (mReductionKind) {
+	case RK_SUM:
+		result = apply (&sc::add, result, value, pair, context);
+		break;
+	case RK_PRODUCT:
+		result = apply (&sc::multiply, result, value, pair, context);
+		break;
+	case RK_MIN:
+	case RK_MAX: {
+		bool less, greater;
+		if (context->accurateLevel && value.isAccurateType() && result.isAccurateType()) {
+			// exact for fractions
+			double difference = apply (&sc::subtract, value, result, pair, context).toDouble();
+			less    = difference < 0;
+			greater = difference > 0;
+		} else {
+			less    = value.toDouble() < result.toDouble();
+			greater = value.toDouble() > result.toDouble();
+		}
+		if (mReductionKind == RK_MIN ? less : greater) result = value;
+		break;
+	}
+	}
+}
+
+int Reduction::degreeOf (const Expression * node, int depth) const {
+	if (depth >= MaxRecursionDepth) return -1;
+	switch (node->kind()) {
+	case EK_VALUE:
+	case EK_CONSTANT:
+	case EK_VARIABLE:
+		return 0;
+	case EK_PARAMETER:
+		return static_cast<const Parameter*> (node)->index() == index().index() ? 1 : 0;
+	case EK_FUNCTION:
+		break;
+	default:
+		return -1;
+	}
+	const NamedFunctionExpression * call = static_cast<const NamedFunctionExpression*> (node);
+	const NamedFunction & function (*call->function());
+	if (!function.isPure()) return -1;
+	std::vector<int> degrees (call->argumentCount());
+	int maxDegree = 0, sumDegree = 0;
+	for (size_t i = 0; i < degrees.size(); i++) {
+		degrees[i] = degreeOf (call->argument (i).get(), depth + 1);
+		if (degrees[i] < 0) return -1;
+		maxDegree  = std::max (maxDegree, degrees[i]);
+		sumDegree += degrees[i];
+	}
+	int result = -1;
+	switch (function.builtin()) {
+	case BF_ADD:
+	case BF_SUBTRACT:
+	case BF_NEGATE:
+		result = maxDegree;
+		break;
+	case BF_MULTIPLY:
+		result = sumDegree;
+		break;
+	case BF_DIVIDE:
+		result = degrees.size() == 2 && degrees[1] == 0 ? degrees[0] : -1;
+		break;
+	case BF_POW: {
+		if (degrees.size() != 2 || degrees[1] != 0) break;
+		if (degrees[0] == 0) {
+			result = 0;
+			break;
+		}
+		// only constant positive integer exponents (0 would hide 0^0 errors)
+		const Expression * exponent = call->argument (1).get();
+		if (exponent->kind() != EK_VALUE) break;
+		const PrimitiveValue & e (static_cast<const Value*> (exponent)->value());
+		if (e.type() == PT_INT64 && e.intValue() >= 1 && e.intValue() <= MaxClosedFormDegree) {
+			result = degrees[0] * (int) e.intValue();
+		}
+		break;
+	}
+	default:
+		// other pure functions only of expressions constant in the index
+		result = maxDegree == 0 ? 0 : -1;
+		break;
+	}
+	return result > MaxClosedFormDegree ? -1 : result;
+}
+
+void Reduction::printTo (std::string & output, PrintingContext * printingContext) const {
+	output += mFunction->name();
+	output += '(';
+	PushPrecedence push (printingContext, mFunction->precedence());
+	const ExpressionPtr * arguments[] = { &mIndex, &mLow, &mHigh, &mBody };
+	for (size_t i = 0; i < 4; i++) {
+		if (i > 0) output += ',';
+		(*arguments[i])->printTo (output, printingContext);
+	}
+	output += ')';
+}
+
+NamedFunctionPtr createReductionFunction (const String & name, ReductionKind kind) {
+	NamedFunctionPtr result (new NamedFunction (name, 4));
+	result->setBuiltin (BF_REDUCTION);
+	result->setCreateExpressionCallback (boost::bind (&createReduction, kind, _1, _2));
+	return result;
+}
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "../Expression.h"
+#include "NamedFunction.h"
+#include "UserFunction.h"
+#include <vector>
+
+namespace sc {
+
+/// What a Reduction calculates
+enum ReductionKind {
+	RK_SUM,
+	RK_PRODUCT,
+	RK_MIN,
+	RK_MAX
+};
+
+/**
+ * Reduction of a body over an integer range, binding an index, e.g. sum(k, 1, 100, k^2)
+ *
+ * Arguments are the index (a Parameter, see UserFunction.h), the lower and the upper bound
+ * (inclusive, integers) and the body. The bounds are evaluated without the index,
+ * the body once per index value with the index as additional parameter.
+ * An empty range sums to 0 and multiplies to 1, min and max of it are an error.
+ *
+ * The range is split into chunks of ChunkSize indices; each chunk is reduced in index order
+ * and the results of the chunks are combined in chunk order. The result does not
+ * depend on the number of threads therefore. With more than one chunk and a body without
+ * side effects the chunks are evaluated by EvaluationContext::threads threads, each with its own
+ * copy of the context (not while profiling).
+ *
+ * In accurate level values are combined with add / multiply of StandardFunctions.h, so
+ * integers and fractions accumulate exactly until an operation overflows.
+ *
+ * Sums of polynomials in the index (up to MaxClosedFormDegree, e.g. 3 * k^2 + a * k)
+ * are calculated in closed form from degree + 1 evaluations of the body, if these values and
+ * their differences are exact (integers and fractions; integral doubles below 2^53 outside
+ * accurate level). If the sum gets too large for that, the closed form finishes in double,
+ * so that huge ranges take constant time; otherwise the range is reduced.
+ */
+class Reduction : public Expression {
+public:
+	enum { ChunkSize = 4096, MaxClosedFormDegree = 8 };
+
+	/// arguments are index, lower bound, upper bound and body
+	Reduction (ReductionKind kind, const NamedFunctionPtr & function, const std::vector<ExpressionPtr> & arguments);
+
+	// Implementation of Expression
+	virtual PrimitiveValue eval (EvaluationContext * evaluationContext) const;
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const;
+	virtual uint64_t structuralHash () const { return mHash; }
+
+	ReductionKind reductionKind () const { return mReductionKind; }
+	/// The function it was parsed from (e.g. sum)
+	const NamedFunctionPtr & function () const { return mFunction; }
+	const Parameter & index () const { return static_cast<const Parameter&> (*mIndex); }
+	const ExpressionPtr & low () const { return mLow; }
+	const ExpressionPtr & high () const { return mHigh; }
+	const ExpressionPtr & body () const { return mBody; }
+	/// Arguments as given to the constructor, e.g. to create a modified copy with function()->createExpression
+	std::vector<ExpressionPtr> arguments () const;
+
+	/// Degree of the body as a polynomial in the index, -1 if it is none (or of higher degree than MaxClosedFormDegree)
+	int degree () const { return mDegree; }
+	/// If the body has no side effects, so that chunks can be evaluated in parallel
+	bool parallel () const { return mParallel; }
+
+private:
+	struct Worker;
+
+	/// Reduces the body over count indices from begin on
+	PrimitiveValue reduceRange (EvaluationContext * context, int64_t begin, int64_t count) const;
+	/// Reduces n indices from lo on in chunks, with threads threads
+	PrimitiveValue reduceChunks (EvaluationContext * context, int64_t lo, int64_t n, int threads) const;
+	/// Sum of n indices from lo on with forward differences, the body must be a polynomial of mDegree.
+	/// Returns null if a value of the body or a difference is not exact, the range must be reduced then
+	PrimitiveValue closedForm (EvaluationContext * context, int64_t lo, int64_t n) const;
+	/// Combines value into result, result is null for the first value
+	void combine (PrimitiveValue & result, const PrimitiveValue & value, std::vector<PrimitiveValue> & pair, const EvaluationContext * context) const;
+	/// Degree of node as a polynomial in the index, -1 if it is none
+	int degreeOf (const Expression * node, int depth) const;
+
+	ReductionKind mReductionKind;
+	NamedFunctionPtr mFunction;
+	ExpressionPtr mIndex;
+	ExpressionPtr mLow;
+	ExpressionPtr mHigh;
+	ExpressionPtr mBody;
+	int mDegree;
+	bool mParallel;
+	uint64_t mHash; ///< Structural hash, calculated on construction
+};
+
+/// Creates the function for a reduction (e.g. sum), the parser binds its index (see Parser.cpp)
+NamedFunctionPtr createReductionFunction (const String & name, ReductionKind kind);
+
+}
@@ -4,6 +4,8 @@
 #include <assert.h>
 #include "../Expression.h" // for EvaluationContext
 #include "../MathFunctions.h"
+#include "../FallbackStats.h"
+#include "../Budget.h"
 
 namespace sc {
 
@@ -62,7 +64,8 @@ PrimitiveValue accurateDivide (const PrimitiveValue & a, const PrimitiveValue &
 	return PrimitiveValue (result);
 }
 
-PrimitiveValue accuratePower (const PrimitiveValue & a, const PrimitiveValue & b, bool * overflow) {
+/// Exact power by repeated multiplication, consumes one step of the budget (if any) per iteration
+PrimitiveValue accuratePower (const PrimitiveValue & a, const PrimitiveValue & b, bool * overflow, const EvaluationContext * context) {
 	CHECK_ERROR2(a,b);
 	if (b.type() != PT_INT64) {
 		// will lead to overflow
@@ -83,6 +86,7 @@ PrimitiveValue accuratePower (const PrimitiveValue & a, const PrimitiveValue & b
 	if (bv < 0) {
 		PrimitiveValue current = PrimitiveValue (int64_t(1));
 		for (int64_t i = 0; i > bv; i--) {
+			if (context->budget && !context->budget->consume()) return context->budget->error();
 			current = accurateDivide (current, a, overflow);
 			if (*overflow) return PrimitiveValue (error::Eval_InvalidOperation, "overflow");
 		}
@@ -90,6 +94,7 @@ PrimitiveValue accuratePower (const PrimitiveValue & a, const PrimitiveValue & b
 	} else {
 		PrimitiveValue current = PrimitiveValue (int64_t(1));
 		for (int64_t i = 0; i < bv; i++) {
+			if (context->budget && !context->budget->consume()) return context->budget->error();
 			current = accurateMultiply (current, a, overflow);
 			if (*overflow) return PrimitiveValue (error::Eval_InvalidOperation, "overflow");
 		}
@@ -97,6 +102,11 @@ PrimitiveValue accuratePower (const PrimitiveValue & a, const PrimitiveValue & b
 	}
 }
 
+/// Records an overflow, if the context counts them
+static void recordFallback (const EvaluationContext* context, AccurateOperation function, AccurateOperation operation, const PrimitiveValue & a, const PrimitiveValue & b) {
+	if (context->fallbacks) context->fallbacks->record (function, operation, a, b);
+}
+
 PrimitiveValue add (const std::vector<PrimitiveValue> & arguments, const EvaluationContext* context) {
 	if (context->accurateLevel){
 		bool overflow = false;
@@ -104,8 +114,12 @@ PrimitiveValue add (const std::vector<PrimitiveValue> & arguments, const Evaluat
 		std::vector<PrimitiveValue>::const_iterator i = arguments.begin();
 		for (; i != arguments.end(); i++) {
 			if (!i->isAccurateType()) break;
-			accurateSum = accurateAdd (accurateSum, *i, &overflow);
-			if (overflow) break;
+			PrimitiveValue next = accurateAdd (accurateSum, *i, &overflow);
+			if (overflow) {
+				recordFallback (context, AO_ADD, AO_ADD, accurateSum, *i);
+				break;
+			}
+			accurateSum = next;
 		}
 		if (i == arguments.end()) return accurateSum;
 	}
@@ -126,8 +140,12 @@ PrimitiveValue multiply (const std::vector<PrimitiveValue> & arguments, const Ev
 		std::vector<PrimitiveValue>::const_iterator i = arguments.begin();
 		for (; i != arguments.end(); i++) {
 			if (!i->isAccurateType()) break;
-			accurateProduct = accurateMultiply (accurateProduct, *i, &overflow);
-			if (overflow) break;
+			PrimitiveValue next = accurateMultiply (accurateProduct, *i, &overflow);
+			if (overflow) {
+				recordFallback (context, AO_MULTIPLY, AO_MULTIPLY, accurateProduct, *i);
+				break;
+			}
+			accurateProduct = next;
 		}
 		if (i == arguments.end()) return accurateProduct;
 	}
@@ -150,6 +168,7 @@ PrimitiveValue subtract (const std::vector<PrimitiveValue> & arguments, const Ev
 		bool overflow = false;
 		PrimitiveValue candidate =  accurateSubtract(a,b, &overflow);
 		if (!overflow) return candidate;
+		recordFallback (context, AO_SUBTRACT, AO_SUBTRACT, a, b);
 	}
 	return a.toDouble() - b.toDouble();
 }
@@ -163,6 +182,7 @@ PrimitiveValue divide (const std::vector<PrimitiveValue> & arguments, const Eval
 		bool overflow = false;
 		PrimitiveValue candidate = accurateDivide(a,b,&overflow);
 		if (!overflow) return candidate;
+		recordFallback (context, AO_DIVIDE, AO_DIVIDE, a, b);
 	}
 	return a.toDouble() / b.toDouble();
 }
@@ -178,8 +198,11 @@ PrimitiveValue exponentation (const std::vector<PrimitiveValue> & arguments, con
 	CHECK_ERROR2(arguments[0], arguments[1]);
 	if (context->accurateLevel && arguments[0].isAccurateType() && arguments[1].isAccurateType()) {
 		bool overflow = false;
-		PrimitiveValue candidate = accuratePower(arguments[0], arguments[1], &overflow);
+		PrimitiveValue candidate = accuratePower(arguments[0], arguments[1], &overflow, context);
 		if (!overflow) return candidate;
+		// accuratePower multiplies for positive, divides for negative exponents
+		AccurateOperation operation = arguments[1].type() != PT_INT64 ? AO_POWER : (arguments[1].intValue() < 0 ? AO_DIVIDE : AO_MULTIPLY);
+		recordFallback (context, AO_POWER, operation, arguments[0], arguments[1]);
 	}
 	return doubleValue (::pow (arguments[0].toDouble(), arguments[1].toDouble()));
 }
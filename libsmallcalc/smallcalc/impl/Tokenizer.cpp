@@ -1,5 +1,7 @@
 #include "Tokenizer.h"
+#include "../Trace.h"
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 
 namespace sc {
 
@@ -135,6 +137,7 @@ static bool splitToNumAndText (const Token & token, Token * num = 0, Token * tex
 }
 
 Error Tokenizer::tokenize (const std::string & input) {
+	TraceSpan span ("tokenize");
 	bool inEmpty = true;
 	int tokenStart = 0;
 	for (int i = 0; i < (int) input.length(); i++) {
@@ -151,7 +154,7 @@ Error Tokenizer::tokenize (const std::string & input) {
 			// add null token (will get removed at end)
 			Token nullToken (" ", i);
 			nullToken.type = Token::TT_NULL;
-			mResult.push_back (nullToken);
+			append (nullToken);
 		}
 		if (isSingleChar (c)) {
 			if (i - tokenStart > 0) {
@@ -170,6 +173,13 @@ Error Tokenizer::tokenize (const std::string & input) {
 	return NoError;
 }
 
+void Tokenizer::append (const Token & token) {
+	if (mResult.size() == mResult.capacity()) {
+		recordAllocation (std::max ((size_t) 1, mResult.capacity() * 2) * sizeof (Token));
+	}
+	mResult.push_back (token);
+}
+
 // Push a token to the result; its possible to combine it with others
 void Tokenizer::pushToken (const std::string & s, int position) {
 	Token token = Token (s, position);
@@ -189,7 +199,7 @@ void Tokenizer::pushToken (const std::string & s, int position) {
 				mResult.pop_back();
 				mResult.pop_back();
 				mResult.pop_back();
-				mResult.push_back (expNumber);
+				append (expNumber);
 				return;
 			}
 		}
@@ -199,7 +209,7 @@ void Tokenizer::pushToken (const std::string & s, int position) {
 			if (expNumber.type == Token::TT_DOUBLE) {
 				mResult.pop_back ();
 				mResult.pop_back ();
-				mResult.push_back (expNumber);
+				append (expNumber);
 				return;
 			}
 		}
@@ -210,10 +220,10 @@ void Tokenizer::pushToken (const std::string & s, int position) {
 		Token numToken;
 		Token textToken;
 		splitToNumAndText(token, &numToken, &textToken);
-		mResult.push_back (numToken);
-		mResult.push_back (textToken);
+		append (numToken);
+		append (textToken);
 	} else {
-		mResult.push_back (token);
+		append (token);
 	}
 }
 
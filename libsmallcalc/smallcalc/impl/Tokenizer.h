@@ -54,6 +54,8 @@ public:
 	std::string errorMessage () const { return mErrorMessage; }
 	int errorPosition () const { return mErrorPosition; }
 private:
+	/// Appends a token to mResult
+	void append (const Token & token);
 	// Push a token to the result; its possible to combine it with others
 	void pushToken (const std::string & s, int position);
 	/// Search for minus signs which are negations and replace thems
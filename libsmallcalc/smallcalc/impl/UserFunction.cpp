@@ -0,0 +1,82 @@
+#include "UserFunction.h"
+#include "Reduction.h"
+#include <boost/bind.hpp>
+
+namespace sc {
+
+void FunctionDefinition::printTo (std::string & output, PrintingContext * printingContext) const {
+	output += mFunction->name();
+	output += '(';
+	for (size_t i = 0; i < mParameters.size(); i++) {
+		if (i > 0) output += ", ";
+		output += mParameters[i];
+	}
+	output += ") = ";
+	PushPrecedence push (printingContext, 0);
+	mFunction->body()->printTo (output, printingContext);
+}
+
+namespace {
+
+PrimitiveValue evaluateUserFunction (const ExpressionPtr & body, const NamedFunction::PrimitiveArgumentVector & arguments, const EvaluationContext * context) {
+	for (size_t i = 0; i < arguments.size(); i++) {
+		if (arguments[i].error()) return arguments[i];
+	}
+	// The frame is only replaced while evaluating the body, the caller gets the context back unchanged
+	EvaluationContext * frame = const_cast<EvaluationContext*> (context);
+	const PrimitiveValue * outer = frame->parameters;
+	int outerCount = frame->parameterCount;
+	frame->parameters = arguments.empty() ? 0 : &arguments[0];
+	frame->parameterCount = (int) arguments.size();
+	frame->frames++;
+	frame->depth++;
+	PrimitiveValue result = body->eval (frame);
+	frame->depth--;
+	frame->frames--;
+	frame->parameters = outer;
+	frame->parameterCount = outerCount;
+	return result;
+}
+
+}
+
+NamedFunctionPtr createUserFunction (const String & name, int arity, const ExpressionPtr & body) {
+	// Count nodes and check for purity, with an explicit stack as bodies can be deep
+	size_t nodes = 0;
+	bool pure = true;
+	std::vector<const Expression*> stack (1, body.get());
+	while (!stack.empty()) {
+		const Expression * node = stack.back();
+		stack.pop_back();
+		nodes++;
+		switch (node->kind()) {
+		case EK_FUNCTION: {
+			const NamedFunctionExpression * function = static_cast<const NamedFunctionExpression*> (node);
+			if (!function->function()->isPure()) pure = false;
+			for (size_t i = 0; i < function->argumentCount(); i++) {
+				stack.push_back (function->argument (i).get());
+			}
+			break;
+		}
+		case EK_REDUCTION: {
+			const Reduction * reduction = static_cast<const Reduction*> (node);
+			stack.push_back (reduction->low().get());
+			stack.push_back (reduction->high().get());
+			stack.push_back (reduction->body().get());
+			break;
+		}
+		case EK_VARIABLE:
+		case EK_ASSIGNMENT:
+			pure = false;
+			break;
+		default:
+			break;
+		}
+	}
+	NamedFunctionPtr result (new NamedFunction (name, arity, boost::bind (&evaluateUserFunction, body, _1, _2)));
+	result->setBody (body, nodes);
+	result->setPure (pure);
+	return result;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "../Expression.h"
+#include "NamedFunction.h"
+#include <vector>
+
+namespace sc {
+
+/**
+ * Parameter of a user defined function, e.g. x in f(x) = x^2
+ *
+ * Evaluates to the argument of the current call (EvaluationContext::parameters).
+ */
+class Parameter : public Expression {
+public:
+	Parameter (const String & name, int index) : Expression (EK_PARAMETER), mName (name), mIndex (index) {}
+
+	virtual PrimitiveValue eval (EvaluationContext * evaluationContext) const {
+		if (!evaluationContext || mIndex >= evaluationContext->parameterCount) return errorValue (error::Eval_UnboundVariable, "Parameter " + mName + " outside of its function");
+		return evaluationContext->parameters[mIndex];
+	}
+
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const { output += mName; }
+	virtual uint64_t structuralHash () const { return hashCombine (EK_PARAMETER, hashCombine (hashString (mName), mIndex)); }
+
+	const String & name () const { return mName; }
+	/// Position in the argument list
+	int index () const { return mIndex; }
+
+private:
+	String mName;
+	int mIndex;
+};
+
+/**
+ * Definition of a user defined function, e.g. f(x, y) = x^2 + y
+ *
+ * Created by the parser; the function gets registered when SmallCalc evaluates the definition.
+ * Evaluates to a null value.
+ */
+class FunctionDefinition : public Expression {
+public:
+	FunctionDefinition (const NamedFunctionPtr & function, const std::vector<String> & parameters) : Expression (EK_DEFINITION), mFunction (function), mParameters (parameters) {}
+
+	virtual PrimitiveValue eval (EvaluationContext * evaluationContext) const { return PrimitiveValue (); }
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const;
+
+	/// The defined function, its body is NamedFunction::body()
+	const NamedFunctionPtr & function () const { return mFunction; }
+	/// Parameter names
+	const std::vector<String> & parameters () const { return mParameters; }
+
+private:
+	NamedFunctionPtr mFunction;
+	std::vector<String> mParameters;
+};
+
+/// Creates a function with arity parameters evaluating body, whose parameters are Parameter nodes.
+/// Calls evaluate body with the arguments as parameter frame (no copy of the EvaluationContext).
+/// The function is pure if body reads no variables and only calls pure functions.
+NamedFunctionPtr createUserFunction (const String & name, int arity, const ExpressionPtr & body);
+
+}
@@ -6,13 +6,14 @@ namespace sc {
 /// A fixed value as an expression
 class Value : public Expression {
 public:
-	Value (const PrimitiveValue & value) : mValue (value) {}
-	Value (double x) : mValue (x) {}
-	Value (int64_t x) : mValue (x) {}
+	Value (const PrimitiveValue & value) : Expression (EK_VALUE), mValue (value) {}
+	Value (double x) : Expression (EK_VALUE), mValue (x) {}
+	Value (int64_t x) : Expression (EK_VALUE), mValue (x) {}
 
 	virtual PrimitiveValue eval (EvaluationContext * calcContext) const { return mValue; }
-	virtual std::string print (PrintingContext * printingContext) const { return mValue.toString(); }
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const { output += mValue.toString(); }
 	virtual Error error () const { return mValue.type() == PT_ERROR ? mValue.error() : NoError; }
+	virtual uint64_t structuralHash () const { return hashCombine (EK_VALUE, mValue.hash()); }
 
 	const PrimitiveValue & value () const { return mValue; }
 private:
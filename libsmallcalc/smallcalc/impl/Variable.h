@@ -7,16 +7,18 @@ namespace sc {
 /// A variable as an expression
 class Variable : public Expression {
 public:
-	Variable (const String& name, VariableId id) : mName (name), mId (id) {}
+	Variable (const String& name, VariableId id) : Expression (EK_VARIABLE), mName (name), mId (id) {}
 
 	virtual PrimitiveValue eval (EvaluationContext * evaluationContext) const {
 		PrimitiveValue val = evaluationContext ? evaluationContext->findVariable(mId) : PrimitiveValue();
 		return val ? val : errorValue (error::Eval_UnboundVariable, "Variable " + mName + " is not bound");
 	};
 
-	virtual std::string print (PrintingContext * printingContext) const { return mName; }
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const { output += mName; }
+	virtual uint64_t structuralHash () const { return hashCombine (EK_VARIABLE, hashString (mName)); }
 
 	const VariableId & id () const { return mId; }
+	const String & name () const { return mName; }
 
 private:
 	String mName;
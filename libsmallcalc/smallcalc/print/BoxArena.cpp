@@ -0,0 +1,39 @@
+#include "BoxArena.h"
+#include "BoxElements.h"
+
+namespace sc {
+
+BoxArena::BoxArena () {
+	mCurrent   = mInlineBlock.data;
+	mEnd       = mInlineBlock.data + InlineBlockSize;
+	mBytesUsed = 0;
+	recordAllocation (64 * sizeof (Box*));
+	mBoxes.reserve (64);
+}
+
+BoxArena::~BoxArena () {
+	for (std::vector<Box*>::reverse_iterator i = mBoxes.rbegin(); i != mBoxes.rend(); i++) {
+		(*i)->~Box();
+	}
+	for (std::vector<char*>::const_iterator i = mBlocks.begin(); i != mBlocks.end(); i++) {
+		::operator delete (*i);
+	}
+}
+
+void * BoxArena::allocate (size_t size) {
+	size = (size + Alignment - 1) & ~((size_t) Alignment - 1);
+	if (mCurrent + size > mEnd) {
+		size_t blockSize = size > (size_t) BlockSize ? size : (size_t) BlockSize;
+		recordAllocation (blockSize);
+		char * block = static_cast<char*> (::operator new (blockSize));
+		mBlocks.push_back (block);
+		mCurrent = block;
+		mEnd     = block + blockSize;
+	}
+	void * result = mCurrent;
+	mCurrent   += size;
+	mBytesUsed += size;
+	return result;
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <stddef.h>
+#include <new>
+#include <vector>
+#include "../AllocationStats.h"
+
+namespace sc {
+
+class Box;
+
+/**
+ * Owner of a whole box tree.
+ *
+ * Boxes are placed into big memory blocks, the first one living inside
+ * the arena itself, so converting small expressions allocates nothing.
+ * Boxes refer to each other with plain pointers; they all get destroyed
+ * together with the arena (in reverse order of their creation).
+ */
+class BoxArena {
+public:
+	BoxArena ();
+	~BoxArena ();
+
+	/// Creates a box inside the arena
+	template <class T> T* create () {
+		return track (new (allocate (sizeof (T))) T ());
+	}
+	template <class T, class A0> T* create (const A0 & a0) {
+		return track (new (allocate (sizeof (T))) T (a0));
+	}
+	template <class T, class A0, class A1> T* create (const A0 & a0, const A1 & a1) {
+		return track (new (allocate (sizeof (T))) T (a0, a1));
+	}
+	template <class T, class A0, class A1, class A2> T* create (const A0 & a0, const A1 & a1, const A2 & a2) {
+		return track (new (allocate (sizeof (T))) T (a0, a1, a2));
+	}
+	template <class T, class A0, class A1, class A2, class A3> T* create (const A0 & a0, const A1 & a1, const A2 & a2, const A3 & a3) {
+		return track (new (allocate (sizeof (T))) T (a0, a1, a2, a3));
+	}
+
+	/// Number of boxes living in the arena
+	size_t boxCount () const { return mBoxes.size(); }
+
+	/// Bytes handed out to boxes so far
+	size_t bytesUsed () const { return mBytesUsed; }
+
+private:
+	/// Returns aligned memory for an object of given size
+	void * allocate (size_t size);
+
+	template <class T> T* track (T* box) {
+		if (mBoxes.size() == mBoxes.capacity()) recordAllocation (mBoxes.capacity() * 2 * sizeof (Box*));
+		mBoxes.push_back (box);
+		return box;
+	}
+
+	enum {
+		Alignment       = 16,
+		InlineBlockSize = 4096,
+		BlockSize       = 16384
+	};
+
+	/// Memory for the first boxes
+	union InlineBlock {
+		char data[InlineBlockSize];
+		long double alignment0;
+		void * alignment1;
+	};
+
+	InlineBlock mInlineBlock;
+	char * mCurrent;             ///< Next free byte in current block
+	char * mEnd;                 ///< End of current block
+	std::vector<char*> mBlocks;  ///< Additional heap blocks
+	std::vector<Box*> mBoxes;    ///< All boxes in order of creation
+	size_t mBytesUsed;
+
+	// forbidden
+	BoxArena (const BoxArena&);
+	void operator= (const BoxArena&);
+};
+
+}
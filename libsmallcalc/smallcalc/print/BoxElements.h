@@ -3,13 +3,14 @@
 #include "Geometry.h"
 #include "DrawEngine.h"
 #include "Utf8Line.h"
-#include <deque>
-#include <boost/make_shared.hpp>
+#include "BoxArena.h"
+#include <vector>
 
 namespace sc {
 
 class Box;
-typedef shared_ptr<Box> BoxPtr;
+/// Boxes are owned by their BoxArena and refer to each other without reference counting
+typedef Box* BoxPtr;
 
 /// Empty Box
 class Box {
@@ -25,6 +26,10 @@ public:
 	virtual void draw (DrawEngine & engine) const {
 	}
 
+	/// Called after the box and all its children are drawn
+	virtual void drawFinished (DrawEngine & engine) const {
+	}
+
 	const Point2i & position () const { return mPosition; }
 	const Surrounding2i & size() const { return mSize; }
 
@@ -54,13 +59,16 @@ public:
 	virtual int flags () const { return 0; }
 
 	const Surrounding2i & minSize (const DrawEngine & engine) const {
-		if (mMinSizeDirty) {
-			mMinSize = calcMinSpace(engine);
-			mMinSizeDirty = false;
-		}
+		if (mMinSizeDirty) calculateMinSize (engine);
 		return mMinSize;
 	}
 
+	/// Minimum size has to be calculated
+	bool minSizeDirty () const { return mMinSizeDirty; }
+
+	/// Creates children which are created on demand, called before calculating minimum sizes without recursion
+	virtual void prepareChildren (const DrawEngine & engine) const {}
+
 
 	/** Recursivly print tree. */
 	void printTree (std::ostream & stream, int depth = 0) const {
@@ -88,6 +96,9 @@ protected:
 	Surrounding2i mSize; ///< Occupied size
 	Box* mParent;
 private:
+	/// Sets the minimum size; boxes nested deeper than MaxRecursionDepth are calculated with an explicit stack (see BoxTraversal.cpp)
+	void calculateMinSize (const DrawEngine & engine) const;
+
 	mutable Surrounding2i mMinSize;
 	mutable bool mMinSizeDirty;
 };
@@ -316,12 +327,12 @@ public:
 
 	void prependChild (const BoxPtr & child) {
 		minSizeGotDirty();
-		mChildren.push_front(child);
+		mChildren.insert (mChildren.begin(), child);
 		child->setParent(this);
 	}
 
 protected:
-	std::deque<BoxPtr> mChildren;
+	std::vector<BoxPtr> mChildren;
 };
 
 
@@ -400,24 +411,24 @@ private:
 /** Draws something in paranthesis. */
 class ParanthesisBox : public HorizontalContainer {
 public:
-	ParanthesisBox (const BoxPtr & child){
-		addChild (BoxPtr(new Paranthesis(DrawEngine::B_LEFT)));
-		addChild (BoxPtr(new ParanthesisSpaceProvider(child)));
-		addChild (BoxPtr(new Paranthesis(DrawEngine::B_RIGHT)));
+	ParanthesisBox (BoxArena * arena, const BoxPtr & child){
+		addChild (arena->create<Paranthesis> (DrawEngine::B_LEFT));
+		addChild (arena->create<ParanthesisSpaceProvider> (child));
+		addChild (arena->create<Paranthesis> (DrawEngine::B_RIGHT));
 	}
 
 	virtual void layoutChildren (const DrawEngine & engine) {
 		HorizontalContainer::layoutChildren(engine);
 	}
-	static BoxPtr create (const BoxPtr & child) { return boost::make_shared<ParanthesisBox>(child); }
+	static BoxPtr create (BoxArena * arena, const BoxPtr & child) { return arena->create<ParanthesisBox> (arena, child); }
 };
 
 class FractionBox : public Box{
 public:
-	FractionBox (const BoxPtr & numerator, const BoxPtr & denumerator) {
-		mNumerator = BoxPtr (new HCenterBox (BoxPtr (new HorizontalSpaceProviderBox (numerator))));
-		mDenumerator = (BoxPtr (new HCenterBox (BoxPtr (new HorizontalSpaceProviderBox (denumerator)))));
-		mLine = BoxPtr (new LineBox());
+	FractionBox (BoxArena * arena, const BoxPtr & numerator, const BoxPtr & denumerator) {
+		mNumerator   = arena->create<HCenterBox> (arena->create<HorizontalSpaceProviderBox> (numerator));
+		mDenumerator = arena->create<HCenterBox> (arena->create<HorizontalSpaceProviderBox> (denumerator));
+		mLine        = arena->create<LineBox> ();
 	}
 	virtual int flags() const { return F_NeedsClosedHSpace | F_NeedsClosedVSpace; }
 
@@ -465,35 +476,38 @@ private:
 /** A Box which paints a primitive (+,-,*) function.*/
 class InfixFunctionBox : public HorizontalContainer {
 public:
-	InfixFunctionBox (const std::string & separator) {
+	InfixFunctionBox (BoxArena * arena, const std::string & separator) {
+		mArena = arena;
 		mSeparator = separator;
 	}
 
 	void addArgument (const BoxPtr & box) {
 		if (!mChildren.empty()) {
-			addChild (BoxPtr (new HSpace ()));
-			addChild (BoxPtr (new TextBox(mSeparator)));
-			addChild (BoxPtr (new HSpace()));
+			addChild (mArena->create<HSpace> ());
+			addChild (mArena->create<TextBox> (mSeparator));
+			addChild (mArena->create<HSpace> ());
 		}
-		addChild (BoxPtr (box));
+		addChild (box);
 	}
 
 private:
+	BoxArena * mArena;
 	std::string mSeparator;
 };
 
 /// A Regular function like sin x
 class RegularFunctionBox : public HorizontalContainer {
 public:
-	RegularFunctionBox (const std::string & name, const BoxPtr & argument) {
-		addChild (BoxPtr (new TextBox (name)));
+	RegularFunctionBox (BoxArena * arena, const std::string & name, const BoxPtr & argument) {
+		addChild (arena->create<TextBox> (name));
 		addChild (argument);
 	}
 };
 
 class RegularFunctionBuilder  {
 public:
-	RegularFunctionBuilder (const std::string & name) {
+	RegularFunctionBuilder (BoxArena * arena, const std::string & name) {
+		mArena = arena;
 		mName = name;
 	}
 	void addArgument (const BoxPtr & arg) {
@@ -501,15 +515,16 @@ public:
 	}
 
 	BoxPtr result () {
-		shared_ptr<InfixFunctionBox> convertedArguments = boost::make_shared<InfixFunctionBox>(",");
+		InfixFunctionBox * convertedArguments = mArena->create<InfixFunctionBox> (mArena, ",");
 		BOOST_FOREACH(BoxPtr & box, mArguments) {
 			convertedArguments->addArgument(box);
 		}
 		mArguments.clear();
-		return boost::make_shared<RegularFunctionBox> (mName,
-				BoxPtr (new ParanthesisBox (convertedArguments)));
+		return mArena->create<RegularFunctionBox> (mArena, mName,
+				ParanthesisBox::create (mArena, convertedArguments));
 	}
 private:
+	BoxArena * mArena;
 	std::string mName;
 	std::vector<BoxPtr> mArguments;
 
@@ -556,9 +571,9 @@ private:
 /** Paints an expontent function. */
 class PowerBox : public HighBox {
 public:
-	PowerBox (const BoxPtr & base, const BoxPtr & exponent) :
-		HighBox (BoxPtr(new HorizontalSpaceProviderBox(base)),
-				BoxPtr(new HorizontalSpaceProviderBox(exponent))){
+	PowerBox (BoxArena * arena, const BoxPtr & base, const BoxPtr & exponent) :
+		HighBox (arena->create<HorizontalSpaceProviderBox> (base),
+				arena->create<HorizontalSpaceProviderBox> (exponent)){
 	}
 };
 
@@ -576,7 +591,7 @@ public:
 	virtual void layoutChildren (const DrawEngine & engine) {
 	}
 
-	static BoxPtr create (const Surrounding2i & space) { return boost::make_shared<DummyBox> (space); }
+	static BoxPtr create (BoxArena * arena, const Surrounding2i & space) { return arena->create<DummyBox> (space); }
 private:
 	Surrounding2i mSpace;
 };
@@ -0,0 +1,128 @@
+#include "BoxTraversal.h"
+#include "../Expression.h"
+
+namespace sc {
+
+namespace {
+
+/// Nesting of minSize calculations in this thread
+#ifdef _MSC_VER
+__declspec(thread) int minSizeDepth = 0;
+#else
+__thread int minSizeDepth = 0;
+#endif
+
+/// Calculates the minimum sizes of root and its children, children before their parents
+void calculateMinSizesIterative (BoxPtr root, const DrawEngine & engine) {
+	std::vector<BoxPtr> stack (1, root);
+	while (!stack.empty()) {
+		BoxPtr box = stack.back();
+		if (!box->minSizeDirty()) {
+			stack.pop_back();
+			continue;
+		}
+		box->prepareChildren (engine);
+		bool childrenReady = true;
+		for (int i = 0; i < box->childCount(); i++) {
+			BoxPtr child = box->child (i);
+			if (child->minSizeDirty()) {
+				stack.push_back (child);
+				childrenReady = false;
+			}
+		}
+		if (childrenReady) {
+			box->minSize (engine);
+			stack.pop_back();
+		}
+	}
+}
+
+void layoutBoxTreeIterative (BoxPtr root, const DrawEngine & engine) {
+	std::vector<BoxPtr> stack (1, root);
+	while (!stack.empty()) {
+		BoxPtr box = stack.back();
+		stack.pop_back();
+		box->layoutChildren (engine);
+		for (int i = box->childCount() - 1; i >= 0; i--) {
+			stack.push_back (box->child (i));
+		}
+	}
+}
+
+void layoutBoxTree (BoxPtr box, const DrawEngine & engine, int depth) {
+	if (depth >= MaxRecursionDepth) {
+		layoutBoxTreeIterative (box, engine);
+		return;
+	}
+	box->layoutChildren (engine);
+	for (int i = 0; i < box->childCount(); i++) {
+		layoutBoxTree (box->child (i), engine, depth + 1);
+	}
+}
+
+void drawBoxTreeIterative (BoxPtr root, DrawEngine & engine, SpaceStack & stack) {
+	// Boxes with the index of their next child to draw
+	std::vector<std::pair<BoxPtr, int> > boxes;
+	stack.push();
+	stack.moveCursor (root->position());
+	root->draw (engine);
+	boxes.push_back (std::make_pair (root, 0));
+	while (!boxes.empty()) {
+		BoxPtr box = boxes.back().first;
+		int next = boxes.back().second;
+		if (next == box->childCount()) {
+			box->drawFinished (engine);
+			stack.pop();
+			boxes.pop_back();
+			continue;
+		}
+		boxes.back().second++;
+		BoxPtr child = box->child (next);
+		stack.push();
+		stack.moveCursor (child->position());
+		child->draw (engine);
+		boxes.push_back (std::make_pair (child, 0));
+	}
+}
+
+void drawBoxTree (BoxPtr box, DrawEngine & engine, SpaceStack & stack, int depth) {
+	if (depth >= MaxRecursionDepth) {
+		drawBoxTreeIterative (box, engine, stack);
+		return;
+	}
+	stack.push();
+	stack.moveCursor (box->position());
+	box->draw (engine);
+	for (int i = 0; i < box->childCount(); i++) {
+		drawBoxTree (box->child (i), engine, stack, depth + 1);
+	}
+	box->drawFinished (engine);
+	stack.pop();
+}
+
+}
+
+void Box::calculateMinSize (const DrawEngine & engine) const {
+	if (minSizeDepth < MaxRecursionDepth) {
+		minSizeDepth++;
+		mMinSize = calcMinSpace (engine);
+		mMinSizeDirty = false;
+		minSizeDepth--;
+		return;
+	}
+	// Too deep: children are calculated bottom up, each box starting a fresh recursion which ends at its calculated children
+	int depth = minSizeDepth;
+	minSizeDepth = 0;
+	calculateMinSizesIterative (const_cast<Box*> (this), engine);
+	minSizeDepth = depth;
+}
+
+void layoutBoxTree (BoxPtr root, const DrawEngine & engine) {
+	layoutBoxTree (root, engine, 0);
+}
+
+void drawBoxTree (BoxPtr root, DrawEngine & engine, SpaceStack & stack) {
+	drawBoxTree (root, engine, stack, 0);
+}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "BoxElements.h"
+#include "SpaceStack.h"
+
+/**
+ * @file
+ * Traversals of box trees. They recurse up to MaxRecursionDepth and continue
+ * deeper subtrees with explicit stacks, so that the nesting depth of a box tree
+ * is only limited by memory and not by the call stack.
+ */
+
+namespace sc {
+
+/// Calls layoutChildren on all boxes, parents before their children
+void layoutBoxTree (BoxPtr root, const DrawEngine & engine);
+
+/// Draws all boxes in the coordinate system of stack (the one used by engine)
+void drawBoxTree (BoxPtr root, DrawEngine & engine, SpaceStack & stack);
+
+}
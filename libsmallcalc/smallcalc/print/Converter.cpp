@@ -5,97 +5,203 @@
 #include "../impl/Constant.h"
 #include "BoxElements.h"
 #include "SpaceStack.h"
+#include "LayoutCache.h"
+#include <vector>
 
 namespace sc {
 
-BoxPtr convertPrimitiveValue (const PrimitiveValue& value) {
+BoxPtr convertPrimitiveValue (BoxArena * arena, const PrimitiveValue& value) {
 	if (value.type() == PT_FRACTION) {
 		Fraction64 frac = value.toFraction();
 		int64_t num = frac.numerator();
 		int64_t den = frac.denumerator();
 		bool negate = num < 0;
 		if (negate) num = -num;
-		BoxPtr fractionBox = boost::make_shared<FractionBox> (
-				boost::make_shared<TextBox> (boost::lexical_cast<std::string> (num)),
-				boost::make_shared<TextBox> (boost::lexical_cast<std::string> (den)));
+		BoxPtr fractionBox = arena->create<FractionBox> (arena,
+				arena->create<TextBox> (boost::lexical_cast<std::string> (num)),
+				arena->create<TextBox> (boost::lexical_cast<std::string> (den)));
 		if (negate) {
-			return boost::make_shared<RegularFunctionBox> ("-", fractionBox);
+			return arena->create<RegularFunctionBox> (arena, "-", fractionBox);
 		} else {
 			return fractionBox;
 		}
 	}
 	// Fallback
-	return boost::make_shared<TextBox> (value.toString());
+	return arena->create<TextBox> (value.toString());
 }
 
 /** Returns true if exp is a trivial type, like a number, a variable or a constant.*/
 bool isTrivialType (const ExpressionPtr & exp) {
-	{
-		Value * v = dynamic_cast<Value*> (exp.get());
-		if (v) return true;
+	switch (exp->kind()) {
+	case EK_VALUE:
+	case EK_VARIABLE:
+	case EK_CONSTANT:
+	case EK_PARAMETER:
+		return true;
+	default:
+		return false;
 	}
-	{
-		Variable * v = dynamic_cast<Variable*> (exp.get());
-		if (v) return true;
-	}
-	{
-		Constant * c = dynamic_cast<Constant*> (exp.get());
-		if (c) return true;
+}
+
+BoxPtr addParanthesisIfNotTrivial (BoxArena * arena, const ExpressionPtr & exp, BoxPtr converted) {
+	return isTrivialType (exp) ? converted : ParanthesisBox::create (arena, converted);
+}
+
+BoxPtr convertExpression (BoxArena * arena, ExpressionPtr exp, int currentPrecedence, LayoutCache * cache) {
+	if (cache && exp->kind() == EK_FUNCTION) {
+		return arena->create<CachedSubtreeBox> (arena, cache, exp, currentPrecedence);
 	}
-	return false;
+	return convertExpressionNode (arena, exp, currentPrecedence, cache);
 }
 
-BoxPtr addParanthesisIfNotTrivial (const ExpressionPtr & exp) {
-	BoxPtr converted = convertExpression (exp);
-	return isTrivialType (exp) ? converted : ParanthesisBox::create (converted);
+namespace {
+
+/// How a function node is converted
+enum ConversionKind { CK_FRACTION, CK_POWER, CK_SQUARE_ROOT, CK_INFIX, CK_REGULAR, CK_TEXT };
+
+ConversionKind conversionKind (const NamedFunctionExpression * exp) {
+	const NamedFunctionPtr & func = exp->function();
+	BuiltinFunction builtin = func->builtin();
+	if (builtin == BF_DIVIDE && exp->argumentCount() == 2) return CK_FRACTION;
+	if (builtin == BF_POW && exp->argumentCount() == 2) return CK_POWER;
+	if (builtin == BF_SQRT && exp->argumentCount() == 1) return CK_SQUARE_ROOT;
+	if (func->notation() == FN_INFIX) return CK_INFIX;
+	if (func->notation() == FN_REGULAR) return CK_REGULAR;
+	return CK_TEXT;
 }
 
-BoxPtr convertExpression (ExpressionPtr exp, int currentPrecedence) {
-	NamedFunctionExpressionPtr namedExp = boost::dynamic_pointer_cast<NamedFunctionExpression>(exp);
-	if (namedExp) {
-		NamedFunctionPtr func = namedExp->function();
-		if (func->name() == "divide" && namedExp->argumentCount() == 2) {
-			return boost::make_shared<FractionBox> (
-					convertExpression (namedExp->argument(0)),
-					convertExpression(namedExp->argument(1)));
-		} else if (func->name() == "pow" && namedExp->argumentCount() == 2) {
-			BoxPtr base     = addParanthesisIfNotTrivial (namedExp->argument(0));
-			BoxPtr exponent = addParanthesisIfNotTrivial (namedExp->argument(1));
-			return boost::make_shared<PowerBox> (base,exponent);
-		} else if (func->name() == "sqrt" && namedExp->argumentCount() == 1) {
-			return boost::make_shared<SquareRootBox> (convertExpression(namedExp->argument(0)));
-		} else if (func->notation() == FN_INFIX) {
-			bool canSkipParanthesis = false;
-			if (func->precedence() > currentPrecedence) {
-				canSkipParanthesis = true;
-			}
-			if (func->precedence() == currentPrecedence && func->isAssociative()) {
-				canSkipParanthesis = true;
-			}
+/// A function node whose arguments are being converted
+struct ConvertFrame {
+	const NamedFunctionExpression * exp;
+	ConversionKind kind;
+	int precedence;       ///< Precedence of the box above
+	size_t next;          ///< Next argument to convert
+	size_t base;          ///< Position of the first converted argument on the box stack
+};
 
-			shared_ptr<InfixFunctionBox> infixBox (new InfixFunctionBox(func->printingName()));
-			for (size_t i = 0; i < namedExp->argumentCount(); i++) {
-				infixBox->addArgument(convertExpression (namedExp->argument(i), func->precedence()));
-			}
+ConvertFrame enterConvert (const Expression * exp, int precedence, size_t base) {
+	ConvertFrame frame;
+	frame.exp = static_cast<const NamedFunctionExpression*> (exp);
+	frame.kind = conversionKind (frame.exp);
+	frame.precedence = precedence;
+	frame.next = 0;
+	frame.base = base;
+	return frame;
+}
 
-			if (!canSkipParanthesis){
-				return BoxPtr (new ParanthesisBox(infixBox));
-			}
-			return infixBox;
-		} else if (func->notation() == FN_REGULAR) {
-			RegularFunctionBuilder builder (func->favouredName());
-			for (size_t i = 0; i < namedExp->argumentCount(); i++) {
-				builder.addArgument(convertExpression (namedExp->argument(i), func->precedence()));
-			}
-			return builder.result();
+/// Creates the box of a function node out of its converted arguments
+BoxPtr createFunctionBox (BoxArena * arena, const ConvertFrame & frame, const BoxPtr * arguments) {
+	const NamedFunctionExpression * namedExp = frame.exp;
+	const NamedFunctionPtr & func = namedExp->function();
+	switch (frame.kind) {
+	case CK_FRACTION:
+		return arena->create<FractionBox> (arena, arguments[0], arguments[1]);
+	case CK_POWER: {
+		BoxPtr base     = addParanthesisIfNotTrivial (arena, namedExp->argument(0), arguments[0]);
+		BoxPtr exponent = addParanthesisIfNotTrivial (arena, namedExp->argument(1), arguments[1]);
+		return arena->create<PowerBox> (arena, base, exponent);
+	}
+	case CK_SQUARE_ROOT:
+		return arena->create<SquareRootBox> (arguments[0]);
+	case CK_INFIX: {
+		bool canSkipParanthesis = false;
+		if (func->precedence() > frame.precedence) {
+			canSkipParanthesis = true;
+		}
+		if (func->precedence() == frame.precedence && func->isAssociative()) {
+			canSkipParanthesis = true;
+		}
+
+		InfixFunctionBox * infixBox = arena->create<InfixFunctionBox> (arena, func->printingName());
+		for (size_t i = 0; i < namedExp->argumentCount(); i++) {
+			infixBox->addArgument(arguments[i]);
+		}
+
+		if (!canSkipParanthesis){
+			return ParanthesisBox::create (arena, infixBox);
+		}
+		return infixBox;
+	}
+	case CK_REGULAR: {
+		RegularFunctionBuilder builder (arena, func->favouredName());
+		for (size_t i = 0; i < namedExp->argumentCount(); i++) {
+			builder.addArgument(arguments[i]);
 		}
+		return builder.result();
 	}
-	ValuePtr value = boost::dynamic_pointer_cast<Value> (exp);
-	if (value) {
-		return convertPrimitiveValue (value->value());
+	default:
+		// Fallback
+		return arena->create<TextBox> (namedExp->printNice());
+	}
+}
+
+/// Precedence the arguments of a node are converted with
+int argumentPrecedence (const ConvertFrame & frame) {
+	return (frame.kind == CK_INFIX || frame.kind == CK_REGULAR) ? frame.exp->function()->precedence() : 0;
+}
+
+BoxPtr convertLeaf (BoxArena * arena, const Expression * exp) {
+	if (exp->kind() == EK_VALUE) {
+		return convertPrimitiveValue (arena, static_cast<const Value*> (exp)->value());
 	}
 	// Fallback
-	return boost::make_shared<TextBox> (exp->printNice());
+	return arena->create<TextBox> (exp->printNice());
+}
+
+/// Post order conversion of a function node with an explicit stack, for subtrees deeper than MaxRecursionDepth.
+/// With a cache, function arguments become cached boxes and the stack stays flat.
+BoxPtr convertIterative (BoxArena * arena, const Expression * exp, int currentPrecedence, LayoutCache * cache) {
+	std::vector<ConvertFrame> frames;
+	std::vector<BoxPtr> boxes;
+	frames.push_back (enterConvert (exp, currentPrecedence, 0));
+	while (true) {
+		ConvertFrame & frame = frames.back();
+		if (frame.kind != CK_TEXT && frame.next < frame.exp->argumentCount()) {
+			const ExpressionPtr & argument = frame.exp->argument (frame.next++);
+			if (!cache && argument->kind() == EK_FUNCTION) {
+				frames.push_back (enterConvert (argument.get(), argumentPrecedence (frame), boxes.size()));
+			} else {
+				boxes.push_back (convertExpression (arena, argument, argumentPrecedence (frame), cache));
+			}
+			continue;
+		}
+		BoxPtr box = createFunctionBox (arena, frame, boxes.empty() ? 0 : &boxes[0] + frame.base);
+		boxes.resize (frame.base);
+		frames.pop_back();
+		if (frames.empty()) return box;
+		boxes.push_back (box);
+	}
+}
+
+BoxPtr convertNode (BoxArena * arena, const ExpressionPtr & exp, int currentPrecedence, LayoutCache * cache, int depth) {
+	if (exp->kind() != EK_FUNCTION) return convertLeaf (arena, exp.get());
+	if (depth >= MaxRecursionDepth) return convertIterative (arena, exp.get(), currentPrecedence, cache);
+	ConvertFrame frame = enterConvert (exp.get(), currentPrecedence, 0);
+	if (frame.kind == CK_TEXT) return createFunctionBox (arena, frame, 0);
+
+	size_t count = frame.exp->argumentCount();
+	BoxPtr fewArguments[4] = {};
+	std::vector<BoxPtr> manyArguments;
+	BoxPtr * arguments = fewArguments;
+	if (count > 4) {
+		manyArguments.resize (count);
+		arguments = &manyArguments[0];
+	}
+	for (size_t i = 0; i < count; i++) {
+		const ExpressionPtr & argument = frame.exp->argument (i);
+		if (cache) {
+			arguments[i] = convertExpression (arena, argument, argumentPrecedence (frame), cache);
+		} else {
+			arguments[i] = convertNode (arena, argument, argumentPrecedence (frame), cache, depth + 1);
+		}
+	}
+	return createFunctionBox (arena, frame, arguments);
+}
+
+}
+
+BoxPtr convertExpressionNode (BoxArena * arena, ExpressionPtr exp, int currentPrecedence, LayoutCache * cache) {
+	return convertNode (arena, exp, currentPrecedence, cache, 0);
 }
 
 }
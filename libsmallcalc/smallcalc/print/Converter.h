@@ -11,10 +11,18 @@
 
 namespace sc {
 
-/** Convert a primitive value to a box. tree */
-BoxPtr convertPrimitiveValue (const PrimitiveValue& value);
+/** Convert a primitive value to a box tree. The boxes are owned by arena. */
+BoxPtr convertPrimitiveValue (BoxArena * arena, const PrimitiveValue& value);
 
-/** Convert a expression to a box tree. Precedence is the precendece of the box above (internally used)*/
-BoxPtr convertExpression (ExpressionPtr exp, int currentPrecedence = 0);
+class LayoutCache;
+
+/**
+ * Convert a expression to a box tree owned by arena. Precedence is the precendece of the box above (internally used)
+ * If a cache is given, function subtrees are converted lazily, reusing the cached layout of unchanged subtrees.
+ */
+BoxPtr convertExpression (BoxArena * arena, ExpressionPtr exp, int currentPrecedence = 0, LayoutCache * cache = 0);
+
+/** Like convertExpression, but never puts exp itself into a cached box (used by the LayoutCache). */
+BoxPtr convertExpressionNode (BoxArena * arena, ExpressionPtr exp, int currentPrecedence, LayoutCache * cache);
 
 }
@@ -0,0 +1,118 @@
+#include "DisplayList.h"
+#include "Converter.h"
+#include "BoxTraversal.h"
+#include "../Trace.h"
+
+namespace sc {
+
+void DisplayList::replay (DrawEngine & engine) const {
+	std::string text;
+	for (std::vector<DrawCommand>::const_iterator i = mCommands.begin(); i != mCommands.end(); i++) {
+		engine.setCursor (Point2i (i->x, i->y));
+		switch (i->type) {
+		case DrawCommand::DC_TEXT:
+			text.assign (mText, i->textOffset, i->length);
+			engine.drawText (text);
+			break;
+		case DrawCommand::DC_LINE:
+			engine.drawLine (i->length);
+			break;
+		case DrawCommand::DC_PARANTHESIS:
+			engine.drawParanthesis (Surrounding2i (i->left, i->top, i->right, i->bottom), (DrawEngine::ParanthesisType) i->paranthesisType);
+			break;
+		case DrawCommand::DC_SQUARE_ROOT:
+			engine.drawSquareRoot (Surrounding2i (i->left, i->top, i->right, i->bottom));
+			break;
+		}
+	}
+}
+
+void DisplayList::clear () {
+	mSize = Surrounding2i ();
+	mCommands.clear ();
+	mText.clear ();
+}
+
+void DisplayListDrawEngine::record (BoxPtr box, DisplayList * list) {
+	list->clear ();
+	mList = list;
+	Surrounding2i size = box->minSize (*this);
+	list->mSize = size;
+	mStack = SpaceStack (size.size());
+	RootBox root (size, box);
+	root.setPosition (Point2i (size.left, size.top));
+	layoutTree (&root);
+	draw (&root);
+	mList = 0;
+}
+
+void DisplayListDrawEngine::drawText (const std::string & s) {
+	DrawCommand & c = addCommand (DrawCommand::DC_TEXT);
+	c.textOffset = mList->mText.size();
+	c.length     = s.size();
+	mList->mText.append (s);
+}
+
+void DisplayListDrawEngine::drawLine (int length) {
+	addCommand (DrawCommand::DC_LINE).length = length;
+}
+
+void DisplayListDrawEngine::drawParanthesis (const Surrounding2i & size, ParanthesisType type) {
+	DrawCommand & c = addCommand (DrawCommand::DC_PARANTHESIS);
+	c.paranthesisType = type;
+	c.left = size.left; c.top = size.top; c.right = size.right; c.bottom = size.bottom;
+}
+
+void DisplayListDrawEngine::drawSquareRoot (const Surrounding2i & size) {
+	DrawCommand & c = addCommand (DrawCommand::DC_SQUARE_ROOT);
+	c.left = size.left; c.top = size.top; c.right = size.right; c.bottom = size.bottom;
+}
+
+void DisplayListDrawEngine::layoutTree (const BoxPtr & box) {
+	layoutBoxTree (box, *this);
+}
+
+void DisplayListDrawEngine::draw (const BoxPtr & box) {
+	drawBoxTree (box, *this, mStack);
+}
+
+DrawCommand & DisplayListDrawEngine::addCommand (DrawCommand::Type type) {
+	assert (mList);
+	DrawCommand c = DrawCommand ();
+	c.type = type;
+	c.x    = mStack.pos().x;
+	c.y    = mStack.pos().y;
+	mList->mCommands.push_back (c);
+	return mList->mCommands.back();
+}
+
+DisplayListPtr DisplayListCache::get (const ExpressionPtr & expression, const DrawEngine & metrics) {
+	uint64_t key = hashCombine (expression->structuralHash(), metrics.identity());
+	ListMap::const_iterator i = mLists.find (key);
+	if (i != mLists.end() && i->second.engine == metrics.identity() &&
+		(i->second.expression == expression || structurallyEqual (*i->second.expression, *expression))) {
+		mHits++;
+		return i->second.list;
+	}
+	mMisses++;
+	DisplayListPtr list (new DisplayList ());
+	BoxArena arena;
+	DisplayListDrawEngine recorder (metrics);
+	BoxPtr box;
+	{
+		TraceSpan span ("convert");
+		box = convertExpression (&arena, expression);
+	}
+	recorder.record (box, list.get());
+	if (mLists.size() >= mMaxEntries) {
+		mLists.clear ();
+	}
+	// on a collision the former list is replaced
+	Entry & entry = mLists[key];
+	entry.expression = expression;
+	entry.engine     = metrics.identity();
+	entry.list       = list;
+	return list;
+}
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "../Expression.h"
+#include "BoxElements.h"
+#include "SpaceStack.h"
+#include <boost/unordered_map.hpp>
+
+namespace sc {
+
+/// One recorded drawing operation, with an absolute position
+struct DrawCommand {
+	enum Type { DC_TEXT, DC_LINE, DC_PARANTHESIS, DC_SQUARE_ROOT };
+
+	uint8_t type;            ///< Type of the command
+	uint8_t paranthesisType; ///< DrawEngine::ParanthesisType, for DC_PARANTHESIS
+	int32_t x, y;            ///< Cursor position when drawing
+	int32_t left, top, right, bottom; ///< Size, for DC_PARANTHESIS and DC_SQUARE_ROOT
+	uint32_t textOffset;     ///< Start of the text in DisplayList::text(), for DC_TEXT
+	uint32_t length;         ///< Text length in bytes for DC_TEXT, line length for DC_LINE
+};
+
+/**
+ * A laid out and drawn box tree, recorded as flat list of draw commands.
+ *
+ * Replaying it does not need the Box tree anymore, so it can be kept
+ * and redrawn as long as the expression does not change.
+ */
+class DisplayList {
+public:
+	/// Size of the whole drawing (the position of the root is (size.left, size.top))
+	const Surrounding2i & size () const { return mSize; }
+
+	/// Recorded commands
+	const std::vector<DrawCommand> & commands () const { return mCommands; }
+
+	/// Texts of all DC_TEXT commands, concatenated
+	const std::string & text () const { return mText; }
+
+	/// Replays all commands into an engine, which must be big enough.
+	void replay (DrawEngine & engine) const;
+
+	/// Removes all commands
+	void clear ();
+
+	/// Memory used by the list
+	size_t bytesUsed () const { return mCommands.capacity() * sizeof (DrawCommand) + mText.capacity(); }
+
+private:
+	friend class DisplayListDrawEngine;
+	Surrounding2i mSize;
+	std::vector<DrawCommand> mCommands;
+	std::string mText;
+};
+typedef shared_ptr<DisplayList> DisplayListPtr;
+
+/**
+ * A DrawEngine recording into DisplayLists.
+ *
+ * All measurements are taken from another engine (metrics), the one
+ * the list is meant to be replayed into.
+ */
+class DisplayListDrawEngine : public DrawEngine {
+public:
+	DisplayListDrawEngine (const DrawEngine & metrics) : mMetrics (metrics), mList (0) {}
+
+	/// Layouts a box tree and records its drawing into list
+	void record (BoxPtr box, DisplayList * list);
+
+	// Implementation of DrawEngine
+	virtual void drawText (const std::string & s);
+	virtual Surrounding2i textSize (const std::string & s) const { return mMetrics.textSize (s); }
+	virtual void drawLine (int length);
+	virtual void drawParanthesis (const Surrounding2i & size, ParanthesisType type);
+	virtual void drawSquareRoot (const Surrounding2i & size);
+	virtual int horizontalExtraSpace () const { return mMetrics.horizontalExtraSpace(); }
+	virtual int verticalExtraSpace() const { return mMetrics.verticalExtraSpace(); }
+	virtual Surrounding2i paranthesisMinSize (ParanthesisType type) const { return mMetrics.paranthesisMinSize (type); }
+	virtual Surrounding2i paranthesisExtraSpace (const Surrounding2i & i) const { return mMetrics.paranthesisExtraSpace (i); }
+	virtual Surrounding2i squareRootExtraSpace (const Surrounding2i & i) const { return mMetrics.squareRootExtraSpace (i); }
+	virtual uint64_t identity () const { return hashCombine (mMetrics.identity(), 0x444c6973ULL); }
+	virtual void setCursor (const Point2i & position) { mStack.moveCursorTo (position); }
+
+private:
+	void layoutTree (const BoxPtr & box);
+	void draw (const BoxPtr & box);
+	DrawCommand & addCommand (DrawCommand::Type type);
+
+	const DrawEngine & mMetrics;
+	DisplayList * mList;
+	SpaceStack mStack;
+};
+
+/**
+ * Keeps the display lists of recently printed expressions.
+ *
+ * Lists are found by structural hash and verified with structurallyEqual, as hashes may collide.
+ * If full, all entries are dropped. Note: this is NOT threadsafe.
+ */
+class DisplayListCache {
+public:
+	DisplayListCache (size_t maxEntries = 256) : mMaxEntries (maxEntries), mHits (0), mMisses (0) {}
+
+	/// Returns the display list of an expression for a metrics engine, records it if necessary
+	DisplayListPtr get (const ExpressionPtr & expression, const DrawEngine & metrics);
+
+	/// Number of cached lists
+	size_t size () const { return mLists.size(); }
+
+	uint64_t hits () const { return mHits; }
+	uint64_t misses () const { return mMisses; }
+
+	/// Removes all lists
+	void clear () { mLists.clear(); }
+
+private:
+	struct Entry {
+		Entry () : engine (0) {}
+		// What the list is for, compared on lookup
+		ExpressionPtr expression;
+		uint64_t engine;
+		DisplayListPtr list;
+	};
+	typedef boost::unordered_map<uint64_t, Entry> ListMap;
+	ListMap mLists;
+	size_t mMaxEntries;
+	uint64_t mHits;
+	uint64_t mMisses;
+};
+
+}
@@ -1,12 +1,24 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <stdint.h>
+#include <assert.h>
+#include "Geometry.h"
 
 namespace sc {
 
+/// An already drawn area, in an engine specific format (see DrawEngine::saveBlock)
+struct RenderedBlock {
+	Surrounding2i size;
+	std::vector<uint32_t> data;
+};
+
 class DrawEngine {
 public:
 	enum ParanthesisType { B_LEFT, B_RIGHT };
 
+	virtual ~DrawEngine () {}
+
 
 	virtual void drawText (const std::string & s) = 0;
 	virtual Surrounding2i textSize (const std::string & s) const = 0;
@@ -28,6 +40,18 @@ public:
 
 	/// Returns surrounding needed for a square root sign around a given object
 	virtual Surrounding2i squareRootExtraSpace (const Surrounding2i & i) const = 0;
+
+	/// Identifies engines with equal layout and drawing results (see LayoutCache)
+	virtual uint64_t identity () const { return 0; }
+
+	/// Copies the area of size around the current position into block; false if not supported
+	virtual bool saveBlock (const Surrounding2i & size, RenderedBlock * block) const { return false; }
+
+	/// Draws a block saved by saveBlock at the current position
+	virtual void restoreBlock (const RenderedBlock & block) {}
+
+	/// Sets the absolute cursor position, e.g. for replaying a DisplayList
+	virtual void setCursor (const Point2i & position) = 0;
 };
 
 
@@ -86,5 +86,8 @@ struct Surrounding2i {
 inline std::ostream& operator<< (std::ostream & o, const Surrounding2i & p) {
 	return o << "[" << p.left << "," << p.top << "," << p.right << "," << p.bottom << "]";
 }
+inline bool operator== (const Surrounding2i & a, const Surrounding2i & b) {
+	return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
 
 }
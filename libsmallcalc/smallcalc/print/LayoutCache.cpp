@@ -0,0 +1,144 @@
+#include "LayoutCache.h"
+#include "Converter.h"
+
+namespace sc {
+
+LayoutCache::RenderedBlockPtr LayoutCache::Entry::findBlock (const Surrounding2i & size) const {
+	for (std::vector<RenderedBlockPtr>::const_iterator i = blocks.begin(); i != blocks.end(); i++) {
+		if ((*i)->size == size) return *i;
+	}
+	return RenderedBlockPtr ();
+}
+
+namespace {
+
+/// If entry was made for the given subtree, not just one with a colliding key
+bool matches (const LayoutCache::Entry & entry, const Expression & expression, int precedence, uint64_t engine) {
+	return entry.precedence == precedence && entry.engine == engine && structurallyEqual (*entry.expression, expression);
+}
+
+}
+
+LayoutCache::LayoutCache (size_t maxEntries, size_t maxBlocksPerEntry) {
+	mMaxEntries        = maxEntries > 0 ? maxEntries : 1;
+	mMaxBlocksPerEntry = maxBlocksPerEntry;
+}
+
+LayoutCache::EntryPtr LayoutCache::lookup (const ExpressionPtr & expression, int precedence, const DrawEngine & engine) {
+	uint64_t key = hashCombine (hashCombine (expression->structuralHash(), precedence), engine.identity());
+	mStatistics.lookups++;
+	EntryMap::iterator i = mCurrent.find (key);
+	if (i != mCurrent.end() && matches (*i->second, *expression, precedence, engine.identity())) {
+		mStatistics.hits++;
+		i->second->uses++;
+		return i->second;
+	}
+	EntryPtr entry;
+	i = mOld.find (key);
+	if (i != mOld.end() && matches (*i->second, *expression, precedence, engine.identity())) {
+		mStatistics.hits++;
+		entry = i->second;
+		mOld.erase (i);
+	} else {
+		// new or colliding, the colliding entry gets replaced
+		entry = EntryPtr (new Entry ());
+		entry->expression = expression;
+		entry->precedence = precedence;
+		entry->engine     = engine.identity();
+	}
+	entry->uses++;
+	if (mCurrent.size() >= mMaxEntries) {
+		mStatistics.evictions += mOld.size();
+		mOld.swap (mCurrent);
+		mCurrent.clear ();
+	}
+	mCurrent[key] = entry;
+	return entry;
+}
+
+void LayoutCache::addBlock (Entry * entry, const RenderedBlock & block) {
+	if (mMaxBlocksPerEntry == 0) return;
+	if (entry->blocks.size() >= mMaxBlocksPerEntry) {
+		entry->blocks.erase (entry->blocks.begin());
+	}
+	entry->blocks.push_back (RenderedBlockPtr (new RenderedBlock (block)));
+}
+
+void LayoutCache::countBlockLookup (bool hit) {
+	mStatistics.blockLookups++;
+	if (hit) mStatistics.blockHits++;
+}
+
+void LayoutCache::recordRender (uint64_t micros) {
+	mStatistics.renders++;
+	mStatistics.totalRenderMicros += micros;
+	mStatistics.lastRenderMicros   = micros;
+	if (micros > mStatistics.maxRenderMicros) mStatistics.maxRenderMicros = micros;
+}
+
+void LayoutCache::clear () {
+	mCurrent.clear ();
+	mOld.clear ();
+}
+
+CachedSubtreeBox::CachedSubtreeBox (BoxArena * arena, LayoutCache * cache, const ExpressionPtr & expression, int precedence)
+: mArena (arena), mCache (cache), mExpression (expression), mPrecedence (precedence), mChild (0) {
+}
+
+void CachedSubtreeBox::prepareChildren (const DrawEngine & engine) const {
+	if (!mEntry) mEntry = mCache->lookup (mExpression, mPrecedence, engine);
+	if (!mEntry->minSizeValid) materialize ();
+}
+
+Surrounding2i CachedSubtreeBox::calcMinSpace (const DrawEngine & engine) const {
+	if (!mEntry) mEntry = mCache->lookup (mExpression, mPrecedence, engine);
+	if (!mEntry->minSizeValid) {
+		materialize ();
+		mEntry->minSize      = mChild->minSize (engine);
+		mEntry->flags        = mChild->flags ();
+		mEntry->minSizeValid = true;
+	}
+	return mEntry->minSize;
+}
+
+void CachedSubtreeBox::layoutChildren (const DrawEngine & engine) {
+	// Some parents lay out their children without asking for their size
+	minSize (engine);
+	mBlock = mEntry->findBlock (mSize);
+	mCache->countBlockLookup (mBlock.get() != 0);
+	if (mBlock) return;
+	materialize ();
+	// Boxes rely on their minimum size being calculated before layout
+	mChild->minSize (engine);
+	mChild->setPosition (Point2i (0,0));
+	mChild->setSize (mSize);
+}
+
+void CachedSubtreeBox::draw (DrawEngine & engine) const {
+	if (mBlock) {
+		engine.restoreBlock (*mBlock);
+	}
+}
+
+void CachedSubtreeBox::drawFinished (DrawEngine & engine) const {
+	// Only subtrees which are seen again are worth the copy
+	if (mBlock || mEntry->uses < 2) return;
+	RenderedBlock block;
+	if (engine.saveBlock (mSize, &block)) {
+		mCache->addBlock (mEntry.get(), block);
+	}
+}
+
+int CachedSubtreeBox::flags () const {
+	if (mEntry && mEntry->minSizeValid) return mEntry->flags;
+	materialize ();
+	return mChild->flags ();
+}
+
+void CachedSubtreeBox::materialize () const {
+	if (mChild) return;
+	mChild = convertExpressionNode (mArena, mExpression, mPrecedence, mCache);
+	mChild->setParent (const_cast<CachedSubtreeBox*> (this));
+}
+
+}
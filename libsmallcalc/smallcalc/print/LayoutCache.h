@@ -0,0 +1,136 @@
+#pragma once
+#include "../Expression.h"
+#include "BoxElements.h"
+#include <boost/unordered_map.hpp>
+
+namespace sc {
+
+/**
+ * Cache for layout results across multiple print calls.
+ *
+ * Entries are keyed by the structural hash of an expression subtree, the
+ * precedence it is printed in and the identity of the DrawEngine; an entry
+ * keeps its subtree, which is compared with structurallyEqual on a hit. An entry
+ * holds the minimum size of the converted subtree and, once the subtree is
+ * seen a second time, the rendered blocks for the sizes it was drawn with.
+ * Unchanged subtrees are therefore neither converted nor laid out again.
+ *
+ * Eviction works in two generations: if the current generation is full
+ * it becomes the old one; entries which are used again move back.
+ *
+ * Note: this is NOT threadsafe.
+ */
+class LayoutCache {
+public:
+	typedef shared_ptr<const RenderedBlock> RenderedBlockPtr;
+
+	/// Cached layout data of one subtree
+	struct Entry {
+		Entry () : precedence (0), engine (0), minSizeValid (false), flags (0), uses (0) {}
+		/// Returns the rendered block for a given size or null
+		RenderedBlockPtr findBlock (const Surrounding2i & size) const;
+
+		// What the entry is for, compared on lookup as keys may collide
+		ExpressionPtr expression;
+		int precedence;
+		uint64_t engine;
+
+		bool minSizeValid;
+		Surrounding2i minSize;
+		int flags;
+		int uses;
+		std::vector<RenderedBlockPtr> blocks; ///< Shared, boxes keep using blocks dropped from the entry
+	};
+	typedef shared_ptr<Entry> EntryPtr;
+
+	/// Counters, for monitoring efficiency
+	struct Statistics {
+		Statistics () : lookups (0), hits (0), blockLookups (0), blockHits (0), evictions (0), renders (0), totalRenderMicros (0), lastRenderMicros (0), maxRenderMicros (0) {}
+		/// Share of subtree lookups which found an entry
+		double hitRate () const { return lookups ? (double) hits / lookups : 0.0; }
+		/// Share of block lookups which could reuse a rendered block
+		double blockHitRate () const { return blockLookups ? (double) blockHits / blockLookups : 0.0; }
+		/// Average latency of the print calls using the cache
+		double averageRenderMicros () const { return renders ? (double) totalRenderMicros / renders : 0.0; }
+
+		uint64_t lookups;
+		uint64_t hits;
+		uint64_t blockLookups;
+		uint64_t blockHits;
+		uint64_t evictions;
+		uint64_t renders;
+		uint64_t totalRenderMicros;
+		uint64_t lastRenderMicros;
+		uint64_t maxRenderMicros;
+	};
+
+	/// maxEntries is the maximum count of entries per generation
+	LayoutCache (size_t maxEntries = 4096, size_t maxBlocksPerEntry = 4);
+
+	/// Returns the entry for a subtree, creates it if not existing
+	EntryPtr lookup (const ExpressionPtr & expression, int precedence, const DrawEngine & engine);
+
+	/// Stores a rendered block for an entry
+	void addBlock (Entry * entry, const RenderedBlock & block);
+
+	/// Counts a block lookup
+	void countBlockLookup (bool hit);
+
+	/// Records the latency of one print call
+	void recordRender (uint64_t micros);
+
+	/// Current statistics
+	const Statistics & statistics () const { return mStatistics; }
+
+	/// Reset statistics
+	void resetStatistics () { mStatistics = Statistics (); }
+
+	/// Number of cached entries
+	size_t size () const { return mCurrent.size() + mOld.size(); }
+
+	/// Removes all entries
+	void clear ();
+
+private:
+	typedef boost::unordered_map<uint64_t, EntryPtr> EntryMap;
+	EntryMap mCurrent;
+	EntryMap mOld;
+	size_t mMaxEntries;
+	size_t mMaxBlocksPerEntry;
+	Statistics mStatistics;
+};
+
+/**
+ * A box standing for an expression subtree, backed by a LayoutCache.
+ *
+ * The subtree is only converted if the cache does not know its size or
+ * has no rendered block for the size it gets during layout.
+ */
+class CachedSubtreeBox : public Box {
+public:
+	CachedSubtreeBox (BoxArena * arena, LayoutCache * cache, const ExpressionPtr & expression, int precedence);
+
+	// Implementation of Box
+	virtual Surrounding2i calcMinSpace (const DrawEngine & engine) const;
+	virtual void prepareChildren (const DrawEngine & engine) const;
+	virtual void layoutChildren (const DrawEngine & engine);
+	virtual void draw (DrawEngine & engine) const;
+	virtual void drawFinished (DrawEngine & engine) const;
+	virtual int childCount () const { return (mBlock || !mChild) ? 0 : 1; }
+	virtual BoxPtr child (int i) const { return mChild; }
+	virtual int flags () const;
+
+private:
+	/// Converts the subtree if not already done
+	void materialize () const;
+
+	BoxArena * mArena;
+	LayoutCache * mCache;
+	ExpressionPtr mExpression;
+	int mPrecedence;
+	mutable LayoutCache::EntryPtr mEntry;
+	mutable BoxPtr mChild;
+	LayoutCache::RenderedBlockPtr mBlock;
+};
+
+}
@@ -3,6 +3,7 @@
 #include "Geometry.h"
 #include <assert.h>
 #include <stack>
+#include <vector>
 
 namespace sc {
 
@@ -31,6 +32,11 @@ public:
 		assert (mScene.size.height >= 0);
 	}
 
+	/// Moves the cursor to an absolute position
+	void moveCursorTo (const Point2i & p) {
+		moveCursor (Point2i (p.x - mScene.position.x, p.y - mScene.position.y));
+	}
+
 	void limitSpace (const Dimension2i & limit) {
 		assert (limit.width <= mScene.size.width);
 		mScene.size.width = limit.width;
@@ -55,7 +61,7 @@ public:
 protected:
 
 	Scene mScene;
-	std::stack<Scene> mCoordinateStack;
+	std::stack<Scene, std::vector<Scene> > mCoordinateStack;
 };
 
 
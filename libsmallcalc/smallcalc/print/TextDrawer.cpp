@@ -1,24 +1,28 @@
 #include "TextDrawer.h"
-#include <boost/foreach.hpp>
+#include "utf8/unchecked.h"
+#include "../Trace.h"
+#include <algorithm>
 
 namespace sc {
 
 void TextDrawer::setSize (const Dimension2i & dim) {
 	mStack.setSize (dim);
-	mLines.resize(dim.height);
-
-	BOOST_FOREACH(Utf8Line & s, mLines) {
-		s.resize (dim.width, ' ');
-	}
+	mWidth  = dim.width;
+	mHeight = dim.height;
+	mGlyphs.assign ((size_t) mWidth * mHeight, G_SPACE);
 }
 
-TextDrawer::TextDrawer (const Dimension2i & dim){
+TextDrawer::TextDrawer (const Dimension2i & dim) : mWidth (0), mHeight (0) {
 	setSize (dim);
 }
 
 void TextDrawer::drawText (const std::string & s) {
-	assert (mStack.pos().x >= 0);
-	line().replace (mStack.pos().x, s);
+	int x = mStack.pos().x;
+	std::string::const_iterator i = s.begin();
+	while (i != s.end()) {
+		putGlyph (x, 0, utf8::next (i, s.end()));
+		x++;
+	}
 }
 
 Surrounding2i TextDrawer::textSize (const std::string & s) const {
@@ -26,43 +30,41 @@ Surrounding2i TextDrawer::textSize (const std::string & s) const {
 }
 
 void TextDrawer::drawLine (int length) {
-	line().replacePattern (mStack.pos().x, length, "─");
+	fillGlyphs (mStack.pos().x, length, G_HORIZONTAL);
 }
 
 void TextDrawer::drawParanthesis (const Surrounding2i & size, ParanthesisType type) {
+	int x = mStack.pos().x;
 	if (size.height() < 2) {
-		std::string c = type == B_LEFT ? "(" : ")";
+		uint32_t c = type == B_LEFT ? G_LEFT_PARANTHESIS : G_RIGHT_PARANTHESIS;
 		for (int i = 0; i < size.bottom; i++) {
-			line (i).replace (mStack.pos().x, c);
+			putGlyph (x, i, c);
 		}
 	} else {
-		std::string c = type == B_LEFT ? "╭" : "╮";
-		line(-size.top).replace(mStack.pos().x, c);
-		c = "│";
+		putGlyph (x, -size.top, type == B_LEFT ? G_ARC_DOWN_RIGHT : G_ARC_DOWN_LEFT);
 		for (int i = 1; i < size.height() - 1; i++) {
-			line(i - size.top).replace(mStack.pos().x, c);
+			putGlyph (x, i - size.top, G_VERTICAL);
 		}
-		c = type == B_LEFT ? "╰" : "╯";
-		line(size.bottom-1).replace(mStack.pos().x, c);
+		putGlyph (x, size.bottom - 1, type == B_LEFT ? G_ARC_UP_RIGHT : G_ARC_UP_LEFT);
 	}
 }
 
 void TextDrawer::drawSquareRoot (const Surrounding2i & size) {
+	int x = mStack.pos().x - size.left;
 	if (size.height() == 1) {
-		line(0).replace (mStack.pos().x - size.left, "√");
+		putGlyph (x, 0, G_SQUARE_ROOT);
 	} else {
-		line(0).replace (mStack.pos().x - size.left, "┤");
-		int x = mStack.pos().x - size.left;
+		putGlyph (x, 0, G_VERTICAL_LEFT);
 		for (int i = 1; i < size.bottom; i++) {
-			line(i).replace (x, "│");
+			putGlyph (x, i, G_VERTICAL);
 		}
 		for (int i = 1; i < size.top; i++) {
-			line(-i).replace (x, "│");
+			putGlyph (x, -i, G_VERTICAL);
 		}
 		int y = -(size.top);
-		line (y).replace (x, "┌");
+		putGlyph (x, y, G_DOWN_RIGHT);
 		for (int i = 0; i < size.right; i++) {
-			line(y).replace(mStack.pos().x + i, "─");
+			putGlyph (mStack.pos().x + i, y, G_HORIZONTAL);
 		}
 	}
 }
@@ -77,42 +79,89 @@ Surrounding2i TextDrawer::squareRootExtraSpace (const Surrounding2i & i) const {
 	return Surrounding2i (1,1,0,0);
 }
 
-void TextDrawer::layoutTree (const BoxPtr & box) {
-	box->layoutChildren(*this);
-	for (int i = 0; i < box->childCount(); i++) {
-		layoutTree (box->child(i));
+bool TextDrawer::saveBlock (const Surrounding2i & size, RenderedBlock * block) const {
+	int x0 = mStack.pos().x - size.left;
+	int y0 = mStack.pos().y - size.top;
+	if (x0 < 0 || y0 < 0 || x0 + size.width() > mWidth || y0 + size.height() > mHeight) return false;
+	block->size = size;
+	block->data.resize ((size_t) size.width() * size.height());
+	std::vector<uint32_t>::iterator out = block->data.begin();
+	for (int y = 0; y < size.height(); y++) {
+		std::vector<uint32_t>::const_iterator row = mGlyphs.begin() + (y0 + y) * mWidth + x0;
+		out = std::copy (row, row + size.width(), out);
 	}
+	return true;
+}
+
+void TextDrawer::restoreBlock (const RenderedBlock & block) {
+	int x0 = mStack.pos().x - block.size.left;
+	int y0 = mStack.pos().y - block.size.top;
+	int width = block.size.width();
+	// clipped like putGlyph, columns [begin, end) of each row are inside the grid
+	int begin = std::max (0, -x0);
+	int end   = std::min (width, mWidth - x0);
+	if (begin >= end) return;
+	for (int y = std::max (0, -y0); y < block.size.height() && y0 + y < mHeight; y++) {
+		std::vector<uint32_t>::const_iterator row = block.data.begin() + y * width;
+		std::copy (row + begin, row + end, mGlyphs.begin() + (y0 + y) * mWidth + x0 + begin);
+	}
+}
+
+void TextDrawer::layoutTree (const BoxPtr & box) {
+	layoutBoxTree (box, *this);
 }
 
 
 void TextDrawer::draw (const BoxPtr & box) {
-	mStack.push();
-	mStack.moveCursor (box->position());
-	box->draw(*this);
-	for (int i = 0; i < box->childCount(); i++) {
-		BoxPtr child (box->child(i));
-		draw (child);
-	}
-	mStack.pop();
+	drawBoxTree (box, *this, mStack);
 }
 
 void TextDrawer::drawLayouted (BoxPtr box) {
 	Surrounding2i size = box->minSize (*this);
 	assert (mStack.space().width >= size.width());
 	assert (mStack.space().height >= size.height());
-	BoxPtr root = boost::make_shared<RootBox> (size, box);
-	root->setPosition (Point2i (size.left, size.top));
-	layoutTree (root);
-	draw (root);
+	RootBox root (size, box);
+	root.setPosition (Point2i (size.left, size.top));
+	{
+		TraceSpan span ("layout");
+		layoutTree (&root);
+	}
+	TraceSpan span ("draw");
+	draw (&root);
 }
 
-void TextDrawer::print (std::ostream & stream) {
-	// omit std::endl on last line to be compatible with other outputs
-    for (std::vector<Utf8Line>::const_iterator i = mLines.begin(); i != mLines.end(); i++) {
-        stream << *i;
-        if ((i + 1) != mLines.end()) stream << std::endl;
-    }
+void TextDrawer::print (std::string & output) const {
+	// A glyph needs at most 4 bytes, plus the line separators
+	size_t begin = output.size();
+	output.resize (begin + mGlyphs.size() * 4 + mHeight);
+	char * start = &output[0] + begin;
+	char * out = start;
+	for (int y = 0; y < mHeight; y++) {
+		// omit newline on last line to be compatible with other outputs
+		if (y > 0) *out++ = '\n';
+		const uint32_t * row = &mGlyphs[y * mWidth];
+		for (int x = 0; x < mWidth; x++) {
+			uint32_t glyph = row[x];
+			if (glyph < 0x80) {
+				*out++ = (char) glyph;
+			} else {
+				out = utf8::unchecked::append (glyph, out);
+			}
+		}
+	}
+	output.resize (begin + (out - start));
 }
 
+void TextDrawer::print (std::ostream & stream) const {
+	std::string output;
+	print (output);
+	stream << output;
+}
+
+void TextDrawer::fillGlyphs (int x, int count, uint32_t glyph) {
+	for (int i = 0; i < count; i++) {
+		putGlyph (x + i, 0, glyph);
+	}
+}
 
 }
@@ -1,7 +1,7 @@
 #pragma once
 #include "BoxElements.h"
 #include "SpaceStack.h"
-#include <boost/make_shared.hpp>
+#include "BoxTraversal.h"
 #include "Utf8Line.h"
 #include <vector>
 
@@ -9,15 +9,35 @@ namespace sc {
 
 /**
  * A drawer which draws into text displays
+ *
+ * All rows live in one contiguous width x height grid of UTF-32 glyphs.
+ * Everything drawn outside the grid is clipped, in debug and release builds alike
+ * (e.g. when the grid only shows a part of a tree).
  */
 class TextDrawer : public DrawEngine{
 public:
 
-	TextDrawer () {
+	/// Pre decoded glyphs used for drawing
+	enum Glyph {
+		G_SPACE              = 0x0020, // ' '
+		G_LEFT_PARANTHESIS   = 0x0028, // (
+		G_RIGHT_PARANTHESIS  = 0x0029, // )
+		G_HORIZONTAL         = 0x2500, // ─
+		G_VERTICAL           = 0x2502, // │
+		G_DOWN_RIGHT         = 0x250C, // ┌
+		G_VERTICAL_LEFT      = 0x2524, // ┤
+		G_ARC_DOWN_RIGHT     = 0x256D, // ╭
+		G_ARC_DOWN_LEFT      = 0x256E, // ╮
+		G_ARC_UP_LEFT        = 0x256F, // ╯
+		G_ARC_UP_RIGHT       = 0x2570, // ╰
+		G_SQUARE_ROOT        = 0x221A  // √
+	};
+
+	TextDrawer () : mWidth (0), mHeight (0) {
 
 	}
 
-	TextDrawer (BoxPtr destination) {
+	TextDrawer (BoxPtr destination) : mWidth (0), mHeight (0) {
 		setSize (destination->minSize(*this).size());
 	}
 
@@ -37,31 +57,43 @@ public:
 	virtual void drawSquareRoot (const Surrounding2i & size);
 	virtual Surrounding2i paranthesisExtraSpace (const Surrounding2i & i) const;
 	virtual Surrounding2i squareRootExtraSpace (const Surrounding2i & i) const;
+	virtual uint64_t identity () const { return 0x54657874ULL; }
+	virtual bool saveBlock (const Surrounding2i & size, RenderedBlock * block) const;
+	virtual void restoreBlock (const RenderedBlock & block);
+	virtual void setCursor (const Point2i & position) { mStack.moveCursorTo (position); }
 
 
 	/** Layout a whole tree.*/
 	void layoutTree (const BoxPtr & box);
 
-	/// Recursivly draws all elements.
+	/// Draws all elements.
 	void draw (const BoxPtr & box);
 
 	/// Convenience function, creates a root
 	/// Note: modifies box' parent flag
 	void drawLayouted (BoxPtr box);
 
+	/// Appends the drawn text (UTF8, rows separated by newlines) to output
+	void print (std::string & output) const;
+
 	/// Print to stdout stream
-	void print (std::ostream & stream);
+	void print (std::ostream & stream) const;
 
 private:
 
-	/// Returns current line together with an offset
-	Utf8Line & line (int offset = 0) {
-		int idx = mStack.pos().y + offset;
-		assert (idx >= 0 && idx < (int) mLines.size());
-		return mLines[idx];
+	/// Sets a glyph relative to the current line, clipping everything outside the grid
+	void putGlyph (int x, int lineOffset, uint32_t glyph) {
+		int y = mStack.pos().y + lineOffset;
+		if (x < 0 || x >= mWidth || y < 0 || y >= mHeight) return;
+		mGlyphs[y * mWidth + x] = glyph;
 	}
 
-	std::vector<Utf8Line> mLines;
+	/// Sets count glyphs in the current line, starting at x
+	void fillGlyphs (int x, int count, uint32_t glyph);
+
+	int mWidth;
+	int mHeight;
+	std::vector<uint32_t> mGlyphs; ///< Row major glyph grid
 	SpaceStack mStack;
 };
 
@@ -52,16 +52,11 @@ public:
 		if (afterwards > length()) {
 			resize (afterwards);
 		}
-		std::vector<int32_t> temp;
-		temp.resize (len);
-		utf8::utf8to32 (s.begin(), s.end(), temp.begin());
-		size_t p = pos;
-		for (size_t i = 0; i < count; i++) {
-			for (size_t j = 0; j < len; j++) {
-				assert (p < mUtf32.size());
-				mUtf32[p] = temp[j];
-				p++;
-			}
+		if (count == 0) return;
+		// decode once, then repeat the decoded pattern
+		utf8::utf8to32 (s.begin(), s.end(), mUtf32.begin() + pos);
+		for (size_t p = pos + len; p < afterwards; p++) {
+			mUtf32[p] = mUtf32[p - len];
 		}
 	}
 
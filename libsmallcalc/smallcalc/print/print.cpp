@@ -1,41 +1,114 @@
 #include "print.h"
 #include "Converter.h"
 #include "TextDrawer.h"
+#include "LayoutCache.h"
+#include "DisplayList.h"
+#include "../Profiler.h"
+#include "../Trace.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 namespace sc {
 
+/// Traced conversion of a whole expression
+static BoxPtr convert (BoxArena * arena, const ExpressionPtr & expression, LayoutCache * cache = 0) {
+	TraceSpan span ("convert");
+	return convertExpression (arena, expression, 0, cache);
+}
+
 static std::string printBox (const BoxPtr & box) {
 	TextDrawer drawer (box);
 	drawer.drawLayouted(box);
-	std::ostringstream ss;
-	drawer.print (ss);
-	return ss.str();
+	std::string result;
+	drawer.print (result);
+	return result;
 }
 
 std::string print (const ExpressionPtr & expression) {
-	BoxPtr box = convertExpression (expression);
+	AllocationScope scope (AP_PRINT);
+	BoxArena arena;
+	BoxPtr box = convert (&arena, expression);
+	return printBox (box);
+}
+
+/// Records the latency of a print call into a LayoutCache
+class RenderTimer {
+public:
+	RenderTimer (LayoutCache * cache) : mCache (cache), mStart (boost::posix_time::microsec_clock::universal_time()) {}
+	~RenderTimer () {
+		boost::posix_time::time_duration d = boost::posix_time::microsec_clock::universal_time() - mStart;
+		mCache->recordRender (d.total_microseconds());
+	}
+private:
+	LayoutCache * mCache;
+	boost::posix_time::ptime mStart;
+};
+
+std::string print (const ExpressionPtr & expression, LayoutCache * cache) {
+	AllocationScope scope (AP_PRINT);
+	if (!cache) return print (expression);
+	RenderTimer timer (cache);
+	BoxArena arena;
+	BoxPtr box = convert (&arena, expression, cache);
 	return printBox (box);
 }
 
+std::string print (const ExpressionPtr & expression, DisplayListCache * cache) {
+	AllocationScope scope (AP_PRINT);
+	if (!cache) return print (expression);
+	TextDrawer metrics;
+	return print (*cache->get (expression, metrics));
+}
+
+std::string print (const DisplayList & list) {
+	AllocationScope scope (AP_PRINT);
+	TextDrawer drawer (list.size().size());
+	list.replay (drawer);
+	std::string result;
+	drawer.print (result);
+	return result;
+}
+
 std::string print (const PrimitiveValue& val) {
-	BoxPtr box = convertPrimitiveValue (val);
+	AllocationScope scope (AP_PRINT);
+	BoxArena arena;
+	BoxPtr box = convertPrimitiveValue (&arena, val);
 	return printBox (box);
 }
 
 std::string printCalcResult (const ExpressionPtr & exp, const std::string & connector, const PrimitiveValue & value) {
-	shared_ptr<InfixFunctionBox> infixBox (new InfixFunctionBox(connector));
-	infixBox->addArgument(convertExpression(exp));
-	infixBox->addArgument(convertPrimitiveValue(value));
+	AllocationScope scope (AP_PRINT);
+	BoxArena arena;
+	InfixFunctionBox * infixBox = arena.create<InfixFunctionBox> (&arena, connector);
+	infixBox->addArgument(convert (&arena, exp));
+	infixBox->addArgument(convertPrimitiveValue(&arena, value));
 	return printBox (infixBox);
 }
 
-std::string printFractionResult (const PrimitiveValue& value, const std::string& connector, const std::string & decimal) {
-	shared_ptr<InfixFunctionBox> infixBox (new InfixFunctionBox(connector));
-	infixBox->addArgument(convertPrimitiveValue(value));
-	infixBox->addArgument(BoxPtr (new TextBox(decimal)));
+std::string printCalcResult (const ExpressionPtr & exp, const std::string & connector, const PrimitiveValue & value, LayoutCache * cache) {
+	AllocationScope scope (AP_PRINT);
+	if (!cache) return printCalcResult (exp, connector, value);
+	RenderTimer timer (cache);
+	BoxArena arena;
+	InfixFunctionBox * infixBox = arena.create<InfixFunctionBox> (&arena, connector);
+	infixBox->addArgument(convert (&arena, exp, cache));
+	infixBox->addArgument(convertPrimitiveValue(&arena, value));
 	return printBox (infixBox);
 }
 
+std::string printFractionResult (const PrimitiveValue& value, const std::string& connector, const std::string & decimal) {
+	AllocationScope scope (AP_PRINT);
+	BoxArena arena;
+	InfixFunctionBox * infixBox = arena.create<InfixFunctionBox> (&arena, connector);
+	infixBox->addArgument(convertPrimitiveValue(&arena, value));
+	infixBox->addArgument(arena.create<TextBox> (decimal));
+	return printBox (infixBox);
+}
 
+std::string printProfile (const ExpressionPtr & expression, const EvaluationProfiler & profiler) {
+	std::string result = print (expression);
+	result += "\n";
+	result += profiler.report (expression);
+	return result;
+}
 
 }
@@ -9,12 +9,33 @@ namespace sc {
 /** Prints an expression into a string. */
 std::string print (const ExpressionPtr & expression);
 
+class LayoutCache;
+class DisplayList;
+class DisplayListCache;
+
+/** Prints an expression into a string, reusing layouts of subtrees printed before with the same cache. */
+std::string print (const ExpressionPtr & expression, LayoutCache * cache);
+
+/** Prints an expression into a string, replaying its display list if it was printed before with the same cache. */
+std::string print (const ExpressionPtr & expression, DisplayListCache * cache);
+
+/** Prints a recorded display list into a string. */
+std::string print (const DisplayList & list);
+
 /** Prints an primitive  value into a string.*/
 std::string print (const PrimitiveValue& val);
 
 /** Prints calculation result in format, "expression connector value", like sin(x) = value. */
 std::string printCalcResult (const ExpressionPtr & exp, const std::string & connector, const PrimitiveValue & value);
 
+/** Like printCalcResult, reusing layouts of subtrees printed before with the same cache. */
+std::string printCalcResult (const ExpressionPtr & exp, const std::string & connector, const PrimitiveValue & value, LayoutCache * cache);
+
+class EvaluationProfiler;
+
+/** Prints an expression followed by the profile of its evaluation as tree along its nodes. */
+std::string printProfile (const ExpressionPtr & expression, const EvaluationProfiler & profiler);
+
 /** Print calculation result in format, "value connector string-representation", like 3/4 = 0.75. */
 std::string printFractionResult (const PrimitiveValue& value, const std::string& connector, const std::string & decimal);
 
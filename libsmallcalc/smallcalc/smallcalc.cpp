@@ -5,12 +5,16 @@
 #include "impl/NamedFunction.h"
 #include "impl/StandardFunctions.h"
 #include "impl/AssignmentExpression.h"
+#include "impl/UserFunction.h"
+#include "impl/Reduction.h"
+#include "Trace.h"
 
 namespace sc {
 
 SmallCalc::SmallCalc () {
 	mParserContext = new ParserContext();
 	mParserContext->variableMapping = &mVariableIdMapping;
+	mEvaluationContext.fallbacks = &mFallbackStats;
 	addFundamentalFunctions();
 }
 SmallCalc::~SmallCalc () {
@@ -23,26 +27,34 @@ void SmallCalc::addStandardConstants () {
 }
 
 void SmallCalc::addStandardFunctions () {
-	mParserContext->addFunction (createNamedFunction("sin", 1, &sc::sin));
-	mParserContext->addFunction (createNamedFunction("cos", 1, &sc::cos));
-	mParserContext->addFunction (createNamedFunction("tan", 1, &sc::tan));
-	mParserContext->addFunction (createNamedFunction("round", 1, &sc::round));
-	mParserContext->addFunction (createNamedFunction("sqrt", 1, &sc::sqrt, "√"));
-
-	mParserContext->addFunction (createNamedFunction("acos", 1, &sc::acos));
-	mParserContext->addFunction (createNamedFunction("asin", 1, &sc::asin));
-	mParserContext->addFunction (createNamedFunction("atan", 1, &sc::atan));
-
-	mParserContext->addFunction (createNamedFunction("cosh", 1, &sc::cosh));
-	mParserContext->addFunction (createNamedFunction("sinh", 1, &sc::sinh));
-	mParserContext->addFunction (createNamedFunction("tanh", 1, &sc::tanh));
-	mParserContext->addFunction (createNamedFunction("acosh", 1, &sc::acosh));
-	mParserContext->addFunction (createNamedFunction("asinh", 1, &sc::asinh));
-	mParserContext->addFunction (createNamedFunction("atanh", 1, &sc::atanh));
-
-	mParserContext->addFunction (createNamedFunction("ln", 1, &sc::ln));
-
-	mParserContext->addFunction (createNamedFunction("abs", 1, &sc::abs));
+	mParserContext->addFunction (createNamedFunction("sin", &sc::sin, &::sin));
+	mParserContext->addFunction (createNamedFunction("cos", &sc::cos, &::cos));
+	mParserContext->addFunction (createNamedFunction("tan", &sc::tan, &::tan));
+	mParserContext->addFunction (createNamedFunction("round", &sc::round, &::round));
+	NamedFunctionPtr sqrt = createNamedFunction("sqrt", &sc::sqrt, &::sqrt, "√");
+	sqrt->setBuiltin (BF_SQRT);
+	mParserContext->addFunction (sqrt);
+
+	mParserContext->addFunction (createNamedFunction("acos", &sc::acos, &::acos));
+	mParserContext->addFunction (createNamedFunction("asin", &sc::asin, &::asin));
+	mParserContext->addFunction (createNamedFunction("atan", &sc::atan, &::atan));
+
+	mParserContext->addFunction (createNamedFunction("cosh", &sc::cosh, &::cosh));
+	mParserContext->addFunction (createNamedFunction("sinh", &sc::sinh, &::sinh));
+	mParserContext->addFunction (createNamedFunction("tanh", &sc::tanh, &::tanh));
+	mParserContext->addFunction (createNamedFunction("acosh", &sc::acosh, &::acosh));
+	mParserContext->addFunction (createNamedFunction("asinh", &sc::asinh, &::asinh));
+	mParserContext->addFunction (createNamedFunction("atanh", &sc::atanh, &::atanh));
+
+	mParserContext->addFunction (createNamedFunction("ln", &sc::ln, &::log));
+
+	mParserContext->addFunction (createNamedFunction("abs", &sc::abs, &::fabs));
+
+	// e.g. sum(k, 1, 100, k^2)
+	mParserContext->addFunction (createReductionFunction ("sum", RK_SUM));
+	mParserContext->addFunction (createReductionFunction ("prod", RK_PRODUCT));
+	mParserContext->addFunction (createReductionFunction ("min", RK_MIN));
+	mParserContext->addFunction (createReductionFunction ("max", RK_MAX));
 }
 
 void SmallCalc::addAllStandard () {
@@ -52,13 +64,65 @@ void SmallCalc::addAllStandard () {
 
 
 PrimitiveValue SmallCalc::eval (const std::string & input) {
-	mLastExpression = parse (input);
+	return eval (parse (input));
+}
+
+PrimitiveValue SmallCalc::eval (const ExpressionPtr & expression) {
+	mLastExpression = expression;
+	AllocationScope scope (AP_EVAL, &mStats);
+	TraceSpan span ("eval");
+	if (mLastExpression->kind() == EK_DEFINITION) {
+		const NamedFunctionPtr & function = static_cast<const FunctionDefinition&> (*mLastExpression).function();
+		NamedFunctionPtr former = mParserContext->findFunction (function->name());
+		if (former != function) {
+			mParserContext->addFunction (function);
+			// reactive variables follow the redefinition, as they follow variables
+			if (mEvaluationContext.dependencies && former && former->body() && former->arity() == function->arity()) {
+				mEvaluationContext.dependencies->redefine (former.get(), function, &mEvaluationContext);
+			}
+		}
+	}
 	return mLastExpression->eval(&mEvaluationContext);
 }
 
+void SmallCalc::setVariable (const VariableId & id, const PrimitiveValue & value) {
+	if (mEvaluationContext.dependencies) {
+		mDependencies.set (id, value, &mEvaluationContext);
+	} else {
+		mEvaluationContext.setVariable (id, value);
+	}
+}
+
+bool SmallCalc::setMemoization (const String & function, size_t capacity) {
+	NamedFunctionPtr f = mParserContext->findFunction (function);
+	return f && f->setMemoization (capacity);
+}
+
+void SmallCalc::setReactive (bool v) {
+	if (!v) mDependencies.clear();
+	mEvaluationContext.dependencies = v ? &mDependencies : 0;
+}
+
+MemoryUsage SmallCalc::memoryUsage () const {
+	MemoryCounter counter;
+	counter.add (*mParserContext);
+	counter.add (mVariableIdMapping);
+	counter.add (mEvaluationContext);
+	counter.add (mLastExpression);
+	for (VariableId id = 0; id < mDependencies.size(); id++) {
+		counter.add (mDependencies.definition (id));
+	}
+	return counter.usage();
+}
+
 ExpressionPtr SmallCalc::parse (const std::string & input) {
 	Tokenizer tokenizer;
-	Error e = tokenizer.tokenize(input);
+	Error e;
+	{
+		AllocationScope scope (AP_TOKENIZE, &mStats);
+		e = tokenizer.tokenize(input);
+	}
+	AllocationScope scope (AP_PARSE, &mStats);
 	if (e) {
 		return createError(e, tokenizer.errorMessage());
 	}
@@ -66,21 +130,28 @@ ExpressionPtr SmallCalc::parse (const std::string & input) {
 	return parser.parse (tokenizer.result());
 }
 
+static NamedFunctionPtr createBuiltinFunction (BuiltinFunction builtin, const std::string & name, int arity, const NamedFunction::EvaluationCallback & callback, FuncNotation notation, int precedence, bool associative, const String & printingName) {
+	NamedFunctionPtr result (new NamedFunction (name, arity, callback, notation, precedence, associative, printingName));
+	result->setBuiltin (builtin);
+	result->setPure (builtin != BF_ASSIGNMENT);
+	return result;
+}
+
 static ExpressionPtr createAssignmentExpression (const NamedFunctionPtr & func, const std::vector<ExpressionPtr> & arguments) {
 	assert (arguments.size() == 2);
 	return ExpressionPtr (new AssignmentExpression(arguments[0], arguments[1]));
 }
 
 void SmallCalc::addFundamentalFunctions () {
-	mParserContext->addFunction (NamedFunctionPtr(new NamedFunction ("add", -1, &sc::add, FN_INFIX, 2, true, "+")));
-	mParserContext->addFunction (NamedFunctionPtr(new NamedFunction ("multiply", -1, &sc::multiply, FN_INFIX, 3, true, "*")));
-	mParserContext->addFunction (NamedFunctionPtr(new NamedFunction ("subtract", 2, &sc::subtract, FN_INFIX, 2, false, "-")));
-	mParserContext->addFunction (NamedFunctionPtr(new NamedFunction ("divide", 2, &sc::divide, FN_INFIX, 3, false, "/")));
-	mParserContext->addFunction (NamedFunctionPtr(new NamedFunction ("negate", 1, &sc::negate, FN_PREFIX, 10, false, "-")));
-	mParserContext->addFunction (NamedFunctionPtr(new NamedFunction ("pow", 2, &sc::exponentation, FN_INFIX, 4, false, "^")));
+	mParserContext->addFunction (createBuiltinFunction (BF_ADD, "add", -1, &sc::add, FN_INFIX, 2, true, "+"));
+	mParserContext->addFunction (createBuiltinFunction (BF_MULTIPLY, "multiply", -1, &sc::multiply, FN_INFIX, 3, true, "*"));
+	mParserContext->addFunction (createBuiltinFunction (BF_SUBTRACT, "subtract", 2, &sc::subtract, FN_INFIX, 2, false, "-"));
+	mParserContext->addFunction (createBuiltinFunction (BF_DIVIDE, "divide", 2, &sc::divide, FN_INFIX, 3, false, "/"));
+	mParserContext->addFunction (createBuiltinFunction (BF_NEGATE, "negate", 1, &sc::negate, FN_PREFIX, 10, false, "-"));
+	mParserContext->addFunction (createBuiltinFunction (BF_POW, "pow", 2, &sc::exponentation, FN_INFIX, 4, false, "^"));
 
 	// Assignment is trickier
-	NamedFunctionPtr assignment  (new NamedFunction ("assignment", 2, 0, FN_INFIX, 1, false, "="));
+	NamedFunctionPtr assignment = createBuiltinFunction (BF_ASSIGNMENT, "assignment", 2, 0, FN_INFIX, 1, false, "=");
 	assignment->setCreateExpressionCallback(&createAssignmentExpression);
 	mParserContext->addFunction(assignment);
 }
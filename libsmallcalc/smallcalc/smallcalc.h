@@ -1,6 +1,10 @@
 #pragma once
 #include "types.h"
 #include "Expression.h"
+#include "AllocationStats.h"
+#include "FallbackStats.h"
+#include "MemoryUsage.h"
+#include "DependencyGraph.h"
 
 namespace sc {
 
@@ -14,20 +18,29 @@ public:
 	~SmallCalc ();
 	/// Add standard constans like pi or e
 	void addStandardConstants ();
-	/// Add standard functions like sin, cos, tan
+	/// Add standard functions like sin, cos, tan and the reductions sum, prod, min, max (see impl/Reduction.h)
 	void addStandardFunctions ();
 
 	/// Add all standard constants / functions
 	void addAllStandard ();
 
+	/// Parses and evaluates input. A function definition (e.g. f(x, y) = x^2 + y) registers
+	/// the function (replacing a former user defined one of the same name) and evaluates to null.
 	PrimitiveValue eval (const std::string & input);
 	ExpressionPtr parse (const std::string & input);
 
+	/// Evaluates an expression returned by parse() like eval(input), registering function definitions.
+	/// Use this instead of expression->eval() whenever the expression may be a definition.
+	PrimitiveValue eval (const ExpressionPtr & expression);
+
 	/// Returns variable id of a given variable
 	VariableId idOfVariable (const String & variableName) const { return mVariableIdMapping.variableIdFor(variableName); }
 
-	/// Sets a variable
-	void setVariable (const VariableId & id, const PrimitiveValue & value) { return mEvaluationContext.setVariable(id, value); }
+	/// Sets a variable (in reactive mode recalculating variables defined by it)
+	void setVariable (const VariableId & id, const PrimitiveValue & value);
+
+	/// Returns the context with the current variable values
+	const EvaluationContext & evaluationContext () const { return mEvaluationContext; }
 
 	/// Returns evaluation of last expression
 	const ExpressionPtr& lastExpression () const { return mLastExpression; }
@@ -35,8 +48,43 @@ public:
 	/// Returns parser context (I hope you know what you are doing!)
 	ParserContext * _parserContext () { return mParserContext; }
 
+	/// Allocations done by parse and eval of this calculator (only counted with SMALLCALC_ALLOCATION_STATS)
+	const AllocationStats & stats () const { return mStats; }
+
+	/// Clears the allocation statistics
+	void resetStats () { mStats.clear(); }
+
+	/// Accurate calculations of eval which fell back to double
+	const FallbackStats & fallbackStats () const { return mFallbackStats; }
+
+	/// Clears the fallback statistics
+	void resetFallbackStats () { mFallbackStats.clear(); }
+
+	/// Memory of registered functions and constants, variables, their definitions and the last expression
+	MemoryUsage memoryUsage () const;
+
 	/// Enables/Disables accurate level for calculation, default is disabled.
 	void setAccurateLevel (bool v = true) { mEvaluationContext.accurateLevel = v; }
+
+	/// Limits evaluation by budget (see Budget.h), 0 for no limits. Not owned.
+	/// Parse limits are in _parserContext().
+	void setBudget (EvaluationBudget * budget) { mEvaluationContext.budget = budget; }
+
+	/// Threads for reductions over large ranges (e.g. sum(k, 1, 10^7, 1/k)), 0 for one per core (default)
+	void setThreads (int threads) { mEvaluationContext.threads = threads; }
+
+	/// Caches up to capacity results of the pure function with the given name (e.g. "sin" or "add"),
+	/// 0 disables caching. Returns false if there is no such pure function. See MemoTable.h.
+	bool setMemoization (const String & function, size_t capacity);
+
+	/// Enables/Disables reactive mode, default is disabled.
+	/// In reactive mode assignments (e.g. b = a + 1) define variables like spreadsheet cells,
+	/// changing a variable recalculates all variables defined by it (see DependencyGraph.h).
+	/// Disabling keeps the current values but forgets the definitions.
+	void setReactive (bool v = true);
+
+	/// Definitions of variables in reactive mode
+	const DependencyGraph & dependencies () const { return mDependencies; }
 private:
 
 	/// inserts fundamental functions (they are always inserted!)
@@ -49,6 +97,9 @@ private:
 	ParserContext * mParserContext;
 	ExpressionPtr mLastExpression;
 	VariableIdMapping mVariableIdMapping;
+	AllocationStats mStats;
+	FallbackStats mFallbackStats;
+	DependencyGraph mDependencies;
 };
 
 /// Parses an expression
@@ -0,0 +1,102 @@
+#include "smallcalc_c.h"
+#include "smallcalc.h"
+#include <string.h>
+#include <limits>
+#include <algorithm>
+
+struct sc_env {
+	sc::SmallCalc calc;
+};
+
+struct sc_expr {
+	sc::ExpressionPtr expression;
+};
+
+static void toValue (const sc::PrimitiveValue & v, sc_value * result) {
+	result->type        = v.type();
+	result->d           = 0;
+	result->numerator   = 0;
+	result->denominator = 1;
+	result->error       = v.error();
+	switch (v.type()) {
+	case sc::PT_DOUBLE:
+		result->d = v.toDouble();
+		break;
+	case sc::PT_INT64:
+	case sc::PT_FRACTION: {
+		sc::Fraction64 fraction = v.toFraction();
+		result->numerator   = fraction.numerator();
+		result->denominator = fraction.denumerator();
+		result->d           = v.toDouble();
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+extern "C" {
+
+sc_env * sc_env_create (int accurate) {
+	sc_env * env = new sc_env ();
+	env->calc.addAllStandard();
+	env->calc.setAccurateLevel (accurate != 0);
+	return env;
+}
+
+void sc_env_free (sc_env * env) {
+	delete env;
+}
+
+int sc_variable_id (sc_env * env, const char * name) {
+	return env->calc.idOfVariable (name);
+}
+
+void sc_set_variable (sc_env * env, int id, double value) {
+	env->calc.setVariable (id, sc::doubleValue (value));
+}
+
+int sc_compile (sc_env * env, const char * input, sc_expr ** result) {
+	sc::ExpressionPtr expression = env->calc.parse (input);
+	sc::Error error = expression->error();
+	if (error) {
+		*result = 0;
+		return error;
+	}
+	if (expression->kind() == sc::EK_DEFINITION) {
+		env->calc.eval (expression); // following compiles can call the function
+	}
+	*result = new sc_expr ();
+	(*result)->expression = expression;
+	return sc::NoError;
+}
+
+void sc_expr_free (sc_expr * expr) {
+	delete expr;
+}
+
+double sc_eval_double (sc_env * env, const sc_expr * expr, int * error) {
+	sc::PrimitiveValue v = env->calc.eval (expr->expression);
+	if (error) *error = v.error();
+	if (v.type() == sc::PT_ERROR) return std::numeric_limits<double>::quiet_NaN();
+	return v.toDouble();
+}
+
+int sc_eval (sc_env * env, const sc_expr * expr, sc_value * result) {
+	sc::PrimitiveValue v = env->calc.eval (expr->expression);
+	toValue (v, result);
+	return v.error();
+}
+
+int sc_eval_string (sc_env * env, const char * input, char * output, size_t size) {
+	sc::PrimitiveValue v = env->calc.eval (input);
+	if (size > 0) {
+		sc::String s = v.toString();
+		size_t length = std::min (s.size(), size - 1);
+		memcpy (output, s.data(), length);
+		output[length] = 0;
+	}
+	return v.error();
+}
+
+}
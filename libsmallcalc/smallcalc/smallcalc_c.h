@@ -0,0 +1,77 @@
+#ifndef SMALLCALC_C_H
+#define SMALLCALC_C_H
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file
+ * Plain C interface to smallcalc, for FFI consumers.
+ *
+ * Expressions are compiled once into opaque handles and evaluated against an
+ * environment; variables are bound by id, so the evaluation path does no
+ * string conversion. An environment with its expressions must only be used
+ * by one thread at a time.
+ *
+ * Evaluation goes through the sc::SmallCalc of the environment, like its
+ * eval(): accurate to double fallbacks are counted and function definitions
+ * are registered. Budgets and reactive mode are not exposed here.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sc_env sc_env;
+typedef struct sc_expr sc_expr;
+
+/** Type of a sc_value, same order as sc::PrimitiveValueType */
+enum sc_value_type {
+	SC_NULL = 0,
+	SC_DOUBLE,
+	SC_INT64,
+	SC_FRACTION,
+	SC_ERROR
+};
+
+/** Tagged result of an evaluation */
+typedef struct sc_value {
+	int type;            /**< sc_value_type */
+	double d;            /**< Value as double, 0 for errors */
+	int64_t numerator;   /**< SC_INT64 and SC_FRACTION */
+	int64_t denominator; /**< SC_FRACTION, 1 for SC_INT64 */
+	int error;           /**< Error code (sc::Error), 0 if no error */
+} sc_value;
+
+/** Creates an environment with standard functions and constants. accurate != 0 calculates with fractions where possible */
+sc_env * sc_env_create (int accurate);
+void sc_env_free (sc_env * env);
+
+/** Returns the id of a variable name */
+int sc_variable_id (sc_env * env, const char * name);
+/** Sets a variable to a double value */
+void sc_set_variable (sc_env * env, int id, double value);
+
+/**
+ * Compiles input. Returns 0 on success and sets *result, an error code otherwise.
+ * Compiling a function definition (f(x) = x^2) registers the function for following compiles,
+ * the definition itself evaluates to SC_NULL.
+ */
+int sc_compile (sc_env * env, const char * input, sc_expr ** result);
+void sc_expr_free (sc_expr * expr);
+
+/** Evaluates to a double, NaN on errors; error (optional) gets the error code */
+double sc_eval_double (sc_env * env, const sc_expr * expr, int * error);
+/** Evaluates to a tagged value, returns the error code */
+int sc_eval (sc_env * env, const sc_expr * expr, sc_value * result);
+
+/**
+ * Parses and evaluates input in one go, writing the result like the calculator prints it
+ * (truncated to size, always terminated). Returns the error code.
+ */
+int sc_eval_string (sc_env * env, const char * input, char * output, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,8 +1,13 @@
 #ifdef ANDROID
 
 #include "smallcalc.h"
+#include "ColumnEvaluator.h"
+#include "smallcalc_c.h"
 #include "de_cgvis_moscalc_SmallCalc.h"
 #include <string>
+#include <vector>
+#include <limits>
+#include <math.h>
 
 inline std::string toCppString (JNIEnv * env, jstring string) {
 	const char * bytes = env->GetStringUTFChars(string, 0);
@@ -12,21 +17,179 @@ inline std::string toCppString (JNIEnv * env, jstring string) {
 }
 
 static sc::SmallCalc smallcalc;
-bool first = false;
+static bool first = true;
 
-
-JNIEXPORT jstring JNICALL Java_de_cgvis_moscalc_SmallCalc_calc
-  (JNIEnv * env, jclass instance, jstring arg) {
-
-	if (!first) {
+/// Returns the global calculator, initialized on first use
+static sc::SmallCalc & calculator () {
+	if (first) {
 		smallcalc.addAllStandard();
 		smallcalc.setAccurateLevel(true);
+		first = false;
 	}
+	return smallcalc;
+}
+
+/// A parsed formula for evaluation over arrays, see parseFormula
+struct JniFormula {
+	sc::ExpressionPtr expression;
+	sc::VariableId variable;
+	sc::ColumnEvaluator columns;
+	bool compiled; ///< columns is usable (only needs variable)
+	sc::EvaluationContext context; ///< used if not compiled, other variables from the global calculator
+};
 
+/// Evaluates formula on count x values into y. Does not call back into the JVM. Returns number of errors.
+static int evaluateFormula (JniFormula * formula, const double * x, double * y, size_t count) {
+	if (formula->compiled) {
+		formula->columns.bind (formula->variable, x);
+		size_t errors = 0;
+		formula->columns.evaluate (count, y, 0, &errors);
+		return (int) errors;
+	}
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	int errors = 0;
+	formula->context = calculator().evaluationContext();
+	formula->context.accurateLevel = false;
+	for (size_t i = 0; i < count; i++) {
+		formula->context.setVariable (formula->variable, sc::doubleValue (x[i]));
+		sc::PrimitiveValue v = formula->expression->eval (&formula->context);
+		double d = v.type() == sc::PT_ERROR ? nan : v.toDouble();
+		// non finite results are errors, like in ColumnEvaluator
+		if (!isfinite (d)) {
+			y[i] = nan;
+			errors++;
+		} else {
+			y[i] = d;
+		}
+	}
+	return errors;
+}
+
+JNIEXPORT jstring JNICALL Java_de_cgvis_moscalc_SmallCalc_calc
+  (JNIEnv * env, jclass instance, jstring arg) {
 	std::string input  = toCppString(env, arg);
-	std::string output = smallcalc.eval(input).toString();
+	std::string output = calculator().eval(input).toString();
 	return env->NewStringUTF(output.c_str());
 }
 
+JNIEXPORT jobjectArray JNICALL Java_de_cgvis_moscalc_SmallCalc_calcAll
+  (JNIEnv * env, jclass instance, jobjectArray args) {
+	sc::SmallCalc & calc = calculator();
+	jsize count = env->GetArrayLength(args);
+	jobjectArray result = env->NewObjectArray(count, env->FindClass("java/lang/String"), 0);
+	if (!result) return 0; // OutOfMemoryError pending
+	for (jsize i = 0; i < count; i++) {
+		jstring arg = (jstring) env->GetObjectArrayElement(args, i);
+		std::string output = arg ? calc.eval(toCppString(env, arg)).toString() : std::string ();
+		jstring value = env->NewStringUTF(output.c_str());
+		env->SetObjectArrayElement(result, i, value);
+		// don't run out of local references on big arrays
+		env->DeleteLocalRef(value);
+		if (arg) env->DeleteLocalRef(arg);
+	}
+	return result;
+}
+
+JNIEXPORT jlong JNICALL Java_de_cgvis_moscalc_SmallCalc_parseFormula
+  (JNIEnv * env, jclass instance, jstring formula, jstring variable) {
+	sc::SmallCalc & calc = calculator();
+	JniFormula * result = new JniFormula ();
+	result->expression = calc.parse(toCppString(env, formula));
+	if (result->expression->kind() == sc::EK_DEFINITION) {
+		calc.eval(result->expression); // registers the function for following formulas, evaluates to null
+	}
+	result->variable   = calc.idOfVariable(toCppString(env, variable));
+	result->compiled   = result->columns.compile(result->expression) == sc::NoError;
+	const std::vector<sc::VariableId> & needed = result->columns.variables();
+	if (needed.size() > 1 || (needed.size() == 1 && needed[0] != result->variable)) {
+		result->compiled = false; // other variables come from the context
+	}
+	return (jlong) (intptr_t) result;
+}
+
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_releaseFormula
+  (JNIEnv * env, jclass instance, jlong handle) {
+	delete (JniFormula*) (intptr_t) handle;
+}
+
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_evalArray
+  (JNIEnv * env, jclass instance, jlong handle, jdoubleArray xs, jdoubleArray ys) {
+	JniFormula * formula = (JniFormula*) (intptr_t) handle;
+	jsize count = env->GetArrayLength(xs);
+	if (!formula || env->GetArrayLength(ys) < count) return -1;
+	// No JNI calls allowed between Get/ReleasePrimitiveArrayCritical
+	double * x = (double*) env->GetPrimitiveArrayCritical(xs, 0);
+	if (!x) return -1;
+	double * y = (double*) env->GetPrimitiveArrayCritical(ys, 0);
+	if (!y) {
+		env->ReleasePrimitiveArrayCritical(xs, x, JNI_ABORT);
+		return -1;
+	}
+	int errors = evaluateFormula(formula, x, y, count);
+	env->ReleasePrimitiveArrayCritical(ys, y, 0);
+	env->ReleasePrimitiveArrayCritical(xs, x, JNI_ABORT);
+	return errors;
+}
+
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_evalBuffer
+  (JNIEnv * env, jclass instance, jlong handle, jobject xs, jobject ys, jint count) {
+	JniFormula * formula = (JniFormula*) (intptr_t) handle;
+	const double * x = (const double*) env->GetDirectBufferAddress(xs);
+	double * y = (double*) env->GetDirectBufferAddress(ys);
+	if (!formula || !x || !y || count < 0) return -1;
+	if (env->GetDirectBufferCapacity(xs) < (jlong) (count * sizeof(double))
+			|| env->GetDirectBufferCapacity(ys) < (jlong) (count * sizeof(double))) return -1;
+	return evaluateFormula(formula, x, y, count);
+}
+
+// Handle based interface, wrapping smallcalc_c.h
+
+JNIEXPORT jlong JNICALL Java_de_cgvis_moscalc_SmallCalc_createEnv
+  (JNIEnv * env, jclass instance, jboolean accurate) {
+	return (jlong) (intptr_t) sc_env_create(accurate);
+}
+
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_freeEnv
+  (JNIEnv * env, jclass instance, jlong handle) {
+	sc_env_free((sc_env*) (intptr_t) handle);
+}
+
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_variableId
+  (JNIEnv * env, jclass instance, jlong handle, jstring name) {
+	return sc_variable_id((sc_env*) (intptr_t) handle, toCppString(env, name).c_str());
+}
+
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_setVariable
+  (JNIEnv * env, jclass instance, jlong handle, jint id, jdouble value) {
+	sc_set_variable((sc_env*) (intptr_t) handle, id, value);
+}
+
+JNIEXPORT jlong JNICALL Java_de_cgvis_moscalc_SmallCalc_compile
+  (JNIEnv * env, jclass instance, jlong handle, jstring input) {
+	sc_expr * result = 0;
+	sc_compile((sc_env*) (intptr_t) handle, toCppString(env, input).c_str(), &result);
+	return (jlong) (intptr_t) result;
+}
+
+JNIEXPORT void JNICALL Java_de_cgvis_moscalc_SmallCalc_freeExpression
+  (JNIEnv * env, jclass instance, jlong expression) {
+	sc_expr_free((sc_expr*) (intptr_t) expression);
+}
+
+JNIEXPORT jdouble JNICALL Java_de_cgvis_moscalc_SmallCalc_evalDouble
+  (JNIEnv * env, jclass instance, jlong handle, jlong expression) {
+	return sc_eval_double((sc_env*) (intptr_t) handle, (const sc_expr*) (intptr_t) expression, 0);
+}
+
+JNIEXPORT jint JNICALL Java_de_cgvis_moscalc_SmallCalc_evalValue
+  (JNIEnv * env, jclass instance, jlong handle, jlong expression, jlongArray parts) {
+	sc_value value;
+	sc_eval((sc_env*) (intptr_t) handle, (const sc_expr*) (intptr_t) expression, &value);
+	if (parts && env->GetArrayLength(parts) >= 3) {
+		jlong out[3] = { value.numerator, value.denominator, value.error };
+		env->SetLongArrayRegion(parts, 0, 3, out);
+	}
+	return value.type;
+}
 
 #endif
@@ -2,6 +2,16 @@
 
 namespace sc {
 
+uint64_t hashString (const String & s) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (String::const_iterator i = s.begin(); i != s.end(); i++) {
+		hash ^= (unsigned char) *i;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
 VariableId VariableIdMapping::variableIdFor (const String & name) const {
 	VariableNameMap::const_iterator i = variableIds.find(name);
 	if (i == variableIds.end()) {
@@ -21,6 +21,14 @@ template <class Key, class Type> shared_ptr<Type> findValuePtr(const unordered_m
 	return shared_ptr<Type> (i->second);
 }
 
+/// Combines a hash value into seed
+inline uint64_t hashCombine (uint64_t seed, uint64_t value) {
+	return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+/// Hash of a string, stable on all platforms
+uint64_t hashString (const String & s);
+
 /// Variable names
 typedef int VariableId;
 
@@ -53,6 +61,10 @@ namespace error {
 		Eval_UnboundVariable,		///< Cannot evaluate variable; its unbound
 		Eval_DivisionByZero,		///< Division by Zero error
 
+		Parser_LimitExceeded,		///< More tokens or deeper nesting than the ParserContext allows
+		Eval_BudgetExhausted,		///< Evaluation ran out of its EvaluationBudget (steps, deadline or cancelled)
+		Eval_CyclicDependency,		///< Definition would make a variable depend on itself (see DependencyGraph)
+
 	};
 }
 typedef error::Error Error;
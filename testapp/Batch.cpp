@@ -0,0 +1,281 @@
+#include "Batch.h"
+#include <smallcalc/Trace.h>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/foreach.hpp>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace testapp {
+
+bool parseOutputFormat (const std::string & name, OutputFormat * format) {
+	if (name == "plain")    { *format = OF_PLAIN;    return true; }
+	if (name == "fraction") { *format = OF_FRACTION; return true; }
+	if (name == "decimal")  { *format = OF_DECIMAL;  return true; }
+	return false;
+}
+
+void appendResult (const sc::PrimitiveValue & value, OutputFormat format, std::string & output) {
+	if (format == OF_DECIMAL && value.type() == sc::PT_FRACTION) {
+		bool exact = false;
+		std::string dec = value.toFraction().toDecimal (&exact);
+		if (exact) {
+			output += dec;
+		} else {
+			output += "~";
+			output += dec;
+			output += "...";
+		}
+		return;
+	}
+	output += value.toString();
+}
+
+InputBuffer::InputBuffer () : mBegin (0), mEnd (0), mMapped (0), mMappedSize (0) {
+}
+
+InputBuffer::~InputBuffer () {
+#ifndef WIN32
+	if (mMapped) munmap (mMapped, mMappedSize);
+#endif
+}
+
+bool InputBuffer::open (const std::string & name) {
+	FILE * file = stdin;
+	if (name != "-") {
+#ifndef WIN32
+		int fd = ::open (name.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0) {
+			void * mapped = mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapped != MAP_FAILED) {
+				madvise (mapped, st.st_size, MADV_SEQUENTIAL);
+				close (fd);
+				mMapped     = mapped;
+				mMappedSize = st.st_size;
+				mBegin      = static_cast<const char*> (mapped);
+				mEnd        = mBegin + mMappedSize;
+				return true;
+			}
+		}
+		close (fd);
+#endif
+		file = fopen (name.c_str(), "rb");
+		if (!file) return false;
+	}
+	// Not mappable (stdin, pipes, empty files): read everything
+	char buffer[65536];
+	size_t read;
+	while ((read = fread (buffer, 1, sizeof (buffer), file)) > 0) {
+		mData.append (buffer, read);
+	}
+	bool ok = !ferror (file);
+	if (file != stdin) fclose (file);
+	mBegin = mData.data();
+	mEnd   = mBegin + mData.size();
+	return ok;
+}
+
+void LineLimits::start (sc::EvaluationBudget * budget) const {
+	budget->reset ();
+	budget->setMaxSteps (maxSteps);
+	budget->setDeadline (timeoutMs > 0 ? sc::monotonicNs() + (uint64_t) (timeoutMs * 1e6) : 0);
+}
+
+LineEvaluator::LineEvaluator (OutputFormat format, const LineLimits & limits) : mLimits (limits), mFormat (format) {
+	mCalc.addAllStandard();
+	mContext.accurateLevel = format != OF_PLAIN;
+	mContext.fallbacks = &mFallbacks;
+	if (limits.enabled()) mContext.budget = &mBudget;
+}
+
+bool LineEvaluator::evaluate (const char * begin, const char * end, std::string & output) {
+	if (end > begin && *(end - 1) == '\r') end--;
+	mLine.assign (begin, end);
+	sc::ExpressionPtr exp = mCalc.parse (mLine);
+	sc::PrimitiveValue value;
+	if (exp->kind() == sc::EK_DEFINITION) {
+		// Would be lost with the line, like assigned values
+		value = sc::PrimitiveValue (sc::error::NotSupported, "Function definitions are not kept between batch lines");
+	} else {
+		if (mContext.budget) mLimits.start (&mBudget);
+		value = exp->eval (&mContext);
+	}
+	// Lines are independent, forget assigned values (also of assignments nested in the line)
+	mContext.variables.assign (mContext.variables.size(), sc::PrimitiveValue());
+	if (value.error() == sc::error::Parser_NoTokens) {
+		return true; // empty line, stays empty
+	}
+	appendResult (value, mFormat, output);
+	return !value.error();
+}
+
+namespace {
+
+/// Some lines of the input and their results
+struct Chunk {
+	Chunk () : begin (0), end (0), lines (0), errors (0) {}
+	const char * begin;
+	const char * end;
+	std::string output;
+	size_t lines;
+	size_t errors;
+};
+typedef boost::shared_ptr<Chunk> ChunkPtr;
+
+/// Hands out chunks to workers and collects them in input order
+class BatchScheduler {
+public:
+	BatchScheduler (const InputBuffer & input, const BatchOptions & options, int threads) :
+		mPosition (input.begin()), mEnd (input.end()), mOptions (options),
+		mNextIndex (0), mNextWrite (0), mMaxInFlight (threads * 4), mLines (0), mErrors (0) {}
+
+	/// Worker loop
+	void work () {
+		LineEvaluator evaluator (mOptions.format, mOptions.limits);
+		size_t index = 0;
+		ChunkPtr chunk;
+		while ((chunk = nextChunk (&index))) {
+			// A chunk has one line more than newlines, the last (maybe empty) one ends at chunk->end
+			const char * line = chunk->begin;
+			while (true) {
+				const char * lineEnd = static_cast<const char*> (memchr (line, '\n', chunk->end - line));
+				if (!lineEnd) lineEnd = chunk->end;
+				if (!evaluator.evaluate (line, lineEnd, chunk->output)) chunk->errors++;
+				chunk->output += '\n';
+				chunk->lines++;
+				if (lineEnd == chunk->end) break;
+				line = lineEnd + 1;
+			}
+			finished (index, chunk);
+		}
+		boost::lock_guard<boost::mutex> lock (mMutex);
+		mFallbacks += evaluator.fallbackStats();
+	}
+
+	/// Writes finished chunks in order until everything is done
+	void write (FILE * output) {
+		while (true) {
+			ChunkPtr chunk;
+			{
+				boost::unique_lock<boost::mutex> lock (mMutex);
+				while (mReady.find (mNextWrite) == mReady.end()) {
+					if (mPosition >= mEnd && mNextWrite == mNextIndex) return;
+					mWriterCondition.wait (lock);
+				}
+				std::map<size_t, ChunkPtr>::iterator i = mReady.find (mNextWrite);
+				chunk = i->second;
+				mReady.erase (i);
+			}
+			fwrite (chunk->output.data(), 1, chunk->output.size(), output);
+			mLines  += chunk->lines;
+			mErrors += chunk->errors;
+			{
+				boost::lock_guard<boost::mutex> lock (mMutex);
+				mNextWrite++;
+			}
+			mWorkerCondition.notify_all();
+		}
+	}
+
+	size_t lines () const { return mLines; }
+	size_t errors () const { return mErrors; }
+	/// Fallbacks of all workers, complete after they are joined
+	const sc::FallbackStats & fallbacks () const { return mFallbacks; }
+
+private:
+	ChunkPtr nextChunk (size_t * index) {
+		boost::unique_lock<boost::mutex> lock (mMutex);
+		// Bound memory: do not run too far ahead of the writer
+		while (mPosition < mEnd && mNextIndex - mNextWrite >= mMaxInFlight) {
+			mWorkerCondition.wait (lock);
+		}
+		if (mPosition >= mEnd) return ChunkPtr();
+		ChunkPtr chunk (new Chunk ());
+		chunk->begin = mPosition;
+		// Whole lines: up to the newline ending the line with the last byte, which may be that newline itself
+		const char * last = mPosition + std::max ((size_t) 1, std::min (mOptions.chunkBytes, (size_t) (mEnd - mPosition))) - 1;
+		const char * lineEnd = static_cast<const char*> (memchr (last, '\n', mEnd - last));
+		chunk->end = lineEnd ? lineEnd : mEnd;
+		mPosition  = lineEnd ? lineEnd + 1 : mEnd;
+		*index = mNextIndex++;
+		return chunk;
+	}
+
+	void finished (size_t index, const ChunkPtr & chunk) {
+		{
+			boost::lock_guard<boost::mutex> lock (mMutex);
+			mReady[index] = chunk;
+		}
+		mWriterCondition.notify_one();
+	}
+
+	const char * mPosition;
+	const char * mEnd;
+	const BatchOptions & mOptions;
+	size_t mNextIndex;
+	size_t mNextWrite;
+	size_t mMaxInFlight;
+	std::map<size_t, ChunkPtr> mReady;
+	boost::mutex mMutex;
+	boost::condition_variable mWorkerCondition;
+	boost::condition_variable mWriterCondition;
+	size_t mLines;
+	size_t mErrors;
+	sc::FallbackStats mFallbacks;
+};
+
+}
+
+int runBatch (const BatchOptions & options) {
+	InputBuffer input;
+	if (!input.open (options.input)) {
+		std::cerr << "Could not read " << options.input << std::endl;
+		return 1;
+	}
+	int threads = options.threads;
+	if (threads <= 0) threads = boost::thread::hardware_concurrency();
+	if (threads <= 0) threads = 1;
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	BatchScheduler scheduler (input, options, threads);
+	boost::thread_group workers;
+	for (int i = 0; i < threads; i++) {
+		workers.create_thread (boost::bind (&BatchScheduler::work, &scheduler));
+	}
+	scheduler.write (stdout);
+	workers.join_all();
+	fflush (stdout);
+	double seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+
+	if (options.summary) {
+		std::cerr << scheduler.lines() << " lines, " << scheduler.errors() << " errors, "
+				<< threads << " threads, " << seconds << "s, "
+				<< (seconds > 0 ? scheduler.lines() / seconds : 0.0) << " lines/s";
+		if (options.format != OF_PLAIN) {
+			std::cerr << ", " << scheduler.fallbacks().total() << " accurate fallbacks";
+		}
+		std::cerr << std::endl;
+	}
+	if (!options.fallbackStats.empty()) {
+		std::ofstream out (options.fallbackStats.c_str());
+		out << scheduler.fallbacks().toJson() << std::endl;
+		if (!out) {
+			std::cerr << "Could not write " << options.fallbackStats << std::endl;
+			return 1;
+		}
+	}
+	return scheduler.errors() ? 2 : 0;
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/Budget.h>
+#include <string>
+#include <stddef.h>
+
+/**
+ * @file
+ * Batch mode of the testapp: evaluates one formula per input line.
+ */
+
+namespace testapp {
+
+/// How results are written
+enum OutputFormat {
+	OF_PLAIN,    ///< Calculate with doubles
+	OF_FRACTION, ///< Calculate accurate, print fractions like 1/3
+	OF_DECIMAL   ///< Calculate accurate, print fractions as decimals
+};
+
+/// Parses a format name, returns false if unknown
+bool parseOutputFormat (const std::string & name, OutputFormat * format);
+
+/// Appends a result in the given format
+void appendResult (const sc::PrimitiveValue & value, OutputFormat format, std::string & output);
+
+/// Limits for evaluating one line of untrusted input, 0 for no limit
+struct LineLimits {
+	LineLimits () : maxSteps (0), timeoutMs (0) {}
+	uint64_t maxSteps;  ///< Evaluation steps, see sc::EvaluationBudget
+	double timeoutMs;   ///< Evaluation time
+
+	bool enabled () const { return maxSteps > 0 || timeoutMs > 0; }
+
+	/// Prepares budget for evaluating the next line
+	void start (sc::EvaluationBudget * budget) const;
+};
+
+/// Evaluates single lines independently of each other (NOT threadsafe)
+class LineEvaluator {
+public:
+	LineEvaluator (OutputFormat format, const LineLimits & limits = LineLimits ());
+
+	/// Evaluates [begin, end) and appends the result (without newline). Returns false on evaluation errors.
+	bool evaluate (const char * begin, const char * end, std::string & output);
+
+	/// Accurate calculations which fell back to double so far
+	const sc::FallbackStats & fallbackStats () const { return mFallbacks; }
+
+private:
+	sc::SmallCalc mCalc;
+	sc::EvaluationContext mContext;
+	sc::FallbackStats mFallbacks;
+	sc::EvaluationBudget mBudget;
+	LineLimits mLimits;
+	OutputFormat mFormat;
+	std::string mLine;
+};
+
+struct BatchOptions {
+	BatchOptions () : input ("-"), format (OF_FRACTION), threads (0), chunkBytes (256 * 1024), summary (true) {}
+	std::string input;   ///< File name, "-" for stdin
+	OutputFormat format;
+	int threads;         ///< Worker count, 0 for one per core
+	size_t chunkBytes;   ///< Approximate input size of one work unit
+	bool summary;        ///< Print a summary to stderr
+	std::string fallbackStats; ///< Write accurate to double fallback statistics as JSON to this file, if set
+	LineLimits limits;   ///< Limits of each line
+};
+
+/// Input of the batch mode, memory mapped if possible
+class InputBuffer {
+public:
+	InputBuffer ();
+	~InputBuffer ();
+
+	/// Opens a file ("-" for stdin). Returns false on error
+	bool open (const std::string & name);
+
+	const char * begin () const { return mBegin; }
+	const char * end () const { return mEnd; }
+private:
+	const char * mBegin;
+	const char * mEnd;
+	void * mMapped;
+	size_t mMappedSize;
+	std::string mData; ///< used if the input cannot be mapped
+	// forbidden
+	InputBuffer (const InputBuffer&);
+	void operator= (const InputBuffer&);
+};
+
+/**
+ * Evaluates every line of the input and writes results to stdout, in input order.
+ *
+ * Lines are evaluated independently of each other (assignments are not
+ * visible in other lines) on a pool of workers, each with its own SmallCalc.
+ * Function definitions (f(x) = x^2) are reported as errors for the same reason.
+ * Returns the exit code of the program.
+ */
+int runBatch (const BatchOptions & options);
+
+}
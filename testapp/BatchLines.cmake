@@ -0,0 +1,67 @@
+# Checks that batch mode writes exactly one output line per input line, also with
+# empty lines at chunk boundaries, that lines don't see each others variables and
+# that function definitions are reported as errors.
+# Called by ctest with TESTAPP and WORK set.
+set (lines "")
+foreach (i RANGE 1 200)
+	math (EXPR m "${i} % 7")
+	if (m EQUAL 0 OR m EQUAL 3)
+		set (lines "${lines}\n")
+	elseif (m EQUAL 5)
+		set (lines "${lines}x = ${i}\n")
+	else ()
+		set (lines "${lines}${i}/3\n")
+	endif ()
+endforeach ()
+file (WRITE "${WORK}/batch_lines.txt" "${lines}")
+file (WRITE "${WORK}/batch_lines_open.txt" "${lines}\n1+1")
+set (nested "")
+foreach (i RANGE 1 30)
+	set (nested "${nested}1 + (a = 2)\na\na*3\n")
+endforeach ()
+file (WRITE "${WORK}/batch_nested.txt" "${nested}")
+
+foreach (input "batch_lines.txt" "batch_lines_open.txt" "batch_nested.txt")
+	set (whole "")
+	foreach (chunk 1000000 1 2 3 5 8 13)
+		execute_process (
+			COMMAND "${TESTAPP}" --batch "${WORK}/${input}" --threads 3 --chunk-bytes ${chunk}
+			OUTPUT_VARIABLE output ERROR_QUIET RESULT_VARIABLE result)
+		set (expectedResult 0)
+		if (input STREQUAL "batch_nested.txt")
+			set (expectedResult 2) # a is unbound in the other lines
+		endif ()
+		if (NOT result EQUAL expectedResult)
+			message (FATAL_ERROR "${input} with chunks of ${chunk} bytes: exit code ${result}")
+		endif ()
+		if (chunk EQUAL 1000000)
+			set (whole "${output}")
+			string (REGEX MATCHALL "\n" newlines "${output}")
+			list (LENGTH newlines count)
+			set (expected 200)
+			if (input STREQUAL "batch_lines_open.txt")
+				set (expected 202)
+			elseif (input STREQUAL "batch_nested.txt")
+				set (expected 90)
+				string (REGEX MATCHALL "not bound" unbound "${output}")
+				list (LENGTH unbound unboundCount)
+				if (NOT unboundCount EQUAL 60)
+					message (FATAL_ERROR "${input}: ${unboundCount} lines with unbound a, expected 60")
+				endif ()
+			endif ()
+			if (NOT count EQUAL expected)
+				message (FATAL_ERROR "${input}: ${count} output lines, expected ${expected}")
+			endif ()
+		elseif (NOT output STREQUAL whole)
+			message (FATAL_ERROR "${input} with chunks of ${chunk} bytes differs from a single chunk")
+		endif ()
+	endforeach ()
+endforeach ()
+
+file (WRITE "${WORK}/batch_definition.txt" "f(x) = x^2\nf(3)\n")
+execute_process (
+	COMMAND "${TESTAPP}" --batch "${WORK}/batch_definition.txt"
+	OUTPUT_VARIABLE output ERROR_QUIET RESULT_VARIABLE result)
+if (NOT result EQUAL 2 OR NOT output MATCHES "^Err: [0-9]+ Function definitions are not kept")
+	message (FATAL_ERROR "batch_definition.txt: exit code ${result}, output ${output}")
+endif ()
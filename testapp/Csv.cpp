@@ -0,0 +1,277 @@
+#include "Csv.h"
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/ColumnEvaluator.h>
+#include <smallcalc/impl/Parser.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/unordered_map.hpp>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace testapp {
+
+namespace {
+
+typedef std::pair<const char*, const char*> Field;
+
+/// Splits a line (without line break) into fields, quotes are removed
+void splitFields (const char * begin, const char * end, std::vector<Field> & fields) {
+	fields.clear();
+	const char * p = begin;
+	while (true) {
+		const char * fieldBegin = p;
+		const char * fieldEnd;
+		if (p < end && *p == '"') {
+			fieldBegin = ++p;
+			while (p < end && !(*p == '"' && (p + 1 == end || p[1] != '"'))) {
+				p += (*p == '"') ? 2 : 1; // "" is an escaped quote
+			}
+			fieldEnd = p;
+			if (p < end) p++;
+			while (p < end && *p != ',') p++;
+		} else {
+			while (p < end && *p != ',') p++;
+			fieldEnd = p;
+		}
+		fields.push_back (Field (fieldBegin, fieldEnd));
+		if (p == end) break;
+		p++; // ','
+	}
+}
+
+/// Parses a whole field as double, returns false if it is no number
+bool parseNumber (const Field & field, double * value) {
+	char buffer[64];
+	size_t length = field.second - field.first;
+	if (length == 0 || length >= sizeof (buffer)) return false;
+	memcpy (buffer, field.first, length);
+	buffer[length] = 0;
+	char * end = 0;
+	*value = strtod (buffer, &end);
+	while (*end == ' ' || *end == '\t') end++;
+	return end != buffer && *end == 0;
+}
+
+/// Strips a trailing '\r'
+const char * lineEnd (const char * begin, const char * end) {
+	if (end > begin && end[-1] == '\r') return end - 1;
+	return end;
+}
+
+/// Reads a file in big blocks and hands out complete lines
+class LineReader {
+public:
+	LineReader (FILE * file, size_t bufferBytes) : mFile (file), mBuffer (bufferBytes), mBegin (0), mEnd (0), mEof (false) {}
+
+	/**
+	 * Makes the next complete lines available in [begin, end), each line ending with '\n'
+	 * (but the last line of the file). Returns false at the end of input.
+	 */
+	bool next (const char ** begin, const char ** end) {
+		// move remainder to the front
+		memmove (&mBuffer[0], &mBuffer[0] + mBegin, mEnd - mBegin);
+		mEnd -= mBegin;
+		mBegin = 0;
+		while (true) {
+			if (mEof) {
+				if (mEnd == 0) return false;
+				*begin = &mBuffer[0];
+				*end   = &mBuffer[0] + mEnd;
+				mBegin = mEnd;
+				return true;
+			}
+			if (mEnd == mBuffer.size()) {
+				mBuffer.resize (mBuffer.size() * 2); // line longer than buffer
+			}
+			size_t got = fread (&mBuffer[0] + mEnd, 1, mBuffer.size() - mEnd, mFile);
+			if (got == 0) {
+				mEof = true;
+				continue;
+			}
+			size_t searchFrom = mEnd;
+			mEnd += got;
+			const char * data = &mBuffer[0];
+			const char * last = 0;
+			for (const char * p = data + mEnd; p > data + searchFrom; p--) {
+				if (p[-1] == '\n') {
+					last = p;
+					break;
+				}
+			}
+			if (last) {
+				*begin = data;
+				*end   = last;
+				mBegin = last - data;
+				return true;
+			}
+		}
+	}
+private:
+	FILE * mFile;
+	std::vector<char> mBuffer;
+	size_t mBegin;  ///< Start of remaining data
+	size_t mEnd;    ///< End of data
+	bool mEof;
+};
+
+/// Evaluates chunks of rows and writes them out
+class CsvProcessor {
+public:
+	CsvProcessor (const CsvOptions & options) : mOptions (options), mRows (0), mErrors (0) {
+		mCalc.addAllStandard();
+	}
+
+	/// Prepares the expression for a header line, returns false on error
+	bool init (const char * begin, const char * end) {
+		sc::ExpressionPtr expression = mCalc.parse (mOptions.expression);
+		sc::Error error = mEvaluator.compile (expression);
+		if (error) {
+			std::cerr << "Cannot compile " << mOptions.expression << " (error " << error << ")" << std::endl;
+			return false;
+		}
+		end = lineEnd (begin, end);
+		splitFields (begin, end, mFields);
+		boost::unordered_map<sc::VariableId, size_t> columnOfVariable;
+		for (size_t i = 0; i < mFields.size(); i++) {
+			sc::String name (mFields[i].first, mFields[i].second);
+			columnOfVariable[mCalc.idOfVariable (name)] = i;
+		}
+		const std::vector<sc::VariableId> & variables = mEvaluator.variables();
+		mColumnIndex.resize (variables.size());
+		mColumns.resize (variables.size());
+		for (size_t i = 0; i < variables.size(); i++) {
+			boost::unordered_map<sc::VariableId, size_t>::const_iterator j = columnOfVariable.find (variables[i]);
+			if (j == columnOfVariable.end()) {
+				std::cerr << "No column for variable " << mCalc._parserContext()->variableMapping->variableNames[variables[i]] << std::endl;
+				return false;
+			}
+			mColumnIndex[i] = j->second;
+			mColumns[i].resize (mOptions.chunkRows);
+			mEvaluator.bind (variables[i], &mColumns[i][0]);
+		}
+		mResults.resize (mOptions.chunkRows);
+		mMask.resize (mOptions.chunkRows);
+		mInvalid.resize (mOptions.chunkRows);
+		mLines.reserve (mOptions.chunkRows);
+		mOutput.assign (begin, end);
+		mOutput += ",";
+		mOutput += mOptions.column;
+		mOutput += "\n";
+		fwrite (mOutput.data(), 1, mOutput.size(), stdout);
+		return true;
+	}
+
+	/// Processes complete lines
+	void process (const char * begin, const char * end) {
+		const char * p = begin;
+		while (p < end) {
+			mLines.clear();
+			while (p < end && mLines.size() < mOptions.chunkRows) {
+				const char * nl = (const char*) memchr (p, '\n', end - p);
+				const char * lineStop = nl ? nl : end;
+				mLines.push_back (Field (p, lineEnd (p, lineStop)));
+				p = nl ? nl + 1 : end;
+			}
+			processChunk ();
+		}
+	}
+
+	size_t rows () const { return mRows; }
+	size_t errors () const { return mErrors; }
+private:
+	void processChunk () {
+		size_t count = mLines.size();
+		for (size_t r = 0; r < count; r++) {
+			mInvalid[r] = 0;
+			if (mColumnIndex.empty()) continue;
+			splitFields (mLines[r].first, mLines[r].second, mFields);
+			for (size_t c = 0; c < mColumnIndex.size(); c++) {
+				double value = 0;
+				if (mColumnIndex[c] >= mFields.size() || !parseNumber (mFields[mColumnIndex[c]], &value)) {
+					mInvalid[r] = 1;
+				}
+				mColumns[c][r] = value;
+			}
+		}
+		if (mEvaluator.evaluate (count, &mResults[0], &mMask[0])) {
+			// the rows are not (completely) written, they would show results of the previous chunk
+			std::fill (mMask.begin(), mMask.begin() + count, 1);
+		}
+		mOutput.clear();
+		char buffer[32];
+		for (size_t r = 0; r < count; r++) {
+			mOutput.append (mLines[r].first, mLines[r].second);
+			mOutput += ",";
+			if (mInvalid[r] || mMask[r]) {
+				mErrors++;
+			} else {
+				mOutput.append (buffer, snprintf (buffer, sizeof (buffer), "%.17g", mResults[r]));
+			}
+			mOutput += "\n";
+		}
+		fwrite (mOutput.data(), 1, mOutput.size(), stdout);
+		mRows += count;
+	}
+
+	const CsvOptions & mOptions;
+	sc::SmallCalc mCalc;
+	sc::ColumnEvaluator mEvaluator;
+	std::vector<size_t> mColumnIndex;          ///< CSV column per evaluator variable
+	std::vector<std::vector<double> > mColumns; ///< Parsed values per evaluator variable
+	std::vector<double> mResults;
+	std::vector<uint8_t> mMask;
+	std::vector<uint8_t> mInvalid;             ///< Rows with unparseable input
+	std::vector<Field> mLines;
+	std::vector<Field> mFields;
+	std::string mOutput;
+	size_t mRows;
+	size_t mErrors;
+};
+
+}
+
+int runCsv (const CsvOptions & options) {
+	FILE * file = stdin;
+	if (options.input != "-") {
+		file = fopen (options.input.c_str(), "rb");
+		if (!file) {
+			std::cerr << "Could not read " << options.input << std::endl;
+			return 1;
+		}
+	}
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	LineReader reader (file, options.bufferBytes);
+	CsvProcessor processor (options);
+	const char * begin;
+	const char * end;
+	int result = 0;
+	if (!reader.next (&begin, &end)) {
+		std::cerr << "Missing header line" << std::endl;
+		result = 1;
+	} else {
+		const char * nl = (const char*) memchr (begin, '\n', end - begin);
+		const char * headerEnd = nl ? nl : end;
+		if (!processor.init (begin, headerEnd)) {
+			result = 1;
+		} else {
+			if (nl) processor.process (nl + 1, end);
+			while (reader.next (&begin, &end)) {
+				processor.process (begin, end);
+			}
+		}
+	}
+	if (file != stdin) fclose (file);
+	fflush (stdout);
+	if (result) return result;
+	double seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+	if (options.summary) {
+		std::cerr << processor.rows() << " rows, " << processor.errors() << " errors, " << seconds << "s, "
+				<< (seconds > 0 ? processor.rows() / seconds : 0.0) << " rows/s" << std::endl;
+	}
+	return processor.errors() ? 2 : 0;
+}
+
+}
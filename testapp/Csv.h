@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <stddef.h>
+
+/**
+ * @file
+ * CSV mode of the testapp: evaluates one formula over all rows of a CSV file.
+ */
+
+namespace testapp {
+
+struct CsvOptions {
+	CsvOptions () : input ("-"), column ("result"), chunkRows (4096), bufferBytes (1024 * 1024), summary (true) {}
+	std::string input;      ///< File name, "-" for stdin
+	std::string expression; ///< Formula, variables are named like the header columns
+	std::string column;     ///< Name of the appended output column
+	size_t chunkRows;       ///< Rows evaluated at once
+	size_t bufferBytes;     ///< Initial size of the read buffer (grows only for longer lines)
+	bool summary;           ///< Print a summary to stderr
+};
+
+/**
+ * Streams a CSV file with a header line through the formula.
+ *
+ * Every input row is written to stdout with the formula result appended as
+ * a new column. Only the columns used by the formula are parsed (as doubles),
+ * chunk by chunk, so memory stays bounded for any input size.
+ * Rows with non numeric values or evaluation errors get an empty result.
+ *
+ * Quoted fields are supported, but not line breaks inside of them.
+ * Returns the exit code of the program.
+ */
+int runCsv (const CsvOptions & options);
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+namespace testapp {
+
+/**
+ * Histogram of latencies in microseconds with bounded relative error.
+ *
+ * Values below 64 get their own bucket, bigger values are put into
+ * 32 buckets per power of two (about 3% error).
+ */
+class LatencyHistogram {
+public:
+	LatencyHistogram () : mBuckets (BucketCount, 0), mCount (0), mSum (0), mMax (0) {}
+
+	void record (uint64_t micros) {
+		mBuckets[bucketOf (micros)]++;
+		mCount++;
+		mSum += micros;
+		if (micros > mMax) mMax = micros;
+	}
+
+	void merge (const LatencyHistogram & other) {
+		for (size_t i = 0; i < mBuckets.size(); i++) {
+			mBuckets[i] += other.mBuckets[i];
+		}
+		mCount += other.mCount;
+		mSum   += other.mSum;
+		if (other.mMax > mMax) mMax = other.mMax;
+	}
+
+	/// Value below which the given share (0..1) of all recorded values are
+	uint64_t percentile (double share) const {
+		if (!mCount) return 0;
+		uint64_t rank = (uint64_t) (share * mCount);
+		if (rank >= mCount) rank = mCount - 1;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < mBuckets.size(); i++) {
+			seen += mBuckets[i];
+			if (seen > rank) {
+				uint64_t value = upperBoundOf (i);
+				return value < mMax ? value : mMax;
+			}
+		}
+		return mMax;
+	}
+
+	uint64_t count () const { return mCount; }
+	uint64_t max () const { return mMax; }
+	double average () const { return mCount ? (double) mSum / mCount : 0.0; }
+
+private:
+	enum { Linear = 64, SubBuckets = 32, SubBucketBits = 5, BucketCount = Linear + 64 * SubBuckets };
+
+	static size_t bucketOf (uint64_t v) {
+		if (v < Linear) return v;
+		int msb = 63;
+		while (!(v & (1ULL << msb))) msb--;
+		size_t sub = (v >> (msb - SubBucketBits)) & (SubBuckets - 1);
+		return Linear + (msb - 6) * SubBuckets + sub;
+	}
+
+	static uint64_t upperBoundOf (size_t bucket) {
+		if (bucket < Linear) return bucket;
+		size_t msb = (bucket - Linear) / SubBuckets + 6;
+		size_t sub = (bucket - Linear) % SubBuckets;
+		return (1ULL << msb) + ((sub + 1) << (msb - SubBucketBits)) - 1;
+	}
+
+	std::vector<uint64_t> mBuckets;
+	uint64_t mCount;
+	uint64_t mSum;
+	uint64_t mMax;
+};
+
+}
@@ -0,0 +1,46 @@
+#include "Plot.h"
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/Tabulate.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+
+namespace testapp {
+
+int runPlot (const PlotOptions & options) {
+	sc::SmallCalc calc;
+	calc.addAllStandard();
+	sc::ExpressionPtr expression = calc.parse (options.expression);
+	if (expression->error()) {
+		std::cerr << "Cannot parse " << options.expression << std::endl;
+		return 1;
+	}
+	sc::VariableId variable = calc.idOfVariable (options.variable);
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	std::vector<double> y (options.samples);
+	std::vector<uint8_t> errors (options.samples);
+	size_t errorCount = 0;
+	if (options.samples > 0) {
+		errorCount = sc::tabulate (expression, variable, options.from, options.to, options.samples, &y[0], &errors[0], options.threads);
+	}
+	double seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+
+	for (size_t i = 0; i < options.samples; i++) {
+		double x = sc::tabulationX (options.from, options.to, i, options.samples);
+		if (errors[i]) {
+			printf ("%.17g nan\n", x);
+		} else {
+			printf ("%.17g %.17g\n", x, y[i]);
+		}
+	}
+	fflush (stdout);
+	if (options.summary) {
+		std::cerr << options.samples << " samples, " << errorCount << " errors, " << seconds << "s, "
+				<< (seconds > 0 ? options.samples / seconds : 0.0) << " samples/s" << std::endl;
+	}
+	return 0;
+}
+
+}
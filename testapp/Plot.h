@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <stddef.h>
+
+/**
+ * @file
+ * Plot mode of the testapp: writes (x, y) samples of a formula.
+ */
+
+namespace testapp {
+
+struct PlotOptions {
+	PlotOptions () : variable ("x"), from (-10), to (10), samples (1000), threads (0), summary (true) {}
+	std::string expression;
+	std::string variable;   ///< Variable which is sampled
+	double from, to;        ///< Range, both included
+	size_t samples;
+	int threads;            ///< Worker count, 0 for one per core
+	bool summary;           ///< Print a summary to stderr
+};
+
+/**
+ * Writes one line "x y" per sample to stdout, ready for gnuplot.
+ * Samples with errors are written as "x nan".
+ * Returns the exit code of the program.
+ */
+int runPlot (const PlotOptions & options);
+
+}
@@ -0,0 +1,584 @@
+#include "Server.h"
+#include "LatencyHistogram.h"
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <iostream>
+#include <deque>
+#include <map>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#endif
+
+namespace testapp {
+
+#ifdef __linux__
+
+namespace {
+
+/// Monotonic time in microseconds
+uint64_t nowMicros () {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// Opens a unix domain socket address, returns false if the path is too long
+bool socketAddress (const std::string & path, struct sockaddr_un * address) {
+	memset (address, 0, sizeof (*address));
+	address->sun_family = AF_UNIX;
+	if (path.size() >= sizeof (address->sun_path)) return false;
+	strcpy (address->sun_path, path.c_str());
+	return true;
+}
+
+struct Request {
+	std::string line;
+	uint64_t received; ///< nowMicros() when read
+};
+
+/// A client connection with its session
+struct Connection {
+	Connection (int _fd, OutputFormat format, const LineLimits & _limits) : fd (_fd), evaluatorFormat (format), limits (_limits), scheduled (false), closing (false), readInterest (true), writeInterest (false) {
+		calc.addAllStandard();
+		calc.setAccurateLevel (format != OF_PLAIN);
+		if (limits.enabled()) calc.setBudget (&budget);
+	}
+
+	int fd;                        ///< -1 if closed; event loop only
+	std::string input;             ///< unfinished request line; event loop only
+	sc::SmallCalc calc;            ///< session; only used by the worker which scheduled the connection
+	OutputFormat evaluatorFormat;
+	LineLimits limits;
+	sc::EvaluationBudget budget;   ///< of the current request, if limits are enabled
+
+	boost::mutex mutex;            ///< guards the following
+	std::deque<Request> pending;   ///< requests to evaluate
+	std::string output;            ///< responses to write
+	bool scheduled;                ///< in the work queue or being worked on
+	bool closing;                  ///< close after all responses are written
+	bool readInterest;             ///< registered for EPOLLIN; event loop only
+	bool writeInterest;            ///< registered for EPOLLOUT; event loop only
+
+	/// If no more requests shall be read until the worker and the client caught up; needs mutex
+	bool backlogged () const { return pending.size() >= MaxPendingRequests || output.size() >= MaxOutputBytes; }
+
+	/// Limits of buffered requests and responses, a client pipelining without reading must not grow the server
+	enum { MaxPendingRequests = 4096, MaxOutputBytes = 1024 * 1024 };
+};
+typedef boost::shared_ptr<Connection> ConnectionPtr;
+
+int gWakeFd = -1;
+volatile sig_atomic_t gStop = 0;
+
+void onSignal (int) {
+	gStop = 1;
+	uint64_t one = 1;
+	ssize_t ignored = write (gWakeFd, &one, sizeof (one));
+	(void) ignored;
+}
+
+class Server {
+public:
+	Server (const ServerOptions & options) : mOptions (options), mListenFd (-1), mEpollFd (-1), mStop (false), mStart (nowMicros()) {}
+
+	int run () {
+		if (!listen()) return 1;
+		int threads = mOptions.threads;
+		if (threads <= 0) threads = boost::thread::hardware_concurrency();
+		if (threads <= 0) threads = 1;
+		boost::thread_group workers;
+		for (int i = 0; i < threads; i++) {
+			workers.create_thread (boost::bind (&Server::work, this));
+		}
+		std::cerr << "Serving on " << mOptions.path << " with " << threads << " workers" << std::endl;
+		eventLoop ();
+		{
+			boost::lock_guard<boost::mutex> lock (mQueueMutex);
+			mStop = true;
+		}
+		mQueueCondition.notify_all();
+		workers.join_all();
+		for (std::map<int, ConnectionPtr>::iterator i = mConnections.begin(); i != mConnections.end(); i++) {
+			close (i->first);
+		}
+		close (mListenFd);
+		close (mEpollFd);
+		close (gWakeFd);
+		unlink (mOptions.path.c_str());
+		std::cerr << statsLine () << std::endl;
+		return 0;
+	}
+
+private:
+	bool listen () {
+		struct sockaddr_un address;
+		if (!socketAddress (mOptions.path, &address)) {
+			std::cerr << "Socket path too long: " << mOptions.path << std::endl;
+			return false;
+		}
+		mListenFd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		unlink (mOptions.path.c_str());
+		if (mListenFd < 0 || bind (mListenFd, (struct sockaddr*) &address, sizeof (address)) != 0 || ::listen (mListenFd, 128) != 0) {
+			std::cerr << "Could not listen on " << mOptions.path << ": " << strerror (errno) << std::endl;
+			return false;
+		}
+		mEpollFd = epoll_create1 (EPOLL_CLOEXEC);
+		gWakeFd  = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+		addToEpoll (mListenFd, EPOLLIN);
+		addToEpoll (gWakeFd, EPOLLIN);
+		signal (SIGINT, onSignal);
+		signal (SIGTERM, onSignal);
+		signal (SIGPIPE, SIG_IGN);
+		return true;
+	}
+
+	void addToEpoll (int fd, uint32_t events) {
+		struct epoll_event ev;
+		memset (&ev, 0, sizeof (ev));
+		ev.events  = events;
+		ev.data.fd = fd;
+		epoll_ctl (mEpollFd, EPOLL_CTL_ADD, fd, &ev);
+	}
+
+	void eventLoop () {
+		const int maxEvents = 64;
+		struct epoll_event events[maxEvents];
+		while (!gStop) {
+			int n = epoll_wait (mEpollFd, events, maxEvents, -1);
+			if (n < 0) {
+				if (errno == EINTR) continue;
+				break;
+			}
+			for (int i = 0; i < n; i++) {
+				int fd = events[i].data.fd;
+				if (fd == mListenFd) {
+					accept ();
+				} else if (fd == gWakeFd) {
+					uint64_t value;
+					while (read (gWakeFd, &value, sizeof (value)) > 0) {}
+					flushAnswered ();
+				} else {
+					std::map<int, ConnectionPtr>::iterator c = mConnections.find (fd);
+					if (c == mConnections.end()) continue;
+					ConnectionPtr connection = c->second;
+					if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+						closeConnection (connection);
+						continue;
+					}
+					if (events[i].events & EPOLLIN) readRequests (connection);
+					if (connection->fd >= 0 && (events[i].events & EPOLLOUT)) flush (connection);
+				}
+			}
+		}
+	}
+
+	void accept () {
+		while (true) {
+			int fd = accept4 (mListenFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) return;
+			mConnections[fd] = ConnectionPtr (new Connection (fd, mOptions.format, mOptions.limits));
+			addToEpoll (fd, EPOLLIN | EPOLLRDHUP);
+		}
+	}
+
+	void readRequests (const ConnectionPtr & connection) {
+		char buffer[16384];
+		bool eof = false;
+		std::deque<Request> requests;
+		uint64_t now = nowMicros();
+		size_t pending = 0;
+		{
+			boost::lock_guard<boost::mutex> lock (connection->mutex);
+			pending = connection->backlogged() ? (size_t) Connection::MaxPendingRequests : connection->pending.size();
+		}
+		// The rest stays in the socket until the backlog drained (see updateEvents)
+		while (pending + requests.size() < Connection::MaxPendingRequests) {
+			ssize_t got = read (connection->fd, buffer, sizeof (buffer));
+			if (got == 0) { eof = true; break; }
+			if (got < 0) {
+				if (errno == EINTR) continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK) eof = true;
+				break;
+			}
+			const char * begin = buffer;
+			const char * end   = buffer + got;
+			while (begin < end) {
+				const char * lineEnd = static_cast<const char*> (memchr (begin, '\n', end - begin));
+				if (!lineEnd) {
+					connection->input.append (begin, end);
+					break;
+				}
+				Request request;
+				request.line.swap (connection->input);
+				request.line.append (begin, lineEnd);
+				if (!request.line.empty() && request.line[request.line.size() - 1] == '\r') request.line.resize (request.line.size() - 1);
+				request.received = now;
+				requests.push_back (request);
+				begin = lineEnd + 1;
+			}
+			if (connection->input.size() > MaxLineLength) {
+				// Not our protocol
+				closeConnection (connection);
+				return;
+			}
+		}
+		bool schedule = false;
+		bool backlogged = false;
+		{
+			boost::lock_guard<boost::mutex> lock (connection->mutex);
+			connection->pending.insert (connection->pending.end(), requests.begin(), requests.end());
+			if (eof) connection->closing = true;
+			if (!connection->scheduled && !connection->pending.empty()) {
+				connection->scheduled = true;
+				schedule = true;
+			}
+			backlogged = connection->backlogged();
+		}
+		if (!eof) updateEvents (connection, !backlogged, connection->writeInterest);
+		if (schedule) {
+			{
+				boost::lock_guard<boost::mutex> lock (mQueueMutex);
+				mQueue.push_back (connection);
+			}
+			mQueueCondition.notify_one();
+		}
+		if (eof) flush (connection);
+	}
+
+	/// Writes as much output as possible, closes the connection if done
+	void flush (const ConnectionPtr & connection) {
+		if (connection->fd < 0) return;
+		bool done = false;
+		bool remaining = false;
+		bool backlogged = false;
+		{
+			boost::lock_guard<boost::mutex> lock (connection->mutex);
+			size_t written = 0;
+			while (written < connection->output.size()) {
+				ssize_t n = write (connection->fd, connection->output.data() + written, connection->output.size() - written);
+				if (n < 0) {
+					if (errno == EINTR) continue;
+					if (errno != EAGAIN && errno != EWOULDBLOCK) {
+						connection->output.clear();
+						written = 0;
+						connection->closing = true;
+					}
+					break;
+				}
+				written += n;
+			}
+			connection->output.erase (0, written);
+			remaining = !connection->output.empty();
+			done = connection->closing && !connection->scheduled && connection->pending.empty() && !remaining;
+			backlogged = connection->backlogged() || connection->closing;
+		}
+		if (done) {
+			closeConnection (connection);
+			return;
+		}
+		// reading resumes once the worker took the pending requests and the client read the responses
+		updateEvents (connection, !backlogged, remaining);
+	}
+
+	/// Registers the events the connection waits for, if they changed
+	void updateEvents (const ConnectionPtr & connection, bool read, bool write) {
+		if (connection->fd < 0 || (read == connection->readInterest && write == connection->writeInterest)) return;
+		struct epoll_event ev;
+		memset (&ev, 0, sizeof (ev));
+		// EPOLLRDHUP only while reading, it would be reported again and again otherwise
+		ev.events  = (read ? EPOLLIN | EPOLLRDHUP : 0) | (write ? EPOLLOUT : 0);
+		ev.data.fd = connection->fd;
+		epoll_ctl (mEpollFd, EPOLL_CTL_MOD, connection->fd, &ev);
+		connection->readInterest  = read;
+		connection->writeInterest = write;
+	}
+
+	void closeConnection (const ConnectionPtr & connection) {
+		if (connection->fd < 0) return;
+		epoll_ctl (mEpollFd, EPOLL_CTL_DEL, connection->fd, 0);
+		close (connection->fd);
+		mConnections.erase (connection->fd);
+		connection->fd = -1;
+		// A worker may still hold it; it just drops the responses
+		boost::lock_guard<boost::mutex> lock (connection->mutex);
+		connection->closing = true;
+		connection->pending.clear();
+	}
+
+	/// Flushes all connections which got new responses from workers
+	void flushAnswered () {
+		std::vector<ConnectionPtr> answered;
+		{
+			boost::lock_guard<boost::mutex> lock (mAnsweredMutex);
+			answered.swap (mAnswered);
+		}
+		for (std::vector<ConnectionPtr>::const_iterator i = answered.begin(); i != answered.end(); i++) {
+			flush (*i);
+		}
+	}
+
+	/// Worker loop: evaluates all pending requests of one connection at a time
+	void work () {
+		std::vector<uint64_t> latencies;
+		while (true) {
+			ConnectionPtr connection;
+			{
+				boost::unique_lock<boost::mutex> lock (mQueueMutex);
+				while (mQueue.empty() && !mStop) {
+					mQueueCondition.wait (lock);
+				}
+				if (mStop) return;
+				connection = mQueue.front();
+				mQueue.pop_front();
+			}
+			std::deque<Request> requests;
+			{
+				boost::lock_guard<boost::mutex> lock (connection->mutex);
+				requests.swap (connection->pending);
+			}
+			while (!requests.empty()) {
+				std::string output;
+				bool quit = false;
+				latencies.clear();
+				for (std::deque<Request>::const_iterator i = requests.begin(); i != requests.end() && !quit; i++) {
+					quit = answer (connection.get(), i->line, output);
+					output += '\n';
+					latencies.push_back (nowMicros() - i->received);
+				}
+				requests.clear();
+				{
+					boost::lock_guard<boost::mutex> lock (connection->mutex);
+					if (quit) {
+						connection->closing = true;
+						connection->pending.clear();
+					}
+					connection->output += output;
+					// Unscheduling together with publishing the output lets the event loop decide on closing
+					requests.swap (connection->pending);
+					if (requests.empty()) connection->scheduled = false;
+				}
+				recordLatencies (latencies);
+				{
+					boost::lock_guard<boost::mutex> lock (mAnsweredMutex);
+					mAnswered.push_back (connection);
+				}
+				uint64_t one = 1;
+				ssize_t ignored = write (gWakeFd, &one, sizeof (one));
+				(void) ignored;
+			}
+		}
+	}
+
+	/// Answers one request. Returns true if the connection shall be closed
+	bool answer (Connection * connection, const std::string & line, std::string & output) {
+		if (!line.empty() && line[0] == ':') {
+			if (line == ":stats") {
+				output += statsLine ();
+				return false;
+			}
+			if (line == ":quit") {
+				output += "bye";
+				return true;
+			}
+			output += "Err: unknown command " + line;
+			return false;
+		}
+		if (connection->limits.enabled()) connection->limits.start (&connection->budget);
+		sc::PrimitiveValue value = connection->calc.eval (line);
+		if (value.error() == sc::error::Parser_NoTokens) return false;
+		appendResult (value, connection->evaluatorFormat, output);
+		return false;
+	}
+
+	void recordLatencies (const std::vector<uint64_t> & latencies) {
+		boost::lock_guard<boost::mutex> lock (mStatsMutex);
+		for (std::vector<uint64_t>::const_iterator i = latencies.begin(); i != latencies.end(); i++) {
+			mLatencies.record (*i);
+		}
+	}
+
+	std::string statsLine () {
+		boost::lock_guard<boost::mutex> lock (mStatsMutex);
+		double seconds = (nowMicros() - mStart) / 1000000.0;
+		std::string result = "requests=" + boost::lexical_cast<std::string> (mLatencies.count());
+		result += " p50_us=" + boost::lexical_cast<std::string> (mLatencies.percentile (0.5));
+		result += " p99_us=" + boost::lexical_cast<std::string> (mLatencies.percentile (0.99));
+		result += " max_us=" + boost::lexical_cast<std::string> (mLatencies.max());
+		result += " throughput_rps=" + boost::lexical_cast<std::string> ((uint64_t) (seconds > 0 ? mLatencies.count() / seconds : 0));
+		return result;
+	}
+
+	enum { MaxLineLength = 1024 * 1024 };
+
+	ServerOptions mOptions;
+	int mListenFd;
+	int mEpollFd;
+	std::map<int, ConnectionPtr> mConnections; ///< event loop only
+
+	boost::mutex mQueueMutex;
+	boost::condition_variable mQueueCondition;
+	std::deque<ConnectionPtr> mQueue;
+	bool mStop;
+
+	boost::mutex mAnsweredMutex;
+	std::vector<ConnectionPtr> mAnswered;
+
+	boost::mutex mStatsMutex;
+	LatencyHistogram mLatencies;
+	uint64_t mStart;
+};
+
+/// One connection of the load generator
+class LoadConnection {
+public:
+	LoadConnection (const LoadOptions & options, int number) : mOptions (options), mNumber (number), mFd (-1), mFailed (false), mSeconds (0) {}
+	~LoadConnection () {
+		if (mFd >= 0) close (mFd);
+	}
+
+	void run () {
+		struct sockaddr_un address;
+		socketAddress (mOptions.path, &address);
+		mFd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (mFd < 0 || connect (mFd, (struct sockaddr*) &address, sizeof (address)) != 0) {
+			mFailed = true;
+			return;
+		}
+		uint64_t start = nowMicros();
+		std::deque<uint64_t> sent;
+		std::string input;
+		int next = 0;
+		int received = 0;
+		while (received < mOptions.requests) {
+			std::string requests;
+			while (next < mOptions.requests && (int) sent.size() < mOptions.pipeline) {
+				requests += request (next++);
+				requests += '\n';
+				sent.push_back (nowMicros());
+			}
+			if (!requests.empty() && !sendAll (requests)) {
+				mFailed = true;
+				return;
+			}
+			char buffer[16384];
+			ssize_t got = read (mFd, buffer, sizeof (buffer));
+			if (got <= 0) {
+				mFailed = true;
+				return;
+			}
+			uint64_t now = nowMicros();
+			for (ssize_t i = 0; i < got; i++) {
+				if (buffer[i] != '\n') continue;
+				mLatencies.record (now - sent.front());
+				sent.pop_front();
+				received++;
+			}
+		}
+		mSeconds = (nowMicros() - start) / 1000000.0;
+	}
+
+	/// Sends a command and returns its response line
+	std::string command (const std::string & line) {
+		if (mFd < 0 || !sendAll (line + "\n")) return std::string ();
+		std::string result;
+		char c;
+		while (read (mFd, &c, 1) == 1 && c != '\n') {
+			result += c;
+		}
+		return result;
+	}
+
+	bool failed () const { return mFailed; }
+	double seconds () const { return mSeconds; }
+	const LatencyHistogram & latencies () const { return mLatencies; }
+
+private:
+	/// Mix of assignments, session variables, fractions and functions
+	std::string request (int i) const {
+		std::string n = boost::lexical_cast<std::string> (i + mNumber);
+		switch (i % 4) {
+		case 0: return "x = " + n + "/7";
+		case 1: return "x * 3 + 1/" + n;
+		case 2: return "sqrt(" + n + ") + sin(x)";
+		default: return "(" + n + "+1)^2 / (x+1)";
+		}
+	}
+
+	bool sendAll (const std::string & data) {
+		size_t written = 0;
+		while (written < data.size()) {
+			ssize_t n = write (mFd, data.data() + written, data.size() - written);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			written += n;
+		}
+		return true;
+	}
+
+	const LoadOptions & mOptions;
+	int mNumber;
+	int mFd;
+	bool mFailed;
+	double mSeconds;
+	LatencyHistogram mLatencies;
+};
+
+}
+
+int runServer (const ServerOptions & options) {
+	Server server (options);
+	return server.run ();
+}
+
+int runLoadClient (const LoadOptions & options) {
+	signal (SIGPIPE, SIG_IGN);
+	std::vector<boost::shared_ptr<LoadConnection> > connections;
+	boost::thread_group threads;
+	uint64_t start = nowMicros();
+	for (int i = 0; i < options.connections; i++) {
+		connections.push_back (boost::shared_ptr<LoadConnection> (new LoadConnection (options, i)));
+		threads.create_thread (boost::bind (&LoadConnection::run, connections.back().get()));
+	}
+	threads.join_all();
+	double seconds = (nowMicros() - start) / 1000000.0;
+	LatencyHistogram latencies;
+	for (size_t i = 0; i < connections.size(); i++) {
+		if (connections[i]->failed()) {
+			std::cerr << "Connection " << i << " failed" << std::endl;
+			return 1;
+		}
+		latencies.merge (connections[i]->latencies());
+	}
+	std::cout << "client: requests=" << latencies.count() << " connections=" << options.connections
+			<< " pipeline=" << options.pipeline
+			<< " p50_us=" << latencies.percentile (0.5) << " p99_us=" << latencies.percentile (0.99)
+			<< " max_us=" << latencies.max()
+			<< " throughput_rps=" << (uint64_t) (seconds > 0 ? latencies.count() / seconds : 0) << std::endl;
+	std::cout << "server: " << connections[0]->command (":stats") << std::endl;
+	return 0;
+}
+
+#else
+
+int runServer (const ServerOptions & options) {
+	std::cerr << "Server mode is only supported on Linux" << std::endl;
+	return 1;
+}
+
+int runLoadClient (const LoadOptions & options) {
+	std::cerr << "Load client is only supported on Linux" << std::endl;
+	return 1;
+}
+
+#endif
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "Batch.h"
+#include <string>
+
+/**
+ * @file
+ * Server mode of the testapp and a load generator for it.
+ *
+ * Protocol: clients send one formula per line and get exactly one result
+ * line per request, in request order; requests can be pipelined. Every
+ * connection is a session, assigned variables stay until it is closed.
+ * While a connection has many requests pending or responses unread, the
+ * server stops reading from it until they drained.
+ * Lines starting with ':' are commands:
+ *  - ":stats" returns request count, p50/p99 latency and throughput
+ *  - ":quit" returns "bye" and closes the connection
+ */
+
+namespace testapp {
+
+struct ServerOptions {
+	ServerOptions () : format (OF_FRACTION), threads (0) {}
+	std::string path;    ///< Path of the unix domain socket
+	OutputFormat format;
+	int threads;         ///< Worker count, 0 for one per core
+	LineLimits limits;   ///< Limits of each request
+};
+
+/// Serves until SIGINT or SIGTERM. Returns the exit code of the program.
+int runServer (const ServerOptions & options);
+
+struct LoadOptions {
+	LoadOptions () : connections (4), requests (10000), pipeline (16) {}
+	std::string path;   ///< Path of the unix domain socket
+	int connections;    ///< Parallel connections, each with its own thread
+	int requests;       ///< Requests per connection
+	int pipeline;       ///< Maximum requests in flight per connection
+};
+
+/// Sends generated requests to a server and prints latency and throughput. Returns the exit code.
+int runLoadClient (const LoadOptions & options);
+
+}
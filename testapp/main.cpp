@@ -1,8 +1,26 @@
 #include <smallcalc/smallcalc.h>
 #include <smallcalc/print/print.h>
+#include <smallcalc/Trace.h>
 #include <iostream>
+#include <stdlib.h>
+#include "Batch.h"
+#include "Server.h"
+#include "Csv.h"
+#include "Plot.h"
 
-int main (int argc, char * argv[]) {
+static int usage (const char * name) {
+	std::cerr << "Usage: " << name << " [--batch [file|-] | --serve socket] [--format plain|fraction|decimal] [--threads n] [--fallback-stats file]" << std::endl;
+	std::cerr << "         [--max-steps n] [--timeout ms] limit the evaluation of each batch line or request" << std::endl;
+	std::cerr << "         [--chunk-bytes n] input bytes of a batch work unit" << std::endl;
+	std::cerr << "       " << name << " --load socket [--connections n] [--requests n] [--pipeline n]" << std::endl;
+	std::cerr << "       " << name << " --csv [file|-] --expr formula [--column name]" << std::endl;
+	std::cerr << "       " << name << " --plot formula [--var x] [--from a] [--to b] [--samples n] [--threads n]" << std::endl;
+	std::cerr << "Without --batch, --serve, --csv or --plot an interactive calculator is started" << std::endl;
+	std::cerr << "All modes accept --trace file to write Chrome trace events of the phases" << std::endl;
+	return 1;
+}
+
+static int interactive () {
 	sc::SmallCalc smallCalc;
 	smallCalc.addStandardConstants();
 	smallCalc.addStandardFunctions();
@@ -10,7 +28,7 @@ int main (int argc, char * argv[]) {
 	std::string line;
 	while (true) {
 		std::cout << "> ";
-		bool suc = std::getline (std::cin, line);
+		bool suc = static_cast<bool> (std::getline (std::cin, line));
 		if (!suc) break;
 		sc::PrimitiveValue val = smallCalc.eval (line);
 		if (val.error() == sc::error::Parser_NoTokens){
@@ -30,3 +48,98 @@ int main (int argc, char * argv[]) {
 	}
 	return 0;
 }
+
+/// Writes the recorded trace events on exit, if requested
+struct TraceOutput {
+	~TraceOutput () {
+		if (!file.empty() && !sc::writeTraceEvents (file)) {
+			std::cerr << "Could not write " << file << std::endl;
+		}
+	}
+	std::string file;
+};
+
+int main (int argc, char * argv[]) {
+	TraceOutput trace;
+	bool batch = false;
+	bool csv = false;
+	testapp::BatchOptions batchOptions;
+	testapp::ServerOptions serverOptions;
+	testapp::LoadOptions loadOptions;
+	testapp::CsvOptions csvOptions;
+	testapp::PlotOptions plotOptions;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--batch") {
+			batch = true;
+			if (i + 1 < argc && (argv[i + 1][0] != '-' || std::string (argv[i + 1]) == "-")) {
+				batchOptions.input = argv[++i];
+			}
+		} else if (arg == "--csv") {
+			csv = true;
+			if (i + 1 < argc && (argv[i + 1][0] != '-' || std::string (argv[i + 1]) == "-")) {
+				csvOptions.input = argv[++i];
+			}
+		} else if (arg == "--expr" && i + 1 < argc) {
+			csvOptions.expression = argv[++i];
+		} else if (arg == "--column" && i + 1 < argc) {
+			csvOptions.column = argv[++i];
+		} else if (arg == "--plot" && i + 1 < argc) {
+			plotOptions.expression = argv[++i];
+		} else if (arg == "--var" && i + 1 < argc) {
+			plotOptions.variable = argv[++i];
+		} else if (arg == "--from" && i + 1 < argc) {
+			plotOptions.from = atof (argv[++i]);
+		} else if (arg == "--to" && i + 1 < argc) {
+			plotOptions.to = atof (argv[++i]);
+		} else if (arg == "--samples" && i + 1 < argc) {
+			plotOptions.samples = strtoul (argv[++i], 0, 10);
+		} else if (arg == "--serve" && i + 1 < argc) {
+			serverOptions.path = argv[++i];
+		} else if (arg == "--load" && i + 1 < argc) {
+			loadOptions.path = argv[++i];
+		} else if (arg == "--format" && i + 1 < argc) {
+			if (!testapp::parseOutputFormat (argv[++i], &batchOptions.format)) return usage (argv[0]);
+			serverOptions.format = batchOptions.format;
+		} else if (arg == "--chunk-bytes" && i + 1 < argc) {
+			batchOptions.chunkBytes = strtoul (argv[++i], 0, 10);
+		} else if (arg == "--fallback-stats" && i + 1 < argc) {
+			batchOptions.fallbackStats = argv[++i];
+		} else if (arg == "--max-steps" && i + 1 < argc) {
+			batchOptions.limits.maxSteps = serverOptions.limits.maxSteps = strtoull (argv[++i], 0, 10);
+		} else if (arg == "--timeout" && i + 1 < argc) {
+			batchOptions.limits.timeoutMs = serverOptions.limits.timeoutMs = atof (argv[++i]);
+		} else if (arg == "--trace" && i + 1 < argc) {
+			trace.file = argv[++i];
+			sc::setTracingEnabled ();
+		} else if (arg == "--threads" && i + 1 < argc) {
+			batchOptions.threads = serverOptions.threads = plotOptions.threads = atoi (argv[++i]);
+		} else if (arg == "--connections" && i + 1 < argc) {
+			loadOptions.connections = atoi (argv[++i]);
+		} else if (arg == "--requests" && i + 1 < argc) {
+			loadOptions.requests = atoi (argv[++i]);
+		} else if (arg == "--pipeline" && i + 1 < argc) {
+			loadOptions.pipeline = atoi (argv[++i]);
+		} else {
+			return usage (argv[0]);
+		}
+	}
+	if (batch) {
+		return testapp::runBatch (batchOptions);
+	}
+	if (csv) {
+		if (csvOptions.expression.empty()) return usage (argv[0]);
+		return testapp::runCsv (csvOptions);
+	}
+	if (!plotOptions.expression.empty()) {
+		return testapp::runPlot (plotOptions);
+	}
+	if (!serverOptions.path.empty()) {
+		return testapp::runServer (serverOptions);
+	}
+	if (!loadOptions.path.empty()) {
+		if (loadOptions.connections <= 0 || loadOptions.requests <= 0 || loadOptions.pipeline <= 0) return usage (argv[0]);
+		return testapp::runLoadClient (loadOptions);
+	}
+	return interactive ();
+}
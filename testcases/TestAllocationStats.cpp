@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/AllocationStats.h>
+#include <smallcalc/print/print.h>
+
+using namespace sc;
+
+static size_t hookCalls = 0;
+static void countingHook (AllocationPhase phase, size_t bytes) {
+	hookCalls++;
+}
+
+TEST (TestAllocationStats, phases) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	calc.setAccurateLevel();
+	PrimitiveValue v = calc.eval ("1/3 + sin(2) * x");
+	const AllocationStats & stats = calc.stats();
+	if (!allocationStatsEnabled()) {
+		// compiled out, nothing is counted
+		EXPECT_EQ (0u, stats.totalAllocations());
+		EXPECT_EQ (0u, threadAllocationStats().totalAllocations());
+		return;
+	}
+	EXPECT_GT (stats.allocations[AP_TOKENIZE], 0u);
+	EXPECT_GT (stats.allocations[AP_PARSE], 0u);   // nodes
+	EXPECT_GT (stats.allocations[AP_EVAL], 0u);    // argument vectors, fraction and error values
+	EXPECT_EQ (0u, stats.allocations[AP_PRINT]);
+	EXPECT_EQ (stats.totalBytes(), stats.bytes[AP_TOKENIZE] + stats.bytes[AP_PARSE] + stats.bytes[AP_EVAL]);
+
+	// Evaluating a value node doesn't allocate
+	calc.resetStats();
+	calc.eval ("2");
+	EXPECT_EQ (0u, calc.stats().allocations[AP_EVAL]);
+
+	// Printing counts into the thread statistics
+	AllocationStats before = threadAllocationStats();
+	print (calc.parse ("1/3 + sin(2)"));
+	AllocationStats printed = threadAllocationStats() - before;
+	EXPECT_GT (printed.allocations[AP_PRINT], 0u);
+	EXPECT_STREQ ("print", allocationPhaseName (AP_PRINT));
+
+	// Replaced hook
+	hookCalls = 0;
+	setAllocationHook (&countingHook);
+	calc.resetStats();
+	calc.eval ("1+2");
+	setAllocationHook (0);
+	EXPECT_GT (hookCalls, 0u);
+	EXPECT_EQ (0u, calc.stats().totalAllocations());
+}
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/Budget.h>
+#include <smallcalc/Trace.h>
+#include <smallcalc/Tabulate.h>
+#include <smallcalc/ColumnEvaluator.h>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/impl/NamedFunction.h>
+#include <smallcalc/impl/Value.h>
+
+using namespace sc;
+
+TEST (TestBudget, unlimited) {
+	EvaluationBudget budget;
+	for (int i = 0; i < 10000; i++) {
+		ASSERT_TRUE (budget.consume());
+	}
+	EXPECT_EQ (10000u, budget.steps());
+	EXPECT_FALSE (budget.exhausted());
+	EXPECT_FALSE (budget.reason());
+}
+
+TEST (TestBudget, maxSteps) {
+	EvaluationBudget budget;
+	budget.setMaxSteps (10);
+	for (int i = 0; i < 10; i++) {
+		ASSERT_TRUE (budget.consume());
+	}
+	EXPECT_FALSE (budget.consume());
+	EXPECT_TRUE (budget.exhausted());
+	EXPECT_FALSE (budget.consume()); // stays exhausted
+	EXPECT_EQ (error::Eval_BudgetExhausted, budget.error().error());
+
+	budget.reset();
+	EXPECT_FALSE (budget.exhausted());
+	EXPECT_TRUE (budget.consume (10));
+	EXPECT_FALSE (budget.consume());
+}
+
+TEST (TestBudget, deadline) {
+	EvaluationBudget budget;
+	budget.setDeadline (monotonicNs() - 1);
+	bool ok = true;
+	for (int i = 0; i <= EvaluationBudget::CheckInterval && ok; i++) {
+		ok = budget.consume();
+	}
+	EXPECT_FALSE (ok);
+	EXPECT_STREQ ("deadline exceeded", budget.reason());
+
+	budget.reset();
+	budget.setTimeout (60 * 1000000000ULL);
+	EXPECT_TRUE (budget.consume (10 * EvaluationBudget::CheckInterval));
+}
+
+TEST (TestBudget, cancel) {
+	boost::atomic<bool> cancel (false);
+	EvaluationBudget budget;
+	budget.setCancelFlag (&cancel);
+	EXPECT_TRUE (budget.consume (EvaluationBudget::CheckInterval));
+	cancel = true;
+	EXPECT_FALSE (budget.consume (EvaluationBudget::CheckInterval));
+	EXPECT_STREQ ("cancelled", budget.reason());
+}
+
+TEST (TestBudget, sharedSteps) {
+	boost::atomic<uint64_t> steps (0);
+	EvaluationBudget a, b;
+	a.setMaxSteps (1000);
+	a.share (&steps, 2);
+	b = a;
+	bool ok = true;
+	for (int i = 0; i < 1000 && ok; i++) {
+		ok = a.consume() && b.consume();
+	}
+	EXPECT_FALSE (ok);
+	EXPECT_GT (steps.load(), 1000u);
+	EXPECT_LE (a.steps() + b.steps(), 1002u);
+}
+
+TEST (TestBudget, parallelReduction) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	ExpressionPtr exp = calc.parse ("sum(k, 1, 10000000, sin(k))");
+	EvaluationBudget budget;
+	budget.setMaxSteps (100000);
+	EvaluationContext context;
+	context.budget = &budget;
+	context.threads = 4;
+	EXPECT_EQ (error::Eval_BudgetExhausted, exp->eval (&context).error());
+	// the threads share the limit, together they don't run much longer than one would
+	EXPECT_LE (budget.steps(), 100000u + 4 * EvaluationBudget::CheckInterval);
+}
+
+TEST (TestBudget, evaluation) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	ExpressionPtr exp = calc.parse ("sin(1) + cos(2) * 3");
+	EvaluationContext context;
+	PrimitiveValue unlimited = exp->eval (&context);
+
+	EvaluationBudget budget;
+	budget.setMaxSteps (4); // 4 function nodes
+	context.budget = &budget;
+	EXPECT_EQ (unlimited, exp->eval (&context));
+	EXPECT_EQ (4u, budget.steps());
+	EXPECT_EQ (error::Eval_BudgetExhausted, exp->eval (&context).error());
+
+	budget.reset();
+	budget.setMaxSteps (2);
+	EXPECT_EQ (error::Eval_BudgetExhausted, exp->eval (&context).error());
+}
+
+TEST (TestBudget, deepEvaluation) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	NamedFunctionPtr sin = calc._parserContext()->findFunction ("sin");
+	ExpressionPtr exp (new Value (0.0));
+	for (int i = 0; i < 4 * MaxRecursionDepth; i++) {
+		exp = sin->createExpression (sin, exp);
+	}
+	EvaluationBudget budget;
+	budget.setMaxSteps (2 * MaxRecursionDepth);
+	EvaluationContext context;
+	context.budget = &budget;
+	EXPECT_EQ (error::Eval_BudgetExhausted, exp->eval (&context).error());
+	EXPECT_LE (budget.steps(), (uint64_t) 2 * MaxRecursionDepth + 1);
+}
+
+TEST (TestBudget, accuratePowerLoop) {
+	SmallCalc calc;
+	calc.setAccurateLevel();
+	// (-1)^n multiplies n times
+	EvaluationBudget budget;
+	budget.setMaxSteps (100000);
+	calc.setBudget (&budget);
+	PrimitiveValue v = calc.eval ("(-1)^1000000000000");
+	EXPECT_EQ (error::Eval_BudgetExhausted, v.error());
+	EXPECT_LE (budget.steps(), 100010u);
+
+	budget.reset();
+	EXPECT_EQ (PrimitiveValue ((int64_t) 1), calc.eval ("(-1)^1000"));
+}
+
+TEST (TestBudget, tabulateAndColumns) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	ExpressionPtr exp = calc.parse ("sin(x) * x");
+	VariableId x = calc.idOfVariable ("x");
+
+	EvaluationBudget budget;
+	budget.setMaxSteps (200); // two nodes per sample
+	EvaluationContext context;
+	context.budget = &budget;
+	std::vector<double> y (1000);
+	std::vector<uint8_t> errors (1000);
+	EXPECT_EQ (900u, tabulate (exp, x, 0, 1, 1000, &y[0], &errors[0], 1, &context));
+	EXPECT_EQ (0, errors[99]);
+	EXPECT_EQ (1, errors[100]);
+	EXPECT_GE (budget.steps(), 200u); // charged back by the thread
+	EXPECT_TRUE (budget.exhausted());
+	EXPECT_EQ (1000u, tabulate (exp, x, 0, 1, 1000, &y[0], &errors[0], 1, &context)); // reused budget stays exhausted
+	budget.reset();
+
+	ColumnEvaluator evaluator;
+	ASSERT_EQ (NoError, evaluator.compile (exp));
+	std::vector<double> input (1000, 0.5);
+	evaluator.bind (x, &input[0]);
+	evaluator.setBudget (&budget);
+	EXPECT_EQ (error::Eval_BudgetExhausted, evaluator.evaluate (1000, &y[0]));
+	budget.setMaxSteps (0);
+	budget.reset();
+	EXPECT_EQ (NoError, evaluator.evaluate (1000, &y[0]));
+}
+
+TEST (TestBudget, tabulateSharesSteps) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	ExpressionPtr exp = calc.parse ("sin(x) * x");
+	VariableId x = calc.idOfVariable ("x");
+
+	const int threads = 4;
+	const size_t n = threads * 8192;
+	const uint64_t maxSteps = 8192; // two nodes per sample
+	EvaluationBudget budget;
+	budget.setMaxSteps (maxSteps);
+	EvaluationContext context;
+	context.budget = &budget;
+	std::vector<double> y (n);
+	// the limit applies to all threads together, not to each of them
+	size_t errors = tabulate (exp, x, 0, 1, n, &y[0], 0, threads, &context);
+	EXPECT_GE (errors, n - (maxSteps + threads * EvaluationBudget::CheckInterval) / 2);
+	EXPECT_GE (budget.steps(), maxSteps);
+	EXPECT_TRUE (budget.exhausted());
+}
+
+TEST (TestBudget, parseLimits) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	calc._parserContext()->maxTokens = 5;
+	EXPECT_EQ (3, calc.eval ("1 + 2").toDouble());
+	EXPECT_EQ (error::Parser_LimitExceeded, calc.eval ("1 + 2 + 3 + 4").error());
+
+	calc._parserContext()->maxTokens = 0;
+	calc._parserContext()->maxDepth = 2;
+	EXPECT_EQ (1, calc.eval ("((1))").toDouble());
+	EXPECT_EQ (0, calc.eval ("sin(sin(0))").toDouble());
+	EXPECT_EQ (error::Parser_LimitExceeded, calc.eval ("(((1)))").error());
+	EXPECT_EQ (error::Parser_LimitExceeded, calc.eval ("sin(sin((0)))").error());
+	EXPECT_EQ (2, calc.eval ("(1)+(1)*((1))").toDouble());
+}
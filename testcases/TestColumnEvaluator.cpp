@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/ColumnEvaluator.h>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/impl/NamedFunction.h>
+#include <math.h>
+
+using namespace sc;
+
+static PrimitiveValue inverse (const NamedFunction::PrimitiveArgumentVector & args, const EvaluationContext *) {
+	if (args[0].toDouble() == 0) return errorValue (error::Eval_DivisionByZero, "zero");
+	return doubleValue (1.0 / args[0].toDouble());
+}
+
+class TestColumnEvaluator : public testing::Test {
+protected:
+	TestColumnEvaluator () {
+		calc.addAllStandard();
+	}
+
+	SmallCalc calc;
+};
+
+TEST_F (TestColumnEvaluator, matchesRowEvaluation) {
+	const char * expressions[] = { "a*b/(c+1)", "a+b+c", "-a^2 + sqrt(abs(b))", "sin(a)*cos(b) - 3/4", "a", "PI*2" };
+	VariableId a = calc.idOfVariable ("a");
+	VariableId b = calc.idOfVariable ("b");
+	VariableId c = calc.idOfVariable ("c");
+	const size_t count = 1000; // more than one block
+	std::vector<double> as (count), bs (count), cs (count);
+	for (size_t i = 0; i < count; i++) {
+		as[i] = i * 0.5 - 100;
+		bs[i] = i % 17;
+		cs[i] = (double) i / 3;
+	}
+	for (size_t e = 0; e < sizeof (expressions) / sizeof (expressions[0]); e++) {
+		ExpressionPtr exp = calc.parse (expressions[e]);
+		ColumnEvaluator evaluator;
+		ASSERT_EQ (NoError, evaluator.compile (exp)) << expressions[e];
+		evaluator.bind (a, &as[0]);
+		evaluator.bind (b, &bs[0]);
+		evaluator.bind (c, &cs[0]);
+		std::vector<double> output (count);
+		size_t errors = 1;
+		ASSERT_EQ (NoError, evaluator.evaluate (count, &output[0], 0, &errors));
+		EXPECT_EQ (0u, errors);
+		for (size_t i = 0; i < count; i++) {
+			EvaluationContext context;
+			context.setVariable (a, doubleValue (as[i]));
+			context.setVariable (b, doubleValue (bs[i]));
+			context.setVariable (c, doubleValue (cs[i]));
+			ASSERT_DOUBLE_EQ (exp->eval (&context).toDouble(), output[i]) << expressions[e] << " row " << i;
+		}
+	}
+}
+
+TEST_F (TestColumnEvaluator, variablesAndErrors) {
+	ColumnEvaluator evaluator;
+	EXPECT_EQ (error::NotSupported, evaluator.compile (calc.parse ("x = 3")));
+	EXPECT_EQ (error::Eval_InvalidOperation, evaluator.evaluate (0, 0));
+
+	ASSERT_EQ (NoError, evaluator.compile (calc.parse ("x * y + x")));
+	ASSERT_EQ (2u, evaluator.variables().size());
+	double x[3] = { 1, 2, 3 };
+	double output[3];
+	evaluator.bind (calc.idOfVariable ("x"), x);
+	EXPECT_EQ (error::Eval_UnboundVariable, evaluator.evaluate (3, output));
+
+	// A function without double implementation, returning errors
+	calc._parserContext()->addFunction (createNamedFunction ("inverse", 1, &inverse));
+	ASSERT_EQ (NoError, evaluator.compile (calc.parse ("inverse(x - 2) + 1")));
+	evaluator.bind (calc.idOfVariable ("x"), x);
+	uint8_t mask[3];
+	size_t errors = 0;
+	ASSERT_EQ (NoError, evaluator.evaluate (3, output, mask, &errors));
+	EXPECT_EQ (1u, errors);
+	EXPECT_EQ (0, output[0]);
+	EXPECT_TRUE (isnan (output[1]));
+	EXPECT_EQ (2, output[2]);
+	EXPECT_EQ (0, mask[0]);
+	EXPECT_EQ (1, mask[1]);
+	EXPECT_EQ (0, mask[2]);
+}
+
+TEST_F (TestColumnEvaluator, nonFiniteRows) {
+	ColumnEvaluator evaluator;
+	ExpressionPtr exp = calc.parse ("1 / (x - 2) + sqrt(x - 1)");
+	ASSERT_EQ (NoError, evaluator.compile (exp));
+	VariableId x = calc.idOfVariable ("x");
+	double input[4] = { 2, 0, 5, 3 };
+	double output[4];
+	uint8_t mask[4];
+	size_t errors = 0;
+	evaluator.bind (x, input);
+	ASSERT_EQ (NoError, evaluator.evaluate (4, output, mask, &errors));
+	EXPECT_EQ (2u, errors);
+	// division by zero, the (accurate) tree path reports an error as well
+	EvaluationContext context;
+	context.accurateLevel = true;
+	context.setVariable (x, PrimitiveValue ((int64_t) 2));
+	EXPECT_EQ (error::Eval_DivisionByZero, exp->eval (&context).error());
+	EXPECT_TRUE (isnan (output[0]));
+	EXPECT_EQ (1, mask[0]);
+	// sqrt(-1)
+	EXPECT_TRUE (isnan (output[1]));
+	EXPECT_EQ (1, mask[1]);
+	EXPECT_DOUBLE_EQ (1.0 / 3 + 2, output[2]);
+	EXPECT_EQ (0, mask[2]);
+	EXPECT_EQ (0, mask[3]);
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/impl/NamedFunction.h>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/impl/Value.h>
+#include <smallcalc/print/print.h>
+#include <smallcalc/print/LayoutCache.h>
+#include <smallcalc/Profiler.h>
+#include <algorithm>
+
+using namespace sc;
+
+/// Nesting far beyond what a recursive implementation survives
+static const int Deep = 100000;
+
+class TestDeepNesting : public testing::Test {
+protected:
+	TestDeepNesting () {
+		calc.addAllStandard();
+	}
+
+	/// f(f(...f(inner)))
+	ExpressionPtr nest (const std::string & function, int depth, ExpressionPtr inner) {
+		NamedFunctionPtr f = calc._parserContext()->findFunction (function);
+		EXPECT_TRUE (f);
+		for (int i = 0; i < depth; i++) {
+			inner = f->createExpression (f, inner);
+		}
+		return inner;
+	}
+
+	/// 1+(1+(...+(1)))
+	ExpressionPtr nestedSum (int depth) {
+		NamedFunctionPtr add = calc._parserContext()->findNonPrefixFunction ("+");
+		EXPECT_TRUE (add);
+		ExpressionPtr one (new Value ((int64_t) 1));
+		ExpressionPtr result = one;
+		for (int i = 0; i < depth; i++) {
+			result = add->createExpression (add, one, result);
+		}
+		return result;
+	}
+
+	SmallCalc calc;
+};
+
+TEST_F (TestDeepNesting, eval) {
+	ExpressionPtr sum = nestedSum (Deep);
+	EvaluationContext context;
+	EXPECT_EQ (Deep + 1, sum->eval (&context).toDouble());
+	context.accurateLevel = true;
+	PrimitiveValue accurate = sum->eval (&context);
+	EXPECT_EQ (PT_INT64, accurate.type());
+	EXPECT_EQ (Deep + 1, accurate.intValue());
+	EXPECT_EQ (0, context.depth);
+
+	ExpressionPtr sin = nest ("sin", Deep, ExpressionPtr (new Value (0.0)));
+	EXPECT_EQ (0, sin->eval (&context).toDouble());
+}
+
+TEST_F (TestDeepNesting, evalProfiled) {
+	ExpressionPtr sum = nestedSum (2 * MaxRecursionDepth);
+	EvaluationProfiler profiler;
+	EvaluationContext context;
+	context.profiler = &profiler;
+	EXPECT_EQ (2 * MaxRecursionDepth + 1, sum->eval (&context).toDouble());
+	NamedFunctionPtr add = calc._parserContext()->findNonPrefixFunction ("+");
+	ASSERT_TRUE (profiler.functionStats (add.get()));
+	EXPECT_EQ ((uint64_t) 2 * MaxRecursionDepth, profiler.functionStats (add.get())->calls);
+}
+
+TEST_F (TestDeepNesting, reportProfile) {
+	ExpressionPtr sum = nestedSum (Deep);
+	EvaluationProfiler profiler;
+	EvaluationContext context;
+	context.profiler = &profiler;
+	sum->eval (&context);
+	std::string report = profiler.report (sum);
+	// one short line per node
+	EXPECT_EQ ((size_t) Deep + 4, (size_t) std::count (report.begin(), report.end(), '\n'));
+	EXPECT_LT (report.size(), (size_t) Deep * 160);
+	EXPECT_NE (std::string::npos, report.find ("[99999] +\n"));
+}
+
+TEST_F (TestDeepNesting, errorsPropagate) {
+	NamedFunctionPtr divide = calc._parserContext()->findNonPrefixFunction ("/");
+	ASSERT_TRUE (divide);
+	ExpressionPtr zero (new Value ((int64_t) 0));
+	ExpressionPtr bad = divide->createExpression (divide, ExpressionPtr (new Value ((int64_t) 1)), zero);
+	ExpressionPtr deep = nest ("sin", 4 * MaxRecursionDepth, bad);
+	EvaluationContext context;
+	context.accurateLevel = true;
+	EXPECT_EQ (deep->eval (&context).type(), bad->eval (&context).type());
+}
+
+TEST_F (TestDeepNesting, printAndHash) {
+	ExpressionPtr a = nest ("sin", Deep, ExpressionPtr (new Value (0.0)));
+	ExpressionPtr b = nest ("sin", Deep, ExpressionPtr (new Value (0.0)));
+	std::string nice = a->printNice();
+	EXPECT_EQ ((size_t) Deep * 5 + 1, nice.size());
+	EXPECT_EQ ("sin(sin(sin(", nice.substr (0, 12));
+	EXPECT_EQ (a->structuralHash(), b->structuralHash());
+
+	ExpressionPtr sum = nestedSum (Deep);
+	EXPECT_EQ ((size_t) Deep * 4 + 1, sum->printNice().size());
+}
+
+TEST_F (TestDeepNesting, print2D) {
+	ExpressionPtr shallow = nest ("sin", 3, ExpressionPtr (new Value ((int64_t) 1)));
+	EXPECT_EQ ("sin(sin(sin(1)))", print (shallow));
+
+	ExpressionPtr deep = nest ("sin", Deep, ExpressionPtr (new Value ((int64_t) 1)));
+	EXPECT_EQ (deep->printNice(), print (deep));
+	LayoutCache cache;
+	EXPECT_EQ (deep->printNice(), print (deep, &cache));
+}
+
+TEST_F (TestDeepNesting, parse) {
+	std::string input;
+	for (int i = 0; i < Deep; i++) input += "-(";
+	input += "1";
+	input += std::string (Deep, ')');
+	ExpressionPtr exp = calc.parse (input);
+	ASSERT_TRUE (exp);
+	EXPECT_EQ (1, calc.eval (input).toDouble());
+}
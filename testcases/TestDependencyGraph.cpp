@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/DependencyGraph.h>
+#include <smallcalc/impl/UserFunction.h>
+#include <sstream>
+
+using namespace sc;
+
+class TestDependencyGraph : public testing::Test {
+protected:
+	TestDependencyGraph () {
+		calc.addAllStandard();
+		calc.setReactive();
+	}
+
+	double value (const std::string & variable) {
+		return calc.evaluationContext().variables[calc.idOfVariable (variable)].toDouble();
+	}
+
+	const DependencyGraph & graph () { return calc.dependencies(); }
+
+	SmallCalc calc;
+};
+
+TEST_F (TestDependencyGraph, recalculates) {
+	calc.eval ("a = 1");
+	EXPECT_EQ (2, calc.eval ("b = a + 1").toDouble());
+	EXPECT_EQ (4, calc.eval ("c = b * 2").toDouble());
+	EXPECT_EQ (5, calc.eval ("d = c + a").toDouble());
+	EXPECT_EQ (1u, graph().lastRecalculated());
+
+	calc.eval ("a = 10");
+	EXPECT_EQ (11, value ("b"));
+	EXPECT_EQ (22, value ("c"));
+	EXPECT_EQ (32, value ("d"));
+	EXPECT_EQ (4u, graph().lastRecalculated()); // a, b, c, d each once
+
+	calc.setVariable (calc.idOfVariable ("a"), PrimitiveValue (1.0));
+	EXPECT_EQ (5, value ("d"));
+	EXPECT_EQ (3u, graph().lastRecalculated());
+	EXPECT_EQ (2, calc.eval ("b").toDouble());
+}
+
+TEST_F (TestDependencyGraph, onlyAffected) {
+	calc.eval ("x = 1");
+	calc.eval ("y = 2");
+	calc.eval ("fx = sin(x) + x");
+	calc.eval ("fy = y * y");
+	calc.eval ("both = fx + fy");
+	EXPECT_EQ (4, value ("fy"));
+
+	calc.eval ("y = 3");
+	EXPECT_EQ (9, value ("fy"));
+	EXPECT_DOUBLE_EQ (::sin (1.0) + 1 + 9, value ("both"));
+	EXPECT_EQ (3u, graph().lastRecalculated()); // y, fy, both; fx stays cached
+
+	VariableId fx = calc.idOfVariable ("fx");
+	ASSERT_EQ (1u, graph().dependencies (fx).size());
+	EXPECT_EQ (calc.idOfVariable ("x"), graph().dependencies (fx)[0]);
+	EXPECT_EQ (1u, graph().dependents (fx).size());
+	EXPECT_TRUE (graph().definition (fx));
+	EXPECT_TRUE (graph().dependencies (calc.idOfVariable ("x")).empty());
+	calc.setVariable (calc.idOfVariable ("x"), PrimitiveValue (2.0));
+	EXPECT_FALSE (graph().definition (calc.idOfVariable ("x")));
+}
+
+TEST_F (TestDependencyGraph, redefine) {
+	calc.eval ("a = 1");
+	calc.eval ("b = 2");
+	calc.eval ("c = a");
+	calc.eval ("d = c * 10");
+	EXPECT_EQ (10, value ("d"));
+	calc.eval ("c = b"); // no longer depends on a
+	EXPECT_EQ (20, value ("d"));
+	calc.eval ("a = 5");
+	EXPECT_EQ (1u, graph().lastRecalculated());
+	EXPECT_EQ (20, value ("d"));
+	calc.eval ("b = 3");
+	EXPECT_EQ (30, value ("d"));
+	EXPECT_TRUE (graph().dependents (calc.idOfVariable ("a")).empty());
+}
+
+TEST_F (TestDependencyGraph, diamond) {
+	// every variable is recalculated once, after all of its dependencies
+	calc.eval ("a = 1");
+	calc.eval ("b = a + 1");
+	calc.eval ("c = a * 2");
+	calc.eval ("d = b * c");
+	calc.eval ("g = d + b + a");
+	calc.eval ("a = 2");
+	EXPECT_EQ (5u, graph().lastRecalculated());
+	EXPECT_EQ (12, value ("d"));
+	EXPECT_EQ (17, value ("g"));
+}
+
+TEST_F (TestDependencyGraph, cycles) {
+	calc.eval ("a = 1");
+	calc.eval ("b = a + 1");
+	calc.eval ("c = b + 1");
+	EXPECT_EQ (error::Eval_CyclicDependency, calc.eval ("a = c + 1").error());
+	EXPECT_EQ (error::Eval_CyclicDependency, calc.eval ("d = d + 1").error());
+	// unchanged
+	EXPECT_TRUE (graph().dependents (calc.idOfVariable ("c")).empty());
+	EXPECT_EQ (1, value ("a"));
+	calc.eval ("a = 2");
+	EXPECT_EQ (4, value ("c"));
+}
+
+TEST_F (TestDependencyGraph, errors) {
+	calc.setAccurateLevel();
+	EXPECT_EQ (error::Eval_UnboundVariable, calc.eval ("b = a + 1").error());
+	EXPECT_EQ (error::Eval_UnboundVariable, calc.eval ("c = b * 2").error());
+	calc.eval ("a = 1");
+	EXPECT_EQ (4, value ("c"));
+	EXPECT_EQ (error::Eval_DivisionByZero, calc.eval ("a = 1/0").error());
+	EXPECT_EQ (error::Eval_DivisionByZero, calc.eval ("c").error());
+	calc.eval ("a = 0");
+	EXPECT_EQ (2, value ("c"));
+	calc.eval ("d = 1/a");
+	EXPECT_EQ (error::Eval_DivisionByZero, calc.eval ("d").error());
+	calc.eval ("a = 2");
+	EXPECT_EQ (0.5, value ("d"));
+	EXPECT_EQ (6, value ("c"));
+}
+
+TEST_F (TestDependencyGraph, notReactive) {
+	calc.setReactive (false);
+	calc.eval ("a = 1");
+	calc.eval ("b = a + 1");
+	calc.eval ("a = 10");
+	EXPECT_EQ (2, value ("b"));
+	EXPECT_EQ (0, graph().size());
+}
+
+TEST_F (TestDependencyGraph, longChain) {
+	const int n = 10000;
+	calc.eval ("c0 = x");
+	for (int i = 1; i < n; i++) {
+		std::ostringstream s;
+		s << "c" << i << " = c" << (i - 1) << " + 1";
+		calc.eval (s.str());
+	}
+	calc.eval ("x = 1");
+	EXPECT_EQ ((size_t) n + 1, graph().lastRecalculated());
+	std::ostringstream last;
+	last << "c" << (n - 1);
+	EXPECT_EQ (n, value (last.str()));
+	calc.eval ("x = 2");
+	EXPECT_EQ (n + 1, value (last.str()));
+}
+
+TEST_F (TestDependencyGraph, userFunctions) {
+	calc.eval ("a = 1");
+	calc.eval ("f(x) = x + a");
+	calc.eval ("g(x) = f(x) * 2");
+	EXPECT_EQ (2, calc.eval ("b = f(1)").toDouble());
+	EXPECT_EQ (4, calc.eval ("c = g(1)").toDouble());
+	EXPECT_EQ (4, calc.eval ("d = sum(k, 1, 2, f(k)) + b - 3").toDouble());
+	ASSERT_EQ (1u, graph().dependencies (calc.idOfVariable ("c")).size()); // a, read by the body of f
+	calc.eval ("a = 10");
+	EXPECT_EQ (11, value ("b"));
+	EXPECT_EQ (22, value ("c"));
+	EXPECT_EQ (31, value ("d"));
+}
+
+TEST_F (TestDependencyGraph, redefineFunction) {
+	calc.eval ("a = 1");
+	calc.eval ("f(x) = x + a");
+	calc.eval ("g(x) = f(x) * 2");
+	calc.eval ("b = f(1)");
+	calc.eval ("c = b + g(1)");
+	calc.eval ("f(x) = x * 100");
+	EXPECT_EQ (100, value ("b"));
+	EXPECT_EQ (104, value ("c")); // g keeps the former f
+	EXPECT_EQ ("f(1)", graph().definition (calc.idOfVariable ("b"))->printNice());
+
+	// no longer depending on a
+	calc.eval ("a = 5");
+	EXPECT_EQ (100, value ("b"));
+	EXPECT_EQ (112, value ("c"));
+
+	// other number of parameters, a new function
+	calc.eval ("f(x, y) = x + y");
+	EXPECT_EQ (100, value ("b"));
+	EXPECT_EQ (3, calc.eval ("f(1, 2)").toDouble());
+}
+
+TEST_F (TestDependencyGraph, assignmentsInFunctions) {
+	calc.eval ("b = 1");
+	calc.eval ("c = b * 10");
+	calc.eval ("f(x, y) = y + (a = y + b)");
+	EXPECT_EQ (5, calc.eval ("f(1, 2)").toDouble());
+	EXPECT_EQ (3, value ("a"));
+	EXPECT_FALSE (graph().definition (calc.idOfVariable ("a"))); // it would read the parameter y
+
+	// b gets set, everything depending on it recalculated outside of the frame of g
+	calc.eval ("g(x) = x + (b = x)");
+	EXPECT_EQ (14, calc.eval ("g(7)").toDouble());
+	EXPECT_EQ (7, value ("b"));
+	EXPECT_EQ (3, value ("a"));
+	EXPECT_EQ (70, value ("c"));
+	EXPECT_FALSE (graph().definition (calc.idOfVariable ("b")));
+}
+
+TEST_F (TestDependencyGraph, assignmentsInFunctionsWithoutParameters) {
+	calc.eval ("b = 1");
+	calc.eval ("f() = (a = b + 1)");
+	EXPECT_EQ (2, calc.eval ("f()").toDouble());
+	EXPECT_EQ (2, value ("a"));
+	EXPECT_FALSE (graph().definition (calc.idOfVariable ("a"))); // a body defines nothing, also without parameters
+	calc.eval ("b = 10");
+	EXPECT_EQ (2, value ("a"));
+}
+
+TEST_F (TestDependencyGraph, parametersOutsideOfTheirFrame) {
+	Parameter y ("y", 1);
+	EvaluationContext context;
+	EXPECT_EQ (error::Eval_UnboundVariable, y.eval (&context).error());
+	PrimitiveValue one (1.0);
+	context.parameters = &one;
+	context.parameterCount = 1;
+	EXPECT_EQ (error::Eval_UnboundVariable, y.eval (&context).error());
+}
+
+TEST_F (TestDependencyGraph, reductions) {
+	calc.eval ("b = 1");
+	EXPECT_EQ (9, calc.eval ("sum(k, 1, 3, a = k + b)").toDouble());
+	EXPECT_EQ (4, value ("a"));
+	EXPECT_FALSE (graph().definition (calc.idOfVariable ("a"))); // it would read the index k
+	EXPECT_EQ (9, calc.eval ("s = sum(k, 1, 3, k + b)").toDouble());
+
+	calc.eval ("g(x) = x + (b = x)");
+	EXPECT_EQ (14, calc.eval ("g(7)").toDouble());
+	EXPECT_EQ (4, value ("a"));
+	EXPECT_EQ (27, value ("s")); // recalculated with its own index
+}
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/FallbackStats.h>
+
+using namespace sc;
+
+TEST (TestFallbackStats, countsOverflows) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	calc.setAccurateLevel();
+	EXPECT_EQ (PT_FRACTION, calc.eval ("1/3 + 1/7").type());
+	EXPECT_EQ (0u, calc.fallbackStats().total());
+
+	EXPECT_EQ (PT_DOUBLE, calc.eval ("9223372036854775807 + 1").type());
+	EXPECT_EQ (1u, calc.fallbackStats().fallbacks[AO_ADD][AO_ADD]);
+	EXPECT_EQ (1u, calc.fallbackStats().operandBits[AO_ADD][63]);
+
+	EXPECT_EQ (PT_DOUBLE, calc.eval ("3^50").type());
+	EXPECT_EQ (1u, calc.fallbackStats().fallbacks[AO_POWER][AO_MULTIPLY]);
+	EXPECT_EQ (PT_DOUBLE, calc.eval ("2^(1/2)").type());
+	EXPECT_EQ (1u, calc.fallbackStats().fallbacks[AO_POWER][AO_POWER]);
+	EXPECT_EQ (3u, calc.fallbackStats().total());
+
+	std::string json = calc.fallbackStats().toJson();
+	EXPECT_NE (std::string::npos, json.find ("\"total\": 3"));
+	EXPECT_NE (std::string::npos, json.find ("\"power\": { \"multiply\": 1, \"power\": 1 }"));
+	EXPECT_NE (std::string::npos, calc.fallbackStats().report().find ("add: 1 (add overflowed)"));
+
+	FallbackStats merged;
+	merged += calc.fallbackStats();
+	merged += calc.fallbackStats();
+	EXPECT_EQ (6u, merged.total());
+
+	calc.resetFallbackStats();
+	EXPECT_EQ (0u, calc.fallbackStats().total());
+}
+
+TEST (TestFallbackStats, magnitude) {
+	EXPECT_EQ (0, magnitudeBits (PrimitiveValue ((int64_t) 0)));
+	EXPECT_EQ (4, magnitudeBits (PrimitiveValue ((int64_t) -8)));
+	EXPECT_EQ (5, magnitudeBits (PrimitiveValue (Fraction64 (3, 17))));
+	EXPECT_EQ (0, magnitudeBits (doubleValue (1e30)));
+}
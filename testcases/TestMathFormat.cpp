@@ -8,9 +8,12 @@
 #include <smallcalc/print/TextDrawer.h>
 #include <smallcalc/print/Converter.h>
 #include <smallcalc/print/print.h>
+#include <smallcalc/print/LayoutCache.h>
+#include <smallcalc/print/DisplayList.h>
 
 #include <smallcalc/smallcalc.h>
-#include <boost/make_shared.hpp>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/impl/NamedFunction.h>
 #include <boost/weak_ptr.hpp>
 
 using namespace sc;
@@ -48,7 +51,8 @@ TEST (TestMathFormat2, testUtf8Lineregression) {
 TEST (TestMathFormat2, testHCenter) {
 	// Es kann sein, dass der Testcase so nicht mehr funktionieren kann
 	// Weil er der RootBox die falsche (kleinere) Größe gibt.
-	BoxPtr target  = boost::make_shared<HCenterBox> (boost::make_shared<TextBox> ("Hallo"));
+	BoxArena arena;
+	BoxPtr target  = arena.create<HCenterBox> (arena.create<TextBox> ("Hallo"));
 	Dimension2i size (12, 1);
 	TextDrawer drawer (Dimension2i (12, 1));
 	drawer.drawLayouted(target);
@@ -57,10 +61,29 @@ TEST (TestMathFormat2, testHCenter) {
 }
 #endif
 
+TEST (TestMathFormat2, textDrawerClips) {
+	TextDrawer drawer (Dimension2i (3, 2));
+	drawer.setCursor (Point2i (-2, 0));
+	drawer.drawText ("abcd");
+	drawer.setCursor (Point2i (2, 1));
+	drawer.drawLine (5);
+	std::string output;
+	drawer.print (output);
+	EXPECT_EQ ("cd \n  ─", output);
+
+	// a paranthesis higher than the grid
+	drawer.setCursor (Point2i (0, 1));
+	drawer.drawParanthesis (Surrounding2i (0, 2, 1, 3), DrawEngine::B_LEFT);
+	output.clear();
+	drawer.print (output);
+	EXPECT_EQ ("│d \n│ ─", output);
+}
+
 TEST (TestMathFormat2, simpleFraction) {
-	BoxPtr upper  = boost::make_shared<TextBox> ("sin(x)");
-	BoxPtr lower  = boost::make_shared<TextBox> ("2");
-	BoxPtr target = boost::make_shared<FractionBox> (upper,lower);
+	BoxArena arena;
+	BoxPtr upper  = arena.create<TextBox> ("sin(x)");
+	BoxPtr lower  = arena.create<TextBox> ("2");
+	BoxPtr target = arena.create<FractionBox> (&arena, upper, lower);
 	TextDrawer drawer (target);
 	drawer.drawLayouted(target);
 	drawer.print (std::cout);
@@ -70,12 +93,13 @@ TEST (TestMathFormat2, simpleFraction) {
 
 
 TEST (TestMathFormat2, simplePrint) {
-	BoxPtr upper  = boost::make_shared<TextBox> ("sin(x)*µ");
+	BoxArena arena;
+	BoxPtr upper  = arena.create<TextBox> ("sin(x)*µ");
 
-	BoxPtr subUpper = boost::make_shared<TextBox> ("2");
-	BoxPtr subLower = boost::make_shared<TextBox> ("3");
-	BoxPtr lower  = boost::make_shared<FractionBox> (subUpper, subLower);
-	BoxPtr target = boost::make_shared<FractionBox> (upper, lower);
+	BoxPtr subUpper = arena.create<TextBox> ("2");
+	BoxPtr subLower = arena.create<TextBox> ("3");
+	BoxPtr lower  = arena.create<FractionBox> (&arena, subUpper, subLower);
+	BoxPtr target = arena.create<FractionBox> (&arena, upper, lower);
 	TextDrawer drawer (target);
 	drawer.drawLayouted(target);
 	drawer.print (std::cout);
@@ -94,9 +118,10 @@ void printAsBox (const PrimitiveValue& val) {
 
 TEST (TestMathFormat2, testHorizontalContainer) {
 	TextDrawer drawer;
-	shared_ptr<HorizontalContainer> container (new HorizontalContainer());
-	container->addChild(DummyBox::create (Surrounding2i (1,1,2,2)));
-	container->addChild(DummyBox::create (Surrounding2i (1,2,2,2)));
+	BoxArena arena;
+	HorizontalContainer * container = arena.create<HorizontalContainer> ();
+	container->addChild(DummyBox::create (&arena, Surrounding2i (1,1,2,2)));
+	container->addChild(DummyBox::create (&arena, Surrounding2i (1,2,2,2)));
 	Surrounding2i surrounding = container->minSize(drawer);
 	ASSERT_EQ (surrounding.width(),  6);
 	ASSERT_EQ (surrounding.height(), 4);
@@ -114,9 +139,10 @@ TEST (TestMathFormat2, testHorizontalContainer) {
 
 TEST (TestMathFormat2, testVerticalContainer) {
 	TextDrawer drawer;
-	shared_ptr<VerticalContainer> container (new VerticalContainer());
-	container->addChild(DummyBox::create (Surrounding2i (1,1,2,2)));
-	container->addChild(DummyBox::create (Surrounding2i (1,2,2,2)));
+	BoxArena arena;
+	VerticalContainer * container = arena.create<VerticalContainer> ();
+	container->addChild(DummyBox::create (&arena, Surrounding2i (1,1,2,2)));
+	container->addChild(DummyBox::create (&arena, Surrounding2i (1,2,2,2)));
 	Surrounding2i surrounding = container->minSize(drawer);
 	ASSERT_EQ (surrounding.width(),  3);
 	ASSERT_EQ (surrounding.height(), 7);
@@ -168,3 +194,149 @@ TEST (TestMathFormat2, autoConversion) {
 
 }
 
+
+TEST (TestMathFormat2, textDrawerOutput) {
+	SmallCalc sc;
+	sc.addAllStandard();
+	EXPECT_EQ (" 1 \n ─ \n 2 \n───\n 3 ", print (sc.parse ("1/2/3")));
+	EXPECT_EQ ("┌─\n│2\n┤─\n│2", print (sc.parse ("sqrt(2/2)")));
+	EXPECT_EQ ("   ╭   ╮\n   │ 1 │\nsin│ ─ │\n   │ 2 │\n   ╰   ╯", print (sc.parse ("sin(1/2)")));
+}
+
+TEST (TestMathFormat2, layoutCache) {
+	SmallCalc sc;
+	sc.addAllStandard();
+	const char * expressions[] = {
+		"1/2/3", "sqrt(2/2)", "sin(1/2)", "(1+2)+1/2", "(1+2)*(1/2)",
+		"sqrt(3/(sin (µ)))", "12 + x^2 + x^3 + 4 * x ^ (1/2)", "sin(1/2) + 1/(3+4)",
+		"sin(1/2) + 1/(3+5)", "1/(3+4) + sin(1/2)", "2*(3+1/4)", "-(1/2)"
+	};
+	int count = sizeof (expressions) / sizeof (expressions[0]);
+	LayoutCache cache;
+	// Cold, then warm; output must not differ from uncached printing
+	for (int round = 0; round < 3; round++) {
+		for (int i = 0; i < count; i++) {
+			ExpressionPtr exp = sc.parse (expressions[i]);
+			EXPECT_EQ (print (exp), print (exp, &cache)) << expressions[i];
+			EXPECT_EQ (printCalcResult (exp, "=", PrimitiveValue (Fraction64 (1,3))), printCalcResult (exp, "=", PrimitiveValue (Fraction64 (1,3)), &cache)) << expressions[i];
+		}
+	}
+	const LayoutCache::Statistics & stats = cache.statistics();
+	EXPECT_GT (stats.hits, 0u);
+	EXPECT_GT (stats.blockHits, 0u);
+	EXPECT_EQ (stats.renders, (uint64_t) count * 6);
+	EXPECT_GT (cache.size(), 0u);
+
+	// Eviction keeps working with a tiny cache
+	LayoutCache tiny (2, 1);
+	for (int round = 0; round < 2; round++) {
+		for (int i = 0; i < count; i++) {
+			ExpressionPtr exp = sc.parse (expressions[i]);
+			EXPECT_EQ (print (exp), print (exp, &tiny)) << expressions[i];
+		}
+	}
+	EXPECT_GT (tiny.statistics().evictions, 0u);
+	EXPECT_LE (tiny.size(), 4u);
+
+	// A cached block drawn partly outside of the grid gets clipped
+	LayoutCache clipped;
+	ExpressionPtr exp = sc.parse ("sin(1/2)");
+	for (int round = 0; round < 3; round++) print (exp, &clipped);
+	uint64_t blockHits = clipped.statistics().blockHits;
+	BoxArena arena;
+	BoxPtr box = convertExpression (&arena, exp, 0, &clipped);
+	TextDrawer drawer (Dimension2i (4, 2));
+	Surrounding2i size = box->minSize (drawer);
+	RootBox root (size, box);
+	root.setPosition (Point2i (size.left - 3, size.top - 1));
+	drawer.layoutTree (&root);
+	drawer.draw (&root);
+	EXPECT_GT (clipped.statistics().blockHits, blockHits);
+	std::string output;
+	drawer.print (output);
+	EXPECT_EQ ("│ 1 \n│ ─ ", output);
+}
+
+namespace {
+
+/// Leaf whose structural hash collides with every other one
+class Colliding : public Expression {
+public:
+	Colliding (const std::string & text) : mText (text) {}
+	virtual PrimitiveValue eval (EvaluationContext * context) const { return PrimitiveValue (); }
+	virtual void printTo (std::string & output, PrintingContext * printingContext) const { output += mText; }
+	virtual uint64_t structuralHash () const { return 42; }
+private:
+	std::string mText;
+};
+
+}
+
+TEST (TestMathFormat2, layoutCacheCollision) {
+	SmallCalc sc;
+	sc.addAllStandard();
+	NamedFunctionPtr divide = sc._parserContext()->findFunction ("divide");
+	ASSERT_TRUE (divide);
+	ExpressionPtr one (new Colliding ("one"));
+	ExpressionPtr other (new Colliding ("other"));
+	ExpressionPtr a = divide->createExpression (divide, one, one);
+	ExpressionPtr b = divide->createExpression (divide, other, one);
+	ASSERT_EQ (a->structuralHash(), b->structuralHash());
+	EXPECT_FALSE (structurallyEqual (*a, *b));
+	EXPECT_TRUE (structurallyEqual (*a, *divide->createExpression (divide, ExpressionPtr (new Colliding ("one")), one)));
+	LayoutCache cache;
+	for (int round = 0; round < 3; round++) {
+		EXPECT_EQ (print (a), print (a, &cache));
+		EXPECT_EQ (print (b), print (b, &cache));
+	}
+}
+
+TEST (TestMathFormat2, displayListCollision) {
+	SmallCalc sc;
+	sc.addAllStandard();
+	NamedFunctionPtr divide = sc._parserContext()->findFunction ("divide");
+	ASSERT_TRUE (divide);
+	ExpressionPtr one (new Colliding ("one"));
+	ExpressionPtr a = divide->createExpression (divide, one, one);
+	ExpressionPtr b = divide->createExpression (divide, ExpressionPtr (new Colliding ("other")), one);
+	ASSERT_EQ (a->structuralHash(), b->structuralHash());
+	DisplayListCache cache;
+	for (int round = 0; round < 2; round++) {
+		EXPECT_EQ (print (a), print (a, &cache));
+		EXPECT_EQ (print (b), print (b, &cache));
+	}
+	EXPECT_EQ (4u, cache.misses());
+	// an equal tree hits
+	EXPECT_EQ (print (b), print (divide->createExpression (divide, ExpressionPtr (new Colliding ("other")), one), &cache));
+	EXPECT_EQ (1u, cache.hits());
+}
+
+TEST (TestMathFormat2, displayList) {
+	SmallCalc sc;
+	sc.addAllStandard();
+	const char * expressions[] = {
+		"1/2/3", "sqrt(2/2)", "sin(1/2)", "(1+2)+1/2", "sqrt(3/(sin (µ)))",
+		"12 + x^2 + x^3 + 4 * x ^ (1/2)", "-(1/2)", "3 * sqrt(2/2/2/2)"
+	};
+	int count = sizeof (expressions) / sizeof (expressions[0]);
+	DisplayListCache cache;
+	for (int round = 0; round < 2; round++) {
+		for (int i = 0; i < count; i++) {
+			ExpressionPtr exp = sc.parse (expressions[i]);
+			EXPECT_EQ (print (exp), print (exp, &cache)) << expressions[i];
+		}
+	}
+	EXPECT_EQ ((uint64_t) count, cache.misses());
+	EXPECT_EQ ((uint64_t) count, cache.hits());
+
+	// Replaying does not need the box tree anymore
+	DisplayList list;
+	{
+		BoxArena arena;
+		TextDrawer metrics;
+		DisplayListDrawEngine recorder (metrics);
+		recorder.record (convertExpression (&arena, sc.parse ("1/2/3")), &list);
+	}
+	EXPECT_EQ (5u, list.commands().size());
+	EXPECT_EQ (" 1 \n ─ \n 2 \n───\n 3 ", print (list));
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/MemoTable.h>
+#include <smallcalc/Budget.h>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/impl/NamedFunction.h>
+
+using namespace sc;
+
+namespace {
+
+int calls = 0;
+
+/// Pure function counting its calls
+PrimitiveValue counting (const NamedFunction::PrimitiveArgumentVector & arguments, const EvaluationContext * context) {
+	calls++;
+	double sum = 0;
+	for (size_t i = 0; i < arguments.size(); i++) {
+		if (arguments[i].error()) return arguments[i];
+		sum += arguments[i].toDouble();
+	}
+	return doubleValue (sum * 2);
+}
+
+}
+
+class TestMemoTable : public testing::Test {
+protected:
+	TestMemoTable () {
+		calls = 0;
+		calc.addAllStandard();
+		function = createNamedFunction ("twice", -1, &counting);
+		function->setPure();
+		calc._parserContext()->addFunction (function);
+	}
+
+	SmallCalc calc;
+	NamedFunctionPtr function;
+};
+
+TEST_F (TestMemoTable, onlyPure) {
+	NamedFunctionPtr impure = createNamedFunction ("impure", 1, &counting);
+	calc._parserContext()->addFunction (impure);
+	EXPECT_FALSE (calc.setMemoization ("impure", 16));
+	EXPECT_FALSE (calc.setMemoization ("unknown", 16));
+	EXPECT_FALSE (calc.setMemoization ("assignment", 16));
+	EXPECT_TRUE (calc.setMemoization ("sin", 16));
+	EXPECT_TRUE (calc.setMemoization ("add", 16));
+	EXPECT_TRUE (calc.setMemoization ("twice", 16));
+	EXPECT_EQ (16u, function->memoTable()->capacity());
+	EXPECT_TRUE (calc.setMemoization ("twice", 0));
+	EXPECT_FALSE (function->memoTable());
+}
+
+TEST_F (TestMemoTable, hitsAndMisses) {
+	ASSERT_TRUE (calc.setMemoization ("twice", 64));
+	EXPECT_EQ (6, calc.eval ("twice(1, 2)").toDouble());
+	EXPECT_EQ (6, calc.eval ("twice(1, 2)").toDouble());
+	EXPECT_EQ (8, calc.eval ("twice(twice(1), 2)").toDouble());
+	EXPECT_EQ (3, calls); // (1, 2), (1) and (2, 2)
+	MemoStats stats = function->memoTable()->stats();
+	EXPECT_EQ (1u, stats.hits);
+	EXPECT_EQ (3u, stats.misses);
+	EXPECT_EQ (0u, stats.evictions);
+	EXPECT_DOUBLE_EQ (0.25, stats.hitRate());
+
+	// same values of another type are other keys
+	EXPECT_EQ (6, calc.eval ("twice(1.0, 2)").toDouble());
+	EXPECT_EQ (4, calls);
+
+	function->memoTable()->clear();
+	EXPECT_EQ (0u, function->memoTable()->stats().hits);
+	calc.eval ("twice(1, 2)");
+	EXPECT_EQ (5, calls);
+}
+
+TEST_F (TestMemoTable, accurateLevel) {
+	ASSERT_TRUE (calc.setMemoization ("divide", 64));
+	EXPECT_EQ (PT_DOUBLE, calc.eval ("1/3").type());
+	calc.setAccurateLevel();
+	EXPECT_EQ (PT_FRACTION, calc.eval ("1/3").type());
+	EXPECT_EQ (PT_FRACTION, calc.eval ("1/3").type());
+	MemoStats stats = calc._parserContext()->findFunction ("divide")->memoTable()->stats();
+	EXPECT_EQ (1u, stats.hits);
+	EXPECT_EQ (2u, stats.misses);
+}
+
+TEST_F (TestMemoTable, errorsAreNotCached) {
+	ASSERT_TRUE (calc.setMemoization ("twice", 64));
+	EXPECT_EQ (error::Eval_UnboundVariable, calc.eval ("twice(x)").error());
+	EXPECT_EQ (error::Eval_UnboundVariable, calc.eval ("twice(x)").error());
+	EXPECT_EQ (2u, function->memoTable()->stats().bypasses);
+
+	ASSERT_TRUE (calc.setMemoization ("pow", 64));
+	calc.setAccurateLevel();
+	EvaluationBudget budget;
+	budget.setMaxSteps (1000);
+	calc.setBudget (&budget);
+	EXPECT_EQ (error::Eval_BudgetExhausted, calc.eval ("(-1)^100000").error());
+	calc.setBudget (0);
+	EXPECT_EQ (1, calc.eval ("(-1)^100000").toDouble());
+}
+
+TEST_F (TestMemoTable, eviction) {
+	ASSERT_TRUE (calc.setMemoization ("twice", 8));
+	VariableId x = calc.idOfVariable ("x");
+	ExpressionPtr exp = calc.parse ("twice(x)");
+	EvaluationContext context;
+	for (int i = 0; i < 100; i++) {
+		context.setVariable (x, PrimitiveValue ((int64_t) i));
+		EXPECT_EQ (2 * i, exp->eval (&context).toDouble());
+	}
+	MemoStats stats = function->memoTable()->stats();
+	EXPECT_EQ (100u, stats.misses);
+	EXPECT_GE (stats.evictions, 92u);
+	EXPECT_EQ (stats.misses - stats.evictions, 8u); // filled all entries
+
+	// the last used stay
+	calls = 0;
+	context.setVariable (x, PrimitiveValue ((int64_t) 99));
+	EXPECT_EQ (198, exp->eval (&context).toDouble());
+	EXPECT_EQ (0, calls);
+}
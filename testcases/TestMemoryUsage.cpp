@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/MemoryUsage.h>
+#include <smallcalc/impl/NamedFunction.h>
+#include <smallcalc/impl/Parser.h>
+
+using namespace sc;
+
+TEST (TestMemoryUsage, expressionNodes) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	MemoryUsage single = memoryUsage (calc.parse ("x"));
+	EXPECT_EQ (1u, single.nodes);
+	EXPECT_GT (single.bytes, 0u);
+	EXPECT_EQ (0u, single.sharedBytes);
+
+	MemoryUsage sum = memoryUsage (calc.parse ("sin(x) + 1/3 + pi"));
+	EXPECT_EQ (7u, sum.nodes);
+	EXPECT_GT (sum.sharedBytes, 0u);
+	EXPECT_GT (sum.bytes, single.bytes * 5);
+	EXPECT_GT (sum.bytesPerNode(), 0);
+
+	// long names need a heap buffer
+	MemoryUsage longName = memoryUsage (calc.parse ("averyveryverylongvariablenamewhichisnotsmall"));
+	EXPECT_GT (longName.bytes, single.bytes);
+}
+
+TEST (TestMemoryUsage, definitions) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	MemoryUsage body = memoryUsage (calc.parse ("x*x*x*x*x + 1"));
+	MemoryUsage definition = memoryUsage (calc.parse ("h(x) = x*x*x*x*x + 1"));
+	EXPECT_EQ (body.nodes + 1, definition.nodes); // the body with parameters instead of variables
+	EXPECT_GT (definition.bytes, body.bytes);
+	EXPECT_GT (definition.sharedBytes, body.sharedBytes); // the defined function
+
+	// parameter and index names need heap buffers if long
+	MemoryUsage shortName = memoryUsage (calc.parse ("g(x) = x + 1"));
+	MemoryUsage longName  = memoryUsage (calc.parse ("g(averyveryverylongparameternamewhichisnotsmall) = averyveryverylongparameternamewhichisnotsmall + 1"));
+	EXPECT_EQ (shortName.nodes, longName.nodes);
+	EXPECT_GT (longName.bytes, shortName.bytes + 2 * 40);
+	EXPECT_GT (memoryUsage (calc.parse ("sum(averyveryverylongindexnamewhichisnotsmall, 1, 2, 3)")).bytes,
+			memoryUsage (calc.parse ("sum(k, 1, 2, 3)")).bytes);
+}
+
+TEST (TestMemoryUsage, sharedSubtreesOnce) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	ExpressionPtr shared = calc.parse ("x * 2 + 3");
+	NamedFunctionPtr add = calc._parserContext()->findNonPrefixFunction ("+");
+	ASSERT_TRUE (add);
+	ExpressionPtr twice = add->createExpression (add, shared, shared);
+
+	MemoryUsage one  = memoryUsage (shared);
+	MemoryUsage both = memoryUsage (twice);
+	EXPECT_EQ (one.nodes + 1, both.nodes);
+	EXPECT_LT (both.bytes, 2 * one.bytes);
+
+	std::vector<ExpressionPtr> many (100, shared);
+	EXPECT_EQ (one.bytes, memoryUsage (many).bytes);
+}
+
+TEST (TestMemoryUsage, contexts) {
+	SmallCalc calc;
+	MemoryUsage empty = memoryUsage (*calc._parserContext());
+	calc.addAllStandard();
+	MemoryUsage full = memoryUsage (*calc._parserContext());
+	EXPECT_GT (full.bytes, empty.bytes);
+	EXPECT_GT (full.sharedBytes, empty.sharedBytes);
+	EXPECT_EQ (2u, full.nodes); // constants pi and e
+
+	VariableIdMapping mapping;
+	size_t before = memoryUsage (mapping).bytes;
+	mapping.variableIdFor ("a");
+	mapping.variableIdFor ("b");
+	EXPECT_GT (memoryUsage (mapping).bytes, before);
+
+	EvaluationContext context;
+	size_t variables = memoryUsage (context).bytes;
+	context.setVariable (1, PrimitiveValue (Fraction64 (1, 3)));
+	EXPECT_GT (memoryUsage (context).bytes, variables);
+
+	calc.eval ("y = 1/7");
+	EXPECT_GT (calc.memoryUsage().bytes, full.bytes);
+}
@@ -1,5 +1,6 @@
 #include <smallcalc/impl/Parser.h>
 #include <smallcalc/impl/Tokenizer.h>
+#include <smallcalc/impl/AssignmentExpression.h>
 #include <smallcalc/smallcalc.h>
 #include <gtest/gtest.h>
 #include <boost/lexical_cast.hpp>
@@ -114,3 +115,47 @@ TEST_F (TestParser, TestParentheses) {
 	EXPECT_EQ ("(2 * (3 + 4))", parseAndBack ("2*(3+4)"));
 	EXPECT_EQ ("((2 + 3) * (4 + 5))", parseAndBack ("(2+3)*(4+5)"));
 }
+
+/// Counts nodes by their kind
+struct KindCounter : public ExpressionVisitor {
+	KindCounter () : values (0), variables (0), constants (0), functions (0), assignments (0) {}
+	virtual void visit (const Value & value) { values++; }
+	virtual void visit (const Variable & variable) { variables++; }
+	virtual void visit (const Constant & constant) { constants++; }
+	virtual void visit (const NamedFunctionExpression & function) {
+		functions++;
+		for (size_t i = 0; i < function.argumentCount(); i++) {
+			function.argument(i)->accept (this);
+		}
+	}
+	virtual void visit (const AssignmentExpression & assignment) {
+		assignments++;
+		assignment.variable()->accept (this);
+		assignment.argument()->accept (this);
+	}
+	int values, variables, constants, functions, assignments;
+};
+
+TEST_F (TestParser, TestExpressionKinds) {
+	calc.addAllStandard();
+	EXPECT_EQ (EK_VALUE, calc.parse ("2")->kind());
+	EXPECT_EQ (EK_VARIABLE, calc.parse ("x")->kind());
+	EXPECT_EQ (EK_CONSTANT, calc.parse ("PI")->kind());
+	EXPECT_EQ (EK_FUNCTION, calc.parse ("sin(x)")->kind());
+	EXPECT_EQ (EK_ASSIGNMENT, calc.parse ("x = 3")->kind());
+
+	ExpressionPtr exp = calc.parse ("y = sqrt(x) / 2 + PI * 3 * x");
+	KindCounter counter;
+	exp->accept (&counter);
+	EXPECT_EQ (1, counter.assignments);
+	EXPECT_EQ (4, counter.functions); // add, divide, sqrt, multiply
+	EXPECT_EQ (3, counter.variables);
+	EXPECT_EQ (1, counter.constants);
+	EXPECT_EQ (2, counter.values);
+
+	ExpressionPtr division = calc.parse ("1/x");
+	ASSERT_EQ (EK_FUNCTION, division->kind());
+	EXPECT_EQ (BF_DIVIDE, static_cast<NamedFunctionExpression*> (division.get())->function()->builtin());
+	EXPECT_EQ (BF_NONE, calc._parserContext()->findFunction ("sin")->builtin());
+	EXPECT_EQ (BF_SQRT, calc._parserContext()->findFunction ("sqrt")->builtin());
+}
@@ -1,7 +1,17 @@
 #include <gtest/gtest.h>
 #include <smallcalc/smallcalc.h>
 #include <smallcalc/impl/Parser.h>
+#include <smallcalc/print/print.h>
+#include <smallcalc/print/LayoutCache.h>
+#include <smallcalc/print/DisplayList.h>
+#include <smallcalc/print/TextDrawer.h>
+#include <smallcalc/Tabulate.h>
 #include <math.h>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
 
 using namespace sc;
 
@@ -14,6 +24,11 @@ protected:
 		return calc.eval (s).error();
 	}
 
+	/// Microseconds since start
+	static double elapsedMicros (const boost::posix_time::ptime & start) {
+		return (double) (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+	}
+
 	SmallCalc calc;
 };
 
@@ -33,3 +48,183 @@ TEST_F (TestPerformance, simpleTest) {
 	}
 	ASSERT_TRUE(true);
 }
+
+TEST_F (TestPerformance, tabulate) {
+	// Same workload as simpleTest, split over threads
+	calc.addAllStandard();
+	ExpressionPtr exp = calc.parse ("sin(x)");
+	VariableId xId = calc.idOfVariable ("x");
+	const size_t n = 2000000;
+	const double hi = (n - 1) / 8.0 * M_PI;
+	std::vector<double> y (n);
+	int maxThreads = std::max (4, (int) boost::thread::hardware_concurrency());
+	double single = 0;
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		size_t errors = tabulate (exp, xId, 0, hi, n, &y[0], 0, threads);
+		double micros = elapsedMicros (start);
+		if (threads == 1) single = micros;
+		EXPECT_EQ (0u, errors);
+		std::cout << "tabulate sin(x), " << n << " samples, " << threads << " threads: " << micros / 1000 << "ms, speedup " << single / micros << std::endl;
+	}
+	for (size_t i = 0; i < n; i += 77) {
+		ASSERT_NEAR (::sin (i / 8.0 * M_PI), y[i], 0.1);
+	}
+}
+
+TEST_F (TestPerformance, printLargeSum) {
+	// Generated formulas with many terms in one n-ary add node
+	const int terms = 20000;
+	std::ostringstream input;
+	std::ostringstream expected;
+	for (int i = 0; i < terms; i++) {
+		if (i > 0) {
+			input << "+";
+			expected << " + ";
+		}
+		input << "x*" << i;
+		expected << "x * " << i;
+	}
+	ExpressionPtr exp = calc.parse (input.str());
+	ASSERT_FALSE (exp->error());
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	const int repetitions = 20;
+	std::string result;
+	for (int i = 0; i < repetitions; i++) {
+		result = exp->printNice();
+	}
+	std::cout << "printNice, sum of " << terms << " terms: " << elapsedMicros (start) / repetitions << "us/op" << std::endl;
+	ASSERT_EQ (expected.str(), result);
+}
+
+TEST_F (TestPerformance, printDeepNesting) {
+	// Alternating operators, so that every level is a node of its own
+	const int depth = 2000;
+	std::string input = "x";
+	for (int i = 0; i < depth; i++) {
+		input = (i % 2 ? "2*(" : "1+(") + input + ")";
+	}
+	ExpressionPtr exp = calc.parse (input);
+	ASSERT_FALSE (exp->error());
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	const int repetitions = 20;
+	std::string result;
+	for (int i = 0; i < repetitions; i++) {
+		result = exp->printWithoutOptimizations();
+	}
+	std::cout << "printWithoutOptimizations, depth " << depth << ": " << elapsedMicros (start) / repetitions << "us/op" << std::endl;
+	ASSERT_EQ ((size_t) depth, (size_t) std::count (result.begin(), result.end(), '('));
+}
+
+TEST_F (TestPerformance, renderThroughput) {
+	// Rendering a result on each keystroke; dominated by building the box tree
+	calc.addAllStandard();
+	ExpressionPtr small = calc.parse ("2+3/sin(0.5*PI)");
+	std::ostringstream input;
+	for (int i = 0; i < 200; i++) {
+		if (i > 0) input << "+";
+		input << "sqrt(x/" << (i + 2) << ")^2";
+	}
+	ExpressionPtr large = calc.parse (input.str());
+	ASSERT_FALSE (small->error());
+	ASSERT_FALSE (large->error());
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	const int smallRepetitions = 5000;
+	for (int i = 0; i < smallRepetitions; i++) {
+		print (small);
+	}
+	std::cout << "sc::print, small expression: " << elapsedMicros (start) / smallRepetitions << "us/op" << std::endl;
+
+	start = boost::posix_time::microsec_clock::universal_time();
+	const int largeRepetitions = 20;
+	for (int i = 0; i < largeRepetitions; i++) {
+		print (large);
+	}
+	std::cout << "sc::print, 200 term expression: " << elapsedMicros (start) / largeRepetitions << "us/op" << std::endl;
+}
+
+TEST_F (TestPerformance, renderFractionTower) {
+	// Continued fraction, tall and wide at the same time
+	const int depth = 60;
+	std::string input = "x";
+	for (int i = 0; i < depth; i++) {
+		input = "1+1/(" + input + ")";
+	}
+	ExpressionPtr exp = calc.parse (input);
+	ASSERT_FALSE (exp->error());
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	const int repetitions = 50;
+	std::string result;
+	for (int i = 0; i < repetitions; i++) {
+		result = print (exp);
+	}
+	std::cout << "sc::print, fraction tower of depth " << depth << ": " << elapsedMicros (start) / repetitions << "us/op, "
+			<< result.size() << " bytes" << std::endl;
+}
+
+TEST_F (TestPerformance, renderEditedExpression) {
+	// Typing into the last term of a long sum: all other terms are unchanged
+	calc.addAllStandard();
+	std::ostringstream prefix;
+	for (int i = 0; i < 200; i++) {
+		prefix << "sqrt(x/" << (i + 2) << ")^2+";
+	}
+	const int repetitions = 50;
+	std::vector<ExpressionPtr> edits;
+	for (int i = 0; i < repetitions; i++) {
+		edits.push_back (calc.parse (prefix.str() + "1/" + boost::lexical_cast<std::string> (i + 1)));
+		ASSERT_FALSE (edits.back()->error());
+	}
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int i = 0; i < repetitions; i++) {
+		print (edits[i]);
+	}
+	double uncached = elapsedMicros (start) / repetitions;
+
+	LayoutCache cache;
+	start = boost::posix_time::microsec_clock::universal_time();
+	for (int i = 0; i < repetitions; i++) {
+		print (edits[i], &cache);
+	}
+	double cached = elapsedMicros (start) / repetitions;
+	const LayoutCache::Statistics & stats = cache.statistics();
+	std::cout << "sc::print, edited 200 term expression: " << uncached << "us/op uncached, " << cached << "us/op cached, "
+			<< "hit rate " << stats.hitRate() << ", block hit rate " << stats.blockHitRate()
+			<< ", max latency " << stats.maxRenderMicros << "us" << std::endl;
+	EXPECT_EQ (print (edits.back()), print (edits.back(), &cache));
+}
+
+TEST_F (TestPerformance, replayDisplayList) {
+	// Redrawing an unchanged formula on each frame
+	calc.addAllStandard();
+	std::ostringstream input;
+	for (int i = 0; i < 200; i++) {
+		if (i > 0) input << "+";
+		input << "sqrt(x/" << (i + 2) << ")^2";
+	}
+	ExpressionPtr exp = calc.parse (input.str());
+	ASSERT_FALSE (exp->error());
+
+	const int repetitions = 50;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int i = 0; i < repetitions; i++) {
+		print (exp);
+	}
+	double relayout = elapsedMicros (start) / repetitions;
+
+	DisplayListCache cache;
+	DisplayListPtr list = cache.get (exp, TextDrawer ());
+	start = boost::posix_time::microsec_clock::universal_time();
+	for (int i = 0; i < repetitions; i++) {
+		print (*list);
+	}
+	double replay = elapsedMicros (start) / repetitions;
+	std::cout << "sc::print, 200 term expression: " << relayout << "us/op full relayout, " << replay << "us/op replay, "
+			<< list->commands().size() << " commands, " << list->bytesUsed() << " bytes" << std::endl;
+	EXPECT_EQ (print (exp), print (*list));
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/Profiler.h>
+#include <smallcalc/impl/NamedFunction.h>
+#include <smallcalc/print/print.h>
+
+using namespace sc;
+
+TEST (TestProfiler, countsNodesAndFunctions) {
+	SmallCalc calc;
+	calc.addAllStandard();
+	ExpressionPtr exp = calc.parse ("sin(x) * 3 + sin(1/3) + 1/4");
+	ASSERT_EQ (EK_FUNCTION, exp->kind());
+	const NamedFunctionExpression * add = static_cast<const NamedFunctionExpression*> (exp.get());
+	const NamedFunctionExpression * product = static_cast<const NamedFunctionExpression*> (add->argument(0).get());
+
+	EvaluationProfiler profiler;
+	EvaluationContext context;
+	context.accurateLevel = true;
+	context.setVariable (calc.idOfVariable ("x"), PrimitiveValue ((int64_t) 2));
+	context.profiler = &profiler;
+	for (int i = 0; i < 3; i++) {
+		exp->eval (&context);
+	}
+
+	const EvaluationProfiler::Stats * root = profiler.nodeStats (exp.get());
+	ASSERT_TRUE (root);
+	EXPECT_EQ (3u, root->calls);
+	EXPECT_GE (root->inclusiveNs, root->exclusiveNs);
+	EXPECT_EQ (profiler.totalNs(), root->inclusiveNs);
+	const EvaluationProfiler::Stats * productStats = profiler.nodeStats (product);
+	ASSERT_TRUE (productStats);
+	EXPECT_EQ (3u, productStats->calls);
+	EXPECT_LE (productStats->inclusiveNs, root->inclusiveNs);
+
+	// sin gets accurate arguments, but results in doubles
+	const EvaluationProfiler::Stats * sin = profiler.functionStats (product->argument(0)->kind() == EK_FUNCTION ?
+			static_cast<const NamedFunctionExpression*> (product->argument(0).get())->function().get() : 0);
+	ASSERT_TRUE (sin);
+	EXPECT_EQ (6u, sin->calls);
+	EXPECT_EQ (6u, sin->fallbacks);
+	EXPECT_EQ (0u, root->fallbacks); // gets a double argument
+
+	std::string report = printProfile (exp, profiler);
+	EXPECT_NE (std::string::npos, report.find ("fallbacks"));
+	// nodes only name their function, indented by depth
+	report = profiler.report (exp);
+	EXPECT_NE (std::string::npos, report.find ("  +\n"));
+	EXPECT_NE (std::string::npos, report.find ("    sin\n"));
+	EXPECT_EQ (std::string::npos, report.find ("sin(x)"));
+
+	profiler.clear();
+	EXPECT_FALSE (profiler.nodeStats (exp.get()));
+	context.profiler = 0;
+	exp->eval (&context);
+	EXPECT_TRUE (profiler.nodes().empty());
+}
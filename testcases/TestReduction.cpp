@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/ColumnEvaluator.h>
+#include <smallcalc/Budget.h>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/impl/Reduction.h>
+
+using namespace sc;
+
+class TestReduction : public testing::Test {
+protected:
+	TestReduction () {
+		calc.addAllStandard();
+	}
+
+	/// Degree of the body of a parsed reduction
+	int degree (const char * input) {
+		ExpressionPtr exp = calc.parse (input);
+		if (exp->kind() != EK_REDUCTION) return -2;
+		return static_cast<const Reduction&> (*exp).degree();
+	}
+
+	SmallCalc calc;
+};
+
+TEST_F (TestReduction, basics) {
+	EXPECT_EQ (55, calc.eval ("sum(k, 1, 10, k)").toDouble());
+	EXPECT_EQ (120, calc.eval ("prod(k, 1, 5, k)").toDouble());
+	EXPECT_EQ (-2, calc.eval ("min(k, -3, 3, k^2 - 2)").toDouble());
+	EXPECT_EQ (0, calc.eval ("max(k, 1, 10, 0 - (k - 4)^2)").toDouble());
+	EXPECT_EQ (11, calc.eval ("1 + sum(i, 1, 4, i)").toDouble());
+
+	EXPECT_EQ (0, calc.eval ("sum(k, 5, 1, k)").toDouble());
+	EXPECT_EQ (1, calc.eval ("prod(k, 5, 1, k)").toDouble());
+	EXPECT_EQ (error::Eval_InvalidOperation, calc.eval ("min(k, 5, 1, k)").error());
+	EXPECT_EQ (error::Eval_BadType, calc.eval ("sum(k, 1.5, 3, k)").error());
+}
+
+TEST_F (TestReduction, parse) {
+	EXPECT_EQ (error::Parser_NoValidToken, calc.eval ("sum(1, 1, 3, 1)").error());
+	EXPECT_EQ (error::Parser_WrongArgumentCount, calc.eval ("sum(k, 1, 3)").error());
+	EXPECT_EQ ("sum(k,1,10,k ^ 2)", calc.parse ("sum(k, 1, 10, k^2)")->printNice());
+
+	// the index is only bound in the body
+	EXPECT_EQ (error::Eval_UnboundVariable, calc.eval ("sum(k, 1, 3, k) + k").error());
+	calc.setVariable (calc.idOfVariable ("k"), doubleValue (3));
+	EXPECT_EQ (6, calc.eval ("sum(k, 1, k, k)").toDouble());
+	EXPECT_EQ (9, calc.eval ("sum(k, 1, 3, k) + k").toDouble());
+}
+
+TEST_F (TestReduction, nested) {
+	EXPECT_EQ (25, calc.eval ("sum(i, 1, 3, sum(j, 1, i, i * j))").toDouble());
+	EXPECT_EQ (9, calc.eval ("sum(k, 1, 3, sum(k, 1, 2, k))").toDouble()); // innermost index wins
+	EXPECT_EQ (30, calc.eval ("prod(i, 1, 2, sum(j, i, 3, j))").toDouble());
+}
+
+TEST_F (TestReduction, userFunctions) {
+	calc.eval ("f(n) = sum(k, 1, n, k^2)");
+	EXPECT_EQ (385, calc.eval ("f(10)").toDouble());
+	EXPECT_TRUE (calc._parserContext()->findFunction ("f")->isPure());
+	calc.eval ("g(n, x) = prod(k, 1, n, x + k)");
+	EXPECT_EQ (60, calc.eval ("g(3, 2)").toDouble());
+	EXPECT_EQ (error::Parser_NoValidToken, calc.eval ("sum(x) = x").error());
+
+	// not inlined into column evaluation, called instead
+	calc.eval ("h(x) = x + sum(k, 1, 3, k * x)");
+	ExpressionPtr exp = calc.parse ("h(a)");
+	ColumnEvaluator evaluator;
+	ASSERT_EQ (NoError, evaluator.compile (exp));
+	double a[] = { 0, 1, 2 };
+	double output[3];
+	evaluator.bind (calc.idOfVariable ("a"), a);
+	ASSERT_EQ (NoError, evaluator.evaluate (3, output));
+	EXPECT_EQ (0, output[0]);
+	EXPECT_EQ (7, output[1]);
+	EXPECT_EQ (14, output[2]);
+}
+
+TEST_F (TestReduction, accurate) {
+	calc.setAccurateLevel();
+	PrimitiveValue harmonic = calc.eval ("sum(k, 1, 20, 1/k)");
+	ASSERT_EQ (PT_FRACTION, harmonic.type());
+	EXPECT_EQ (55835135, harmonic.toFraction().numerator());
+	EXPECT_EQ (15519504, harmonic.toFraction().denumerator());
+
+	PrimitiveValue squares = calc.eval ("sum(k, 1, 1000000, k^2)");
+	ASSERT_EQ (PT_INT64, squares.type());
+	EXPECT_EQ (333333833333500000LL, squares.intValue());
+
+	PrimitiveValue thirds = calc.eval ("sum(k, 1, 1000, k/3)");
+	ASSERT_EQ (PT_FRACTION, thirds.type());
+	EXPECT_EQ (500500, thirds.toFraction().numerator());
+	EXPECT_EQ (3, thirds.toFraction().denumerator());
+
+	EXPECT_EQ (PT_INT64, calc.eval ("prod(k, 1, 20, k)").type());
+	EXPECT_EQ (2432902008176640000LL, calc.eval ("prod(k, 1, 20, k)").intValue());
+	EXPECT_EQ (error::Eval_DivisionByZero, calc.eval ("max(k, -3, 3, 1/k)").error());
+}
+
+TEST_F (TestReduction, closedForm) {
+	EXPECT_EQ (2, degree ("sum(k, 1, 10, k^2 + 3*k)"));
+	EXPECT_EQ (1, degree ("sum(k, 1, 10, a*k - 1)"));
+	EXPECT_EQ (0, degree ("sum(k, 1, 10, sin(a))"));
+	EXPECT_EQ (4, degree ("sum(k, 1, 10, (k^2 + 1) * (k - 1)^2 / 5)"));
+	EXPECT_EQ (-1, degree ("sum(k, 1, 10, sin(k))"));
+	EXPECT_EQ (-1, degree ("sum(k, 1, 10, 1/k)"));
+	EXPECT_EQ (-1, degree ("sum(k, 1, 10, 2^k)"));
+	EXPECT_EQ (-1, degree ("sum(k, 1, 10, k^0)"));
+	EXPECT_EQ (-1, degree ("sum(k, 1, 10, k^9)"));
+
+	// exact against a loop
+	calc.setAccurateLevel();
+	int64_t twice = 0; // twice the sum of 3 k^3 - k^2 / 2 + 7
+	for (int64_t k = -50; k <= 70; k++) {
+		twice += 6 * k * k * k - k * k + 14;
+	}
+	PrimitiveValue v = calc.eval ("sum(k, -50, 70, 3*k^3 - k^2/2 + 7)");
+	ASSERT_TRUE (v.fractionable());
+	EXPECT_EQ (twice, v.toFraction().normalize().numerator() * (2 / v.toFraction().normalize().denumerator()));
+
+	calc.setVariable (calc.idOfVariable ("a"), PrimitiveValue ((int64_t) 4));
+	EXPECT_EQ (4000000000LL, calc.eval ("sum(k, 1, 1000000000, a)").intValue());
+}
+
+TEST_F (TestReduction, closedFormLargeOffset) {
+	// the values overflow int64 (and 2^53), forward differences in double would lose most of their digits
+	long double cubes = 0, quartics = 0;
+	for (int64_t k = 1000000000; k <= 1000100000; k++) {
+		cubes += (long double) k * k * k;
+	}
+	for (int64_t k = 10000000; k <= 10001000; k++) {
+		quartics += 0.5L * k * k * k * k;
+	}
+	for (int accurate = 0; accurate < 2; accurate++) {
+		calc.setAccurateLevel (accurate != 0);
+		EXPECT_NEAR ((double) cubes, calc.eval ("sum(k, 1000000000, 1000100000, k^3)").toDouble(), (double) cubes * 1e-12);
+		EXPECT_NEAR ((double) quartics, calc.eval ("sum(k, 10000000, 10001000, 0.5*k^4)").toDouble(), (double) quartics * 1e-12);
+	}
+}
+
+TEST_F (TestReduction, closedFormOverflow) {
+	// the sums overflow int64, the closed form finishes in double instead of looping over 10^12 indices
+	const double n = 1e12;
+	for (int accurate = 0; accurate < 2; accurate++) {
+		calc.setAccurateLevel (accurate != 0);
+		PrimitiveValue linear = calc.eval ("sum(k, 1, 10^12, k)");
+		EXPECT_EQ (PT_DOUBLE, linear.type());
+		EXPECT_NEAR (n * (n + 1) / 2, linear.toDouble(), n * n * 1e-14);
+		double squares = n * (n + 1) * (2 * n + 1) / 6;
+		EXPECT_NEAR (squares, calc.eval ("sum(k, 1, 10^12, k^2)").toDouble(), squares * 1e-14);
+		double cubic = n * n * (n + 1) * (n + 1) / 4 - 3 * n;
+		EXPECT_NEAR (cubic, calc.eval ("sum(k, 1, 10^12, k^3 - 3)").toDouble(), cubic * 1e-14);
+	}
+	EvaluationBudget budget;
+	budget.setMaxSteps (1000); // constant time
+	calc.setBudget (&budget);
+	EXPECT_FALSE (calc.eval ("sum(k, 1, 10^12, k^2 + k)").error());
+	calc.setBudget (0);
+}
+
+TEST_F (TestReduction, deterministicThreads) {
+	const char * inputs[] = { "sum(k, 1, 100000, 1/k)", "max(k, 1, 50000, sin(k))", "prod(k, 1, 30000, 1 + 1/(k*k))" };
+	for (size_t i = 0; i < sizeof (inputs) / sizeof (inputs[0]); i++) {
+		calc.setThreads (1);
+		double single = calc.eval (inputs[i]).toDouble();
+		calc.setThreads (3);
+		double three = calc.eval (inputs[i]).toDouble();
+		calc.setThreads (8);
+		double eight = calc.eval (inputs[i]).toDouble();
+		EXPECT_EQ (single, three) << inputs[i];
+		EXPECT_EQ (single, eight) << inputs[i];
+	}
+	EXPECT_NEAR (12.0901461, calc.eval ("sum(k, 1, 100000, 1/k)").toDouble(), 1e-6);
+
+	calc.setAccurateLevel();
+	calc.setThreads (4);
+	EXPECT_EQ (error::Eval_DivisionByZero, calc.eval ("sum(k, -20000, 20000, 1/k)").error());
+}
+
+TEST_F (TestReduction, sideEffects) {
+	ExpressionPtr exp = calc.parse ("sum(k, 1, 10000, x = k)");
+	ASSERT_EQ (EK_REDUCTION, exp->kind());
+	EXPECT_FALSE (static_cast<const Reduction&> (*exp).parallel());
+	EXPECT_TRUE (static_cast<const Reduction&> (*calc.parse ("sum(k, 1, 10, sin(k) + a)")).parallel());
+	calc.setThreads (4);
+	EXPECT_EQ (50005000, calc.eval ("sum(k, 1, 10000, x = k)").toDouble());
+	EXPECT_EQ (10000, calc.eval ("x").toDouble());
+}
+
+TEST_F (TestReduction, budget) {
+	EvaluationBudget budget;
+	budget.setMaxSteps (10000);
+	calc.setBudget (&budget);
+	EXPECT_EQ (error::Eval_BudgetExhausted, calc.eval ("max(k, 1, 1000000000, k)").error());
+	budget.reset();
+	calc.setThreads (4);
+	EXPECT_EQ (error::Eval_BudgetExhausted, calc.eval ("max(k, 1, 1000000000, k)").error());
+	budget.reset();
+	EXPECT_EQ (1000, calc.eval ("max(k, 1, 1000, k)").toDouble());
+}
+
+TEST_F (TestReduction, reactive) {
+	calc.setReactive();
+	calc.setVariable (calc.idOfVariable ("n"), PrimitiveValue ((int64_t) 10));
+	EXPECT_EQ (55, calc.eval ("s = sum(k, 1, n, k)").toDouble());
+	calc.setVariable (calc.idOfVariable ("n"), PrimitiveValue ((int64_t) 20));
+	EXPECT_EQ (210, calc.eval ("s").toDouble());
+}
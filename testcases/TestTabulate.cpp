@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/Tabulate.h>
+#include <math.h>
+
+using namespace sc;
+
+class TestTabulate : public testing::Test {
+protected:
+	TestTabulate () {
+		calc.addAllStandard();
+	}
+	SmallCalc calc;
+};
+
+TEST_F (TestTabulate, matchesSequentialEvaluation) {
+	ExpressionPtr exp = calc.parse ("x^2 - 3*x + cos(x)");
+	VariableId x = calc.idOfVariable ("x");
+	const size_t n = 20001;
+	Tabulation single = tabulate (exp, x, -5, 5, n, 1);
+	Tabulation parallel = tabulate (exp, x, -5, 5, n, 4);
+	ASSERT_EQ (n, single.y.size());
+	EXPECT_EQ (-5, single.x.front());
+	EXPECT_EQ (5, single.x.back());
+	EXPECT_EQ (0u, single.errorCount);
+	EXPECT_EQ (0u, parallel.errorCount);
+	EvaluationContext context;
+	for (size_t i = 0; i < n; i++) {
+		context.setVariable (x, doubleValue (single.x[i]));
+		ASSERT_EQ (exp->eval (&context).toDouble(), single.y[i]);
+		ASSERT_EQ (single.y[i], parallel.y[i]);
+	}
+}
+
+TEST_F (TestTabulate, errorSamples) {
+	ExpressionPtr exp = calc.parse ("1/x + sqrt(x)");
+	VariableId x = calc.idOfVariable ("x");
+	Tabulation result = tabulate (exp, x, -2, 2, 5, 2); // -2, -1, 0, 1, 2
+	EXPECT_TRUE (isnan (result.y[0]));
+	EXPECT_TRUE (isnan (result.y[1]));
+	EXPECT_TRUE (isnan (result.y[2]));
+	EXPECT_EQ (2, result.y[3]);
+	EXPECT_EQ (3u, result.errorCount);
+	uint8_t expected[] = { 1, 1, 1, 0, 0 };
+	for (size_t i = 0; i < 5; i++) {
+		EXPECT_EQ (expected[i], result.errors[i]) << i;
+	}
+
+	// Other variables come from the context
+	exp = calc.parse ("a * x");
+	EvaluationContext context;
+	context.setVariable (calc.idOfVariable ("a"), doubleValue (3));
+	double y[3];
+	EXPECT_EQ (0u, tabulate (exp, x, 0, 1, 3, y, 0, 1, &context));
+	EXPECT_EQ (1.5, y[1]);
+	EXPECT_EQ (3u, tabulate (exp, x, 0, 1, 3, y, 0, 1)); // a is unbound
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/Trace.h>
+#include <smallcalc/print/print.h>
+#include <boost/thread.hpp>
+
+using namespace sc;
+
+namespace {
+
+/// Disables tracing and restores the buffer size when leaving a test
+struct TraceGuard {
+	TraceGuard () { setTraceBufferSize (65536); }
+	~TraceGuard () {
+		setTracingEnabled (false);
+		setTraceBufferSize (65536);
+	}
+};
+
+void tracedWork () {
+	for (int i = 0; i < 3; i++) {
+		TraceSpan span ("worker");
+	}
+}
+
+/// tracedWork, keeping the thread alive until all threads of barrier have traced
+void tracedWorkTogether (boost::barrier * barrier) {
+	tracedWork ();
+	barrier->wait ();
+}
+
+}
+
+TEST (TestTrace, recordsPhases) {
+	TraceGuard guard;
+	SmallCalc calc;
+	calc.addAllStandard();
+	calc.eval ("1+2");
+	EXPECT_EQ (0u, traceEventCount());
+
+	setTracingEnabled ();
+	PrimitiveValue v = calc.eval ("sin(1) + 2 * (3 + 4)");
+	print (calc.lastExpression());
+	setTracingEnabled (false);
+	EXPECT_FALSE (v.error());
+
+	std::string json = traceEventJson();
+	EXPECT_EQ (0u, json.find ("{\"traceEvents\":["));
+	const char * phases[] = { "tokenize", "parse", "compress", "eval", "convert", "layout", "draw" };
+	for (size_t i = 0; i < sizeof (phases) / sizeof (phases[0]); i++) {
+		EXPECT_NE (std::string::npos, json.find (std::string ("\"name\":\"") + phases[i] + "\"")) << phases[i];
+	}
+	EXPECT_NE (std::string::npos, json.find ("\"ph\":\"X\""));
+
+	size_t count = traceEventCount();
+	calc.eval ("1+2");
+	EXPECT_EQ (count, traceEventCount());
+	clearTrace();
+	EXPECT_EQ (0u, traceEventCount());
+}
+
+TEST (TestTrace, ringBufferKeepsNewest) {
+	TraceGuard guard;
+	setTraceBufferSize (4);
+	setTracingEnabled ();
+	{ TraceSpan span ("old"); }
+	for (int i = 0; i < 10; i++) {
+		TraceSpan span ("new");
+	}
+	EXPECT_EQ (4u, traceEventCount());
+	EXPECT_EQ (std::string::npos, traceEventJson().find ("\"old\""));
+}
+
+TEST (TestTrace, perThreadBuffers) {
+	TraceGuard guard;
+	setTracingEnabled ();
+	// finished threads hand their buffer to the next one, so both have to live at the same time
+	boost::barrier barrier (2);
+	boost::thread a (boost::bind (&tracedWorkTogether, &barrier));
+	boost::thread b (boost::bind (&tracedWorkTogether, &barrier));
+	a.join();
+	b.join();
+	EXPECT_EQ (6u, traceEventCount());
+	std::string json = traceEventJson();
+	std::string tid = "\"tid\":";
+	size_t first = json.find (tid);
+	ASSERT_NE (std::string::npos, first);
+	int firstTid = atoi (json.c_str() + first + tid.size());
+	bool otherThread = false;
+	for (size_t p = json.find (tid); p != std::string::npos; p = json.find (tid, p + 1)) {
+		if (atoi (json.c_str() + p + tid.size()) != firstTid) otherThread = true;
+	}
+	EXPECT_TRUE (otherThread);
+}
+
+TEST (TestTrace, buffersOfFinishedThreadsAreReused) {
+	TraceGuard guard;
+	clearTrace();
+	setTracingEnabled ();
+	{ TraceSpan span ("main"); }
+	boost::thread first (&tracedWork);
+	first.join();
+	size_t buffers = traceBufferCount();
+	for (int i = 0; i < 20; i++) {
+		boost::thread t (&tracedWork);
+		t.join();
+	}
+	EXPECT_EQ (buffers, traceBufferCount());
+	EXPECT_EQ (1u + 21 * 3, traceEventCount()); // events of finished threads are kept
+
+	// clearing and resizing while other threads trace
+	boost::thread_group group;
+	for (int i = 0; i < 3; i++) {
+		group.create_thread (&tracedWork);
+	}
+	for (int i = 0; i < 20; i++) {
+		clearTrace();
+		setTraceBufferSize (16 + i);
+	}
+	group.join_all();
+	EXPECT_LE (traceEventCount(), 9u);
+}
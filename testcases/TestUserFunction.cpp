@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <smallcalc/smallcalc.h>
+#include <smallcalc/ColumnEvaluator.h>
+#include <smallcalc/MemoTable.h>
+#include <smallcalc/impl/Parser.h>
+#include <smallcalc/impl/NamedFunction.h>
+#include <smallcalc/impl/UserFunction.h>
+#include <algorithm>
+
+using namespace sc;
+
+class TestUserFunction : public testing::Test {
+protected:
+	TestUserFunction () {
+		calc.addAllStandard();
+	}
+
+	SmallCalc calc;
+};
+
+TEST_F (TestUserFunction, defineAndCall) {
+	PrimitiveValue v = calc.eval ("f(x, y) = x^2 + y");
+	EXPECT_FALSE (v.error());
+	EXPECT_EQ (PT_NULL, v.type());
+	ASSERT_TRUE (calc._parserContext()->findFunction ("f"));
+	EXPECT_EQ (2, calc._parserContext()->findFunction ("f")->arity());
+	EXPECT_EQ (11, calc.eval ("f(3, 2)").toDouble());
+	EXPECT_EQ (12, calc.eval ("f(3, 2) + 1").toDouble());
+	EXPECT_EQ (error::Parser_WrongArgumentCount, calc.eval ("f(3)").error());
+
+	calc.eval ("c() = 2 + 3");
+	EXPECT_EQ (5, calc.eval ("c()").toDouble());
+}
+
+TEST_F (TestUserFunction, nestedCalls) {
+	calc.eval ("sq(x) = x * x");
+	calc.eval ("g(x, y) = sq(x) + sq(y)");
+	EXPECT_EQ (25, calc.eval ("g(sq(2), 3)").toDouble());
+	EXPECT_EQ (2, calc.eval ("g(sin(0), 1) + sq(-1)").toDouble());
+}
+
+TEST_F (TestUserFunction, parametersAndVariables) {
+	calc.setVariable (calc.idOfVariable ("x"), doubleValue (100));
+	calc.eval ("f(x) = x + a");
+	calc.setVariable (calc.idOfVariable ("a"), doubleValue (2));
+	EXPECT_EQ (3, calc.eval ("f(1)").toDouble());          // the parameter shadows the variable
+	EXPECT_EQ (102, calc.eval ("f(x)").toDouble());
+	calc.setVariable (calc.idOfVariable ("a"), doubleValue (5));
+	EXPECT_EQ (6, calc.eval ("f(1)").toDouble());
+	EXPECT_FALSE (calc._parserContext()->findFunction ("f")->isPure());
+	EXPECT_FALSE (calc.setMemoization ("f", 16));
+}
+
+TEST_F (TestUserFunction, redefinition) {
+	calc.eval ("f(x) = x + 1");
+	calc.eval ("g(x) = f(x) * 2");
+	EXPECT_EQ (4, calc.eval ("g(1)").toDouble());
+	calc.eval ("f(x) = x + 10");
+	EXPECT_EQ (11, calc.eval ("f(1)").toDouble());
+	EXPECT_EQ (4, calc.eval ("g(1)").toDouble()); // g was bound to the former f
+
+	EXPECT_EQ (error::Parser_NoValidToken, calc.eval ("sin(x) = x").error());
+	EXPECT_EQ (error::Parser_NoValidToken, calc.eval ("PI(x) = x").error());
+	EXPECT_EQ (error::Parser_NoValidToken, calc.eval ("h(x, x) = x").error());
+	EXPECT_EQ (error::Parser_NoValidToken, calc.eval ("h(x) =").error());
+	EXPECT_FALSE (calc._parserContext()->findFunction ("h"));
+	EXPECT_EQ (0, calc.eval ("sin(0)").toDouble());
+}
+
+TEST_F (TestUserFunction, parsedDefinition) {
+	ExpressionPtr definition = calc.parse ("f(x) = x^2");
+	EXPECT_FALSE (calc._parserContext()->findFunction ("f")); // parsing alone defines nothing
+	EXPECT_EQ (PT_NULL, calc.eval (definition).type());
+	EXPECT_EQ (9, calc.eval (calc.parse ("f(3)")).toDouble());
+	calc.eval (definition); // same function again, stays registered
+	EXPECT_EQ (16, calc.eval ("f(4)").toDouble());
+}
+
+TEST_F (TestUserFunction, errorsAndAccurate) {
+	calc.setAccurateLevel();
+	calc.eval ("inv(x) = 1 / x");
+	PrimitiveValue third = calc.eval ("inv(3)");
+	EXPECT_EQ (PT_FRACTION, third.type());
+	EXPECT_EQ (1, calc.eval ("inv(3) * 3").toDouble());
+	EXPECT_EQ (error::Eval_DivisionByZero, calc.eval ("inv(0)").error());
+	EXPECT_EQ (error::Eval_DivisionByZero, calc.eval ("inv(inv(0))").error());
+}
+
+TEST_F (TestUserFunction, memoization) {
+	calc.eval ("f(x) = sin(x)^2 + cos(x)^2");
+	ASSERT_TRUE (calc._parserContext()->findFunction ("f")->isPure());
+	ASSERT_TRUE (calc.setMemoization ("f", 16));
+	EXPECT_DOUBLE_EQ (1, calc.eval ("f(1)").toDouble());
+	EXPECT_DOUBLE_EQ (1, calc.eval ("f(1)").toDouble());
+	EXPECT_EQ (1u, calc._parserContext()->findFunction ("f")->memoTable()->stats().hits);
+}
+
+TEST_F (TestUserFunction, print) {
+	ExpressionPtr definition = calc.parse ("f(x, y) = x^2 + y");
+	ASSERT_EQ (EK_DEFINITION, definition->kind());
+	EXPECT_EQ ("f(x, y) = x ^ 2 + y", definition->printNice());
+	EXPECT_EQ ("x ^ 2 + y", static_cast<const FunctionDefinition&> (*definition).function()->body()->printNice());
+}
+
+TEST_F (TestUserFunction, columnInlining) {
+	calc.eval ("f(x, y) = x^2 + y");
+	calc.eval ("g(x) = f(x, x) - 1 / (1 + x^2)");
+	calc.eval ("id(x) = x");
+	const char * expressions[] = { "g(a) + f(a, b)", "g(g(a))", "id(a)", "f(id(b), 3)" };
+	VariableId a = calc.idOfVariable ("a");
+	VariableId b = calc.idOfVariable ("b");
+	const size_t count = 300;
+	std::vector<double> as (count), bs (count);
+	for (size_t i = 0; i < count; i++) {
+		as[i] = i * 0.25 - 30;
+		bs[i] = i % 7;
+	}
+	for (size_t e = 0; e < sizeof (expressions) / sizeof (expressions[0]); e++) {
+		ExpressionPtr exp = calc.parse (expressions[e]);
+		ColumnEvaluator inlined, called;
+		called.setInlineLimit (0);
+		ASSERT_EQ (NoError, inlined.compile (exp)) << expressions[e];
+		ASSERT_EQ (NoError, called.compile (exp)) << expressions[e];
+		std::vector<double> inlinedOutput (count), calledOutput (count);
+		ColumnEvaluator * evaluators[] = { &inlined, &called };
+		std::vector<double> * outputs[] = { &inlinedOutput, &calledOutput };
+		for (int k = 0; k < 2; k++) {
+			evaluators[k]->bind (a, &as[0]);
+			evaluators[k]->bind (b, &bs[0]);
+			size_t errors = 1;
+			ASSERT_EQ (NoError, evaluators[k]->evaluate (count, &(*outputs[k])[0], 0, &errors));
+			EXPECT_EQ (0u, errors);
+		}
+		for (size_t i = 0; i < count; i++) {
+			EvaluationContext context;
+			context.setVariable (a, doubleValue (as[i]));
+			context.setVariable (b, doubleValue (bs[i]));
+			double expected = exp->eval (&context).toDouble();
+			ASSERT_DOUBLE_EQ (expected, inlinedOutput[i]) << expressions[e] << " row " << i;
+			ASSERT_DOUBLE_EQ (expected, calledOutput[i]) << expressions[e] << " row " << i;
+		}
+	}
+}
+
+TEST_F (TestUserFunction, columnCallsReadingVariables) {
+	calc.eval ("f(x) = x + c");
+	calc.eval ("g(x) = f(x) * d");
+	calc.eval ("h(x) = sum(k, 1, 3, k * x) + c"); // a reduction, never inlined
+	calc.eval ("s(x) = x + (c = 1)");
+	VariableId t = calc.idOfVariable ("t");
+	VariableId c = calc.idOfVariable ("c");
+	VariableId d = calc.idOfVariable ("d");
+	const size_t count = 300;
+	std::vector<double> ts (count), cs (count), ds (count);
+	for (size_t i = 0; i < count; i++) {
+		ts[i] = i * 0.5 - 20;
+		cs[i] = i % 5;
+		ds[i] = 3 - (double) (i % 3);
+	}
+	const char * expressions[] = { "f(t)", "g(t) + t", "h(t)" };
+	for (size_t e = 0; e < sizeof (expressions) / sizeof (expressions[0]); e++) {
+		ExpressionPtr exp = calc.parse (expressions[e]);
+		ColumnEvaluator called;
+		called.setInlineLimit (0);
+		ASSERT_EQ (NoError, called.compile (exp)) << expressions[e];
+		// the variables of the bodies are needed as well, e.g. to choose between columns and the context
+		EXPECT_NE (called.variables().end(), std::find (called.variables().begin(), called.variables().end(), c)) << expressions[e];
+		EXPECT_EQ (e == 1 ? 3u : 2u, called.variables().size()) << expressions[e];
+		std::vector<double> output (count);
+		EXPECT_EQ (error::Eval_UnboundVariable, called.evaluate (count, &output[0]));
+		called.bind (t, &ts[0]);
+		called.bind (c, &cs[0]);
+		called.bind (d, &ds[0]);
+		size_t errors = 1;
+		ASSERT_EQ (NoError, called.evaluate (count, &output[0], 0, &errors));
+		EXPECT_EQ (0u, errors);
+		for (size_t i = 0; i < count; i++) {
+			EvaluationContext context;
+			context.setVariable (t, doubleValue (ts[i]));
+			context.setVariable (c, doubleValue (cs[i]));
+			context.setVariable (d, doubleValue (ds[i]));
+			ASSERT_DOUBLE_EQ (exp->eval (&context).toDouble(), output[i]) << expressions[e] << " row " << i;
+		}
+	}
+	// bodies writing variables are not supported
+	ColumnEvaluator writing;
+	writing.setInlineLimit (0);
+	EXPECT_EQ (error::NotSupported, writing.compile (calc.parse ("s(t)")));
+}
@@ -0,0 +1,105 @@
+/* Checks the C interface and compares per call overhead of compiled handles with the string path */
+#include <smallcalc/smallcalc_c.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static double now (void) {
+	struct timespec t;
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void testValues (void) {
+	sc_env * env = sc_env_create (1);
+	sc_expr * expr = 0;
+	sc_value value;
+	char output[64];
+
+	CHECK (sc_compile (env, "1/3 + x", &expr) == 0);
+	CHECK (expr != 0);
+	int x = sc_variable_id (env, "x");
+	sc_set_variable (env, x, 2);
+	CHECK (sc_eval (env, expr, &value) == 0);
+	CHECK (value.type == SC_DOUBLE);
+	CHECK (fabs (value.d - 7.0 / 3) < 1e-12);
+	sc_expr_free (expr);
+
+	CHECK (sc_compile (env, "1/3 + 2", &expr) == 0);
+	CHECK (sc_eval (env, expr, &value) == 0);
+	CHECK (value.type == SC_FRACTION);
+	CHECK (value.numerator == 7 && value.denominator == 3);
+	sc_expr_free (expr);
+
+	CHECK (sc_compile (env, "1/0", &expr) == 0);
+	int error = 0;
+	CHECK (isnan (sc_eval_double (env, expr, &error)));
+	CHECK (error != 0);
+	CHECK (sc_eval (env, expr, &value) == error && value.type == SC_ERROR);
+	sc_expr_free (expr);
+
+	CHECK (sc_compile (env, "(1+", &expr) != 0);
+	CHECK (expr == 0);
+
+	CHECK (sc_compile (env, "f(x) = x^2", &expr) == 0);
+	CHECK (sc_eval (env, expr, &value) == 0 && value.type == SC_NULL);
+	sc_expr_free (expr);
+	CHECK (sc_compile (env, "f(3)", &expr) == 0);
+	CHECK (sc_eval_double (env, expr, 0) == 9);
+	sc_expr_free (expr);
+	CHECK (sc_eval_string (env, "g(x) = x + 1", output, sizeof (output)) == 0);
+	CHECK (sc_eval_string (env, "g(f(2))", output, sizeof (output)) == 0);
+	CHECK (strcmp (output, "5") == 0);
+
+	CHECK (sc_eval_string (env, "1/4 + 1/4", output, sizeof (output)) == 0);
+	CHECK (strcmp (output, "1/2") == 0);
+	CHECK (sc_eval_string (env, "1/4 + 1/4", output, 2) == 0);
+	CHECK (strcmp (output, "1") == 0);
+	sc_env_free (env);
+}
+
+static void compareOverhead (void) {
+	const int calls = 20000;
+	sc_env * env = sc_env_create (0);
+	sc_expr * expr = 0;
+	char output[64];
+	int x = sc_variable_id (env, "x");
+	double sum = 0;
+	int i;
+
+	double start = now ();
+	for (i = 0; i < calls; i++) {
+		char input[64];
+		snprintf (input, sizeof (input), "sin(%d) * 3 + 1", i);
+		sc_eval_string (env, input, output, sizeof (output));
+	}
+	double stringPath = (now () - start) / calls;
+
+	CHECK (sc_compile (env, "sin(x) * 3 + 1", &expr) == 0);
+	start = now ();
+	for (i = 0; i < calls; i++) {
+		sc_set_variable (env, x, i);
+		sum += sc_eval_double (env, expr, 0);
+	}
+	double handlePath = (now () - start) / calls;
+	sc_expr_free (expr);
+	sc_env_free (env);
+
+	printf ("sin(x) * 3 + 1: %.0fns/call string path, %.0fns/call compiled handle, sum %g\n", stringPath * 1e9, handlePath * 1e9, sum);
+	CHECK (handlePath < stringPath);
+}
+
+int main (void) {
+	testValues ();
+	compareOverhead ();
+	if (failures) {
+		fprintf (stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}